@@ -0,0 +1,336 @@
+#include "AlsaMidiInput.h"
+#include <cerrno>
+#include <ctime>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+const size_t AlsaMidiInput::MAX_MESSAGE_BYTES;
+
+namespace {
+
+// Data bytes after a status byte; system real-time is handled separately
+size_t dataBytes(unsigned char status) {
+    if (status < 0xF0) {
+        unsigned char high = status & 0xF0;
+        return high == 0xC0 || high == 0xD0 ? 1 : 2;
+    }
+    switch (status) {
+        case 0xF1: return 1;   // MTC quarter frame
+        case 0xF2: return 2;   // song position
+        case 0xF3: return 1;   // song select
+        default: return 0;
+    }
+}
+
+} // namespace
+
+AlsaMidiInput::AlsaMidiInput()
+    : sequencer(nullptr)
+    , decoder(nullptr)
+    , queue(-1)
+    , queueOffsetNs(0)
+    , rawMidi(nullptr)
+    , rawTimestamps(false)
+    , epollFd(epoll_create1(EPOLL_CLOEXEC))
+    , stopFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , running(false)
+    , runningStatus(0)
+    , messageSize(0)
+    , expectedSize(0)
+    , inSysEx(false)
+    , messages(0)
+    , wakeups(0)
+    , overruns(0)
+    , oversized(0)
+{
+    if (epollFd >= 0 && stopFd >= 0) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = stopFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd, &event);
+    }
+}
+
+AlsaMidiInput::~AlsaMidiInput() {
+    stop();
+    if (decoder) snd_midi_event_free(decoder);
+    if (sequencer) snd_seq_close(sequencer);
+    if (rawMidi) snd_rawmidi_close(rawMidi);
+    if (stopFd >= 0) close(stopFd);
+    if (epollFd >= 0) close(epollFd);
+}
+
+int64_t AlsaMidiInput::monotonicNs() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
+
+bool AlsaMidiInput::watch(int count, struct pollfd* descriptors, std::string& error) {
+    if (epollFd < 0 || stopFd < 0) {
+        error = "epoll unavailable";
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = descriptors[i].fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, descriptors[i].fd, &event) < 0 && errno != EEXIST) {
+            error = "epoll_ctl failed";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool AlsaMidiInput::openSequencer(const std::string& source, std::string& error) {
+    int result = snd_seq_open(&sequencer, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK);
+    if (result < 0) {
+        sequencer = nullptr;
+        error = std::string("cannot open sequencer: ") + snd_strerror(result);
+        return false;
+    }
+    snd_seq_set_client_name(sequencer, "MIDI Keyboard Monitor");
+
+    // Events are stamped with the queue's real time as they enter our port
+    queue = snd_seq_alloc_named_queue(sequencer, "input timestamps");
+    snd_seq_port_info_t* port;
+    snd_seq_port_info_alloca(&port);
+    snd_seq_port_info_set_name(port, "input");
+    snd_seq_port_info_set_capability(port, SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE);
+    snd_seq_port_info_set_type(port, SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+    snd_seq_port_info_set_timestamping(port, 1);
+    snd_seq_port_info_set_timestamp_real(port, 1);
+    snd_seq_port_info_set_timestamp_queue(port, queue);
+    if (queue < 0 || (result = snd_seq_create_port(sequencer, port)) < 0) {
+        error = std::string("cannot create sequencer port: ") + snd_strerror(queue < 0 ? queue : result);
+        return false;
+    }
+
+    snd_seq_addr_t address;
+    if ((result = snd_seq_parse_address(sequencer, &address, source.c_str())) < 0 ||
+        (result = snd_seq_connect_from(sequencer, snd_seq_port_info_get_port(port), address.client, address.port)) < 0) {
+        error = "cannot connect to " + source + ": " + snd_strerror(result);
+        return false;
+    }
+
+    snd_seq_start_queue(sequencer, queue, nullptr);
+    snd_seq_drain_output(sequencer);
+    snd_seq_queue_status_t* status;
+    snd_seq_queue_status_alloca(&status);
+    snd_seq_get_queue_status(sequencer, queue, status);
+    const snd_seq_real_time_t* queueTime = snd_seq_queue_status_get_real_time(status);
+    queueOffsetNs = monotonicNs() - (static_cast<int64_t>(queueTime->tv_sec) * 1000000000LL + queueTime->tv_nsec);
+
+    if ((result = snd_midi_event_new(MAX_MESSAGE_BYTES, &decoder)) < 0) {
+        decoder = nullptr;
+        error = std::string("cannot create event decoder: ") + snd_strerror(result);
+        return false;
+    }
+    snd_midi_event_no_status(decoder, 1);
+
+    snd_seq_client_info_t* client;
+    snd_seq_client_info_alloca(&client);
+    sourceName = source;
+    if (snd_seq_get_any_client_info(sequencer, address.client, client) >= 0) {
+        sourceName = std::string(snd_seq_client_info_get_name(client)) + ":" + std::to_string(address.port);
+    }
+
+    int count = snd_seq_poll_descriptors_count(sequencer, POLLIN);
+    std::vector<struct pollfd> descriptors(count);
+    snd_seq_poll_descriptors(sequencer, descriptors.data(), count, POLLIN);
+    return watch(count, descriptors.data(), error);
+}
+
+bool AlsaMidiInput::openRawMidi(const std::string& device, std::string& error) {
+    int result = snd_rawmidi_open(&rawMidi, nullptr, device.c_str(), SND_RAWMIDI_NONBLOCK);
+    if (result < 0) {
+        rawMidi = nullptr;
+        error = "cannot open " + device + ": " + snd_strerror(result);
+        return false;
+    }
+
+#if SND_LIB_VERSION >= 0x010206
+    // Let the kernel frame reads with the arrival time of their first byte
+    snd_rawmidi_params_t* params;
+    snd_rawmidi_params_alloca(&params);
+    snd_rawmidi_params_current(rawMidi, params);
+    snd_rawmidi_params_set_read_mode(rawMidi, params, SND_RAWMIDI_READ_TSTAMP);
+    snd_rawmidi_params_set_clock_type(rawMidi, params, SND_RAWMIDI_CLOCK_MONOTONIC);
+    rawTimestamps = snd_rawmidi_params(rawMidi, params) >= 0;
+#endif
+    if (!rawTimestamps) {
+        std::cerr << "Rawmidi timestamps unavailable, stamping on read" << std::endl;
+    }
+
+    sourceName = device;
+    int count = snd_rawmidi_poll_descriptors_count(rawMidi);
+    std::vector<struct pollfd> descriptors(count);
+    snd_rawmidi_poll_descriptors(rawMidi, descriptors.data(), count);
+    return watch(count, descriptors.data(), error);
+}
+
+bool AlsaMidiInput::start(const Callback& onMessage, std::string& error) {
+    if (!sequencer && !rawMidi) {
+        error = "no ALSA source open";
+        return false;
+    }
+    callback = onMessage;
+    running = true;
+    thread = std::thread(&AlsaMidiInput::run, this);
+    return true;
+}
+
+void AlsaMidiInput::stop() {
+    if (!thread.joinable()) return;
+    running = false;
+    uint64_t one = 1;
+    ssize_t written = write(stopFd, &one, sizeof(one));
+    (void)written;
+    thread.join();
+}
+
+std::string AlsaMidiInput::getSourceName() const {
+    return sourceName;
+}
+
+AlsaMidiInput::Stats AlsaMidiInput::getStats() const {
+    Stats stats;
+    stats.messages = messages.load(std::memory_order_relaxed);
+    stats.wakeups = wakeups.load(std::memory_order_relaxed);
+    stats.overruns = overruns.load(std::memory_order_relaxed);
+    stats.oversized = oversized.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AlsaMidiInput::run() {
+    epoll_event events[8];
+    while (running.load()) {
+        int count = epoll_wait(epollFd, events, 8, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "ALSA input: epoll_wait failed" << std::endl;
+            return;
+        }
+        wakeups.fetch_add(1, std::memory_order_relaxed);
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd == stopFd) return;
+        }
+        if (sequencer) {
+            readSequencer();
+        } else {
+            readRawMidi();
+        }
+    }
+}
+
+void AlsaMidiInput::readSequencer() {
+    unsigned char buffer[MAX_MESSAGE_BYTES];
+    snd_seq_event_t* event;
+    for (;;) {
+        int result = snd_seq_event_input(sequencer, &event);
+        if (result == -ENOSPC) {
+            overruns.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (result < 0) return;   // -EAGAIN: drained
+
+        int64_t timeNs = (event->flags & SND_SEQ_TIME_STAMP_MASK) == SND_SEQ_TIME_STAMP_REAL
+            ? queueOffsetNs + static_cast<int64_t>(event->time.time.tv_sec) * 1000000000LL + event->time.time.tv_nsec
+            : monotonicNs();
+        long size = snd_midi_event_decode(decoder, buffer, sizeof(buffer), event);
+        if (size == -ENOMEM) {
+            oversized.fetch_add(1, std::memory_order_relaxed);
+        } else if (size > 0) {
+            deliver(timeNs, buffer, static_cast<size_t>(size));
+        }
+        // Anything else is a port announcement or a non-MIDI event
+    }
+}
+
+void AlsaMidiInput::readRawMidi() {
+    unsigned char buffer[256];
+    for (;;) {
+        ssize_t count;
+        int64_t timeNs;
+#if SND_LIB_VERSION >= 0x010206
+        if (rawTimestamps) {
+            timespec stamp;
+            count = snd_rawmidi_tread(rawMidi, &stamp, buffer, sizeof(buffer));
+            timeNs = static_cast<int64_t>(stamp.tv_sec) * 1000000000LL + stamp.tv_nsec;
+        } else
+#endif
+        {
+            count = snd_rawmidi_read(rawMidi, buffer, sizeof(buffer));
+            timeNs = monotonicNs();
+        }
+        if (count <= 0) return;   // -EAGAIN: drained
+        for (ssize_t i = 0; i < count; i++) {
+            parseByte(timeNs, buffer[i]);
+        }
+    }
+}
+
+void AlsaMidiInput::parseByte(int64_t timeNs, unsigned char byte) {
+    // Real-time messages may arrive between any two bytes
+    if (byte >= 0xF8) {
+        deliver(timeNs, &byte, 1);
+        return;
+    }
+
+    if (inSysEx) {
+        if (byte < 0x80 || byte == 0xF7) {
+            if (messageSize < MAX_MESSAGE_BYTES) message[messageSize] = byte;
+            messageSize++;
+            if (byte != 0xF7) return;
+            if (messageSize <= MAX_MESSAGE_BYTES) {
+                deliver(timeNs, message, messageSize);
+            } else {
+                oversized.fetch_add(1, std::memory_order_relaxed);
+            }
+            inSysEx = false;
+            messageSize = 0;
+            return;
+        }
+        // Any other status byte ends an unterminated SysEx
+        inSysEx = false;
+        messageSize = 0;
+    }
+
+    if (byte & 0x80) {
+        message[0] = byte;
+        messageSize = 1;
+        if (byte == 0xF0) {
+            inSysEx = true;
+            runningStatus = 0;
+            return;
+        }
+        // System common messages cancel running status
+        runningStatus = byte < 0xF0 ? byte : 0;
+        expectedSize = 1 + dataBytes(byte);
+        if (expectedSize == 1) {
+            deliver(timeNs, message, 1);
+            messageSize = 0;
+        }
+        return;
+    }
+
+    if (messageSize == 0) {
+        if (runningStatus == 0) return;   // stray data byte
+        message[0] = runningStatus;
+        messageSize = 1;
+        expectedSize = 1 + dataBytes(runningStatus);
+    }
+    message[messageSize++] = byte;
+    if (messageSize == expectedSize) {
+        deliver(timeNs, message, messageSize);
+        messageSize = 0;
+    }
+}
+
+void AlsaMidiInput::deliver(int64_t timeNs, const unsigned char* data, size_t size) {
+    messages.fetch_add(1, std::memory_order_relaxed);
+    callback(timeNs, data, size);
+}
\ No newline at end of file
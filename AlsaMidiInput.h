@@ -0,0 +1,80 @@
+#pragma once
+
+#include <alsa/asoundlib.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Linux MIDI input that reads ALSA directly instead of through RtMidi. The
+// sequencer or rawmidi descriptors are multiplexed with epoll on one ingest
+// thread, which hands every message on with its kernel timestamp, so there
+// is no callback thread between the driver and our own ring.
+//
+// Built only with -DMIDI_MONITOR_ALSA=ON.
+class AlsaMidiInput {
+public:
+    // CLOCK_MONOTONIC nanoseconds of arrival, as stamped by the kernel
+    using Callback = std::function<void(int64_t timeNs, const unsigned char* data, size_t size)>;
+
+    struct Stats {
+        uint64_t messages;
+        uint64_t wakeups;     // epoll returns
+        uint64_t overruns;    // kernel buffer overflowed
+        uint64_t oversized;   // SysEx longer than MAX_MESSAGE_BYTES
+    };
+
+    static const size_t MAX_MESSAGE_BYTES = 256;
+
+    AlsaMidiInput();
+    ~AlsaMidiInput();
+
+    // Subscribes to a sequencer port, e.g. "24:0" or "Keystation:0"
+    bool openSequencer(const std::string& source, std::string& error);
+    // Opens a rawmidi device, e.g. "hw:1,0,0"
+    bool openRawMidi(const std::string& device, std::string& error);
+
+    bool start(const Callback& callback, std::string& error);
+    void stop();
+
+    std::string getSourceName() const;
+    Stats getStats() const;
+
+private:
+    snd_seq_t* sequencer;
+    snd_midi_event_t* decoder;
+    int queue;
+    int64_t queueOffsetNs;            // CLOCK_MONOTONIC at queue time zero
+    snd_rawmidi_t* rawMidi;
+    bool rawTimestamps;               // kernel-framed reads (ALSA 1.2.6+)
+    std::string sourceName;
+
+    int epollFd;
+    int stopFd;                       // eventfd that wakes the thread to exit
+    std::thread thread;
+    std::atomic<bool> running;
+    Callback callback;
+
+    // Rawmidi byte stream parser state
+    unsigned char runningStatus;
+    unsigned char message[MAX_MESSAGE_BYTES];
+    size_t messageSize;
+    size_t expectedSize;
+    bool inSysEx;
+
+    std::atomic<uint64_t> messages;
+    std::atomic<uint64_t> wakeups;
+    std::atomic<uint64_t> overruns;
+    std::atomic<uint64_t> oversized;
+
+    void run();
+    void readSequencer();
+    void readRawMidi();
+    void parseByte(int64_t timeNs, unsigned char byte);
+    void deliver(int64_t timeNs, const unsigned char* data, size_t size);
+    bool watch(int count, struct pollfd* descriptors, std::string& error);
+
+    static int64_t monotonicNs();
+};
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "AlsaPortWatcher.h"
+#include <QSocketNotifier>
+
+AlsaPortWatcher::AlsaPortWatcher(QObject* parent)
+    : QObject(parent)
+    , sequencer(nullptr)
+    , notifier(nullptr)
+    , announcements(0)
+{
+}
+
+AlsaPortWatcher::~AlsaPortWatcher() {
+    delete notifier;
+    if (sequencer) snd_seq_close(sequencer);
+}
+
+bool AlsaPortWatcher::start(std::string& error) {
+    int result = snd_seq_open(&sequencer, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK);
+    if (result < 0) {
+        sequencer = nullptr;
+        error = std::string("cannot open sequencer: ") + snd_strerror(result);
+        return false;
+    }
+    snd_seq_set_client_name(sequencer, "MIDI Keyboard Monitor (ports)");
+
+    // Hidden from other clients' port lists, including our own RtMidi scan
+    int port = snd_seq_create_simple_port(sequencer, "announcements",
+                                          SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_NO_EXPORT,
+                                          SND_SEQ_PORT_TYPE_APPLICATION);
+    if (port < 0 ||
+        (result = snd_seq_connect_from(sequencer, port, SND_SEQ_CLIENT_SYSTEM, SND_SEQ_PORT_SYSTEM_ANNOUNCE)) < 0) {
+        error = std::string("cannot subscribe to announcements: ") + snd_strerror(port < 0 ? port : result);
+        return false;
+    }
+
+    struct pollfd descriptor;
+    if (snd_seq_poll_descriptors(sequencer, &descriptor, 1, POLLIN) != 1) {
+        error = "no sequencer descriptor";
+        return false;
+    }
+    notifier = new QSocketNotifier(descriptor.fd, QSocketNotifier::Read);
+    connect(notifier, &QSocketNotifier::activated, this, &AlsaPortWatcher::onReadable);
+    return true;
+}
+
+uint64_t AlsaPortWatcher::getAnnouncements() const {
+    return announcements;
+}
+
+void AlsaPortWatcher::onReadable() {
+    bool changed = false;
+    snd_seq_event_t* event;
+    while (snd_seq_event_input(sequencer, &event) >= 0) {
+        switch (event->type) {
+        case SND_SEQ_EVENT_CLIENT_START:
+        case SND_SEQ_EVENT_CLIENT_EXIT:
+        case SND_SEQ_EVENT_PORT_START:
+        case SND_SEQ_EVENT_PORT_EXIT:
+            announcements++;
+            changed = true;
+            break;
+        default:
+            break;
+        }
+    }
+    if (changed) emit portsChanged();
+}
\ No newline at end of file
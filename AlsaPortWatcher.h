@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QObject>
+#include <alsa/asoundlib.h>
+#include <cstdint>
+#include <string>
+
+class QSocketNotifier;
+
+// Reports ALSA sequencer clients and ports coming and going, as announced
+// by the kernel on System:Announce, so device detection needs no polling.
+// The sequencer descriptor is watched by the Qt event loop; nothing runs
+// between announcements.
+//
+// Built only with -DMIDI_MONITOR_ALSA=ON.
+class AlsaPortWatcher : public QObject {
+    Q_OBJECT
+
+public:
+    explicit AlsaPortWatcher(QObject* parent = nullptr);
+    ~AlsaPortWatcher();
+
+    bool start(std::string& error);
+    uint64_t getAnnouncements() const;
+
+signals:
+    // One per batch of announcements read together
+    void portsChanged();
+
+private slots:
+    void onReadable();
+
+private:
+    snd_seq_t* sequencer;
+    QSocketNotifier* notifier;
+    uint64_t announcements;
+};
\ No newline at end of file
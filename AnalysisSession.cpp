@@ -0,0 +1,395 @@
+#include "AnalysisSession.h"
+#include "MidiManager.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <set>
+
+AnalysisSession::AnalysisSession(int id, const std::string& name, int keySignatureIndex,
+                                 MusicTheoryEngine* theoryEngine)
+    : id(id)
+    , name(name)
+    , keySignatureIndex(keySignatureIndex)
+    , theoryEngine(theoryEngine)
+    , chordAnalyzer(theoryEngine)
+    , scheduled(false)
+    , closeRequested(false)
+    , closed(false)
+    , closedInDrain(false)
+    , sustainDown(false)
+    , chordChanged(false)
+    , catalogBuilder(theoryEngine)
+    , startNs(monotonicNs())
+    , startWallClockMs(std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch()).count())
+    , output(nullptr)
+    , checkpointIntervalNs(0)
+    , lastCheckpointNs(0)
+    , eventsProcessed(0)
+    , analysesRun(0)
+    , totalLatencyNs(0)
+    , latencySamples(0)
+    , maxLatencyNs(0)
+{
+    std::memset(velocities, 0, sizeof(velocities));
+    std::memset(pitchClassCounts, 0, sizeof(pitchClassCounts));
+    inbox.reserve(256);
+    processing.reserve(256);
+}
+
+int AnalysisSession::getId() const {
+    return id;
+}
+
+const std::string& AnalysisSession::getName() const {
+    return name;
+}
+
+int AnalysisSession::getKeySignatureIndex() const {
+    return keySignatureIndex;
+}
+
+void AnalysisSession::attachPlugins(std::unique_ptr<PluginHost::Chain> chain) {
+    plugins = std::move(chain);
+    pluginEvents.reserve(256);
+}
+
+void AnalysisSession::attachOutput(OutputSink* sink, int64_t checkpointIntervalNs) {
+    output = sink;
+    this->checkpointIntervalNs = checkpointIntervalNs;
+    if (!output) return;
+
+    int64_t wallClockMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    int64_t timeNs = monotonicNs() - startNs;
+    output->writeSessionOpen(id, timeNs, wallClockMs, name.data(), name.size());
+
+    // Seeking always finds a checkpoint, even before the first interval elapses
+    QMutexLocker locker(&stateMutex);
+    writeCheckpoint(timeNs);
+}
+
+void AnalysisSession::closeOutput() {
+    if (!output) return;
+    output->writeSessionClose(id, monotonicNs() - startNs);
+}
+
+const std::bitset<128>& AnalysisSession::getHeldNotes() const {
+    return heldNotes;
+}
+
+const QString& AnalysisSession::getChordName() const {
+    return chordName;
+}
+
+const QString& AnalysisSession::getRomanNumeral() const {
+    return romanNumeral;
+}
+
+bool AnalysisSession::chordChangedInLastDrain() const {
+    return chordChanged;
+}
+
+bool AnalysisSession::closedInLastDrain() const {
+    return closedInDrain;
+}
+
+bool AnalysisSession::isClosed() const {
+    return closed.load();
+}
+
+const std::vector<PluginHost::Result>& AnalysisSession::getPluginResults() const {
+    static const std::vector<PluginHost::Result> none;
+    return plugins ? plugins->getResults() : none;
+}
+
+int64_t AnalysisSession::monotonicNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SessionSnapshot AnalysisSession::takeSnapshot() const {
+    QMutexLocker locker(&stateMutex);
+    return snapshotLocked(monotonicNs() - startNs);
+}
+
+SessionSnapshot AnalysisSession::snapshotLocked(int64_t timeNs) const {
+    SessionSnapshot snapshot;
+    snapshot.sessionId = id;
+    snapshot.name = name;
+    snapshot.timeNs = timeNs;
+    snapshot.keySignatureIndex = keySignatureIndex;
+    snapshot.eventsProcessed = eventsProcessed.load();
+    snapshot.heldNotes = heldNotes;
+    snapshot.sustainedNotes = sustainedNotes;
+    snapshot.sustainDown = sustainDown;
+    std::memcpy(snapshot.velocities, velocities, sizeof(velocities));
+    std::memcpy(snapshot.pitchClassCounts, pitchClassCounts, sizeof(pitchClassCounts));
+    snapshot.chord = chordName.toStdString();
+    snapshot.roman = romanNumeral.toStdString();
+    snapshot.chordHistory.assign(chordHistory.begin(), chordHistory.end());
+    catalogBuilder.save(snapshot.catalogState);
+    return snapshot;
+}
+
+void AnalysisSession::restoreSnapshot(const SessionSnapshot& snapshot) {
+    QMutexLocker locker(&stateMutex);
+    keySignatureIndex = snapshot.keySignatureIndex;
+    eventsProcessed = snapshot.eventsProcessed;
+    heldNotes = snapshot.heldNotes;
+    sustainedNotes = snapshot.sustainedNotes;
+    sustainDown = snapshot.sustainDown;
+    std::memcpy(velocities, snapshot.velocities, sizeof(velocities));
+    std::memcpy(pitchClassCounts, snapshot.pitchClassCounts, sizeof(pitchClassCounts));
+    chordName = QString::fromStdString(snapshot.chord);
+    romanNumeral = QString::fromStdString(snapshot.roman);
+    chordHistory.assign(snapshot.chordHistory.begin(), snapshot.chordHistory.end());
+    if (!snapshot.catalogState.empty()) {
+        catalogBuilder.restore(snapshot.catalogState);
+    }
+    startNs = monotonicNs() - snapshot.timeNs;
+    startWallClockMs -= snapshot.timeNs / 1000000;
+}
+
+void AnalysisSession::writeCheckpoint(int64_t timeNs) {
+    checkpointBuffer.clear();
+    snapshotLocked(timeNs).serialize(checkpointBuffer);
+    output->writeCheckpoint(id, timeNs, checkpointBuffer.data(), checkpointBuffer.size());
+    lastCheckpointNs = timeNs;
+}
+
+bool AnalysisSession::submit(const unsigned char* data, size_t size) {
+    int64_t now = monotonicNs();
+    return enqueue(data, size, now, now);
+}
+
+bool AnalysisSession::submitRecorded(const unsigned char* data, size_t size, int64_t sessionTimeNs) {
+    return enqueue(data, size, startNs + sessionTimeNs, startNs + sessionTimeNs);
+}
+
+bool AnalysisSession::submitAt(const unsigned char* data, size_t size, int64_t eventNs) {
+    return enqueue(data, size, monotonicNs(), eventNs);
+}
+
+bool AnalysisSession::requestClose() {
+    closeRequested.store(true);
+    return !scheduled.exchange(true);
+}
+
+bool AnalysisSession::enqueue(const unsigned char* data, size_t size, int64_t enqueuedNs, int64_t eventNs) {
+    // Only channel voice messages matter for analysis; SysEx stays out of the inbox
+    if (size == 0 || size > 3) return false;
+
+    PendingEvent event;
+    event.enqueuedNs = enqueuedNs;
+    event.eventNs = eventNs;
+    event.size = static_cast<unsigned char>(size);
+    std::memcpy(event.bytes, data, size);
+
+    {
+        QMutexLocker locker(&inboxMutex);
+        inbox.push_back(event);
+    }
+
+    return !scheduled.exchange(true);
+}
+
+bool AnalysisSession::drain() {
+    // Read before the swap: everything submitted before the close request is in this batch
+    bool closing = closeRequested.load() && !closed.load();
+    closedInDrain = false;
+    {
+        QMutexLocker locker(&inboxMutex);
+        processing.swap(inbox);
+    }
+    if (processing.empty()) {
+        if (closing) finishClose();
+        return false;
+    }
+
+    QMutexLocker stateLocker(&stateMutex);
+    bool notesChanged = false;
+
+    // Note state is always updated exactly; analysis runs once per batch
+    for (const PendingEvent& pending : processing) {
+        if (output) {
+            output->writeMidi(id, pending.eventNs - startNs, pending.bytes, pending.size);
+        }
+
+        // Sustain pedal (CC 64): notes released while it is down keep sounding
+        if ((pending.bytes[0] & 0xF0) == 0xB0 && pending.size == 3 && pending.bytes[1] == 64) {
+            bool down = pending.bytes[2] >= 64;
+            if (!down && sustainedNotes.any()) {
+                sustainedNotes.reset();
+                notesChanged = true;
+            }
+            sustainDown = down;
+            continue;
+        }
+
+        MusicTypes::MidiEvent event = MidiManager::parseMidiMessage(pending.bytes, pending.size);
+        int note = event.noteNumber & 0x7F;
+        if (event.type == MusicTypes::MidiEventType::NoteOn) {
+            heldNotes[note] = true;
+            velocities[note] = static_cast<unsigned char>(event.velocity);
+            pitchClassCounts[note % 12]++;
+            catalogBuilder.noteOn(pending.eventNs - startNs, note);
+            notesChanged = true;
+        } else if (event.type == MusicTypes::MidiEventType::NoteOff) {
+            heldNotes[note] = false;
+            velocities[note] = 0;
+            if (sustainDown) sustainedNotes[note] = true;
+            notesChanged = true;
+        }
+    }
+
+    int64_t now = monotonicNs();
+    for (const PendingEvent& pending : processing) {
+        totalLatencyNs += now - pending.enqueuedNs;
+    }
+    latencySamples += processing.size();
+    int64_t oldest = now - processing.front().enqueuedNs;
+    int64_t previousMax = maxLatencyNs.load();
+    while (oldest > previousMax && !maxLatencyNs.compare_exchange_weak(previousMax, oldest)) {
+    }
+
+    eventsProcessed += processing.size();
+
+    // Session time of the batch is that of its newest event, so replays line up
+    int64_t batchTimeNs = processing.back().eventNs - startNs;
+
+    chordChanged = notesChanged && analyze();
+    if (chordChanged) {
+        chordHistory.push_back({batchTimeNs, chordName.toStdString(), romanNumeral.toStdString()});
+        if (chordHistory.size() > CHORD_HISTORY_LENGTH) {
+            chordHistory.pop_front();
+        }
+    }
+
+    size_t annotations = runPlugins();
+    if (output) {
+        if (chordChanged || annotations > 0) {
+            writeResults(batchTimeNs);
+        }
+        if (checkpointIntervalNs > 0 && batchTimeNs - lastCheckpointNs >= checkpointIntervalNs) {
+            writeCheckpoint(batchTimeNs);
+        }
+    }
+    processing.clear();
+
+    if (closing) finishClose();
+
+    return chordChanged || annotations > 0;
+}
+
+void AnalysisSession::finishClose() {
+    closeOutput();
+    closedInDrain = true;
+    closed = true;
+}
+
+bool AnalysisSession::releaseAfterDrain() {
+    scheduled.store(false);
+
+    bool hasMore;
+    {
+        QMutexLocker locker(&inboxMutex);
+        hasMore = !inbox.empty();
+    }
+    // A close requested during the drain still needs a drain of its own
+    hasMore = hasMore || (closeRequested.load() && !closed.load());
+    return hasMore && !scheduled.exchange(true);
+}
+
+bool AnalysisSession::analyze() {
+    const MusicTypes::KeySignature& key = theoryEngine->getKeySignature(keySignatureIndex);
+
+    std::bitset<128> soundingNotes = heldNotes | sustainedNotes;
+    std::set<int> activeNotes;
+    for (int note = 0; note < 128; note++) {
+        if (soundingNotes[note]) activeNotes.insert(note);
+    }
+
+    QString newChord = chordAnalyzer.analyzeNotes(activeNotes, key);
+    QString newRoman;
+    std::string quality;
+    if (activeNotes.size() >= 3) {
+        std::vector<int> notes(activeNotes.begin(), activeNotes.end());
+        MusicTypes::ChordAnalysis analysis = chordAnalyzer.analyzeChord(notes, key);
+        newRoman = analysis.romanNumeral;
+        quality = analysis.chordQuality;
+    }
+    analysesRun++;
+
+    if (newChord == chordName && newRoman == romanNumeral) return false;
+    chordName = newChord;
+    romanNumeral = newRoman;
+    if (!quality.empty()) catalogBuilder.chord(quality);
+    return true;
+}
+
+size_t AnalysisSession::runPlugins() {
+    if (!plugins) return 0;
+
+    pluginEvents.clear();
+    for (const PendingEvent& pending : processing) {
+        midimon_event event;
+        event.time_seconds = static_cast<double>(pending.eventNs - startNs) / 1e9;
+        event.status = pending.bytes[0];
+        event.data1 = pending.size > 1 ? pending.bytes[1] : 0;
+        event.data2 = pending.size > 2 ? pending.bytes[2] : 0;
+        event.size = pending.size;
+        event.source_id = static_cast<uint32_t>(id);
+        pluginEvents.push_back(event);
+    }
+
+    const MusicTypes::KeySignature& key = theoryEngine->getKeySignature(keySignatureIndex);
+    midimon_note_state state;
+    state.struct_size = sizeof(midimon_note_state);
+    state.held_count = static_cast<uint32_t>(heldNotes.count());
+    state.held[0] = 0;
+    state.held[1] = 0;
+    for (int note = 0; note < 128; note++) {
+        if (heldNotes[note]) state.held[note / 64] |= uint64_t(1) << (note % 64);
+    }
+    std::memcpy(state.velocity, velocities, sizeof(state.velocity));
+    state.key_signature_index = keySignatureIndex;
+    state.key_tonic = key.tonic;
+    state.key_is_major = key.isMajor ? 1 : 0;
+
+    return plugins->run(pluginEvents.data(), static_cast<uint32_t>(pluginEvents.size()), state);
+}
+
+void AnalysisSession::writeResults(int64_t timeNs) {
+    if (chordChanged) {
+        QByteArray chord = chordName.toUtf8();
+        QByteArray roman = romanNumeral.toUtf8();
+        output->writeChord(id, timeNs, chord.constData(), static_cast<size_t>(chord.size()),
+                           roman.constData(), static_cast<size_t>(roman.size()));
+    }
+
+    for (const PluginHost::Result& result : getPluginResults()) {
+        for (uint32_t i = 0; i < result.count; i++) {
+            output->writeAnnotation(id, timeNs, result.pluginName, std::strlen(result.pluginName),
+                                    result.annotations[i]);
+        }
+    }
+}
+
+AnalysisSession::Stats AnalysisSession::getStats() const {
+    Stats stats;
+    stats.eventsProcessed = eventsProcessed.load();
+    stats.analysesRun = analysesRun.load();
+    uint64_t samples = latencySamples.load();
+    stats.meanLatencyMs = samples > 0 ? static_cast<double>(totalLatencyNs.load()) / samples / 1e6 : 0.0;
+    stats.maxLatencyMs = static_cast<double>(maxLatencyNs.load()) / 1e6;
+    return stats;
+}
+
+SessionCatalog::Summary AnalysisSession::summarize() const {
+    QMutexLocker locker(&stateMutex);
+    SessionCatalog::Summary summary = catalogBuilder.finish(startWallClockMs, monotonicNs() - startNs);
+    summary.device = name;
+    return summary;
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "MusicTypes.h"
+#include "MusicTheoryEngine.h"
+#include "ChordAnalyzer.h"
+#include "PluginHost.h"
+#include "OutputSink.h"
+#include "SessionSnapshot.h"
+#include "SessionCatalog.h"
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One independent analysis stream (e.g. one classroom keyboard) with its own
+// note state, key and chord analyzer. Any thread may submit events; the
+// scheduler guarantees that only one worker drains a session at a time.
+class AnalysisSession {
+public:
+    struct Stats {
+        uint64_t eventsProcessed;
+        uint64_t analysesRun;
+        double meanLatencyMs;
+        double maxLatencyMs;
+    };
+
+    AnalysisSession(int id, const std::string& name, int keySignatureIndex, MusicTheoryEngine* theoryEngine);
+
+    int getId() const;
+    const std::string& getName() const;
+    int getKeySignatureIndex() const;
+    void attachPlugins(std::unique_ptr<PluginHost::Chain> chain);
+
+    // Records every event, chord change and annotation. Writes the open record,
+    // an initial checkpoint and then one every checkpointIntervalNs (0 = none).
+    void attachOutput(OutputSink* sink, int64_t checkpointIntervalNs);
+    void closeOutput();
+
+    // Any thread; reflects the last completed drain
+    SessionSnapshot takeSnapshot() const;
+    // Only before the session is first scheduled; the session clock continues from the snapshot
+    void restoreSnapshot(const SessionSnapshot& snapshot);
+
+    // Producer side - returns true when the session must be handed to the scheduler
+    bool submit(const unsigned char* data, size_t size);
+    // Journal replay: the event keeps its recorded session time
+    bool submitRecorded(const unsigned char* data, size_t size, int64_t sessionTimeNs);
+    // Live input with a de-jittered time stamp (steady clock, as monotonicNs)
+    bool submitAt(const unsigned char* data, size_t size, int64_t eventNs);
+    // Nothing may be submitted after this; the next drain processes what is
+    // queued, then writes the close record. Same return as submit.
+    bool requestClose();
+    static int64_t monotonicNs();
+
+    // Worker side
+    bool drain();            // true if the chord or a plugin annotation changed
+    bool releaseAfterDrain(); // true if new events arrived and the session must be rescheduled
+
+    // Analysis results (read on the draining worker)
+    const std::bitset<128>& getHeldNotes() const;
+    const QString& getChordName() const;
+    const QString& getRomanNumeral() const;
+    bool chordChangedInLastDrain() const;
+    bool closedInLastDrain() const;
+    bool isClosed() const;   // any thread
+    const std::vector<PluginHost::Result>& getPluginResults() const;
+
+    Stats getStats() const;
+
+    // Any thread; catalog row for the session so far (device = session name)
+    SessionCatalog::Summary summarize() const;
+
+private:
+    struct PendingEvent {
+        int64_t enqueuedNs;   // for latency
+        int64_t eventNs;      // when it was played: journal, catalog and plugin time
+        unsigned char size;
+        unsigned char bytes[3];
+    };
+
+    int id;
+    std::string name;
+    int keySignatureIndex;
+    MusicTheoryEngine* theoryEngine;
+    ChordAnalyzer chordAnalyzer;
+
+    // Double-buffered inbox: producers append, the worker swaps and processes
+    QMutex inboxMutex;
+    std::vector<PendingEvent> inbox;
+    std::vector<PendingEvent> processing;
+    std::atomic<bool> scheduled;
+    std::atomic<bool> closeRequested;
+    std::atomic<bool> closed;
+    bool closedInDrain;
+
+    static const size_t CHORD_HISTORY_LENGTH = 32;
+
+    // Everything from here to the statistics is written by the draining worker;
+    // stateMutex makes snapshots from other threads consistent
+    mutable QMutex stateMutex;
+
+    // Note state
+    std::bitset<128> heldNotes;
+    std::bitset<128> sustainedNotes;
+    bool sustainDown;
+    unsigned char velocities[128];
+    uint32_t pitchClassCounts[12];
+
+    // Analysis context
+    QString chordName;
+    QString romanNumeral;
+    bool chordChanged;
+    std::deque<SessionSnapshot::ChordSpan> chordHistory;
+    SessionCatalog::Builder catalogBuilder;
+
+    // Custom analyzers, fed the same batches on the draining worker
+    std::unique_ptr<PluginHost::Chain> plugins;
+    std::vector<midimon_event> pluginEvents;
+    int64_t startNs;
+    int64_t startWallClockMs;
+
+    OutputSink* output;
+    int64_t checkpointIntervalNs;
+    int64_t lastCheckpointNs;
+    std::vector<char> checkpointBuffer;
+
+    // Statistics
+    std::atomic<uint64_t> eventsProcessed;
+    std::atomic<uint64_t> analysesRun;
+    std::atomic<int64_t> totalLatencyNs;
+    std::atomic<uint64_t> latencySamples;  // events in totalLatencyNs; not restored from snapshots
+    std::atomic<int64_t> maxLatencyNs;
+
+    bool enqueue(const unsigned char* data, size_t size, int64_t enqueuedNs, int64_t eventNs);
+    bool analyze();
+    size_t runPlugins();
+    void writeResults(int64_t timeNs);
+    SessionSnapshot snapshotLocked(int64_t timeNs) const;
+    void writeCheckpoint(int64_t timeNs);
+    void finishClose();
+};
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef MIDIMON_ANALYZER_PLUGIN_H
+#define MIDIMON_ANALYZER_PLUGIN_H
+
+/*
+ * Stable C ABI for custom analyzers loaded with dlopen().
+ *
+ * A plugin exports one symbol, MIDIMON_ANALYZER_ENTRY_SYMBOL, returning a
+ * static midimon_analyzer_plugin table. The host creates one instance per
+ * analysis session and calls process_batch() on that session's worker thread
+ * with every drained batch of events and the note state after the batch.
+ * Annotations are written into host-owned, preallocated slots; the plugin
+ * must never write more than `capacity` entries and must not allocate per call.
+ *
+ * Every call has a time budget. Overruns are counted, and a plugin that keeps
+ * overrunning, returns an error or overfills its slots is disabled.
+ *
+ * Structs only ever grow at the end; check struct_size before reading new fields.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIDIMON_ANALYZER_ABI_VERSION 1
+#define MIDIMON_ANALYZER_ENTRY_SYMBOL "midimon_analyzer_plugin_entry"
+#define MIDIMON_ANNOTATION_TEXT_SIZE 48
+
+typedef struct midimon_event {
+    double time_seconds;     /* seconds since the session started */
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+    uint8_t size;            /* 1-3 bytes */
+    uint32_t source_id;
+} midimon_event;
+
+typedef struct midimon_note_state {
+    uint32_t struct_size;
+    uint32_t held_count;
+    uint64_t held[2];        /* bit n of held[n / 64] = note n is down */
+    uint8_t velocity[128];
+    int32_t key_signature_index;
+    int32_t key_tonic;       /* pitch class 0-11 */
+    int32_t key_is_major;
+} midimon_note_state;
+
+typedef struct midimon_annotation {
+    uint32_t kind;           /* plugin-defined */
+    int32_t value;
+    double time_seconds;
+    char text[MIDIMON_ANNOTATION_TEXT_SIZE];
+} midimon_annotation;
+
+typedef struct midimon_result_slots {
+    midimon_annotation* entries;
+    uint32_t capacity;
+    uint32_t count;          /* set by the plugin */
+} midimon_result_slots;
+
+typedef struct midimon_analyzer_plugin {
+    uint32_t abi_version;    /* MIDIMON_ANALYZER_ABI_VERSION */
+    uint32_t struct_size;    /* sizeof(midimon_analyzer_plugin) */
+    const char* name;
+
+    /* config is the host's --plugin-config string (may be empty, never NULL) */
+    void* (*create)(const char* config);
+    void (*destroy)(void* instance);
+
+    /* Return 0 on success; any other value disables the plugin */
+    int (*process_batch)(void* instance,
+                         const midimon_event* events, uint32_t event_count,
+                         const midimon_note_state* state,
+                         midimon_result_slots* results);
+} midimon_analyzer_plugin;
+
+typedef const midimon_analyzer_plugin* (*midimon_analyzer_entry_fn)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MIDIMON_ANALYZER_PLUGIN_H */
\ No newline at end of file
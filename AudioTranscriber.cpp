@@ -0,0 +1,114 @@
+#include "AudioTranscriber.h"
+#include "WavReader.h"
+#include "ChromaEngine.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+AudioTranscriber::AudioTranscriber(int keySignatureIndex, int workerCount, OutputSink* output)
+    : keySignatureIndex(keySignatureIndex)
+    , workerCount(std::max(1, workerCount))
+    , output(output)
+    , theoryEngine(&MusicTheoryEngine::instance())
+    , detectorConfig(PitchDetector::defaultConfig())
+{
+}
+
+void AudioTranscriber::setDetectorConfig(const PitchDetector::Config& config) {
+    detectorConfig = config;
+}
+
+std::vector<AudioTranscriber::Result> AudioTranscriber::run(const std::vector<std::string>& paths,
+                                                            const ChordCallback& onChord) {
+    std::vector<Result> results(paths.size());
+    std::atomic<size_t> nextFile(0);
+
+    // Files are independent; each worker takes the next one until none are left
+    auto worker = [&]() {
+        for (size_t i = nextFile++; i < paths.size(); i = nextFile++) {
+            results[i] = transcribe(static_cast<int>(i) + 1, paths[i], onChord);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    int count = std::min(workerCount, static_cast<int>(paths.size()));
+    for (int i = 1; i < count; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    return results;
+}
+
+AudioTranscriber::Result AudioTranscriber::transcribe(int sessionId, const std::string& path,
+                                                      const ChordCallback& onChord) const {
+    Result result;
+    result.path = path;
+    result.ok = false;
+    result.audioSeconds = 0.0;
+    result.elapsedSeconds = 0.0;
+    result.noteEvents = 0;
+    result.estimatedKeyIndex = keySignatureIndex;
+    result.keyCorrelation = 0.0f;
+
+    auto start = std::chrono::steady_clock::now();
+
+    WavReader reader;
+    if (!reader.open(path, result.error)) {
+        return result;
+    }
+
+    // Driven on this thread only, so it never goes through the scheduler
+    AnalysisSession session(sessionId, path, keySignatureIndex, theoryEngine);
+    session.attachOutput(output, 0);
+
+    // Events of one frame share a timestamp; analyse once per frame
+    double batchTime = -1.0;
+    auto analyzeBatch = [&]() {
+        if (session.drain() && session.chordChangedInLastDrain()) {
+            onChord(path, batchTime, session);
+        }
+        session.releaseAfterDrain();
+    };
+
+    PitchDetector detector(reader.getSampleRate(), detectorConfig);
+    auto onNote = [&](double timeSeconds, const unsigned char* data, size_t size) {
+        if (timeSeconds != batchTime && batchTime >= 0.0) {
+            analyzeBatch();
+        }
+        batchTime = timeSeconds;
+        session.submitRecorded(data, size, static_cast<int64_t>(timeSeconds * 1e9));
+        result.noteEvents++;
+    };
+
+    float profile[ChromaEngine::BINS] = {};
+    ChromaEngine chroma(reader.getSampleRate(), ChromaEngine::defaultConfig(),
+                        [&profile](const float* frames, size_t frameCount) {
+                            for (size_t i = 0; i < frameCount * ChromaEngine::BINS; i++) {
+                                profile[i % ChromaEngine::BINS] += frames[i];
+                            }
+                        });
+
+    std::vector<float> block(8192);
+    size_t frames;
+    while ((frames = reader.readMono(block.data(), block.size())) > 0) {
+        detector.process(block.data(), frames, onNote);
+        chroma.processAudio(block.data(), frames);
+    }
+    detector.finish(onNote);
+    chroma.flush();
+    result.estimatedKeyIndex = theoryEngine->estimateKey(profile, &result.keyCorrelation);
+    if (batchTime >= 0.0) {
+        analyzeBatch();
+    }
+    session.closeOutput();
+
+    result.ok = true;
+    result.audioSeconds = static_cast<double>(reader.getFrameCount()) / reader.getSampleRate();
+    result.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
\ No newline at end of file
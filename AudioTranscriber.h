@@ -0,0 +1,47 @@
+#pragma once
+
+#include "AnalysisSession.h"
+#include "MusicTheoryEngine.h"
+#include "OutputSink.h"
+#include "PitchDetector.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Offline audio front end: streams WAV recordings through PitchDetector into
+// one analysis session per file, so acoustic recordings get the same chord
+// analysis as MIDI input, and through ChromaEngine for a key estimate. Files
+// are spread over worker threads.
+class AudioTranscriber {
+public:
+    struct Result {
+        std::string path;
+        bool ok;
+        std::string error;
+        double audioSeconds;
+        double elapsedSeconds;
+        uint64_t noteEvents;
+        int estimatedKeyIndex;  // from the recording's overall chroma
+        float keyCorrelation;
+    };
+
+    // Called on worker threads whenever a file's chord changes
+    using ChordCallback = std::function<void(const std::string& path, double timeSeconds,
+                                             const AnalysisSession& session)>;
+
+    AudioTranscriber(int keySignatureIndex, int workerCount, OutputSink* output);
+
+    void setDetectorConfig(const PitchDetector::Config& config);
+
+    std::vector<Result> run(const std::vector<std::string>& paths, const ChordCallback& onChord);
+
+private:
+    int keySignatureIndex;
+    int workerCount;
+    OutputSink* output;
+    MusicTheoryEngine* theoryEngine;
+    PitchDetector::Config detectorConfig;
+
+    Result transcribe(int sessionId, const std::string& path, const ChordCallback& onChord) const;
+};
\ No newline at end of file
@@ -0,0 +1,272 @@
+#include "AuditionSynth.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+const int AuditionSynth::BLOCK_SIZE;
+const int AuditionSynth::MAX_VOICES;
+const int AuditionSynth::EVENT_CAPACITY;
+const int AuditionSynth::MIN_SAMPLE_RATE;
+const int AuditionSynth::MAX_SAMPLE_RATE;
+const int AuditionSynth::TABLE_SIZE;
+const int AuditionSynth::TABLE_COUNT;
+
+namespace {
+
+const int LOWEST_TABLE_NOTE = 24;
+const float SILENT_LEVEL = 1e-4f;
+
+float noteFrequency(int note) {
+    return 440.0f * std::pow(2.0f, (note - 69) / 12.0f);
+}
+
+} // namespace
+
+AuditionSynth::AuditionSynth(int sampleRate)
+    : sampleRate(std::max(MIN_SAMPLE_RATE, std::min(MAX_SAMPLE_RATE, sampleRate)))
+    , tables(TABLE_COUNT * (TABLE_SIZE + 1), 0.0f)
+    , voiceCounter(0)
+    , chordLevel(0.5f)
+    , eventHead(0)
+    , eventTail(0)
+    , activeVoices(0)
+    , peakVoices(0)
+    , blocksRendered(0)
+    , totalBlockNs(0)
+    , peakBlockNs(0)
+    , droppedEvents(0)
+    , stolenVoices(0)
+{
+    // One table per octave, with only the partials that stay below Nyquist for
+    // the octave's highest note; partial strengths fall off like a soft piano
+    const double twoPi = 6.283185307179586;
+    for (int t = 0; t < TABLE_COUNT; t++) {
+        float* table = tables.data() + t * (TABLE_SIZE + 1);
+        float topFrequency = noteFrequency(LOWEST_TABLE_NOTE + 12 * t + 11);
+        int harmonics = std::max(1, std::min(16, static_cast<int>(sampleRate / 2 / topFrequency)));
+
+        float peak = 0.0f;
+        for (int i = 0; i < TABLE_SIZE; i++) {
+            double value = 0.0;
+            for (int h = 1; h <= harmonics; h++) {
+                value += std::exp(-0.35 * (h - 1)) / h * std::sin(twoPi * h * i / TABLE_SIZE);
+            }
+            table[i] = static_cast<float>(value);
+            peak = std::max(peak, std::fabs(table[i]));
+        }
+        for (int i = 0; i < TABLE_SIZE; i++) {
+            table[i] /= peak;
+        }
+        table[TABLE_SIZE] = table[0];
+    }
+
+    for (Voice& voice : voices) {
+        voice.active = false;
+    }
+}
+
+int AuditionSynth::getSampleRate() const {
+    return sampleRate;
+}
+
+void AuditionSynth::post(EventType type, int note, int velocity) {
+    uint32_t head = eventHead.load(std::memory_order_relaxed);
+    uint32_t tail = eventTail.load(std::memory_order_acquire);
+    if (head - tail >= static_cast<uint32_t>(EVENT_CAPACITY)) {
+        droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Event& event = events[head & (EVENT_CAPACITY - 1)];
+    event.type = type;
+    event.note = static_cast<uint8_t>(note & 0x7F);
+    event.velocity = static_cast<uint8_t>(velocity & 0x7F);
+    eventHead.store(head + 1, std::memory_order_release);
+}
+
+void AuditionSynth::noteOn(int note, int velocity) {
+    post(EventType::NoteOn, note, velocity);
+}
+
+void AuditionSynth::noteOff(int note) {
+    post(EventType::NoteOff, note, 0);
+}
+
+void AuditionSynth::setChord(const std::vector<int>& pitchClasses, int rootPitchClass) {
+    post(EventType::ChordClear, 0, 0);
+    if (pitchClasses.empty()) return;
+
+    // Root in the bass octave, the rest closed around C3
+    post(EventType::ChordNote, 36 + rootPitchClass % 12, 100);
+    for (int pitchClass : pitchClasses) {
+        post(EventType::ChordNote, 48 + pitchClass % 12, 90);
+    }
+}
+
+void AuditionSynth::setChordLevel(float level) {
+    chordLevel.store(level, std::memory_order_relaxed);
+}
+
+void AuditionSynth::startVoice(int note, int velocity, bool chord) {
+    // A free voice, else steal the quietest released one, else the oldest
+    Voice* target = nullptr;
+    for (Voice& voice : voices) {
+        if (!voice.active) {
+            target = &voice;
+            break;
+        }
+    }
+    if (!target) {
+        for (Voice& voice : voices) {
+            if (voice.released && (!target || voice.level < target->level)) target = &voice;
+        }
+        if (!target) {
+            target = &voices[0];
+            for (Voice& voice : voices) {
+                if (voice.age < target->age) target = &voice;
+            }
+        }
+        stolenVoices.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int table = std::max(0, std::min(TABLE_COUNT - 1, (note - LOWEST_TABLE_NOTE) / 12));
+    float strength = velocity / 127.0f;
+    float peak = 0.3f * strength * strength * (chord ? chordLevel.load(std::memory_order_relaxed) : 1.0f);
+
+    // Higher notes die away sooner, as on a piano
+    float decaySeconds = std::max(0.4f, std::min(8.0f, 4.0f * std::pow(2.0f, (48 - note) / 24.0f)));
+    float attackSamples = 0.003f * sampleRate;
+
+    target->active = true;
+    target->released = false;
+    target->chord = chord;
+    target->note = note;
+    target->table = tables.data() + table * (TABLE_SIZE + 1);
+    target->phase = 0.0f;
+    target->increment = noteFrequency(note) * TABLE_SIZE / sampleRate;
+    target->level = 0.0f;
+    target->attackStep = peak / attackSamples;
+    target->attackTarget = peak;
+    target->decay = std::exp(-1.0f / (decaySeconds * sampleRate));
+    target->release = std::exp(-1.0f / ((chord ? 0.3f : 0.08f) * sampleRate));
+    target->age = voiceCounter++;
+}
+
+void AuditionSynth::handle(const Event& event) {
+    switch (event.type) {
+    case EventType::NoteOn:
+        // Retriggering a held note releases the old voice
+        for (Voice& voice : voices) {
+            if (voice.active && !voice.chord && !voice.released && voice.note == event.note) {
+                voice.released = true;
+                voice.attackStep = 0.0f;
+            }
+        }
+        startVoice(event.note, event.velocity, false);
+        break;
+    case EventType::NoteOff:
+        for (Voice& voice : voices) {
+            if (voice.active && !voice.chord && voice.note == event.note) {
+                voice.released = true;
+                voice.attackStep = 0.0f;
+            }
+        }
+        break;
+    case EventType::ChordClear:
+        for (Voice& voice : voices) {
+            if (voice.active && voice.chord) {
+                voice.released = true;
+                voice.attackStep = 0.0f;
+            }
+        }
+        break;
+    case EventType::ChordNote:
+        startVoice(event.note, event.velocity, true);
+        break;
+    }
+}
+
+void AuditionSynth::renderVoice(Voice& voice, float* output) {
+    const float* table = voice.table;
+    float phase = voice.phase;
+    float increment = voice.increment;
+    float level = voice.level;
+    int i = 0;
+
+    for (; i < BLOCK_SIZE && voice.attackStep > 0.0f; i++) {
+        int index = static_cast<int>(phase);
+        float fraction = phase - index;
+        output[i] += (table[index] + fraction * (table[index + 1] - table[index])) * level;
+        level += voice.attackStep;
+        if (level >= voice.attackTarget) {
+            level = voice.attackTarget;
+            voice.attackStep = 0.0f;
+        }
+        phase += increment;
+        while (phase >= TABLE_SIZE) phase -= TABLE_SIZE;
+    }
+
+    float multiplier = voice.released ? voice.release : voice.decay;
+    for (; i < BLOCK_SIZE; i++) {
+        int index = static_cast<int>(phase);
+        float fraction = phase - index;
+        output[i] += (table[index] + fraction * (table[index + 1] - table[index])) * level;
+        level *= multiplier;
+        phase += increment;
+        while (phase >= TABLE_SIZE) phase -= TABLE_SIZE;
+    }
+
+    voice.phase = phase;
+    voice.level = level;
+    if (level < SILENT_LEVEL && voice.attackStep == 0.0f) {
+        voice.active = false;
+    }
+}
+
+void AuditionSynth::renderBlock(float* output) {
+    auto start = std::chrono::steady_clock::now();
+
+    uint32_t tail = eventTail.load(std::memory_order_relaxed);
+    uint32_t head = eventHead.load(std::memory_order_acquire);
+    for (; tail != head; tail++) {
+        handle(events[tail & (EVENT_CAPACITY - 1)]);
+    }
+    eventTail.store(tail, std::memory_order_release);
+
+    std::fill(output, output + BLOCK_SIZE, 0.0f);
+    int active = 0;
+    for (Voice& voice : voices) {
+        if (!voice.active) continue;
+        renderVoice(voice, output);
+        active++;
+    }
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        output[i] = std::max(-1.0f, std::min(1.0f, output[i]));
+    }
+
+    uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    activeVoices.store(active, std::memory_order_relaxed);
+    if (active > peakVoices.load(std::memory_order_relaxed)) {
+        peakVoices.store(active, std::memory_order_relaxed);
+    }
+    if (elapsed > peakBlockNs.load(std::memory_order_relaxed)) {
+        peakBlockNs.store(elapsed, std::memory_order_relaxed);
+    }
+    totalBlockNs.fetch_add(elapsed, std::memory_order_relaxed);
+    blocksRendered.fetch_add(1, std::memory_order_relaxed);
+}
+
+AuditionSynth::Stats AuditionSynth::getStats() const {
+    Stats stats;
+    stats.activeVoices = activeVoices.load(std::memory_order_relaxed);
+    stats.peakVoices = peakVoices.load(std::memory_order_relaxed);
+    stats.blocksRendered = blocksRendered.load(std::memory_order_relaxed);
+    stats.averageBlockUs = stats.blocksRendered > 0
+        ? totalBlockNs.load(std::memory_order_relaxed) / 1000.0 / stats.blocksRendered : 0.0;
+    stats.peakBlockUs = peakBlockNs.load(std::memory_order_relaxed) / 1000.0;
+    stats.load = stats.averageBlockUs / (1e6 * BLOCK_SIZE / sampleRate);
+    stats.droppedEvents = droppedEvents.load(std::memory_order_relaxed);
+    stats.stolenVoices = stolenVoices.load(std::memory_order_relaxed);
+    return stats;
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Small polyphonic wavetable synth for auditioning what is played and the
+// chord the analyzer hears. Band-limited piano-like tables (one per octave)
+// are built up front; the control thread posts note events through a
+// single-producer/single-consumer ring and the audio thread renders fixed
+// blocks with no locks and no allocation. Per-block render time is tracked
+// so the voice count can be sized for slower machines.
+class AuditionSynth {
+public:
+    static const int BLOCK_SIZE = 128;      // frames per renderBlock()
+    static const int MAX_VOICES = 32;
+    static const int EVENT_CAPACITY = 256;  // power of two
+    // Below the minimum the top notes step more than a table per sample
+    static const int MIN_SAMPLE_RATE = 22050;
+    static const int MAX_SAMPLE_RATE = 192000;
+
+    struct Stats {
+        int activeVoices;
+        int peakVoices;
+        uint64_t blocksRendered;
+        double averageBlockUs;
+        double peakBlockUs;
+        double load;              // average render time / block duration
+        uint64_t droppedEvents;   // ring full
+        uint64_t stolenVoices;
+    };
+
+    explicit AuditionSynth(int sampleRate);   // clamped to MIN_SAMPLE_RATE-MAX_SAMPLE_RATE
+
+    int getSampleRate() const;
+
+    // Control thread (one at a time). Events are dropped, never blocked on,
+    // when the audio thread falls behind.
+    void noteOn(int note, int velocity);
+    void noteOff(int note);
+    // Replaces the chord layer, voiced below the played notes; empty clears it
+    void setChord(const std::vector<int>& pitchClasses, int rootPitchClass);
+    void setChordLevel(float level);
+
+    // Audio thread: writes BLOCK_SIZE mono samples
+    void renderBlock(float* output);
+
+    Stats getStats() const;
+
+private:
+    enum class EventType : uint8_t { NoteOn, NoteOff, ChordClear, ChordNote };
+
+    struct Event {
+        EventType type;
+        uint8_t note;
+        uint8_t velocity;
+    };
+
+    struct Voice {
+        bool active;
+        bool released;
+        bool chord;
+        int note;
+        const float* table;
+        float phase;              // in table samples
+        float increment;
+        float level;
+        float attackStep;
+        float attackTarget;
+        float decay;              // per-sample multipliers
+        float release;
+        uint64_t age;
+    };
+
+    static const int TABLE_SIZE = 2048;
+    static const int TABLE_COUNT = 8;     // octaves, from MIDI 24 up
+
+    int sampleRate;
+    std::vector<float> tables;            // TABLE_COUNT * (TABLE_SIZE + 1), guard sample last
+    Voice voices[MAX_VOICES];
+    uint64_t voiceCounter;
+    std::atomic<float> chordLevel;
+
+    Event events[EVENT_CAPACITY];
+    std::atomic<uint32_t> eventHead;      // written by the control thread
+    std::atomic<uint32_t> eventTail;      // written by the audio thread
+
+    std::atomic<int> activeVoices;
+    std::atomic<int> peakVoices;
+    std::atomic<uint64_t> blocksRendered;
+    std::atomic<uint64_t> totalBlockNs;
+    std::atomic<uint64_t> peakBlockNs;
+    std::atomic<uint64_t> droppedEvents;
+    std::atomic<uint64_t> stolenVoices;
+
+    void post(EventType type, int note, int velocity);
+    void handle(const Event& event);
+    void startVoice(int note, int velocity, bool chord);
+    void renderVoice(Voice& voice, float* output);
+};
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "AuditionWavOutput.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+void putU16(unsigned char* p, uint16_t value) {
+    p[0] = static_cast<unsigned char>(value);
+    p[1] = static_cast<unsigned char>(value >> 8);
+}
+
+void putU32(unsigned char* p, uint32_t value) {
+    putU16(p, static_cast<uint16_t>(value));
+    putU16(p + 2, static_cast<uint16_t>(value >> 16));
+}
+
+const size_t HEADER_SIZE = 44;
+
+} // namespace
+
+AuditionWavOutput::AuditionWavOutput(AuditionSynth* synth)
+    : synth(synth)
+    , file(nullptr)
+    , running(false)
+    , framesWritten(0)
+    , lateBlocks(0)
+    , writeFailed(false)
+{
+}
+
+AuditionWavOutput::~AuditionWavOutput() {
+    stop();
+}
+
+bool AuditionWavOutput::start(const std::string& path, std::string& error) {
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        error = "cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 16);
+
+    // Sizes are patched in on stop()
+    if (!writeHeader(0)) {
+        error = "cannot write " + path + ": " + std::strerror(errno);
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+    running = true;
+    thread = std::thread(&AuditionWavOutput::run, this);
+    return true;
+}
+
+void AuditionWavOutput::stop() {
+    if (!file) return;
+
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    uint64_t dataBytes = framesWritten.load() * 2;
+    std::fseek(file, 0, SEEK_SET);
+    if (!writeHeader(static_cast<uint32_t>(std::min<uint64_t>(dataBytes, 0xFFFFFFFFu - HEADER_SIZE)))) {
+        writeFailed = true;
+    }
+    if (std::fclose(file) != 0) writeFailed = true;
+    file = nullptr;
+}
+
+uint64_t AuditionWavOutput::getFramesWritten() const {
+    return framesWritten.load(std::memory_order_relaxed);
+}
+
+uint64_t AuditionWavOutput::getLateBlocks() const {
+    return lateBlocks.load(std::memory_order_relaxed);
+}
+
+bool AuditionWavOutput::hasWriteFailed() const {
+    return writeFailed.load(std::memory_order_relaxed);
+}
+
+bool AuditionWavOutput::writeHeader(uint32_t dataBytes) {
+    int sampleRate = synth->getSampleRate();
+    unsigned char header[HEADER_SIZE];
+    std::memcpy(header, "RIFF", 4);
+    putU32(header + 4, static_cast<uint32_t>(HEADER_SIZE - 8 + dataBytes));
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    putU32(header + 16, 16);
+    putU16(header + 20, 1);                 // PCM
+    putU16(header + 22, 1);                 // mono
+    putU32(header + 24, static_cast<uint32_t>(sampleRate));
+    putU32(header + 28, static_cast<uint32_t>(sampleRate * 2));
+    putU16(header + 32, 2);
+    putU16(header + 34, 16);
+    std::memcpy(header + 36, "data", 4);
+    putU32(header + 40, dataBytes);
+    return std::fwrite(header, 1, sizeof(header), file) == sizeof(header);
+}
+
+void AuditionWavOutput::run() {
+    // Everything the loop touches is allocated here, before the first block
+    float block[AuditionSynth::BLOCK_SIZE];
+    unsigned char pcm[AuditionSynth::BLOCK_SIZE * 2];
+    auto period = std::chrono::nanoseconds(
+        static_cast<int64_t>(1e9 * AuditionSynth::BLOCK_SIZE / synth->getSampleRate()));
+    auto deadline = std::chrono::steady_clock::now() + period;
+
+    while (running.load(std::memory_order_relaxed)) {
+        synth->renderBlock(block);
+        for (int i = 0; i < AuditionSynth::BLOCK_SIZE; i++) {
+            putU16(pcm + 2 * i, static_cast<uint16_t>(static_cast<int16_t>(std::lround(block[i] * 32767.0f))));
+        }
+        if (std::fwrite(pcm, 1, sizeof(pcm), file) != sizeof(pcm)) {
+            // Disk full or similar: the file keeps what was written whole
+            writeFailed = true;
+            break;
+        }
+        framesWritten.fetch_add(AuditionSynth::BLOCK_SIZE, std::memory_order_relaxed);
+
+        auto now = std::chrono::steady_clock::now();
+        if (now > deadline) {
+            lateBlocks.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            std::this_thread::sleep_until(deadline);
+        }
+        deadline += period;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "AuditionSynth.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Stands in for a sound card: a dedicated thread pulls fixed blocks from an
+// AuditionSynth at the audio rate, as a device callback would, and writes
+// them to a 16-bit mono WAV file. Lets the synth be heard and measured on
+// machines without audio hardware.
+class AuditionWavOutput {
+public:
+    explicit AuditionWavOutput(AuditionSynth* synth);
+    ~AuditionWavOutput();
+
+    bool start(const std::string& path, std::string& error);
+    void stop();
+
+    uint64_t getFramesWritten() const;
+    uint64_t getLateBlocks() const;   // rendered after their deadline
+    bool hasWriteFailed() const;      // a short write ended the output
+
+private:
+    AuditionSynth* synth;
+    std::FILE* file;
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> framesWritten;
+    std::atomic<uint64_t> lateBlocks;
+    std::atomic<bool> writeFailed;
+
+    void run();
+    bool writeHeader(uint32_t dataBytes);
+};
\ No newline at end of file
@@ -78,6 +78,7 @@ MusicTypes::ChordAnalysis ChordAnalyzer::analyzeChord(const std::vector<int>& no
     
     analysis.rootNote = bestRootNote;
     analysis.chordName = chordName;
+    analysis.chordQuality = bestChordQuality;
     
     // Calculate inversion figure
     analysis.inversionFigure = calculateInversionFigure(bestChordQuality, analysis.bassNote, analysis.rootNote);
@@ -0,0 +1,174 @@
+#include "ChromaEngine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const int ChromaEngine::BINS;
+
+ChromaEngine::Config ChromaEngine::defaultConfig() {
+    Config config;
+    config.frameSize = 4096;
+    config.hopSize = 512;
+    config.minHz = 55.0f;     // A1
+    config.maxHz = 4200.0f;   // C8
+    config.silenceDb = -60.0f;
+    config.blockFrames = 256;
+    config.decaySeconds = 2.0f;
+    config.releaseSeconds = 0.15f;
+    return config;
+}
+
+ChromaEngine::ChromaEngine(int sampleRate, const Config& config, BlockCallback onBlock)
+    : sampleRate(sampleRate)
+    , config(config)
+    , onBlock(std::move(onBlock))
+    , frameCount(0)
+    , fft(config.frameSize)
+    , frame(config.frameSize, 0.0f)
+    , filled(0)
+    , spectrum(fft.getBinCount())
+    , block(config.blockFrames * BINS)
+    , blockUsed(0)
+{
+    std::fill(std::begin(levels), std::end(levels), 0.0f);
+    std::fill(std::begin(lastChange), std::end(lastChange), 0.0);
+
+    // Each semitone owns the contiguous bins within half a semitone of it
+    double binHz = static_cast<double>(sampleRate) / config.frameSize;
+    int lowestNote = static_cast<int>(std::ceil(69.0 + 12.0 * std::log2(config.minHz / 440.0)));
+    int highestNote = static_cast<int>(std::floor(69.0 + 12.0 * std::log2(config.maxHz / 440.0)));
+    for (int note = lowestNote; note <= highestNote; note++) {
+        double low = 440.0 * std::pow(2.0, (note - 69.5) / 12.0) / binHz;
+        double high = 440.0 * std::pow(2.0, (note - 68.5) / 12.0) / binHz;
+        SemitoneRange range;
+        range.pitchClass = note % 12;
+        range.lowBin = std::max(1, static_cast<int>(std::ceil(low)));
+        range.highBin = std::min(fft.getBinCount() - 1, static_cast<int>(std::floor(high)));
+        if (range.lowBin <= range.highBin) {
+            semitoneRanges.push_back(range);
+        }
+    }
+}
+
+double ChromaEngine::getFrameTime(uint64_t frameIndex) const {
+    return static_cast<double>(frameIndex * config.hopSize + config.frameSize / 2) / sampleRate;
+}
+
+uint64_t ChromaEngine::getFrameCount() const {
+    return frameCount;
+}
+
+float* ChromaEngine::nextFrame() {
+    float* chroma = block.data() + blockUsed * BINS;
+    std::fill(chroma, chroma + BINS, 0.0f);
+    return chroma;
+}
+
+void ChromaEngine::finishFrame(float* chroma) {
+    // Normalize to unit sum so loudness does not dominate similarity
+    float sum = 0.0f;
+    for (int i = 0; i < BINS; i++) {
+        sum += chroma[i];
+    }
+    if (sum > 1e-9f) {
+        float scale = 1.0f / sum;
+        for (int i = 0; i < BINS; i++) {
+            chroma[i] *= scale;
+        }
+    }
+
+    frameCount++;
+    if (++blockUsed == config.blockFrames) {
+        onBlock(block.data(), blockUsed);
+        blockUsed = 0;
+    }
+}
+
+void ChromaEngine::processAudio(const float* samples, size_t count) {
+    size_t frameSize = frame.size();
+    size_t hop = static_cast<size_t>(config.hopSize);
+
+    while (count > 0) {
+        size_t take = std::min(count, frameSize - filled);
+        std::memcpy(frame.data() + filled, samples, take * sizeof(float));
+        filled += take;
+        samples += take;
+        count -= take;
+        if (filled < frameSize) break;
+
+        float* chroma = nextFrame();
+
+        float energy = 0.0f;
+        for (float sample : frame) {
+            energy += sample * sample;
+        }
+        if (10.0f * std::log10(energy / frameSize + 1e-12f) >= config.silenceDb) {
+            fft.magnitudes(frame.data(), spectrum.data());
+            for (const SemitoneRange& range : semitoneRanges) {
+                float semitoneEnergy = 0.0f;
+                for (int bin = range.lowBin; bin <= range.highBin; bin++) {
+                    semitoneEnergy += spectrum[bin] * spectrum[bin];
+                }
+                chroma[range.pitchClass] += semitoneEnergy;
+            }
+        }
+        finishFrame(chroma);
+
+        std::memmove(frame.data(), frame.data() + hop, (frameSize - hop) * sizeof(float));
+        filled = frameSize - hop;
+    }
+}
+
+void ChromaEngine::emitMidiFrame(double timeSeconds) {
+    float* chroma = nextFrame();
+    for (int note = 0; note < 128; note++) {
+        if (!sounding[note]) continue;
+
+        double elapsed = timeSeconds - lastChange[note];
+        float tau = held[note] ? config.decaySeconds : config.releaseSeconds;
+        float level = levels[note] * std::exp(static_cast<float>(-elapsed / tau));
+        if (!held[note] && level < 1e-3f) {
+            sounding[note] = false;
+            continue;
+        }
+        chroma[note % 12] += level;
+    }
+    finishFrame(chroma);
+}
+
+void ChromaEngine::processMidi(double timeSeconds, const unsigned char* data, size_t size) {
+    while (getFrameTime(frameCount) <= timeSeconds) {
+        emitMidiFrame(getFrameTime(frameCount));
+    }
+
+    if (size < 3) return;
+    int status = data[0] & 0xF0;
+    int note = data[1] & 0x7F;
+    bool noteOn = status == 0x90 && data[2] > 0;
+    bool noteOff = status == 0x80 || (status == 0x90 && data[2] == 0);
+
+    if (noteOn) {
+        float velocity = data[2] / 127.0f;
+        levels[note] = velocity * velocity;
+        held[note] = true;
+        sounding[note] = true;
+        lastChange[note] = timeSeconds;
+    } else if (noteOff && held[note]) {
+        // Continue from the decayed level at release
+        double elapsed = timeSeconds - lastChange[note];
+        levels[note] *= std::exp(static_cast<float>(-elapsed / config.decaySeconds));
+        held[note] = false;
+        lastChange[note] = timeSeconds;
+    }
+}
+
+void ChromaEngine::flush(double endTimeSeconds) {
+    while (endTimeSeconds >= 0.0 && getFrameTime(frameCount) <= endTimeSeconds) {
+        emitMidiFrame(getFrameTime(frameCount));
+    }
+
+    if (blockUsed > 0) {
+        onBlock(block.data(), blockUsed);
+        blockUsed = 0;
+    }
+}
\ No newline at end of file
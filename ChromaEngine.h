@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Fft.h"
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Chroma features: one 12-bin pitch-class energy vector per frame, bin
+// = midiNote % 12 as in MusicTheoryEngine. Frames come either from audio
+// spectra or from MIDI note state (velocity-weighted, decaying), on the same
+// grid - frame k is centred at (k * hopSize + frameSize / 2) / sampleRate - so
+// audio and MIDI chroma of one recording line up. Frames are delivered in
+// fixed-size blocks as one contiguous frame-major float array
+// (frame0[0..11], frame1[0..11], ...), so memory use does not depend on the
+// length of the input.
+class ChromaEngine {
+public:
+    static const int BINS = 12;
+
+    struct Config {
+        int frameSize;            // FFT size for audio input
+        int hopSize;              // frame period in samples, for audio and MIDI
+        float minHz;              // spectrum range folded into chroma
+        float maxHz;
+        float silenceDb;          // quieter audio frames are all zero
+        size_t blockFrames;       // frames per delivered block
+        float decaySeconds;       // MIDI: held-note energy time constant
+        float releaseSeconds;     // MIDI: energy time constant after release
+    };
+
+    // frames points at frameCount * BINS floats, valid for the duration of the call
+    using BlockCallback = std::function<void(const float* frames, size_t frameCount)>;
+
+    static Config defaultConfig();
+
+    ChromaEngine(int sampleRate, const Config& config, BlockCallback onBlock);
+
+    // Audio input (mono)
+    void processAudio(const float* samples, size_t count);
+
+    // MIDI input in time order; frames up to timeSeconds are emitted first
+    void processMidi(double timeSeconds, const unsigned char* data, size_t size);
+
+    // Emits MIDI frames up to endTimeSeconds (if given) and delivers the partial block
+    void flush(double endTimeSeconds = -1.0);
+
+    double getFrameTime(uint64_t frameIndex) const;
+    uint64_t getFrameCount() const;
+
+private:
+    struct SemitoneRange {
+        int pitchClass;
+        int lowBin;
+        int highBin;
+    };
+
+    int sampleRate;
+    Config config;
+    BlockCallback onBlock;
+    uint64_t frameCount;
+
+    // Audio
+    Fft fft;
+    std::vector<float> frame;
+    size_t filled;
+    std::vector<float> spectrum;
+    std::vector<SemitoneRange> semitoneRanges;
+
+    // MIDI
+    std::bitset<128> held;
+    std::bitset<128> sounding;
+    float levels[128];          // energy at lastChange
+    double lastChange[128];
+
+    std::vector<float> block;
+    size_t blockUsed;
+
+    float* nextFrame();
+    void finishFrame(float* chroma);
+    void emitMidiFrame(double timeSeconds);
+};
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "ClockEstimator.h"
+#include <cmath>
+
+const int ClockEstimator::WARMUP_EVENTS;
+const int ClockEstimator::MAX_CONSECUTIVE_OUTLIERS;
+
+namespace {
+
+// Arrivals this many standard deviations (and at least 20 ms) off the fit are
+// stalls, not jitter
+const double OUTLIER_SIGMAS = 6.0;
+const double OUTLIER_FLOOR_SECONDS = 0.02;
+
+} // namespace
+
+ClockEstimator::ClockEstimator(int window)
+    : forgetting(1.0 - 1.0 / (window > 1 ? window : 2))
+{
+    reset();
+}
+
+void ClockEstimator::reset() {
+    events = 0;
+    outliers = 0;
+    residualMax = 0.0;
+    lastSmoothedNs = 0;
+    restartFit();
+}
+
+void ClockEstimator::restartFit() {
+    fitEvents = 0;
+    consecutiveOutliers = 0;
+    originHostNs = 0;
+    sourceSeconds = 0.0;
+    weight = 0.0;
+    meanX = 0.0;
+    meanY = 0.0;
+    varianceX = 0.0;
+    covarianceXY = 0.0;
+    residualVariance = 0.0;
+}
+
+void ClockEstimator::advance(double deltaSeconds) {
+    if (fitEvents > 0 && deltaSeconds > 0.0) sourceSeconds += deltaSeconds;
+}
+
+int64_t ClockEstimator::update(double deltaSeconds, int64_t arrivalHostNs) {
+    if (fitEvents == 0) {
+        originHostNs = arrivalHostNs;
+        sourceSeconds = 0.0;
+    } else {
+        sourceSeconds += deltaSeconds > 0.0 ? deltaSeconds : 0.0;
+    }
+    events++;
+    fitEvents++;
+
+    double x = sourceSeconds;
+    double y = static_cast<double>(arrivalHostNs - originHostNs) / 1e9 - x;
+
+    // Residual against the fit so far
+    double drift = varianceX > 1e-12 ? covarianceXY / varianceX : 0.0;
+    double predicted = weight > 0.0 ? meanY + drift * (x - meanX) : y;
+    double residual = y - predicted;
+
+    bool outlier = fitEvents > WARMUP_EVENTS &&
+                   std::fabs(residual) > std::fmax(OUTLIER_SIGMAS * std::sqrt(residualVariance), OUTLIER_FLOOR_SECONDS);
+    if (outlier) {
+        outliers++;
+        // A run of outliers means the port's clock jumped; this event seeds
+        // a new fit, which warms up again. Totals and monotonicity are kept.
+        if (++consecutiveOutliers >= MAX_CONSECUTIVE_OUTLIERS) {
+            events--;
+            outliers--;
+            restartFit();
+            return update(0.0, arrivalHostNs);
+        }
+    } else {
+        consecutiveOutliers = 0;
+
+        // Exponentially weighted means and (co)variances, updated in place
+        weight = forgetting * weight + 1.0;
+        double alpha = 1.0 / weight;
+        double dx = x - meanX;
+        double dy = y - meanY;
+        meanX += alpha * dx;
+        meanY += alpha * dy;
+        varianceX = (1.0 - alpha) * (varianceX + alpha * dx * dx);
+        covarianceXY = (1.0 - alpha) * (covarianceXY + alpha * dx * dy);
+
+        if (fitEvents > 1) {
+            residualVariance = forgetting * residualVariance + (1.0 - forgetting) * residual * residual;
+            if (fitEvents > WARMUP_EVENTS) residualMax = std::fmax(residualMax, std::fabs(residual));
+        }
+        drift = varianceX > 1e-12 ? covarianceXY / varianceX : 0.0;
+    }
+
+    // Until the fit has settled the arrival time is the best estimate
+    int64_t smoothedNs = arrivalHostNs;
+    if (fitEvents > WARMUP_EVENTS) {
+        double fitted = meanY + drift * (x - meanX);
+        smoothedNs = originHostNs + static_cast<int64_t>(std::llround((x + fitted) * 1e9));
+    }
+    if (smoothedNs < lastSmoothedNs) smoothedNs = lastSmoothedNs;
+    lastSmoothedNs = smoothedNs;
+    return smoothedNs;
+}
+
+ClockEstimator::Stats ClockEstimator::getStats() const {
+    Stats stats;
+    stats.events = events;
+    stats.outliers = outliers;
+    stats.driftPpm = fitEvents > WARMUP_EVENTS && varianceX > 1e-12 ? covarianceXY / varianceX * 1e6 : 0.0;
+    stats.jitterRmsUs = std::sqrt(residualVariance) * 1e6;
+    stats.jitterMaxUs = residualMax * 1e6;
+    return stats;
+}
\ No newline at end of file
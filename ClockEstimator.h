@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+// Maps one port's source clock (the running sum of the deltas a driver or
+// RTP-MIDI playout reports) onto the host's monotonic clock. An exponentially
+// weighted linear regression of host time against source time tracks the
+// offset and the drift between the two; the fitted line, not the moment the
+// event reached us, is the event's smoothed host time. Residuals give the
+// port's delivery jitter.
+//
+// Constant time and no allocation per event, so it runs on the ingest thread.
+// Not thread-safe: one instance per port, fed by one thread at a time.
+class ClockEstimator {
+public:
+    struct Stats {
+        uint64_t events;
+        uint64_t outliers;      // far off the fit (stalls), not used to fit
+        double driftPpm;        // source clock slower (+) or faster (-) than the host
+        double jitterRmsUs;     // deviation of arrivals from the fit
+        double jitterMaxUs;
+    };
+
+    // window: events weighted in the fit (time constant of the forgetting)
+    explicit ClockEstimator(int window = 256);
+
+    // Returns the smoothed host time of an event that arrived at
+    // arrivalHostNs, deltaSeconds after the port's previous event
+    int64_t update(double deltaSeconds, int64_t arrivalHostNs);
+    // Source time taken by an event that is not fitted (SysEx chunks)
+    void advance(double deltaSeconds);
+
+    void reset();
+    Stats getStats() const;
+
+private:
+    static const int WARMUP_EVENTS = 8;
+    static const int MAX_CONSECUTIVE_OUTLIERS = 16;
+
+    double forgetting;
+    uint64_t events;
+    uint64_t outliers;
+    uint64_t fitEvents;         // since the fit was last started over
+    int consecutiveOutliers;
+
+    // Both clocks relative to the first event, in seconds; y is the host
+    // time minus the source time, so the fit is y = offset + drift * x
+    int64_t originHostNs;
+    double sourceSeconds;
+    double weight;
+    double meanX;
+    double meanY;
+    double varianceX;
+    double covarianceXY;
+    double residualVariance;
+    double residualMax;
+    int64_t lastSmoothedNs;
+
+    void restartFit();
+};
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "DeviceIdentity.h"
+#include <cstdio>
+
+namespace {
+
+struct Manufacturer {
+    uint32_t id;
+    const char* name;
+};
+
+// Makers of keyboards and controllers likely to be plugged in
+const Manufacturer MANUFACTURERS[] = {
+    {0x01, "Sequential"},
+    {0x04, "Moog"},
+    {0x07, "Kurzweil"},
+    {0x0F, "Ensoniq"},
+    {0x18, "E-mu"},
+    {0x33, "Clavia"},
+    {0x40, "Kawai"},
+    {0x41, "Roland"},
+    {0x42, "Korg"},
+    {0x43, "Yamaha"},
+    {0x44, "Casio"},
+    {0x47, "Akai"},
+    {0x1000E, "Alesis"},
+    {0x10105, "M-Audio"},
+    {0x12029, "Novation"},
+    {0x12032, "Behringer"},
+    {0x1203C, "Elektron"},
+    {0x1206B, "Arturia"},
+    {0x12109, "Native Instruments"},
+    {0x12110, "ROLI"},
+};
+
+} // namespace
+
+std::vector<unsigned char> DeviceIdentity::request() {
+    return {0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7};
+}
+
+bool DeviceIdentity::parseReply(const unsigned char* data, size_t size, DeviceIdentity& identity) {
+    if (size < 15 || data[0] != 0xF0 || data[1] != 0x7E || data[3] != 0x06 || data[4] != 0x02) {
+        return false;
+    }
+
+    size_t pos = 5;
+    if (data[pos] == 0x00) {
+        if (size < 17) return false;
+        identity.manufacturer = 0x10000 | (static_cast<uint32_t>(data[pos + 1] & 0x7F) << 8) | (data[pos + 2] & 0x7F);
+        pos += 3;
+    } else {
+        identity.manufacturer = data[pos];
+        pos += 1;
+    }
+
+    // Family and model are 14-bit, LSB first
+    identity.family = static_cast<uint16_t>((data[pos] & 0x7F) | ((data[pos + 1] & 0x7F) << 7));
+    identity.model = static_cast<uint16_t>((data[pos + 2] & 0x7F) | ((data[pos + 3] & 0x7F) << 7));
+    for (int i = 0; i < 4; i++) {
+        identity.version[i] = data[pos + 4 + i] & 0x7F;
+    }
+    return data[pos + 8] == 0xF7;
+}
+
+std::string DeviceIdentity::manufacturerName() const {
+    for (const Manufacturer& entry : MANUFACTURERS) {
+        if (entry.id == manufacturer) return entry.name;
+    }
+    char unknown[32];
+    if (manufacturer & 0x10000) {
+        std::snprintf(unknown, sizeof(unknown), "manufacturer 00 %02X %02X", (manufacturer >> 8) & 0x7F,
+                      manufacturer & 0x7F);
+    } else {
+        std::snprintf(unknown, sizeof(unknown), "manufacturer %02X", manufacturer);
+    }
+    return unknown;
+}
+
+std::string DeviceIdentity::describe() const {
+    char details[96];
+    std::snprintf(details, sizeof(details), " family 0x%04X model 0x%04X, firmware %d.%d.%d.%d", family, model,
+                  version[0], version[1], version[2], version[3]);
+    return manufacturerName() + details;
+}
\ No newline at end of file
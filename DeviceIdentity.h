@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Universal Non-Real-Time device identity (MIDI 1.0 "General Information"):
+// the request every instrument that implements it answers with its
+// manufacturer, family, model and firmware version.
+struct DeviceIdentity {
+    uint32_t manufacturer;   // one-byte id, or 0x1XXYY for the three-byte id 00 XX YY
+    uint16_t family;
+    uint16_t model;
+    unsigned char version[4];
+
+    // F0 7E 7F 06 01 F7, addressed to all device ids
+    static std::vector<unsigned char> request();
+
+    // F0 7E <device> 06 02 <manufacturer> <family> <model> <version> F7
+    static bool parseReply(const unsigned char* data, size_t size, DeviceIdentity& identity);
+
+    std::string manufacturerName() const;
+    // e.g. "Roland family 0x0123 model 0x0004, firmware 1.2.0.0"
+    std::string describe() const;
+};
\ No newline at end of file
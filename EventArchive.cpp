@@ -0,0 +1,407 @@
+#include "EventArchive.h"
+#include <QByteArray>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+const size_t EventArchiveWriter::EVENTS_PER_BLOCK;
+
+namespace {
+
+const char FILE_MAGIC[8] = {'M', 'I', 'D', 'I', 'A', 'R', 'C', '\x01'};
+const char INDEX_MAGIC[8] = {'M', 'I', 'D', 'I', 'A', 'I', 'D', 'X'};
+const size_t BLOCK_HEADER_SIZE = 4 + 4 + 4 + 8;
+const size_t INDEX_ENTRY_SIZE = 8 + 8 + 8;
+const size_t FOOTER_SIZE = 8 + 4 + 8 + 8;
+
+// Undefined in MIDI; introduces a message stored verbatim with its length
+const unsigned char ESCAPE = 0xF4;
+
+// Message length implied by a status byte, 0 where it has to be stored
+struct LengthTable {
+    uint8_t length[256];
+
+    LengthTable() {
+        for (int status = 0; status < 256; status++) {
+            int high = status & 0xF0;
+            if (status < 0x80) length[status] = 0;
+            else if (high == 0xC0 || high == 0xD0) length[status] = 2;
+            else if (status < 0xF0) length[status] = 3;
+            else if (status == 0xF1 || status == 0xF3) length[status] = 2;
+            else if (status == 0xF2) length[status] = 3;
+            else if (status == 0xF6 || status >= 0xF8) length[status] = 1;
+            else length[status] = 0;
+        }
+    }
+};
+
+const LengthTable impliedLength;
+
+uint32_t readU32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+uint64_t readU64(const unsigned char* p) {
+    return static_cast<uint64_t>(readU32(p)) | static_cast<uint64_t>(readU32(p + 4)) << 32;
+}
+
+void putU32(unsigned char* p, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+void putU64(unsigned char* p, uint64_t value) {
+    putU32(p, static_cast<uint32_t>(value));
+    putU32(p + 4, static_cast<uint32_t>(value >> 32));
+}
+
+} // namespace
+
+EventArchiveWriter::EventArchiveWriter()
+    : file(nullptr)
+    , blockEvents(0)
+    , blockFirstTimeUs(0)
+    , lastTimeUs(0)
+    , eventCount(0)
+    , bytesWritten(0)
+    , writeError(0)
+{
+}
+
+EventArchiveWriter::~EventArchiveWriter() {
+    if (file) {
+        std::fclose(file);
+    }
+}
+
+bool EventArchiveWriter::open(const std::string& path, std::string& error) {
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        error = "cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    writeError = 0;
+    deltas.reserve(EVENTS_PER_BLOCK);
+    firstData.reserve(EVENTS_PER_BLOCK);
+    secondData.reserve(EVENTS_PER_BLOCK);
+    write(FILE_MAGIC, sizeof(FILE_MAGIC));
+    return true;
+}
+
+void EventArchiveWriter::write(const void* data, size_t size) {
+    if (std::fwrite(data, 1, size, file) < size && writeError == 0) {
+        writeError = errno != 0 ? errno : EIO;
+    }
+    bytesWritten += size;
+}
+
+void EventArchiveWriter::append(int64_t timeNs, const unsigned char* data, size_t size) {
+    if (size == 0) return;
+    size = std::min<size_t>(size, 255);
+
+    uint64_t timeUs = static_cast<uint64_t>(std::max<int64_t>(timeNs, 0) / 1000);
+    timeUs = std::max(timeUs, lastTimeUs);
+    if (blockEvents == 0) {
+        blockFirstTimeUs = timeUs;
+        lastTimeUs = timeUs;
+    }
+    deltas.push_back(timeUs - lastTimeUs);
+    lastTimeUs = timeUs;
+
+    // Anything whose length the status does not imply is kept verbatim
+    unsigned char status = data[0];
+    bool wellFormed = impliedLength.length[status] == size;
+    for (size_t i = 1; i < size && wellFormed; i++) {
+        wellFormed = data[i] < 0x80;
+    }
+    if (!wellFormed) {
+        status = ESCAPE;
+        longMessages.push_back(static_cast<unsigned char>(size));
+        longMessages.insert(longMessages.end(), data, data + size);
+    } else {
+        if (size > 1) firstData.push_back(data[1]);
+        if (size > 2) secondData.push_back(data[2]);
+    }
+
+    if (!runs.empty() && runs.back().status == status && runs.back().length < 0xFFFF) {
+        runs.back().length++;
+    } else {
+        runs.push_back({status, 1});
+    }
+
+    eventCount++;
+    if (++blockEvents == EVENTS_PER_BLOCK) {
+        flushBlock();
+    }
+}
+
+void EventArchiveWriter::flushBlock() {
+    if (blockEvents == 0) return;
+
+    uint64_t largest = *std::max_element(deltas.begin(), deltas.end());
+    int width = 1;
+    while (width < 8 && (largest >> (8 * width)) != 0) width++;
+
+    payload.clear();
+    payload.push_back(static_cast<unsigned char>(width));
+    unsigned char count[4];
+    putU32(count, static_cast<uint32_t>(runs.size()));
+    payload.insert(payload.end(), count, count + 4);
+    for (uint64_t delta : deltas) {
+        for (int i = 0; i < width; i++) {
+            payload.push_back(static_cast<unsigned char>(delta >> (8 * i)));
+        }
+    }
+    for (const Run& run : runs) {
+        payload.push_back(run.status);
+        payload.push_back(static_cast<unsigned char>(run.length));
+        payload.push_back(static_cast<unsigned char>(run.length >> 8));
+    }
+    payload.insert(payload.end(), firstData.begin(), firstData.end());
+    payload.insert(payload.end(), secondData.begin(), secondData.end());
+    payload.insert(payload.end(), longMessages.begin(), longMessages.end());
+    // Lets the reader load every delta as a full 8 bytes
+    payload.insert(payload.end(), 8, 0);
+
+    // Inflating is far slower than decoding, so it has to save at least a third
+    QByteArray compressed = qCompress(payload.data(), static_cast<qsizetype>(payload.size()));
+    bool useCompressed = static_cast<size_t>(compressed.size()) < payload.size() - payload.size() / 3;
+    const char* stored = useCompressed ? compressed.constData() : reinterpret_cast<const char*>(payload.data());
+    size_t storedSize = useCompressed ? static_cast<size_t>(compressed.size()) : payload.size();
+
+    BlockInfo info;
+    info.offset = bytesWritten;
+    info.firstTimeUs = blockFirstTimeUs;
+    info.firstEvent = eventCount - blockEvents;
+    index.push_back(info);
+
+    unsigned char header[BLOCK_HEADER_SIZE];
+    putU32(header, static_cast<uint32_t>(storedSize));
+    putU32(header + 4, useCompressed ? static_cast<uint32_t>(payload.size()) : 0);
+    putU32(header + 8, static_cast<uint32_t>(blockEvents));
+    putU64(header + 12, blockFirstTimeUs);
+    write(header, sizeof(header));
+    write(stored, storedSize);
+
+    deltas.clear();
+    runs.clear();
+    firstData.clear();
+    secondData.clear();
+    longMessages.clear();
+    blockEvents = 0;
+}
+
+bool EventArchiveWriter::close(std::string& error) {
+    if (!file) return true;
+    flushBlock();
+
+    uint64_t indexOffset = bytesWritten;
+    for (const BlockInfo& info : index) {
+        unsigned char entry[INDEX_ENTRY_SIZE];
+        putU64(entry, info.offset);
+        putU64(entry + 8, info.firstTimeUs);
+        putU64(entry + 16, info.firstEvent);
+        write(entry, sizeof(entry));
+    }
+
+    unsigned char footer[FOOTER_SIZE];
+    putU64(footer, indexOffset);
+    putU32(footer + 8, static_cast<uint32_t>(index.size()));
+    putU64(footer + 12, eventCount);
+    std::memcpy(footer + 20, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    write(footer, sizeof(footer));
+
+    if (std::fflush(file) != 0 && writeError == 0) writeError = errno;
+    if (std::ferror(file) && writeError == 0) writeError = EIO;
+    if (std::fclose(file) != 0 && writeError == 0) writeError = errno;
+    file = nullptr;
+    if (writeError != 0) {
+        error = std::strerror(writeError);
+        return false;
+    }
+    return true;
+}
+
+uint64_t EventArchiveWriter::getEventCount() const {
+    return eventCount;
+}
+
+uint64_t EventArchiveWriter::getBytesWritten() const {
+    return bytesWritten;
+}
+
+EventArchiveReader::EventArchiveReader()
+    : data(nullptr)
+    , size(0)
+    , eventCount(0)
+{
+}
+
+EventArchiveReader::~EventArchiveReader() {
+    if (data) {
+        file.unmap(const_cast<uchar*>(data));
+    }
+}
+
+bool EventArchiveReader::open(const QString& path, std::string& error) {
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString().toStdString();
+        return false;
+    }
+
+    size = static_cast<size_t>(file.size());
+    data = size > 0 ? file.map(0, file.size()) : nullptr;
+    if (!data || size < sizeof(FILE_MAGIC) + FOOTER_SIZE ||
+        std::memcmp(data, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+        std::memcmp(data + size - sizeof(INDEX_MAGIC), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+        error = path.toStdString() + " is not a complete event archive";
+        return false;
+    }
+
+    const unsigned char* footer = data + size - FOOTER_SIZE;
+    uint64_t indexOffset = readU64(footer);
+    uint32_t blockCount = readU32(footer + 8);
+    eventCount = readU64(footer + 12);
+    if (indexOffset > size - FOOTER_SIZE || (size - FOOTER_SIZE - indexOffset) / INDEX_ENTRY_SIZE < blockCount) {
+        error = path.toStdString() + " has a damaged index";
+        return false;
+    }
+
+    index.resize(blockCount);
+    for (uint32_t i = 0; i < blockCount; i++) {
+        const unsigned char* entry = data + indexOffset + i * INDEX_ENTRY_SIZE;
+        index[i].offset = readU64(entry);
+        index[i].firstTimeUs = readU64(entry + 8);
+        index[i].firstEvent = readU64(entry + 16);
+    }
+    return true;
+}
+
+uint64_t EventArchiveReader::getEventCount() const {
+    return eventCount;
+}
+
+size_t EventArchiveReader::getBlockCount() const {
+    return index.size();
+}
+
+int64_t EventArchiveReader::getBlockStartNs(size_t block) const {
+    return static_cast<int64_t>(index[block].firstTimeUs * 1000);
+}
+
+size_t EventArchiveReader::findBlock(int64_t timeNs) const {
+    uint64_t timeUs = static_cast<uint64_t>(std::max<int64_t>(timeNs, 0) / 1000);
+    auto next = std::upper_bound(index.begin(), index.end(), timeUs,
+                                 [](uint64_t t, const BlockInfo& info) { return t < info.firstTimeUs; });
+    return next == index.begin() ? 0 : static_cast<size_t>(next - index.begin() - 1);
+}
+
+const unsigned char* EventArchiveReader::messageBytes(const Event& event, const std::vector<unsigned char>& longMessages) {
+    return event.size <= sizeof(event.bytes) ? event.bytes : longMessages.data() + event.longOffset;
+}
+
+bool EventArchiveReader::decodeBlock(size_t block, std::vector<Event>& events,
+                                     std::vector<unsigned char>& longMessages) const {
+    // events keeps its capacity (and old contents) until the block is known good
+    auto fail = [&events]() {
+        events.clear();
+        return false;
+    };
+    longMessages.clear();
+    if (block >= index.size()) return fail();
+
+    uint64_t offset = index[block].offset;
+    if (offset > size || size - offset < BLOCK_HEADER_SIZE) return fail();
+    const unsigned char* header = data + offset;
+    uint32_t storedSize = readU32(header);
+    uint32_t rawSize = readU32(header + 4);
+    uint32_t count = readU32(header + 8);
+    if (size - offset - BLOCK_HEADER_SIZE < storedSize) return fail();
+
+    // Uncompressed blocks are decoded straight from the mapping
+    QByteArray inflated;
+    const unsigned char* p = header + BLOCK_HEADER_SIZE;
+    size_t payloadSize = storedSize;
+    if (rawSize != 0) {
+        inflated = qUncompress(p, static_cast<qsizetype>(storedSize));
+        p = reinterpret_cast<const unsigned char*>(inflated.constData());
+        payloadSize = static_cast<size_t>(inflated.size());
+    }
+    const unsigned char* end = p + payloadSize;
+
+    // Check the column sizes once so the loops below need no bounds checks
+    if (payloadSize < 5 + 8) return fail();
+    int width = p[0];
+    uint32_t runCount = readU32(p + 1);
+    if (width < 1 || width > 8 || static_cast<size_t>(count) * width > payloadSize - 5 - 8) return fail();
+    const unsigned char* deltas = p + 5;
+    const unsigned char* runs = deltas + static_cast<size_t>(count) * width;
+    if (static_cast<size_t>(end - runs) < static_cast<size_t>(runCount) * 3) return fail();
+
+    size_t firstCount = 0, secondCount = 0, runTotal = 0;
+    for (uint32_t r = 0; r < runCount; r++) {
+        size_t length = runs[3 * r + 1] | runs[3 * r + 2] << 8;
+        size_t messageLength = impliedLength.length[runs[3 * r]];
+        if (runs[3 * r] != ESCAPE && messageLength == 0) return fail();
+        if (messageLength > 1) firstCount += length;
+        if (messageLength > 2) secondCount += length;
+        runTotal += length;
+    }
+    const unsigned char* first = runs + static_cast<size_t>(runCount) * 3;
+    const unsigned char* second = first + firstCount;
+    if (runTotal != count || static_cast<size_t>(end - first) < firstCount + secondCount + 8) return fail();
+    const unsigned char* longData = second + secondCount;
+    const unsigned char* longEnd = end - 8;
+
+    events.resize(count);
+    Event* event = events.data();
+    uint64_t mask = width == 8 ? ~0ULL : (1ULL << (8 * width)) - 1;
+    uint64_t timeUs = index[block].firstTimeUs;
+
+    for (uint32_t r = 0; r < runCount; r++) {
+        unsigned char status = runs[3 * r];
+        size_t length = runs[3 * r + 1] | runs[3 * r + 2] << 8;
+        size_t messageLength = impliedLength.length[status];
+
+        for (size_t k = 0; k < length; k++, event++, deltas += width) {
+            timeUs += readU64(deltas) & mask;
+            event->timeNs = static_cast<int64_t>(timeUs * 1000);
+            event->bytes[0] = status;
+            event->size = static_cast<uint8_t>(messageLength);
+        }
+        event -= length;
+
+        if (messageLength == 3) {
+            for (size_t k = 0; k < length; k++) {
+                event[k].bytes[1] = first[k];
+                event[k].bytes[2] = second[k];
+            }
+            first += length;
+            second += length;
+        } else if (messageLength == 2) {
+            for (size_t k = 0; k < length; k++) {
+                event[k].bytes[1] = first[k];
+            }
+            first += length;
+        } else if (status == ESCAPE) {
+            for (size_t k = 0; k < length; k++) {
+                if (longData >= longEnd || static_cast<size_t>(longEnd - longData - 1) < longData[0]) return fail();
+                size_t messageSize = longData[0];
+                event[k].size = static_cast<uint8_t>(messageSize);
+                if (messageSize <= sizeof(event[k].bytes)) {
+                    std::memcpy(event[k].bytes, longData + 1, messageSize);
+                } else {
+                    event[k].longOffset = static_cast<uint32_t>(longMessages.size());
+                    longMessages.insert(longMessages.end(), longData + 1, longData + 1 + messageSize);
+                }
+                longData += 1 + messageSize;
+            }
+        }
+        event += length;
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Compact cold-storage format for one session's MIDI events. Events are
+// grouped into blocks of up to EVENTS_PER_BLOCK, each stored column-wise:
+// microsecond time deltas at the narrowest byte width the block needs,
+// status bytes as runs (running status, so a phrase of note messages stores
+// its status once), then the first and second data bytes. Blocks are zlib
+// compressed unless that saves too little to be worth the inflate. A
+// trailing index of block offsets and start times lets a reader seek to any
+// time by decoding a single block, and the column layout keeps the decode
+// loops free of per-event branches.
+//
+// File layout (little endian):
+//   "MIDIARC\x01"
+//   blocks: u32 stored size | u32 raw size (0 = not compressed) | u32 event count
+//           | u64 first time (us) | payload
+//   payload: u8 delta width | u32 run count | deltas | runs (u8 status, u16 length)
+//            | first data bytes | second data bytes | long messages (u8 length, bytes)
+//   index:  per block u64 offset | u64 first time (us) | u64 first event number
+//   footer: u64 index offset | u32 block count | u64 event count | "MIDIAIDX"
+class EventArchiveWriter {
+public:
+    static const size_t EVENTS_PER_BLOCK = 8192;
+
+    EventArchiveWriter();
+    ~EventArchiveWriter();
+
+    bool open(const std::string& path, std::string& error);
+    // timeNs must not decrease; messages up to 255 bytes
+    void append(int64_t timeNs, const unsigned char* data, size_t size);
+    // Writes the last block and the index
+    bool close(std::string& error);
+
+    uint64_t getEventCount() const;
+    uint64_t getBytesWritten() const;
+
+private:
+    struct BlockInfo {
+        uint64_t offset;
+        uint64_t firstTimeUs;
+        uint64_t firstEvent;
+    };
+
+    struct Run {
+        uint8_t status;
+        uint16_t length;
+    };
+
+    std::FILE* file;
+    size_t blockEvents;
+    uint64_t blockFirstTimeUs;
+    uint64_t lastTimeUs;
+    uint64_t eventCount;
+
+    // Columns of the block being filled
+    std::vector<uint64_t> deltas;
+    std::vector<Run> runs;
+    std::vector<unsigned char> firstData;
+    std::vector<unsigned char> secondData;
+    std::vector<unsigned char> longMessages;
+    std::vector<unsigned char> payload;
+    uint64_t bytesWritten;
+    std::vector<BlockInfo> index;
+    int writeError;         // errno of the first failed write, 0 = none; close reports it
+
+    void flushBlock();
+    void write(const void* data, size_t size);
+};
+
+class EventArchiveReader {
+public:
+    // Messages of up to 3 bytes are stored inline; longer ones live in the
+    // block's message arena at longOffset
+    struct Event {
+        int64_t timeNs;
+        uint8_t bytes[3];
+        uint8_t size;
+        uint32_t longOffset;
+    };
+
+    EventArchiveReader();
+    ~EventArchiveReader();
+
+    bool open(const QString& path, std::string& error);
+
+    uint64_t getEventCount() const;
+    size_t getBlockCount() const;
+    int64_t getBlockStartNs(size_t block) const;
+    // Last block starting at or before timeNs (0 if timeNs precedes the archive)
+    size_t findBlock(int64_t timeNs) const;
+
+    // Replaces events and longMessages with the contents of one block
+    bool decodeBlock(size_t block, std::vector<Event>& events, std::vector<unsigned char>& longMessages) const;
+
+    static const unsigned char* messageBytes(const Event& event, const std::vector<unsigned char>& longMessages);
+
+private:
+    struct BlockInfo {
+        uint64_t offset;
+        uint64_t firstTimeUs;
+        uint64_t firstEvent;
+    };
+
+    QFile file;
+    const unsigned char* data;
+    size_t size;
+    uint64_t eventCount;
+    std::vector<BlockInfo> index;
+};
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "Fft.h"
+#include <cmath>
+
+Fft::Fft(int size)
+    : size(size)
+    , levels(0)
+    , window(size)
+    , cosTable(size / 2)
+    , sinTable(size / 2)
+    , bitReversed(size)
+    , real(size)
+    , imag(size)
+{
+    while ((1 << levels) < size) levels++;
+
+    const double pi = 3.14159265358979323846;
+    for (int i = 0; i < size; i++) {
+        window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * pi * i / size));
+
+        int reversed = 0;
+        for (int bit = 0; bit < levels; bit++) {
+            if (i & (1 << bit)) reversed |= 1 << (levels - 1 - bit);
+        }
+        bitReversed[i] = reversed;
+    }
+    for (int i = 0; i < size / 2; i++) {
+        cosTable[i] = static_cast<float>(std::cos(2.0 * pi * i / size));
+        sinTable[i] = static_cast<float>(-std::sin(2.0 * pi * i / size));
+    }
+}
+
+int Fft::getSize() const {
+    return size;
+}
+
+int Fft::getBinCount() const {
+    return size / 2 + 1;
+}
+
+void Fft::magnitudes(const float* input, float* output) {
+    for (int i = 0; i < size; i++) {
+        real[bitReversed[i]] = input[i] * window[i];
+        imag[i] = 0.0f;
+    }
+
+    transform();
+
+    // Scaled so a full-scale sine peaks near 1.0
+    float scale = 4.0f / size;
+    int bins = getBinCount();
+    for (int i = 0; i < bins; i++) {
+        output[i] = std::sqrt(real[i] * real[i] + imag[i] * imag[i]) * scale;
+    }
+}
+
+void Fft::transform() {
+    float* re = real.data();
+    float* im = imag.data();
+
+    for (int half = 1; half < size; half *= 2) {
+        int stride = size / (2 * half);
+        for (int start = 0; start < size; start += 2 * half) {
+            float* reA = re + start;
+            float* imA = im + start;
+            float* reB = re + start + half;
+            float* imB = im + start + half;
+            for (int k = 0; k < half; k++) {
+                float c = cosTable[k * stride];
+                float s = sinTable[k * stride];
+                float tr = reB[k] * c - imB[k] * s;
+                float ti = reB[k] * s + imB[k] * c;
+                reB[k] = reA[k] - tr;
+                imB[k] = imA[k] - ti;
+                reA[k] += tr;
+                imA[k] += ti;
+            }
+        }
+    }
+}
\ No newline at end of file
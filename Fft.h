@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+// Radix-2 FFT for fixed-size analysis frames. Twiddles, window and
+// bit-reversal tables are computed once; data is kept as separate real and
+// imaginary arrays so the butterfly loops vectorize. Not thread-safe: use
+// one instance per thread.
+class Fft {
+public:
+    explicit Fft(int size); // power of two
+
+    int getSize() const;
+    int getBinCount() const; // size / 2 + 1
+
+    // Hann-windowed magnitude spectrum of size samples into getBinCount() bins
+    void magnitudes(const float* input, float* output);
+
+private:
+    int size;
+    int levels;
+    std::vector<float> window;
+    std::vector<float> cosTable;
+    std::vector<float> sinTable;
+    std::vector<int> bitReversed;
+    std::vector<float> real;
+    std::vector<float> imag;
+
+    void transform();
+};
\ No newline at end of file
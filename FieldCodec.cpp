@@ -0,0 +1,166 @@
+#include "FieldCodec.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+FieldWriter::FieldWriter(std::vector<char>& out)
+    : out(out)
+{
+}
+
+void FieldWriter::u8(uint8_t value) {
+    out.push_back(static_cast<char>(value));
+}
+
+void FieldWriter::u32(uint32_t value) {
+    for (int i = 0; i < 4; i++) u8(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void FieldWriter::u64(uint64_t value) {
+    for (int i = 0; i < 8; i++) u8(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void FieldWriter::f64(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    u64(bits);
+}
+
+void FieldWriter::text(const std::string& value) {
+    size_t length = std::min<size_t>(value.size(), 0xFFFF);
+    u8(static_cast<uint8_t>(length));
+    u8(static_cast<uint8_t>(length >> 8));
+    out.insert(out.end(), value.data(), value.data() + length);
+}
+
+void FieldWriter::bits(const std::bitset<128>& value) {
+    for (int word = 0; word < 2; word++) {
+        uint64_t packed = 0;
+        for (int bit = 0; bit < 64; bit++) {
+            if (value[word * 64 + bit]) packed |= uint64_t(1) << bit;
+        }
+        u64(packed);
+    }
+}
+
+void FieldWriter::blob(const std::vector<char>& value) {
+    u32(static_cast<uint32_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+FieldReader::FieldReader(const char* data, size_t size)
+    : data(data)
+    , size(size)
+    , offset(0)
+    , failed(false)
+{
+}
+
+bool FieldReader::ok() const {
+    return !failed;
+}
+
+uint8_t FieldReader::u8() {
+    if (!need(1)) return 0;
+    return static_cast<uint8_t>(data[offset++]);
+}
+
+uint32_t FieldReader::u32() {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) value |= static_cast<uint32_t>(u8()) << (8 * i);
+    return value;
+}
+
+uint64_t FieldReader::u64() {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) value |= static_cast<uint64_t>(u8()) << (8 * i);
+    return value;
+}
+
+double FieldReader::f64() {
+    uint64_t bits = u64();
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::string FieldReader::text() {
+    size_t length = u8();
+    length |= static_cast<size_t>(u8()) << 8;
+    if (!need(length)) return std::string();
+    std::string value(data + offset, length);
+    offset += length;
+    return value;
+}
+
+std::bitset<128> FieldReader::bits() {
+    std::bitset<128> value;
+    for (int word = 0; word < 2; word++) {
+        uint64_t packed = u64();
+        for (int bit = 0; bit < 64; bit++) {
+            if (packed & (uint64_t(1) << bit)) value[word * 64 + bit] = true;
+        }
+    }
+    return value;
+}
+
+std::vector<char> FieldReader::blob() {
+    size_t length = u32();
+    if (!need(length)) return std::vector<char>();
+    std::vector<char> value(data + offset, data + offset + length);
+    offset += length;
+    return value;
+}
+
+bool FieldReader::need(size_t count) {
+    if (failed || size - offset < count) {
+        failed = true;
+        return false;
+    }
+    return true;
+}
+
+namespace FieldCodec {
+
+bool writeFileAtomically(const std::string& path, const std::vector<char>& contents, std::string& error) {
+    std::string temporaryPath = path + ".tmp";
+    std::FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file) {
+        error = "cannot open " + temporaryPath + ": " + std::strerror(errno);
+        return false;
+    }
+    bool written = std::fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+    written = std::fclose(file) == 0 && written;
+
+    if (!written || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        error = "cannot write " + path + ": " + std::strerror(errno);
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool readFile(const std::string& path, std::vector<char>& contents, std::string& error) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    contents.clear();
+    char chunk[65536];
+    size_t count;
+    while ((count = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        contents.insert(contents.end(), chunk, chunk + count);
+    }
+    bool failed = std::ferror(file) != 0;
+    std::fclose(file);
+    if (failed) {
+        error = "cannot read " + path;
+        return false;
+    }
+    return true;
+}
+
+} // namespace FieldCodec
\ No newline at end of file
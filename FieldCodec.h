@@ -0,0 +1,59 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Little-endian fields for the small state files (session snapshots,
+// practice summaries): fixed-width integers, doubles, length-prefixed text
+// and byte blobs, and 128-bit note sets. The reader never runs past its buffer; a short
+// field reads as zero and leaves ok() false.
+class FieldWriter {
+public:
+    explicit FieldWriter(std::vector<char>& out);
+
+    void u8(uint8_t value);
+    void u32(uint32_t value);
+    void u64(uint64_t value);
+    void f64(double value);
+    void text(const std::string& value);   // up to 65535 bytes
+    void bits(const std::bitset<128>& value);
+    void blob(const std::vector<char>& value);
+
+private:
+    std::vector<char>& out;
+};
+
+class FieldReader {
+public:
+    FieldReader(const char* data, size_t size);
+
+    bool ok() const;
+
+    uint8_t u8();
+    uint32_t u32();
+    uint64_t u64();
+    double f64();
+    std::string text();
+    std::bitset<128> bits();
+    std::vector<char> blob();
+
+private:
+    const char* data;
+    size_t size;
+    size_t offset;
+    bool failed;
+
+    bool need(size_t count);
+};
+
+namespace FieldCodec {
+
+// Writes through a temporary file and a rename, so readers see the old
+// contents or the new, never a torn file
+bool writeFileAtomically(const std::string& path, const std::vector<char>& contents, std::string& error);
+bool readFile(const std::string& path, std::vector<char>& contents, std::string& error);
+
+} // namespace FieldCodec
\ No newline at end of file
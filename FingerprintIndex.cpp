@@ -0,0 +1,379 @@
+#include "FingerprintIndex.h"
+#include "SessionCatalog.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+const int Fingerprinter::MELODY_GRAM;
+const int Fingerprinter::HARMONY_GRAM;
+const int Fingerprinter::WINNOW_WINDOW;
+const int64_t Fingerprinter::ONSET_WINDOW_NS;
+
+namespace {
+
+const char FILE_MAGIC[8] = {'M', 'I', 'D', 'I', 'F', 'P', 'X', '\x01'};
+const size_t HEADER_SIZE = 8 + 4 + 4 + 4;
+
+// Melody intervals fold into +-an octave; harmony codes carry the top bit
+const int INTERVALS = 25;
+const int QUALITIES = SessionCatalog::QUALITY_COUNT;
+const uint32_t HARMONY_TAG = 0x80000000u;
+
+// Posting lists longer than this are stop words at search time
+const uint32_t STOP_FRACTION = 50;
+const uint32_t STOP_MIN_PIECES = 64;
+
+uint32_t readU32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+void putU32(unsigned char* p, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+// Winnowing order; codes themselves are small and clustered
+uint32_t rank(uint32_t code) {
+    code ^= code >> 16;
+    code *= 0x7feb352du;
+    code ^= code >> 15;
+    code *= 0x846ca68bu;
+    return code ^ (code >> 16);
+}
+
+std::vector<uint32_t> grams(const std::vector<uint8_t>& symbols, int length, uint32_t base, uint32_t tag) {
+    std::vector<uint32_t> codes;
+    for (size_t i = 0; i + length <= symbols.size(); i++) {
+        uint32_t code = 0;
+        for (int j = 0; j < length; j++) {
+            code = code * base + symbols[i + j];
+        }
+        codes.push_back(code | tag);
+    }
+    return codes;
+}
+
+} // namespace
+
+Fingerprinter::Fingerprinter(MusicTheoryEngine* theoryEngine)
+    : theoryEngine(theoryEngine)
+    , chordAnalyzer(theoryEngine)
+    , onsetStartNs(0)
+    , onsetOpen(false)
+    , lastTopNote(-1)
+    , lastChordRoot(-1)
+    , lastChordQuality(-1)
+{
+}
+
+void Fingerprinter::process(int64_t timeNs, const unsigned char* data, size_t size) {
+    if (size < 3) return;
+    int type = data[0] & 0xF0;
+    int note = data[1] & 0x7F;
+
+    if (type == 0x90 && data[2] > 0) {
+        if (onsetOpen && timeNs - onsetStartNs > ONSET_WINDOW_NS) {
+            closeOnset();
+        }
+        if (!onsetOpen) {
+            onsetOpen = true;
+            onsetStartNs = timeNs;
+        }
+        onsetNotes[note] = true;
+        heldNotes[note] = true;
+    } else if (type == 0x80 || type == 0x90) {
+        heldNotes[note] = false;
+    }
+}
+
+void Fingerprinter::closeOnset() {
+    onsetOpen = false;
+
+    int top = 127;
+    while (!onsetNotes[top]) top--;
+    if (lastTopNote >= 0) {
+        int interval = top - lastTopNote;
+        while (interval > 12) interval -= 12;
+        while (interval < -12) interval += 12;
+        melody.push_back(static_cast<uint8_t>(interval + 12));
+    }
+    lastTopNote = top;
+
+    // Notes still held from earlier onsets belong to the chord too
+    std::bitset<128> chordNotes = heldNotes | onsetNotes;
+    onsetNotes.reset();
+    if (chordNotes.count() < 3) return;
+
+    std::vector<int> notes;
+    for (int n = 0; n < 128; n++) {
+        if (chordNotes[n]) notes.push_back(n);
+    }
+    MusicTypes::ChordAnalysis analysis = chordAnalyzer.analyzeChord(notes, theoryEngine->getKeySignature(0));
+    if (analysis.chordQuality.empty()) return;
+
+    int root = analysis.rootNote % 12;
+    int quality = SessionCatalog::qualityOf(analysis.chordQuality);
+    if (root == lastChordRoot && quality == lastChordQuality) return;
+    if (lastChordRoot >= 0) {
+        int interval = (root - lastChordRoot + 12) % 12;
+        harmony.push_back(static_cast<uint8_t>(interval * QUALITIES + quality));
+    }
+    lastChordRoot = root;
+    lastChordQuality = quality;
+}
+
+void Fingerprinter::winnow(const std::vector<uint32_t>& codes, std::vector<uint32_t>& hashes) {
+    if (codes.size() <= static_cast<size_t>(WINNOW_WINDOW)) {
+        hashes.insert(hashes.end(), codes.begin(), codes.end());
+        return;
+    }
+    for (size_t start = 0; start + WINNOW_WINDOW <= codes.size(); start++) {
+        size_t best = start;
+        for (size_t i = start + 1; i < start + WINNOW_WINDOW; i++) {
+            if (rank(codes[i]) < rank(codes[best])) best = i;
+        }
+        hashes.push_back(codes[best]);
+    }
+}
+
+std::vector<uint32_t> Fingerprinter::finish() {
+    if (onsetOpen) closeOnset();
+
+    std::vector<uint32_t> hashes;
+    winnow(grams(melody, MELODY_GRAM, INTERVALS, 0), hashes);
+    winnow(grams(harmony, HARMONY_GRAM, 12 * QUALITIES, HARMONY_TAG), hashes);
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    return hashes;
+}
+
+uint32_t FingerprintIndexWriter::addPiece(const std::string& name, const std::vector<uint32_t>& fingerprint) {
+    uint32_t piece = static_cast<uint32_t>(hashCounts.size());
+    for (uint32_t hash : fingerprint) {
+        postings.emplace_back(hash, piece);
+    }
+    hashCounts.push_back(static_cast<uint32_t>(fingerprint.size()));
+    nameOffsets.push_back(static_cast<uint32_t>(names.size()));
+    names += name;
+    return piece;
+}
+
+uint32_t FingerprintIndexWriter::getPieceCount() const {
+    return static_cast<uint32_t>(hashCounts.size());
+}
+
+bool FingerprintIndexWriter::write(const std::string& path, std::string& error) const {
+    if (postings.size() > UINT32_MAX || names.size() > UINT32_MAX) {
+        error = "index too large";
+        return false;
+    }
+
+    // Pieces were added in order, so sorting by hash keeps each posting list sorted by piece
+    std::vector<std::pair<uint32_t, uint32_t>> sorted(postings);
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) {
+                         return a.first < b.first;
+                     });
+
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> offsets;
+    for (size_t i = 0; i < sorted.size(); i++) {
+        if (i == 0 || sorted[i].first != sorted[i - 1].first) {
+            keys.push_back(sorted[i].first);
+            offsets.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    offsets.push_back(static_cast<uint32_t>(sorted.size()));
+
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    std::vector<unsigned char> buffer;
+    auto put = [&](uint32_t value) {
+        size_t at = buffer.size();
+        buffer.resize(at + 4);
+        putU32(buffer.data() + at, value);
+    };
+    auto flush = [&]() {
+        bool ok = buffer.empty() || std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+        buffer.clear();
+        return ok;
+    };
+
+    bool ok = true;
+    buffer.assign(FILE_MAGIC, FILE_MAGIC + sizeof(FILE_MAGIC));
+    put(getPieceCount());
+    put(static_cast<uint32_t>(keys.size()));
+    put(static_cast<uint32_t>(sorted.size()));
+    for (uint32_t key : keys) put(key);
+    for (uint32_t offset : offsets) put(offset);
+    ok = ok && flush();
+    for (const auto& posting : sorted) put(posting.second);
+    ok = ok && flush();
+    for (uint32_t count : hashCounts) put(count);
+    for (uint32_t offset : nameOffsets) put(offset);
+    put(static_cast<uint32_t>(names.size()));
+    buffer.insert(buffer.end(), names.begin(), names.end());
+    ok = ok && flush();
+
+    if (std::fclose(file) != 0 || !ok) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+FingerprintIndex::FingerprintIndex()
+    : data(nullptr)
+    , pieceCount(0)
+    , hashCount(0)
+    , hashes(nullptr)
+    , offsets(nullptr)
+    , postings(nullptr)
+    , pieceHashCounts(nullptr)
+    , nameOffsets(nullptr)
+    , names(nullptr)
+{
+}
+
+FingerprintIndex::~FingerprintIndex() {
+    if (data) {
+        file.unmap(const_cast<uchar*>(data));
+    }
+}
+
+bool FingerprintIndex::open(const QString& path, std::string& error) {
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString().toStdString();
+        return false;
+    }
+
+    uint64_t size = static_cast<uint64_t>(file.size());
+    data = size > 0 ? file.map(0, file.size()) : nullptr;
+    if (!data || size < HEADER_SIZE || std::memcmp(data, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+        return reject(path.toStdString() + " is not a fingerprint index", error);
+    }
+
+    pieceCount = readU32(data + 8);
+    hashCount = readU32(data + 12);
+    uint64_t postingCount = readU32(data + 16);
+    uint64_t namesOffset = HEADER_SIZE + 4 * (static_cast<uint64_t>(hashCount) * 2 + 1 + postingCount +
+                                               static_cast<uint64_t>(pieceCount) * 2 + 1);
+    if (namesOffset > size) {
+        return reject(path.toStdString() + " is truncated", error);
+    }
+
+    hashes = data + HEADER_SIZE;
+    offsets = hashes + 4 * static_cast<size_t>(hashCount);
+    postings = offsets + 4 * (static_cast<size_t>(hashCount) + 1);
+    pieceHashCounts = postings + 4 * postingCount;
+    nameOffsets = pieceHashCounts + 4 * static_cast<size_t>(pieceCount);
+    names = data + namesOffset;
+
+    // Every table search() and getPieceName() index into is checked once, here
+    std::string damaged = path.toStdString() + " is damaged";
+    for (size_t i = 1; i < hashCount; i++) {
+        if (readU32(hashes + 4 * i) <= readU32(hashes + 4 * (i - 1))) return reject(damaged, error);
+    }
+    if (readU32(offsets) != 0 || readU32(offsets + 4 * static_cast<size_t>(hashCount)) != postingCount) {
+        return reject(damaged, error);
+    }
+    for (size_t i = 0; i < hashCount; i++) {
+        if (readU32(offsets + 4 * (i + 1)) < readU32(offsets + 4 * i)) return reject(damaged, error);
+    }
+    for (size_t i = 0; i < postingCount; i++) {
+        if (readU32(postings + 4 * i) >= pieceCount) return reject(damaged, error);
+    }
+    if (readU32(nameOffsets) != 0 || readU32(nameOffsets + 4 * static_cast<size_t>(pieceCount)) > size - namesOffset) {
+        return reject(path.toStdString() + " is truncated", error);
+    }
+    for (size_t i = 0; i < pieceCount; i++) {
+        if (readU32(nameOffsets + 4 * (i + 1)) < readU32(nameOffsets + 4 * i)) return reject(damaged, error);
+    }
+    return true;
+}
+
+bool FingerprintIndex::reject(const std::string& error, std::string& errorOut) {
+    errorOut = error;
+    if (data) {
+        file.unmap(const_cast<uchar*>(data));
+        data = nullptr;
+    }
+    file.close();
+    pieceCount = 0;
+    hashCount = 0;
+    return false;
+}
+
+uint32_t FingerprintIndex::getPieceCount() const {
+    return pieceCount;
+}
+
+std::string FingerprintIndex::getPieceName(uint32_t piece) const {
+    if (!data || piece >= pieceCount) return std::string();
+    uint32_t begin = readU32(nameOffsets + 4 * static_cast<size_t>(piece));
+    uint32_t end = readU32(nameOffsets + 4 * (static_cast<size_t>(piece) + 1));
+    return std::string(reinterpret_cast<const char*>(names) + begin, end - begin);
+}
+
+std::vector<FingerprintIndex::Match> FingerprintIndex::search(const std::vector<uint32_t>& fingerprint,
+                                                              size_t maxMatches) const {
+    std::vector<Match> matches;
+    if (!data || fingerprint.empty()) return matches;
+
+    uint32_t stopLength = std::max(pieceCount / STOP_FRACTION, STOP_MIN_PIECES);
+    std::vector<uint32_t> candidates;
+    uint32_t usedHashes = 0;
+    for (uint32_t hash : fingerprint) {
+        // Binary search over the sorted hash column
+        uint32_t low = 0, high = hashCount;
+        while (low < high) {
+            uint32_t middle = low + (high - low) / 2;
+            if (readU32(hashes + 4 * static_cast<size_t>(middle)) < hash) low = middle + 1;
+            else high = middle;
+        }
+        if (low == hashCount || readU32(hashes + 4 * static_cast<size_t>(low)) != hash) {
+            usedHashes++;
+            continue;
+        }
+
+        uint32_t begin = readU32(offsets + 4 * static_cast<size_t>(low));
+        uint32_t end = readU32(offsets + 4 * (static_cast<size_t>(low) + 1));
+        if (end - begin > stopLength) continue;
+        usedHashes++;
+        for (uint32_t i = begin; i < end; i++) {
+            candidates.push_back(readU32(postings + 4 * static_cast<size_t>(i)));
+        }
+    }
+    if (usedHashes == 0) return matches;
+
+    std::sort(candidates.begin(), candidates.end());
+    for (size_t i = 0; i < candidates.size();) {
+        size_t j = i;
+        while (j < candidates.size() && candidates[j] == candidates[i]) j++;
+
+        Match match;
+        match.piece = candidates[i];
+        match.sharedHashes = static_cast<uint32_t>(j - i);
+        uint32_t pieceHashes = readU32(pieceHashCounts + 4 * static_cast<size_t>(match.piece));
+        match.containment = static_cast<float>(match.sharedHashes) / usedHashes;
+        match.similarity = static_cast<float>(match.sharedHashes) /
+                           (fingerprint.size() + pieceHashes - match.sharedHashes);
+        matches.push_back(match);
+        i = j;
+    }
+
+    size_t keep = std::min(maxMatches, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + keep, matches.end(), [](const Match& a, const Match& b) {
+        return a.sharedHashes != b.sharedHashes ? a.sharedHashes > b.sharedHashes : a.similarity > b.similarity;
+    });
+    matches.resize(keep);
+    return matches;
+}
\ No newline at end of file
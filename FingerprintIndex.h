@@ -0,0 +1,112 @@
+#pragma once
+
+#include "ChordAnalyzer.h"
+#include "MusicTheoryEngine.h"
+#include <QFile>
+#include <QString>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Turns a performance into a set of transposition-invariant hashes. The
+// melody (top note of each onset) becomes a sequence of intervals and the
+// harmony a sequence of chord transitions (root interval and quality); each
+// run of MELODY_GRAM intervals or HARMONY_GRAM transitions is one code. Only
+// the smallest code of every WINNOW_WINDOW consecutive codes is kept, which
+// shrinks the fingerprint while guaranteeing that any longer shared passage
+// still shares a hash.
+class Fingerprinter {
+public:
+    explicit Fingerprinter(MusicTheoryEngine* theoryEngine);
+
+    void process(int64_t timeNs, const unsigned char* data, size_t size);
+    // Sorted, distinct hashes of everything processed so far
+    std::vector<uint32_t> finish();
+
+private:
+    static const int MELODY_GRAM = 6;
+    static const int HARMONY_GRAM = 4;
+    static const int WINNOW_WINDOW = 4;
+    static const int64_t ONSET_WINDOW_NS = 30000000;
+
+    MusicTheoryEngine* theoryEngine;
+    ChordAnalyzer chordAnalyzer;
+    std::bitset<128> heldNotes;
+
+    // Notes struck within ONSET_WINDOW_NS form one onset
+    std::bitset<128> onsetNotes;
+    int64_t onsetStartNs;
+    bool onsetOpen;
+
+    int lastTopNote;
+    int lastChordRoot;
+    int lastChordQuality;
+    std::vector<uint8_t> melody;    // interval + 12
+    std::vector<uint8_t> harmony;   // root interval * QUALITIES + quality
+
+    void closeOnset();
+    static void winnow(const std::vector<uint32_t>& codes, std::vector<uint32_t>& hashes);
+};
+
+// Collects fingerprints and writes them as an inverted index: every distinct
+// hash maps to the sorted list of pieces containing it.
+//
+// File layout (little endian, 4-byte aligned):
+//   "MIDIFPX\x01" | u32 piece count | u32 hash count | u32 posting count
+//   | hashes (u32, ascending) | posting offsets (u32, hash count + 1)
+//   | postings (u32 piece) | piece hash counts (u32) | name offsets (u32, piece count + 1)
+//   | names (UTF-8)
+class FingerprintIndexWriter {
+public:
+    uint32_t addPiece(const std::string& name, const std::vector<uint32_t>& fingerprint);
+    bool write(const std::string& path, std::string& error) const;
+
+    uint32_t getPieceCount() const;
+
+private:
+    std::vector<std::pair<uint32_t, uint32_t>> postings;   // hash, piece
+    std::vector<uint32_t> hashCounts;
+    std::string names;
+    std::vector<uint32_t> nameOffsets;
+};
+
+class FingerprintIndex {
+public:
+    struct Match {
+        uint32_t piece;
+        uint32_t sharedHashes;
+        float containment;   // share of the query found in the piece
+        float similarity;    // Jaccard similarity of the two fingerprints
+    };
+
+    FingerprintIndex();
+    ~FingerprintIndex();
+
+    // Every offset table is checked against the file size here, so a
+    // truncated or damaged index is rejected instead of read out of bounds
+    bool open(const QString& path, std::string& error);
+
+    uint32_t getPieceCount() const;
+    std::string getPieceName(uint32_t piece) const;
+
+    // Best matches first. Hashes shared by more than a fiftieth of the pieces
+    // (scales, repeated notes) carry no evidence and are skipped; below 3200
+    // pieces the limit stays at 64, so small indexes keep their common hashes.
+    std::vector<Match> search(const std::vector<uint32_t>& fingerprint, size_t maxMatches) const;
+
+private:
+    QFile file;
+    const unsigned char* data;
+    uint32_t pieceCount;
+    uint32_t hashCount;
+    const unsigned char* hashes;
+    const unsigned char* offsets;
+    const unsigned char* postings;
+    const unsigned char* pieceHashCounts;
+    const unsigned char* nameOffsets;
+    const unsigned char* names;
+
+    bool reject(const std::string& error, std::string& errorOut);
+};
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "JournalReader.h"
+#include "OutputSink.h"
+#include "SessionSnapshot.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+uint32_t readU32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+uint64_t readU64(const unsigned char* p) {
+    return static_cast<uint64_t>(readU32(p)) | static_cast<uint64_t>(readU32(p + 4)) << 32;
+}
+
+// type + session id + time; the u32 length prefix is not counted
+const size_t RECORD_HEADER_SIZE = 1 + 4 + 8;
+
+} // namespace
+
+JournalReader::JournalReader()
+    : data(nullptr)
+    , size(0)
+{
+}
+
+JournalReader::~JournalReader() {
+    if (data) {
+        file.unmap(const_cast<uchar*>(data));
+    }
+}
+
+bool JournalReader::open(const QString& path, std::string& error) {
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString().toStdString();
+        return false;
+    }
+
+    size = static_cast<size_t>(file.size());
+    data = size > 0 ? file.map(0, file.size()) : nullptr;
+    if (!data || size < sizeof(OutputSink::FILE_MAGIC) ||
+        std::memcmp(data, OutputSink::FILE_MAGIC, sizeof(OutputSink::FILE_MAGIC)) != 0) {
+        error = path.toStdString() + " is not a binary journal";
+        return false;
+    }
+
+    // One pass to index sessions and checkpoints; a truncated tail (crash) is ignored
+    Record record;
+    for (size_t offset = sizeof(OutputSink::FILE_MAGIC); readRecord(offset, record); offset = record.next) {
+        if (record.type == OutputSink::SessionOpenRecord && record.payloadSize >= 10) {
+            SessionInfo info;
+            info.sessionId = record.sessionId;
+            info.wallClockMs = static_cast<int64_t>(readU64(record.payload));
+            size_t nameLength = std::min<size_t>(record.payload[8] | record.payload[9] << 8, record.payloadSize - 10);
+            info.name.assign(reinterpret_cast<const char*>(record.payload + 10), nameLength);
+            info.openTimeNs = record.timeNs;
+            sessions.push_back(info);
+        } else if (record.type == OutputSink::CheckpointRecord) {
+            checkpoints[record.sessionId].push_back({record.timeNs, offset});
+        }
+    }
+
+    return true;
+}
+
+const std::vector<JournalReader::SessionInfo>& JournalReader::getSessions() const {
+    return sessions;
+}
+
+bool JournalReader::readRecord(size_t offset, Record& record) const {
+    if (size - offset < 4) return false;
+    size_t length = readU32(data + offset);
+    if (length < RECORD_HEADER_SIZE || size - offset - 4 < length) return false;
+
+    const unsigned char* p = data + offset + 4;
+    record.type = p[0];
+    record.sessionId = static_cast<int32_t>(readU32(p + 1));
+    record.timeNs = static_cast<int64_t>(readU64(p + 5));
+    record.payload = p + RECORD_HEADER_SIZE;
+    record.payloadSize = length - RECORD_HEADER_SIZE;
+    record.next = offset + 4 + length;
+    return true;
+}
+
+std::unique_ptr<AnalysisSession> JournalReader::restoreSession(int32_t sessionId, int64_t timeNs,
+                                                               MusicTheoryEngine* theoryEngine,
+                                                               size_t* replayedEvents) const {
+    auto it = checkpoints.find(sessionId);
+    if (it == checkpoints.end() || it->second.empty()) return nullptr;
+    const std::vector<Checkpoint>& index = it->second;
+
+    // Latest checkpoint at or before timeNs (the first one if timeNs precedes it)
+    auto next = std::upper_bound(index.begin(), index.end(), timeNs,
+                                 [](int64_t t, const Checkpoint& c) { return t < c.timeNs; });
+    auto start = next == index.begin() ? next : next - 1;
+
+    Record record;
+    SessionSnapshot snapshot;
+    if (!readRecord(start->offset, record) ||
+        !snapshot.deserialize(reinterpret_cast<const char*>(record.payload), record.payloadSize)) {
+        return nullptr;
+    }
+
+    std::unique_ptr<AnalysisSession> session(
+        new AnalysisSession(sessionId, snapshot.name, snapshot.keySignatureIndex, theoryEngine));
+    session->restoreSnapshot(snapshot);
+
+    // Replay this session's events up to timeNs; the next checkpoint bounds the scan
+    size_t end = next == index.end() ? size : next->offset;
+    size_t replayed = 0;
+    for (size_t offset = record.next; offset < end && readRecord(offset, record); offset = record.next) {
+        if (record.sessionId != sessionId) continue;
+        if (record.type == OutputSink::SessionCloseRecord || record.timeNs > timeNs) break;
+        if (record.type != OutputSink::MidiRecord || record.payloadSize < 1) continue;
+
+        size_t eventSize = std::min<size_t>(record.payload[0], record.payloadSize - 1);
+        session->submitRecorded(record.payload + 1, eventSize, record.timeNs);
+        session->drain();
+        session->releaseAfterDrain();
+        replayed++;
+    }
+
+    if (replayedEvents) *replayedEvents = replayed;
+    return session;
+}
+
+void JournalReader::forEachMidi(int32_t sessionId, const MidiVisitor& visit) const {
+    Record record;
+    for (size_t offset = sizeof(OutputSink::FILE_MAGIC); data && readRecord(offset, record); offset = record.next) {
+        if (record.sessionId != sessionId || record.type != OutputSink::MidiRecord || record.payloadSize < 1) continue;
+        size_t eventSize = std::min<size_t>(record.payload[0], record.payloadSize - 1);
+        visit(record.timeNs, record.payload + 1, eventSize);
+    }
+}
+
+size_t JournalReader::forEachRecord(size_t from, const RecordVisitor& visit) const {
+    size_t offset = std::max(from, sizeof(OutputSink::FILE_MAGIC));
+    Record record;
+    for (; data && readRecord(offset, record); offset = record.next) {
+        visit(record.type, record.sessionId, record.timeNs, record.payload, record.payloadSize);
+    }
+    return offset;
+}
+
+const unsigned char* JournalReader::getData() const {
+    return data;
+}
+
+size_t JournalReader::getSize() const {
+    return size;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "AnalysisSession.h"
+#include "MusicTheoryEngine.h"
+#include <QFile>
+#include <QString>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Random access into a binary journal written by OutputSink. The file is
+// mapped and its checkpoints are indexed once on open; restoring a session at
+// any time loads the nearest earlier checkpoint and replays at most one
+// checkpoint interval of events.
+class JournalReader {
+public:
+    struct SessionInfo {
+        int32_t sessionId;
+        std::string name;
+        int64_t wallClockMs;  // when the session opened
+        int64_t openTimeNs;   // session time at the open record
+    };
+
+    JournalReader();
+    ~JournalReader();
+
+    bool open(const QString& path, std::string& error);
+
+    const std::vector<SessionInfo>& getSessions() const;
+
+    // nullptr if the session is unknown; replayedEvents reports the seek cost
+    std::unique_ptr<AnalysisSession> restoreSession(int32_t sessionId, int64_t timeNs,
+                                                    MusicTheoryEngine* theoryEngine,
+                                                    size_t* replayedEvents = nullptr) const;
+
+    // Visits every MIDI event of a session in journal order
+    using MidiVisitor = std::function<void(int64_t timeNs, const unsigned char* data, size_t size)>;
+    void forEachMidi(int32_t sessionId, const MidiVisitor& visit) const;
+
+    // Visits every complete record from byte offset `from` (0 = the first record)
+    // and returns the offset just past the last one, where a later pass can resume
+    using RecordVisitor = std::function<void(uint8_t type, int32_t sessionId, int64_t timeNs,
+                                             const unsigned char* payload, size_t payloadSize)>;
+    size_t forEachRecord(size_t from, const RecordVisitor& visit) const;
+
+    // The mapped file
+    const unsigned char* getData() const;
+    size_t getSize() const;
+
+private:
+    struct Record {
+        uint8_t type;
+        int32_t sessionId;
+        int64_t timeNs;
+        const unsigned char* payload;
+        size_t payloadSize;
+        size_t next;          // offset of the following record
+    };
+
+    struct Checkpoint {
+        int64_t timeNs;
+        size_t offset;        // of the checkpoint record
+    };
+
+    QFile file;
+    const unsigned char* data;
+    size_t size;
+
+    std::vector<SessionInfo> sessions;
+    std::map<int32_t, std::vector<Checkpoint>> checkpoints;
+
+    bool readRecord(size_t offset, Record& record) const;
+};
\ No newline at end of file
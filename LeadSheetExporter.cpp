@@ -0,0 +1,502 @@
+#include "LeadSheetExporter.h"
+#include "ChordAnalyzer.h"
+#include "SessionCatalog.h"
+#include <QFile>
+#include <QXmlStreamWriter>
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <vector>
+
+namespace {
+
+const char* const NOTE_TYPES[] = {"whole", "half", "quarter", "eighth", "16th", "32nd", "64th"};
+const int NOTE_TYPE_COUNT = 7;
+
+// Pitch class as step and alter, with sharps or flats after the key signature
+void spell(int pitchClass, bool flats, QString& step, int& alter) {
+    static const char sharpSteps[] = "CCDDEFFGGAAB";
+    static const char flatSteps[] = "CDDEEFGGAABB";
+    static const bool black[] = {false, true, false, true, false, false, true, false, true, false, true, false};
+    step = QString(QChar(flats ? flatSteps[pitchClass] : sharpSteps[pitchClass]));
+    alter = black[pitchClass] ? (flats ? -1 : 1) : 0;
+}
+
+// MusicXML harmony kind of a MusicTheoryEngine chord pattern
+QString harmonyKind(const std::string& quality) {
+    static const std::map<std::string, const char*> kinds = {
+        {"maj", "major"}, {"maj7", "major-seventh"}, {"maj9", "major-ninth"}, {"6", "major-sixth"},
+        {"m", "minor"}, {"m7", "minor-seventh"}, {"m9", "minor-ninth"}, {"m6", "minor-sixth"},
+        {"mMaj7", "major-minor"}, {"7", "dominant"}, {"9", "dominant-ninth"}, {"11", "dominant-11th"},
+        {"13", "dominant-13th"}, {"dim", "diminished"}, {"dim7", "diminished-seventh"},
+        {"ø7", "half-diminished"}, {"aug", "augmented"}, {"aug7", "augmented-seventh"},
+        {"sus2", "suspended-second"}, {"sus4", "suspended-fourth"}, {"add9", "major"}};
+    auto it = kinds.find(quality);
+    if (it != kinds.end()) return it->second;
+    // Altered and suspended sevenths; the text attribute carries the detail
+    return quality[0] == '7' ? "dominant" : "other";
+}
+
+int pitchClassCount(const std::bitset<128>& notes) {
+    std::bitset<12> pitchClasses;
+    for (int note = 0; note < 128; note++) {
+        if (notes.test(note)) pitchClasses.set(note % 12);
+    }
+    return static_cast<int>(pitchClasses.count());
+}
+
+// Quantizes onsets to a grid that follows the player: each onset pulls the
+// grid's phase part of the way towards it and nudges the step length, so a
+// session that drifts in tempo over hours stays on the beat
+class BeatGrid {
+public:
+    BeatGrid(int64_t originNs, double stepNs)
+        : anchorNs(originNs)
+        , anchorStep(0)
+        , stepNs(stepNs)
+        , nominalStepNs(stepNs)
+    {
+    }
+
+    int64_t onset(int64_t timeNs) {
+        double exact = anchorStep + (timeNs - anchorNs) / stepNs;
+        int64_t step = std::max(anchorStep, static_cast<int64_t>(std::llround(exact)));
+        double error = exact - step;   // in steps, positive when the onset is late
+        double predictedNs = anchorNs + (step - anchorStep) * stepNs;
+        if (step > anchorStep) {
+            stepNs *= 1.0 + PERIOD_GAIN * error / (step - anchorStep);
+            stepNs = std::min(std::max(stepNs, nominalStepNs * 0.8), nominalStepNs * 1.25);
+        }
+        anchorNs = static_cast<int64_t>(predictedNs + PHASE_GAIN * error * stepNs);
+        anchorStep = step;
+        return step;
+    }
+
+    int64_t position(int64_t timeNs) const {
+        return static_cast<int64_t>(std::llround(anchorStep + (timeNs - anchorNs) / stepNs));
+    }
+
+private:
+    static constexpr double PHASE_GAIN = 0.5;
+    static constexpr double PERIOD_GAIN = 0.1;
+
+    int64_t anchorNs;
+    int64_t anchorStep;
+    double stepNs;
+    double nominalStepNs;
+};
+
+} // namespace
+
+// Streams measures into the XML writer. Positions are grid steps from the
+// first onset; everything before the cursor has been written.
+class LeadSheetExporter::Score {
+public:
+    Score(QIODevice* device, const Options& options);
+
+    void begin(const std::string& title, int fifths, bool major, float tempoBpm);
+    // Chord symbol written with the next note
+    void harmony(int root, const std::string& quality, int bass);
+    void note(int64_t start, int64_t end, int pitch);
+    void finish();
+
+    bool hasError() const;
+    uint32_t getMeasures() const;
+
+private:
+    struct NoteValue {
+        int steps;
+        int type;    // index into NOTE_TYPES
+        bool dotted;
+    };
+
+    QXmlStreamWriter xml;
+    const Options& options;
+    int64_t measureSteps;
+    std::vector<NoteValue> values;   // longest first
+    int fifths;
+    bool major;
+    float tempoBpm;
+    bool flats;
+    int64_t cursor;
+    uint32_t measures;
+
+    bool harmonyPending;
+    int harmonyRoot;
+    std::string harmonyQuality;
+    int harmonyBass;
+
+    void span(int64_t end, int pitch);   // rest when pitch < 0
+    void openMeasure();
+    void writeHarmony();
+    void writeNote(int pitch, const NoteValue& value, bool tieStop, bool tieStart);
+};
+
+LeadSheetExporter::Score::Score(QIODevice* device, const Options& options)
+    : xml(device)
+    , options(options)
+    , measureSteps(static_cast<int64_t>(options.beatsPerMeasure) * options.divisions)
+    , fifths(0)
+    , major(true)
+    , tempoBpm(0.0f)
+    , flats(false)
+    , cursor(0)
+    , measures(0)
+    , harmonyPending(false)
+    , harmonyRoot(0)
+    , harmonyBass(0)
+{
+    // Every plain and dotted value that lands on the grid; with a power-of-two
+    // grid the single step is among them, so any length decomposes greedily
+    int wholeSteps = 4 * options.divisions;
+    for (int type = 0; type < NOTE_TYPE_COUNT && (wholeSteps >> type) > 0; type++) {
+        int steps = wholeSteps >> type;
+        if (steps % 2 == 0) values.push_back({steps + steps / 2, type, true});
+        values.push_back({steps, type, false});
+    }
+    xml.setAutoFormatting(true);
+    xml.setAutoFormattingIndent(2);
+}
+
+void LeadSheetExporter::Score::begin(const std::string& title, int keyFifths, bool keyMajor, float bpm) {
+    fifths = keyFifths;
+    major = keyMajor;
+    tempoBpm = bpm;
+    flats = keyFifths < 0;
+
+    xml.writeStartDocument();
+    xml.writeDTD("<!DOCTYPE score-partwise PUBLIC \"-//Recordare//DTD MusicXML 4.0 Partwise//EN\" "
+                 "\"http://www.musicxml.org/dtds/partwise.dtd\">");
+    xml.writeStartElement("score-partwise");
+    xml.writeAttribute("version", "4.0");
+
+    xml.writeStartElement("work");
+    xml.writeTextElement("work-title", QString::fromStdString(title));
+    xml.writeEndElement();
+    xml.writeStartElement("identification");
+    xml.writeStartElement("encoding");
+    xml.writeTextElement("software", "MIDI Keyboard Monitor");
+    xml.writeEndElement();
+    xml.writeEndElement();
+
+    xml.writeStartElement("part-list");
+    xml.writeStartElement("score-part");
+    xml.writeAttribute("id", "P1");
+    xml.writeTextElement("part-name", "Lead");
+    xml.writeEndElement();
+    xml.writeEndElement();
+
+    xml.writeStartElement("part");
+    xml.writeAttribute("id", "P1");
+}
+
+void LeadSheetExporter::Score::harmony(int root, const std::string& quality, int bass) {
+    harmonyPending = true;
+    harmonyRoot = root;
+    harmonyQuality = quality;
+    harmonyBass = bass;
+}
+
+void LeadSheetExporter::Score::note(int64_t start, int64_t end, int pitch) {
+    if (start > cursor) span(start, -1);
+    span(end, pitch);
+}
+
+void LeadSheetExporter::Score::finish() {
+    // Rest out the last measure, or fill an empty sheet with one
+    if (measures == 0 || cursor % measureSteps != 0) {
+        span((cursor / measureSteps + 1) * measureSteps, -1);
+    }
+    xml.writeStartElement("barline");
+    xml.writeAttribute("location", "right");
+    xml.writeTextElement("bar-style", "light-heavy");
+    xml.writeEndElement();
+    xml.writeEndElement();   // measure
+    xml.writeEndElement();   // part
+    xml.writeEndElement();   // score-partwise
+    xml.writeEndDocument();
+}
+
+bool LeadSheetExporter::Score::hasError() const {
+    return xml.hasError();
+}
+
+uint32_t LeadSheetExporter::Score::getMeasures() const {
+    return measures;
+}
+
+void LeadSheetExporter::Score::span(int64_t end, int pitch) {
+    bool first = true;
+    while (cursor < end) {
+        if (cursor % measureSteps == 0) openMeasure();
+        int64_t pieceEnd = std::min(end, (cursor / measureSteps + 1) * measureSteps);
+        while (cursor < pieceEnd) {
+            const NoteValue* value = &values.back();
+            for (const NoteValue& candidate : values) {
+                if (candidate.steps <= pieceEnd - cursor) {
+                    value = &candidate;
+                    break;
+                }
+            }
+            if (first && pitch >= 0 && harmonyPending) writeHarmony();
+            writeNote(pitch, *value, pitch >= 0 && !first, pitch >= 0 && cursor + value->steps < end);
+            cursor += value->steps;
+            first = false;
+        }
+    }
+}
+
+void LeadSheetExporter::Score::openMeasure() {
+    if (measures > 0) xml.writeEndElement();
+    xml.writeStartElement("measure");
+    xml.writeAttribute("number", QString::number(++measures));
+    if (measures > 1) return;
+
+    xml.writeStartElement("attributes");
+    xml.writeTextElement("divisions", QString::number(options.divisions));
+    xml.writeStartElement("key");
+    xml.writeTextElement("fifths", QString::number(fifths));
+    xml.writeTextElement("mode", major ? "major" : "minor");
+    xml.writeEndElement();
+    xml.writeStartElement("time");
+    xml.writeTextElement("beats", QString::number(options.beatsPerMeasure));
+    xml.writeTextElement("beat-type", "4");
+    xml.writeEndElement();
+    xml.writeStartElement("clef");
+    xml.writeTextElement("sign", "G");
+    xml.writeTextElement("line", "2");
+    xml.writeEndElement();
+    xml.writeEndElement();
+
+    QString bpm = QString::number(static_cast<int>(std::lround(tempoBpm)));
+    xml.writeStartElement("direction");
+    xml.writeAttribute("placement", "above");
+    xml.writeStartElement("direction-type");
+    xml.writeStartElement("metronome");
+    xml.writeTextElement("beat-unit", "quarter");
+    xml.writeTextElement("per-minute", bpm);
+    xml.writeEndElement();
+    xml.writeEndElement();
+    xml.writeEmptyElement("sound");
+    xml.writeAttribute("tempo", bpm);
+    xml.writeEndElement();
+}
+
+void LeadSheetExporter::Score::writeHarmony() {
+    QString step;
+    int alter;
+    xml.writeStartElement("harmony");
+    xml.writeStartElement("root");
+    spell(harmonyRoot, flats, step, alter);
+    xml.writeTextElement("root-step", step);
+    if (alter != 0) xml.writeTextElement("root-alter", QString::number(alter));
+    xml.writeEndElement();
+    xml.writeStartElement("kind");
+    xml.writeAttribute("text", harmonyQuality == "maj" ? QString() : QString::fromStdString(harmonyQuality));
+    xml.writeCharacters(harmonyKind(harmonyQuality));
+    xml.writeEndElement();
+    if (harmonyBass != harmonyRoot) {
+        xml.writeStartElement("bass");
+        spell(harmonyBass, flats, step, alter);
+        xml.writeTextElement("bass-step", step);
+        if (alter != 0) xml.writeTextElement("bass-alter", QString::number(alter));
+        xml.writeEndElement();
+    }
+    xml.writeEndElement();
+    harmonyPending = false;
+}
+
+void LeadSheetExporter::Score::writeNote(int pitch, const NoteValue& value, bool tieStop, bool tieStart) {
+    xml.writeStartElement("note");
+    if (pitch >= 0) {
+        QString step;
+        int alter;
+        spell(pitch % 12, flats, step, alter);
+        xml.writeStartElement("pitch");
+        xml.writeTextElement("step", step);
+        if (alter != 0) xml.writeTextElement("alter", QString::number(alter));
+        xml.writeTextElement("octave", QString::number(pitch / 12 - 1));
+        xml.writeEndElement();
+    } else {
+        xml.writeEmptyElement("rest");
+    }
+    xml.writeTextElement("duration", QString::number(value.steps));
+    if (tieStop) {
+        xml.writeEmptyElement("tie");
+        xml.writeAttribute("type", "stop");
+    }
+    if (tieStart) {
+        xml.writeEmptyElement("tie");
+        xml.writeAttribute("type", "start");
+    }
+    xml.writeTextElement("voice", "1");
+    xml.writeTextElement("type", NOTE_TYPES[value.type]);
+    if (value.dotted) xml.writeEmptyElement("dot");
+    if (tieStop || tieStart) {
+        xml.writeStartElement("notations");
+        if (tieStop) {
+            xml.writeEmptyElement("tied");
+            xml.writeAttribute("type", "stop");
+        }
+        if (tieStart) {
+            xml.writeEmptyElement("tied");
+            xml.writeAttribute("type", "start");
+        }
+        xml.writeEndElement();
+    }
+    xml.writeEndElement();
+}
+
+LeadSheetExporter::Options LeadSheetExporter::defaultOptions() {
+    Options options;
+    options.divisions = 4;
+    options.beatsPerMeasure = 4;
+    options.tempoBpm = 0.0f;
+    return options;
+}
+
+LeadSheetExporter::LeadSheetExporter(MusicTheoryEngine* theoryEngine, const Options& options)
+    : theoryEngine(theoryEngine)
+    , options(options)
+{
+}
+
+bool LeadSheetExporter::exportSession(const JournalReader& journal, const JournalReader::SessionInfo& session,
+                                      const QString& path, Result& result, std::string& error) {
+    if (options.divisions < 1 || options.divisions > 16 || (options.divisions & (options.divisions - 1)) != 0) {
+        error = "grid divisions must be a power of two up to 16";
+        return false;
+    }
+    if (options.beatsPerMeasure < 1) {
+        error = "a measure needs at least one beat";
+        return false;
+    }
+
+    // First pass: tempo and prevailing key, the same estimates the session catalog uses
+    SessionCatalog::Builder builder(theoryEngine);
+    int64_t originNs = std::numeric_limits<int64_t>::min();
+    journal.forEachMidi(session.sessionId, [&](int64_t timeNs, const unsigned char* data, size_t size) {
+        if (size < 3 || (data[0] & 0xF0) != 0x90 || data[2] == 0) return;
+        if (originNs == std::numeric_limits<int64_t>::min()) originNs = timeNs;
+        builder.noteOn(timeNs, data[1]);
+    });
+    SessionCatalog::Summary summary = builder.finish(0, 0);
+
+    int keyIndex = static_cast<int>(std::max_element(std::begin(summary.keyShares), std::end(summary.keyShares)) -
+                                    std::begin(summary.keyShares));
+    const MusicTypes::KeySignature* key = &theoryEngine->getKeySignature(0);
+    for (const MusicTypes::KeySignature& candidate : theoryEngine->getKeySignatures()) {
+        if (candidate.tonic == keyIndex % 12 && candidate.isMajor == (keyIndex < 12)) key = &candidate;
+    }
+    keyIndex = key->tonic + (key->isMajor ? 0 : 12);
+
+    result.keyName = SessionCatalog::keyName(keyIndex);
+    result.tempoBpm = options.tempoBpm > 0.0f ? options.tempoBpm
+                    : summary.tempoBpm > 0.0f ? summary.tempoBpm : 120.0f;
+    result.measures = 0;
+    result.notes = 0;
+    result.chords = 0;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        error = file.errorString().toStdString();
+        return false;
+    }
+    Score score(&file, options);
+    score.begin(session.name, SessionCatalog::keyAccidentals(keyIndex), key->isMajor, result.tempoBpm);
+
+    // Second pass: each melody note is written once the next onset fixes its end
+    BeatGrid grid(originNs, 60e9 / result.tempoBpm / options.divisions);
+    const int64_t open = std::numeric_limits<int64_t>::max();
+
+    ChordAnalyzer chordAnalyzer(theoryEngine);
+    std::bitset<128> heldNotes;
+    std::bitset<128> onsetNotes;
+    int64_t onsetStartNs = 0;
+    bool onsetOpen = false;
+    int melodyPitch = -1;
+    int64_t melodyStart = 0;
+    int64_t melodyEnd = open;   // until the next onset, unless released earlier
+    int lastRoot = -1;
+    int lastBass = -1;
+    std::string lastQuality;
+
+    auto flushMelody = [&](int64_t limit) {
+        int64_t end = std::min(melodyEnd, limit);
+        if (end == open) end = melodyStart + options.divisions;
+        score.note(melodyStart, std::max(end, melodyStart + 1), melodyPitch);
+    };
+
+    auto closeOnset = [&]() {
+        onsetOpen = false;
+        int top = 127;
+        while (!onsetNotes.test(top)) top--;
+        onsetNotes.reset();
+
+        int64_t start = grid.onset(onsetStartNs);
+        if (melodyPitch >= 0 && start <= melodyStart) {
+            // Quantized onto the same step as the previous onset
+            melodyPitch = std::max(melodyPitch, top);
+        } else {
+            if (melodyPitch >= 0) flushMelody(start);
+            melodyPitch = top;
+            melodyStart = start;
+            melodyEnd = open;
+            result.notes++;
+        }
+
+        // The chord is what sounds under the melody; block chords without a
+        // separate melody keep their top note
+        std::bitset<128> chordNotes = heldNotes;
+        chordNotes.reset(top);
+        if (pitchClassCount(chordNotes) < 3) chordNotes = heldNotes;
+        if (pitchClassCount(chordNotes) < 3) return;
+
+        std::vector<int> notes;
+        for (int note = 0; note < 128; note++) {
+            if (chordNotes.test(note)) notes.push_back(note);
+        }
+        MusicTypes::ChordAnalysis analysis = chordAnalyzer.analyzeChord(notes, *key);
+        if (analysis.chordQuality.empty()) return;
+        int root = analysis.rootNote % 12;
+        int bass = analysis.bassNote % 12;
+        if (root == lastRoot && bass == lastBass && analysis.chordQuality == lastQuality) return;
+        score.harmony(root, analysis.chordQuality, bass);
+        result.chords++;
+        lastRoot = root;
+        lastBass = bass;
+        lastQuality = analysis.chordQuality;
+    };
+
+    journal.forEachMidi(session.sessionId, [&](int64_t timeNs, const unsigned char* data, size_t size) {
+        if (size < 3) return;
+        if (onsetOpen && timeNs - onsetStartNs >= ONSET_WINDOW_NS) closeOnset();
+
+        uint8_t type = data[0] & 0xF0;
+        int note = data[1] & 0x7F;
+        if (type == 0x90 && data[2] > 0) {
+            if (!onsetOpen) {
+                onsetOpen = true;
+                onsetStartNs = timeNs;
+            }
+            onsetNotes.set(note);
+            heldNotes.set(note);
+        } else if (type == 0x80 || type == 0x90) {
+            heldNotes.reset(note);
+            if (note == melodyPitch && melodyEnd == open && !onsetNotes.test(note)) melodyEnd = grid.position(timeNs);
+        }
+    });
+    if (onsetOpen) closeOnset();
+    if (melodyPitch >= 0) flushMelody(open);
+    score.finish();
+    result.measures = score.getMeasures();
+
+    file.close();
+    if (score.hasError()) {
+        error = "failed to write " + path.toStdString();
+        return false;
+    }
+    return true;
+}
\ No newline at end of file
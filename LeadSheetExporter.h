@@ -0,0 +1,48 @@
+#pragma once
+
+#include "JournalReader.h"
+#include "MusicTheoryEngine.h"
+#include <cstdint>
+#include <string>
+
+// Writes a journal session as a MusicXML lead sheet: the melody (top note of
+// each onset) quantized to a grid at the session's estimated tempo, with the
+// chords under it as chord symbols and the key signature of the session's
+// prevailing key.
+//
+// The session is read twice and nothing is kept between notes: the first
+// pass estimates tempo and key, the second resolves each melody note when the
+// next onset arrives and streams it straight into the XML writer, splitting
+// it at barlines with ties. Output time and memory do not depend on the
+// length of the session beyond the file itself.
+class LeadSheetExporter {
+public:
+    struct Options {
+        int divisions;         // grid steps per quarter note, a power of two
+        int beatsPerMeasure;   // quarter-note beats
+        float tempoBpm;        // 0 = estimate from the session
+    };
+
+    struct Result {
+        std::string keyName;
+        float tempoBpm;
+        uint32_t measures;
+        uint32_t notes;        // melody notes, before splitting at barlines
+        uint32_t chords;       // chord symbols
+    };
+
+    static Options defaultOptions();
+
+    LeadSheetExporter(MusicTheoryEngine* theoryEngine, const Options& options);
+
+    bool exportSession(const JournalReader& journal, const JournalReader::SessionInfo& session,
+                       const QString& path, Result& result, std::string& error);
+
+private:
+    class Score;
+
+    static const int64_t ONSET_WINDOW_NS = 30000000;
+
+    MusicTheoryEngine* theoryEngine;
+    Options options;
+};
\ No newline at end of file
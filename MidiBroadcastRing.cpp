@@ -0,0 +1,153 @@
+#include "MidiBroadcastRing.h"
+#include <cstring>
+
+const size_t MidiBroadcastRing::INLINE_BYTES;
+const int MidiBroadcastRing::MAX_CONSUMERS;
+
+MidiBroadcastRing::MidiBroadcastRing(size_t requestedCapacity)
+    : capacity(1)
+    , head(0)
+    , dropped(0)
+    , oversized(0)
+{
+    while (capacity < requestedCapacity) capacity <<= 1;
+    mask = capacity - 1;
+    entries.reset(new Slot[capacity]);
+    for (size_t i = 0; i < capacity; i++) {
+        entries[i].sequence.store(0, std::memory_order_relaxed);
+    }
+    for (Consumer& consumer : consumers) {
+        consumer.active.store(false, std::memory_order_relaxed);
+    }
+}
+
+MidiBroadcastRing::~MidiBroadcastRing() {
+}
+
+int MidiBroadcastRing::addConsumer(const std::string& name, LagPolicy policy) {
+    for (int i = 0; i < MAX_CONSUMERS; i++) {
+        Consumer& consumer = consumers[i];
+        if (consumer.active.load(std::memory_order_acquire)) continue;
+
+        consumer.name = name;
+        consumer.policy = policy;
+        consumer.read.store(0, std::memory_order_relaxed);
+        consumer.peakLag.store(0, std::memory_order_relaxed);
+        consumer.lost.store(0, std::memory_order_relaxed);
+        consumer.stalls.store(0, std::memory_order_relaxed);
+        consumer.stalled.store(false, std::memory_order_relaxed);
+        consumer.cursor.store(head.load(std::memory_order_acquire), std::memory_order_relaxed);
+        consumer.active.store(true, std::memory_order_release);
+        return i;
+    }
+    return -1;
+}
+
+void MidiBroadcastRing::removeConsumer(int consumer) {
+    if (consumer < 0 || consumer >= MAX_CONSUMERS) return;
+    consumers[consumer].active.store(false, std::memory_order_release);
+}
+
+bool MidiBroadcastRing::publish(double timeStamp, int64_t hostTimeNs, double beats, int sourceId,
+                                const unsigned char* data, size_t size) {
+    if (size > INLINE_BYTES) {
+        oversized.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint64_t position = head.load(std::memory_order_relaxed);
+    for (Consumer& consumer : consumers) {
+        if (!consumer.active.load(std::memory_order_acquire) || consumer.policy != LagPolicy::Stall) continue;
+        if (position - consumer.cursor.load(std::memory_order_acquire) >= capacity) {
+            consumer.stalls.fetch_add(1, std::memory_order_relaxed);
+            consumer.stalled.store(true, std::memory_order_relaxed);
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    // Overwrite consumers still reading the old entry see the sequence change
+    Slot& slot = entries[position & mask];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.entry.timeStamp = timeStamp;
+    slot.entry.hostTimeNs = hostTimeNs;
+    slot.entry.beats = beats;
+    slot.entry.sourceId = sourceId;
+    slot.entry.size = static_cast<uint16_t>(size);
+    std::memcpy(slot.entry.data, data, size);
+    slot.sequence.store(position + 1, std::memory_order_release);
+    head.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+size_t MidiBroadcastRing::consume(int index, const Visitor& visit, size_t maxEntries) {
+    Consumer& consumer = consumers[index];
+    uint64_t cursor = consumer.cursor.load(std::memory_order_relaxed);
+    uint64_t available = head.load(std::memory_order_acquire);
+
+    uint64_t lag = available - cursor;
+    if (lag > consumer.peakLag.load(std::memory_order_relaxed)) {
+        consumer.peakLag.store(lag, std::memory_order_relaxed);
+    }
+    // Only Overwrite consumers can be lapped; resume at the oldest entry left
+    if (lag > capacity) {
+        consumer.lost.fetch_add(lag - capacity, std::memory_order_relaxed);
+        cursor = available - capacity;
+    }
+
+    size_t visited = 0;
+    for (; cursor != available && visited < maxEntries; cursor++) {
+        const Slot& slot = entries[cursor & mask];
+        if (consumer.policy == LagPolicy::Stall) {
+            visit(slot.entry);
+        } else {
+            uint64_t before = slot.sequence.load(std::memory_order_acquire);
+            Entry snapshot = slot.entry;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (before != cursor + 1 || slot.sequence.load(std::memory_order_relaxed) != cursor + 1) {
+                consumer.lost.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            visit(snapshot);
+        }
+        visited++;
+    }
+
+    consumer.read.fetch_add(visited, std::memory_order_relaxed);
+    consumer.cursor.store(cursor, std::memory_order_release);
+    if (available - cursor < capacity / 2) {
+        consumer.stalled.store(false, std::memory_order_relaxed);
+    }
+    return visited;
+}
+
+MidiBroadcastRing::ConsumerStats MidiBroadcastRing::getConsumerStats(int index) const {
+    const Consumer& consumer = consumers[index];
+    ConsumerStats stats;
+    stats.name = consumer.name;
+    stats.policy = consumer.policy;
+    stats.read = consumer.read.load(std::memory_order_relaxed);
+    stats.lag = head.load(std::memory_order_acquire) - consumer.cursor.load(std::memory_order_acquire);
+    stats.peakLag = consumer.peakLag.load(std::memory_order_relaxed);
+    stats.lost = consumer.lost.load(std::memory_order_relaxed);
+    stats.stalls = consumer.stalls.load(std::memory_order_relaxed);
+    stats.stalled = consumer.stalled.load(std::memory_order_relaxed);
+    return stats;
+}
+
+uint64_t MidiBroadcastRing::getLag(int index) const {
+    return head.load(std::memory_order_acquire) - consumers[index].cursor.load(std::memory_order_acquire);
+}
+
+uint64_t MidiBroadcastRing::getPublished() const {
+    return head.load(std::memory_order_relaxed);
+}
+
+uint64_t MidiBroadcastRing::getDropped() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+uint64_t MidiBroadcastRing::getOversized() const {
+    return oversized.load(std::memory_order_relaxed);
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Single-producer, multi-consumer broadcast ring for ingested MIDI. Every
+// message is written once into a fixed slot and each consumer walks the ring
+// with its own cursor, so journaling, thru, network output and analysis all
+// read the same entries instead of each taking a copy of a queue.
+//
+// When the ring is full the slowest consumer's policy decides: an Overwrite
+// consumer is lapped and later skips ahead, counting what it lost; a Stall
+// consumer is never lapped, so the new event is dropped for everyone and the
+// consumer is flagged as the one holding the ring up.
+class MidiBroadcastRing {
+public:
+    static const size_t INLINE_BYTES = 16;   // longer messages are not carried
+    static const int MAX_CONSUMERS = 8;
+
+    enum class LagPolicy {
+        Overwrite,   // lossy: display, thru, network output
+        Stall        // exact: note state, journaling
+    };
+
+    struct Entry {
+        double timeStamp;      // as delivered by the source
+        int64_t hostTimeNs;    // de-jittered steady clock time (ClockEstimator)
+        double beats;          // transport position in quarter notes, < 0 without external clock
+        int32_t sourceId;      // MusicTypes::LocalMidiSource or a network peer
+        uint16_t size;
+        unsigned char data[INLINE_BYTES];
+    };
+
+    struct ConsumerStats {
+        std::string name;
+        LagPolicy policy;
+        uint64_t read;
+        uint64_t lag;          // entries published but not yet read
+        uint64_t peakLag;
+        uint64_t lost;         // overwritten before they were read
+        uint64_t stalls;       // events dropped because this consumer was full
+        bool stalled;          // full at the last publish that found it so
+    };
+
+    using Visitor = std::function<void(const Entry& entry)>;
+
+    explicit MidiBroadcastRing(size_t capacity);   // rounded up to a power of two
+    ~MidiBroadcastRing();
+
+    // Consumers start at the current head; -1 when all slots are taken
+    int addConsumer(const std::string& name, LagPolicy policy);
+    void removeConsumer(int consumer);
+
+    // Producer (one thread at a time); false when dropped
+    bool publish(double timeStamp, int64_t hostTimeNs, double beats, int sourceId, const unsigned char* data, size_t size);
+
+    // Consumer thread: visits up to maxEntries unread entries in order and
+    // returns how many. Stall consumers are handed the slot itself; Overwrite
+    // consumers get a validated snapshot, since the producer may lap them.
+    size_t consume(int consumer, const Visitor& visit, size_t maxEntries = SIZE_MAX);
+
+    ConsumerStats getConsumerStats(int consumer) const;
+    uint64_t getLag(int consumer) const;  // entries the consumer has yet to read
+    uint64_t getPublished() const;
+    uint64_t getDropped() const;         // stalled by a Stall consumer
+    uint64_t getOversized() const;       // longer than INLINE_BYTES
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence;  // published position + 1, 0 while being written
+        Entry entry;
+    };
+
+    // One cache line each, so consumers do not slow the producer down by sharing
+    struct alignas(64) Consumer {
+        std::atomic<bool> active;
+        std::atomic<uint64_t> cursor;    // next position to read
+        LagPolicy policy;
+        std::string name;
+        std::atomic<uint64_t> read;
+        std::atomic<uint64_t> peakLag;
+        std::atomic<uint64_t> lost;
+        std::atomic<uint64_t> stalls;
+        std::atomic<bool> stalled;
+    };
+
+    size_t capacity;
+    uint64_t mask;
+    std::unique_ptr<Slot[]> entries;
+    Consumer consumers[MAX_CONSUMERS];
+
+    alignas(64) std::atomic<uint64_t> head;   // next position to publish
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> oversized;
+};
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "MidiInputBench.h"
+#include "AlsaMidiInput.h"
+#include <RtMidi.h>
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <sys/resource.h>
+#include <vector>
+
+namespace {
+
+const char* const GENERATOR_NAME = "MIDI Monitor Load";
+const int ID_COUNT = 128 * 127;   // note number x non-zero velocity
+
+int64_t monotonicNs() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
+
+double cpuMs() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+// Send times by note id, and the latency of every delivery in order
+struct Probe {
+    std::vector<std::atomic<int64_t>> sentNs;
+    std::vector<int64_t> latencyNs;
+    std::atomic<uint64_t> received;
+
+    explicit Probe(size_t capacity)
+        : sentNs(ID_COUNT)
+        , latencyNs(capacity)
+        , received(0)
+    {
+    }
+
+    void deliver(const unsigned char* data, size_t size) {
+        int64_t nowNs = monotonicNs();
+        if (size < 3 || (data[0] & 0xF0) != 0x90 || data[2] == 0) return;
+        int id = data[1] * 127 + data[2] - 1;
+        uint64_t index = received.fetch_add(1, std::memory_order_relaxed);
+        if (index < latencyNs.size()) {
+            latencyNs[index] = nowNs - sentNs[id].load(std::memory_order_acquire);
+        }
+    }
+};
+
+void rtMidiCallback(double, std::vector<unsigned char>* message, void* userData) {
+    static_cast<Probe*>(userData)->deliver(message->data(), message->size());
+}
+
+} // namespace
+
+bool MidiInputBench::run(const std::string& backend, int eventsPerSecond, int seconds, Result& result,
+                         std::string& error) {
+    if (backend != "rtmidi" && backend != "alsa") {
+        error = "unknown backend '" + backend + "' (rtmidi or alsa)";
+        return false;
+    }
+    eventsPerSecond = std::max(1, eventsPerSecond);
+    uint64_t total = static_cast<uint64_t>(eventsPerSecond) * std::max(1, seconds);
+
+    // Generator: a plain output port anyone can subscribe to
+    snd_seq_t* generator;
+    int status = snd_seq_open(&generator, "default", SND_SEQ_OPEN_OUTPUT, 0);
+    if (status < 0) {
+        error = std::string("cannot open sequencer: ") + snd_strerror(status);
+        return false;
+    }
+    std::unique_ptr<snd_seq_t, int (*)(snd_seq_t*)> generatorGuard(generator, snd_seq_close);
+    snd_seq_set_client_name(generator, GENERATOR_NAME);
+    int port = snd_seq_create_simple_port(generator, "load", SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+                                          SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+    if (port < 0) {
+        error = std::string("cannot create generator port: ") + snd_strerror(port);
+        return false;
+    }
+    std::string address = std::to_string(snd_seq_client_id(generator)) + ":" + std::to_string(port);
+
+    Probe probe(total);
+    std::unique_ptr<RtMidiIn> rtMidi;
+    std::unique_ptr<AlsaMidiInput> alsa;
+    try {
+        if (backend == "rtmidi") {
+            rtMidi.reset(new RtMidiIn(RtMidi::LINUX_ALSA, "MIDI Keyboard Monitor"));
+            unsigned int target = rtMidi->getPortCount();
+            for (unsigned int i = 0; i < rtMidi->getPortCount(); i++) {
+                if (rtMidi->getPortName(i).find(GENERATOR_NAME) != std::string::npos) target = i;
+            }
+            if (target == rtMidi->getPortCount()) {
+                error = "generator port not visible to RtMidi";
+                return false;
+            }
+            rtMidi->openPort(target);
+            rtMidi->setCallback(&rtMidiCallback, &probe);
+            rtMidi->ignoreTypes(false, false, false);
+        } else {
+            alsa.reset(new AlsaMidiInput());
+            if (!alsa->openSequencer(address, error)) return false;
+            if (!alsa->start([&probe](int64_t, const unsigned char* data, size_t size) {
+                    probe.deliver(data, size);
+                }, error)) {
+                return false;
+            }
+        }
+    } catch (RtMidiError& rtError) {
+        error = rtError.getMessage();
+        return false;
+    }
+
+    // Paced on absolute deadlines so slow sends do not lower the rate
+    double cpuStart = cpuMs();
+    int64_t startNs = monotonicNs();
+    int64_t intervalNs = 1000000000LL / eventsPerSecond;
+    snd_seq_event_t event;
+    for (uint64_t i = 0; i < total; i++) {
+        int64_t dueNs = startNs + static_cast<int64_t>(i) * intervalNs;
+        timespec due = {static_cast<time_t>(dueNs / 1000000000LL), static_cast<long>(dueNs % 1000000000LL)};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, nullptr);
+
+        int id = static_cast<int>(i % ID_COUNT);
+        snd_seq_ev_clear(&event);
+        snd_seq_ev_set_source(&event, port);
+        snd_seq_ev_set_subs(&event);
+        snd_seq_ev_set_direct(&event);
+        snd_seq_ev_set_noteon(&event, 0, id / 127, id % 127 + 1);
+        probe.sentNs[id].store(monotonicNs(), std::memory_order_release);
+        snd_seq_event_output_direct(generator, &event);
+    }
+
+    // Let the last deliveries arrive before tearing down
+    timespec settle = {0, 200000000};
+    nanosleep(&settle, nullptr);
+    result.cpuMs = cpuMs() - cpuStart;
+    if (alsa) {
+        alsa->stop();
+        result.wakeups = alsa->getStats().wakeups;
+    } else {
+        rtMidi->closePort();
+        result.wakeups = 0;
+    }
+
+    result.sent = total;
+    result.received = probe.received.load();
+    size_t measured = static_cast<size_t>(std::min<uint64_t>(result.received, probe.latencyNs.size()));
+    std::vector<int64_t> latencies(probe.latencyNs.begin(), probe.latencyNs.begin() + measured);
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double fraction) {
+        return latencies.empty() ? 0.0 : latencies[static_cast<size_t>(fraction * (latencies.size() - 1))] / 1000.0;
+    };
+    result.latencyMedianUs = percentile(0.5);
+    result.latencyP99Us = percentile(0.99);
+    result.latencyMaxUs = percentile(1.0);
+    result.cpuUsPerEvent = result.received > 0 ? result.cpuMs * 1000.0 / result.received : 0.0;
+    return true;
+}
\ No newline at end of file
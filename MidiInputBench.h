@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Compares the RtMidi input path with AlsaMidiInput. An in-process load
+// generator sends notes at a fixed rate through a virtual sequencer port to
+// the backend under test; each note carries an id so its delivery into our
+// code can be matched with its send time. Process CPU time covers the
+// generator too, which is the same for both backends.
+//
+// Built only with -DMIDI_MONITOR_ALSA=ON.
+class MidiInputBench {
+public:
+    struct Result {
+        uint64_t sent;
+        uint64_t received;
+        double latencyMedianUs;
+        double latencyP99Us;
+        double latencyMaxUs;
+        double cpuMs;              // user + system over the run
+        double cpuUsPerEvent;
+        uint64_t wakeups;          // ingest thread wakeups (ALSA backend only)
+    };
+
+    // backend is "rtmidi" or "alsa"
+    static bool run(const std::string& backend, int eventsPerSecond, int seconds, Result& result,
+                    std::string& error);
+};
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include "MidiKeyboardMonitor.h"
+#include <algorithm>
 #include <iostream>
 
 MidiKeyboardMonitor::MidiKeyboardMonitor(QWidget *parent)
     : QMainWindow(parent)
+    , auditionStatsTimer(nullptr)
     , currentKeySignatureIndex(0)
 {
     initializeComponents();
@@ -27,6 +29,14 @@ MidiKeyboardMonitor::~MidiKeyboardMonitor() {
         midiManager->stopDeviceMonitoring();
     }
     
+    // Then the audio thread, which still reads the synth
+    if (auditionOutput) {
+        auditionOutput->stop();
+        reportAuditionStats();
+    }
+    auditionOutput.reset();
+    auditionSynth.reset();
+    
     // Components will be cleaned up automatically due to smart pointers
     // but we explicitly reset them to control the order
     midiManager.reset();
@@ -52,8 +62,16 @@ void MidiKeyboardMonitor::connectSignals() {
             this, &MidiKeyboardMonitor::onDeviceDisconnected);
     connect(midiManager.get(), &MidiManager::noteEvent,
             this, &MidiKeyboardMonitor::onNoteEvent);
+    connect(midiManager.get(), &MidiManager::caughtUp,
+            this, &MidiKeyboardMonitor::onMidiCaughtUp);
+    connect(midiManager.get(), &MidiManager::transportChanged,
+            this, &MidiKeyboardMonitor::onTransportChanged);
     connect(midiManager.get(), &MidiManager::midiError,
             this, &MidiKeyboardMonitor::onMidiError);
+    connect(midiManager.get(), &MidiManager::networkPeerConnected,
+            this, &MidiKeyboardMonitor::onNetworkPeerConnected);
+    connect(midiManager.get(), &MidiManager::networkPeerDisconnected,
+            this, &MidiKeyboardMonitor::onNetworkPeerDisconnected);
     
     // Connect UI manager signals
     connect(uiManager.get(), &UIManager::keySignatureChanged,
@@ -73,9 +91,98 @@ void MidiKeyboardMonitor::onDeviceDisconnected() {
     std::cout << "Device disconnected" << std::endl;
 }
 
+bool MidiKeyboardMonitor::enableNetworkMidi(const NetworkMidiOptions& options) {
+    return midiManager->enableNetworkMidi(options);
+}
+
+#ifdef MIDI_MONITOR_ALSA
+bool MidiKeyboardMonitor::enableAlsaInput(const QString& source) {
+    return midiManager->enableAlsaInput(source);
+}
+#endif
+
+void MidiKeyboardMonitor::setStuckNoteTimeout(double seconds) {
+    midiManager->setStuckNoteTimeout(seconds);
+}
+
+void MidiKeyboardMonitor::addTransform(const std::string& devicePattern, const NoteTransform& transform) {
+    midiManager->addTransform(devicePattern, transform);
+}
+
+bool MidiKeyboardMonitor::enableAudition(const QString& wavPath, int sampleRate) {
+    auditionSynth = std::make_unique<AuditionSynth>(sampleRate);
+    auditionOutput = std::make_unique<AuditionWavOutput>(auditionSynth.get());
+
+    std::string error;
+    if (!auditionOutput->start(wavPath.toStdString(), error)) {
+        std::cerr << "Failed to start audition: " << error << std::endl;
+        auditionOutput.reset();
+        auditionSynth.reset();
+        return false;
+    }
+
+    auditionStatsTimer = new QTimer(this);
+    connect(auditionStatsTimer, &QTimer::timeout, this, &MidiKeyboardMonitor::reportAuditionStats);
+    auditionStatsTimer->start(10000);
+    std::cout << "Audition synth rendering to " << wavPath.toStdString() << std::endl;
+    return true;
+}
+
+void MidiKeyboardMonitor::reportAuditionStats() {
+    if (!auditionSynth) return;
+    AuditionSynth::Stats stats = auditionSynth->getStats();
+    std::cout << "Audition: " << stats.activeVoices << " voices (peak " << stats.peakVoices << "/"
+              << AuditionSynth::MAX_VOICES << ", " << stats.stolenVoices << " stolen), block "
+              << stats.averageBlockUs << " us avg / " << stats.peakBlockUs << " us peak, "
+              << stats.load * 100.0 << "% load, " << auditionOutput->getLateBlocks() << " late blocks, "
+              << stats.droppedEvents << " dropped events" << std::endl;
+    if (auditionOutput->hasWriteFailed()) {
+        std::cerr << "Audition output stopped: write to WAV file failed" << std::endl;
+    }
+}
+
+void MidiKeyboardMonitor::updateAuditionChord(const std::set<int>& activeNotes, int rootNote) {
+    if (!auditionSynth) return;
+
+    // Pitch classes with the root first; only changes are sent to the synth
+    std::vector<int> chord;
+    if (rootNote >= 0) {
+        chord.push_back(rootNote % 12);
+        for (int note : activeNotes) {
+            if (std::find(chord.begin(), chord.end(), note % 12) == chord.end()) {
+                chord.push_back(note % 12);
+            }
+        }
+    }
+    if (chord == auditionChord) return;
+    auditionChord = chord;
+
+    auditionSynth->setChord(chord, chord.empty() ? 0 : chord.front());
+}
+
+void MidiKeyboardMonitor::onNetworkPeerConnected(const QString& peerName) {
+    uiManager->addMidiLogEntry("Network Connected: " + peerName);
+}
+
+void MidiKeyboardMonitor::onNetworkPeerDisconnected(const QString& peerName) {
+    uiManager->addMidiLogEntry("Network Disconnected: " + peerName);
+}
+
 void MidiKeyboardMonitor::onNoteEvent(const MusicTypes::MidiEvent& event) {
     const MusicTypes::KeySignature& currentKey = theoryEngine->getKeySignature(currentKeySignatureIndex);
     
+    if (auditionSynth) {
+        if (event.type == MusicTypes::MidiEventType::NoteOn) {
+            auditionSynth->noteOn(event.noteNumber, event.velocity);
+        } else if (event.type == MusicTypes::MidiEventType::NoteOff) {
+            auditionSynth->noteOff(event.noteNumber);
+        }
+    }
+    
+    // Behind on input: the synth follows every note, the log and chord
+    // display catch up once the backlog is gone
+    if (midiManager->isCatchingUp()) return;
+    
     // Add to MIDI log
     QString logEntry = formatMidiLogEntry(event, currentKey);
     uiManager->addMidiLogEntry(logEntry);
@@ -84,6 +191,16 @@ void MidiKeyboardMonitor::onNoteEvent(const MusicTypes::MidiEvent& event) {
     updateDisplays();
 }
 
+void MidiKeyboardMonitor::onMidiCaughtUp(int shedEvents) {
+    uiManager->addMidiLogEntry(QString("Caught up on MIDI input (%1 notes not logged)").arg(shedEvents));
+    updateDisplays();
+}
+
+void MidiKeyboardMonitor::onTransportChanged(bool running, double bpm) {
+    QString tempo = bpm > 0.0 ? QString(" at %1 BPM").arg(bpm, 0, 'f', 1) : QString();
+    uiManager->addMidiLogEntry(QString("Transport: ") + (running ? "playing" : "stopped") + tempo);
+}
+
 void MidiKeyboardMonitor::onMidiError(const QString& error) {
     uiManager->addMidiLogEntry("MIDI Error: " + error);
     std::cerr << "MIDI Error: " << error.toStdString() << std::endl;
@@ -103,6 +220,7 @@ void MidiKeyboardMonitor::updateDisplays() {
     const MusicTypes::KeySignature& currentKey = theoryEngine->getKeySignature(currentKeySignatureIndex);
     
     if (activeNotes.empty()) {
+        updateAuditionChord(activeNotes, -1);
         // Only start clear timer when there are no active notes
         uiManager->startClearTimer();
         return;
@@ -141,14 +259,24 @@ void MidiKeyboardMonitor::updateDisplays() {
         }
         
         uiManager->updateRomanNumeralDisplay(romanDisplay, analysis.isNonDiatonic);
+        updateAuditionChord(activeNotes, analysis.rootNote);
     } else {
         // Clear Roman numeral for intervals
         uiManager->updateRomanNumeralDisplay("", false);
+        updateAuditionChord(activeNotes, -1);
     }
 }
 
 QString MidiKeyboardMonitor::formatMidiLogEntry(const MusicTypes::MidiEvent& event, const MusicTypes::KeySignature& key) const {
     QString noteName = theoryEngine->midiNoteToNoteNameInKey(event.noteNumber, key);
     QString eventType = (event.type == MusicTypes::MidiEventType::NoteOn) ? "ON" : "OFF";
-    return noteName + " " + eventType + " vel: " + QString::number(event.velocity);
+    QString entry = noteName + " " + eventType + " vel: " + QString::number(event.velocity);
+    if (event.beats >= 0.0) {
+        // Bar:beat against the external clock, assuming 4/4
+        int bar = 0;
+        int beat = 0;
+        TransportTracker::toBarBeat(event.beats, 4, bar, beat);
+        entry += QString(" @ %1:%2").arg(bar).arg(beat);
+    }
+    return entry;
 }
\ No newline at end of file
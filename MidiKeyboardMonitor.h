@@ -6,6 +6,9 @@
 #include "MidiManager.h"
 #include "ChordAnalyzer.h"
 #include "UIManager.h"
+#include "AuditionSynth.h"
+#include "AuditionWavOutput.h"
+#include <QTimer>
 #include <memory>
 
 class MidiKeyboardMonitor : public QMainWindow
@@ -16,22 +19,49 @@ public:
     MidiKeyboardMonitor(QWidget *parent = nullptr);
     ~MidiKeyboardMonitor();
 
+    // Optional RTP-MIDI input next to the local device
+    bool enableNetworkMidi(const NetworkMidiOptions& options);
+#ifdef MIDI_MONITOR_ALSA
+    // Direct ALSA input in place of RtMidi
+    bool enableAlsaInput(const QString& source);
+#endif
+
+    // Held notes with no activity from their port are released after this long (0 = never)
+    void setStuckNoteTimeout(double seconds);
+    // Per-device velocity curve / split / transposition (see NoteTransform)
+    void addTransform(const std::string& devicePattern, const NoteTransform& transform);
+
+    // Plays notes and the analysed chord through the built-in synth into a WAV file
+    bool enableAudition(const QString& wavPath, int sampleRate);
+
 private slots:
     // MIDI event handlers
     void onDeviceConnected(const QString& deviceName);
     void onDeviceDisconnected();
     void onNoteEvent(const MusicTypes::MidiEvent& event);
+    void onMidiCaughtUp(int shedEvents);
+    void onTransportChanged(bool running, double bpm);
     void onMidiError(const QString& error);
+    void onNetworkPeerConnected(const QString& peerName);
+    void onNetworkPeerDisconnected(const QString& peerName);
     
     // UI event handlers
     void onKeySignatureChanged(int index);
 
+    void reportAuditionStats();
+
 private:
     // Core components
     std::unique_ptr<MidiManager> midiManager;
     std::unique_ptr<ChordAnalyzer> chordAnalyzer;
     std::unique_ptr<UIManager> uiManager;
     MusicTheoryEngine* theoryEngine; // Singleton reference
+
+    // Audition (optional); the output thread must stop before the synth goes
+    std::unique_ptr<AuditionSynth> auditionSynth;
+    std::unique_ptr<AuditionWavOutput> auditionOutput;
+    QTimer* auditionStatsTimer;
+    std::vector<int> auditionChord; // last chord sent, root first
     
     // Current state
     int currentKeySignatureIndex;
@@ -40,5 +70,6 @@ private:
     void initializeComponents();
     void connectSignals();
     void updateDisplays();
+    void updateAuditionChord(const std::set<int>& activeNotes, int rootNote);
     QString formatMidiLogEntry(const MusicTypes::MidiEvent& event, const MusicTypes::KeySignature& key) const;
 };
\ No newline at end of file
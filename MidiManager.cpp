@@ -1,23 +1,122 @@
 #include "MidiManager.h"
 #include <iostream>
+#include <QHostInfo>
 #include <QMutexLocker>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef MIDI_MONITOR_ALSA
+#include "AlsaMidiInput.h"
+#include "AlsaPortWatcher.h"
+#endif
+
+namespace {
+
+const size_t INPUT_RING_CAPACITY = 8192;
+const int IDENTITY_TIMEOUT_MS = 500;
+
+// A drain stops after this long and lets the event loop run before going on
+const int64_t DRAIN_BUDGET_NS = 4000000;
+const size_t DRAIN_SLICE = 64;
+// More than this waiting at the start of a drain sheds per-note display work
+const uint64_t SHED_BACKLOG = 256;
+
+// Drain timer interval while active, and how long input must be quiet
+// before it stops
+const int PROCESS_INTERVAL_MS = 10;
+const int64_t IDLE_AFTER_NS = 1000000000;
+
+// External tempo changes smaller than this are not reported
+const double TEMPO_REPORT_BPM = 0.5;
+
+int64_t monotonicNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Ports the monitor has always picked first when several are present
+bool isPreferredPort(const std::string& portName) {
+    return portName.find("Recital Play") != std::string::npos ||
+           portName.find("Keyboard") != std::string::npos ||
+           portName.find("Piano") != std::string::npos;
+}
+
+// Note on/off of the 7-bit model the display and analysis still use
+MusicTypes::MidiEvent toMidiEvent(const UmpEvent& ump) {
+    MusicTypes::MidiEvent event;
+    event.type = MusicTypes::MidiEventType::Unknown;
+    event.noteNumber = ump.note;
+    event.velocity = static_cast<int>(UmpParser::scaleDown(ump.velocity, 16, 7));
+    event.channel = ump.channel;
+    event.timeNs = 0;
+    event.beats = -1.0;
+    
+    if (ump.type == UmpEvent::Type::NoteOn) {
+        // MIDI 2.0 allows a note on below 7-bit velocity 1; it still sounds
+        event.type = MusicTypes::MidiEventType::NoteOn;
+        if (event.velocity == 0) event.velocity = 1;
+    } else if (ump.type == UmpEvent::Type::NoteOff) {
+        event.type = MusicTypes::MidiEventType::NoteOff;
+    }
+    return event;
+}
+
+} // namespace
 
 MidiManager::MidiManager(QObject* parent)
     : QObject(parent)
     , midiIn(nullptr)
     , midiConnected(false)
+    , identityCandidate(0)
+    , identityTimer(new QTimer(this))
+    , deviceIdentified(false)
+    , networkSession(nullptr)
+#ifdef MIDI_MONITOR_ALSA
+    , lastAlsaTimeNs(0)
+#endif
     , isDestroying(false)
+    , rtMidiDetached(false)
+    , noteWatchdog(NoteWatchdog::defaultOptions())
+    , inputRing(INPUT_RING_CAPACITY)
+    , analysisConsumer(-1)
+    , networkConsumer(-1)
+    , forwardClock(false)
+    , catchingUp(false)
+    , drainContinuationPending(false)
+    , shedSinceCatchUp(0)
+    , idle(false)
+    , wakePending(false)
+    , lastInputNs(0)
+    , stateSinceNs(monotonicNs())
+    , filteredMessages(0)
     , deviceCheckTimer(new QTimer(this))
     , midiProcessTimer(new QTimer(this))
 {
+    std::memset(&drainStats, 0, sizeof(drainStats));
+    std::memset(&wakeupStats, 0, sizeof(wakeupStats));
+    reportedTransport = transport.getState();
+    analysisConsumer = inputRing.addConsumer("analysis", MidiBroadcastRing::LagPolicy::Stall);
     setupMidi();
     
-    connect(deviceCheckTimer, &QTimer::timeout, this, &MidiManager::checkForMidiDevices);
-    connect(midiProcessTimer, &QTimer::timeout, this, &MidiManager::processPendingMidiMessages);
+    // Every timer expiry is a wakeup of the process, counted against the current state
+    connect(deviceCheckTimer, &QTimer::timeout, this, [this]() {
+        countWakeup();
+        checkForMidiDevices();
+    });
+    connect(midiProcessTimer, &QTimer::timeout, this, [this]() {
+        countWakeup();
+        processPendingMidiMessages();
+    });
+    connect(identityTimer, &QTimer::timeout, this, [this]() {
+        countWakeup();
+        onIdentityTimeout();
+    });
+    identityTimer->setSingleShot(true);
     
-    midiProcessTimer->start(10); // Process MIDI messages every 10ms
+    midiProcessTimer->start(PROCESS_INTERVAL_MS); // until the first drain finds nothing to do
 }
 
 MidiManager::~MidiManager() {
@@ -33,13 +132,67 @@ MidiManager::~MidiManager() {
     if (midiProcessTimer) {
         midiProcessTimer->stop();
     }
+    identityTimer->stop();
+    
+    // End network sessions before the ring goes away
+    if (networkSession) {
+        networkSession->endSession();
+    }
+    
+#ifdef MIDI_MONITOR_ALSA
+    if (alsaInput) {
+        alsaInput->stop();
+        AlsaMidiInput::Stats stats = alsaInput->getStats();
+        std::cout << "ALSA input: " << stats.messages << " messages, " << stats.wakeups << " wakeups, "
+                  << stats.overruns << " overruns, " << stats.oversized << " oversized" << std::endl;
+    }
+#endif
     
     // Disconnect MIDI
     disconnectMidi();
     
-    // Clear any pending messages
-    QMutexLocker locker(&midiQueueMutex);
-    midiMessageQueue.clear();
+    for (int consumer : {analysisConsumer, networkConsumer}) {
+        if (consumer < 0) continue;
+        MidiBroadcastRing::ConsumerStats stats = inputRing.getConsumerStats(consumer);
+        std::cout << "Input ring consumer " << stats.name << ": " << stats.read << " read, peak lag "
+                  << stats.peakLag << ", " << stats.lost << " lost, " << stats.stalls << " stalls" << std::endl;
+    }
+    std::cout << "Input drain: " << drainStats.drains << " drains, " << drainStats.yields << " yields, peak backlog "
+              << drainStats.peakBacklog << ", " << drainStats.shedEvents << " note events shed in "
+              << drainStats.catchUps << " catch-ups" << std::endl;
+    TransportTracker::State transportState = transport.getState();
+    if (transportState.ticks > 0) {
+        std::cout << "External clock: " << transportState.ticks << " ticks, last tempo " << transportState.bpm
+                  << " BPM" << std::endl;
+    }
+    if (filteredMessages > 0) {
+        std::cout << "Transforms filtered " << filteredMessages << " messages" << std::endl;
+    }
+    WakeupStats wakeups = getWakeupStats();
+    std::cout << "Wakeups: " << (wakeups.idleSeconds > 0 ? wakeups.idleWakeups / wakeups.idleSeconds : 0.0)
+              << "/s idle over " << wakeups.idleSeconds << "s, "
+              << (wakeups.activeSeconds > 0 ? wakeups.activeWakeups / wakeups.activeSeconds : 0.0)
+              << "/s active over " << wakeups.activeSeconds << "s" << std::endl;
+#ifdef MIDI_MONITOR_ALSA
+    if (portWatcher) {
+        std::cout << "Port announcements: " << portWatcher->getAnnouncements() << std::endl;
+    }
+#endif
+    NoteWatchdog::Counters watchdog = noteWatchdog.getCounters();
+    std::cout << "Stuck notes cleared: " << watchdog.clearedBySensing << " after " << watchdog.sensingTimeouts
+              << " active sensing timeouts, " << watchdog.clearedByController << " by all notes off, "
+              << watchdog.clearedByReset << " by reset, " << watchdog.agedOut << " aged out" << std::endl;
+    for (const auto& entry : getClockStats()) {
+        std::cout << "Source " << entry.first << " clock: " << entry.second.events << " events, drift "
+                  << entry.second.driftPpm << "ppm, jitter rms " << entry.second.jitterRmsUs << "us max "
+                  << entry.second.jitterMaxUs << "us, " << entry.second.outliers << " outliers" << std::endl;
+    }
+    SysExAssembler::Stats sysExStats = sysExAssembler.getStats();
+    if (sysExStats.completed > 0 || sysExStats.oversized > 0 || sysExStats.poolExhausted > 0) {
+        std::cout << "SysEx: " << sysExStats.completed << " messages (" << sysExStats.bytes << " bytes), "
+                  << sysExStats.oversized << " oversized, " << sysExStats.poolExhausted << " without a buffer, "
+                  << sysExStats.unterminated << " unterminated" << std::endl;
+    }
     
     std::cout << "MidiManager destructor finished" << std::endl;
 }
@@ -61,6 +214,11 @@ const std::string& MidiManager::getConnectedDeviceName() const {
     return lastConnectedDevice;
 }
 
+bool MidiManager::getDeviceIdentity(DeviceIdentity& identity) const {
+    if (deviceIdentified) identity = deviceIdentity;
+    return deviceIdentified;
+}
+
 const std::set<int>& MidiManager::getActiveNotes() const {
     return activeNotes;
 }
@@ -69,17 +227,322 @@ void MidiManager::clearActiveNotes() {
     activeNotes.clear();
 }
 
+void MidiManager::setStuckNoteTimeout(double seconds) {
+    noteWatchdog.setHoldTimeout(static_cast<int64_t>(seconds * 1e9));
+}
+
+NoteWatchdog::Counters MidiManager::getWatchdogCounters() const {
+    return noteWatchdog.getCounters();
+}
+
+std::map<int, ClockEstimator::Stats> MidiManager::getClockStats() {
+    QMutexLocker locker(&producerMutex);
+    std::map<int, ClockEstimator::Stats> stats;
+    for (const auto& entry : clocks) {
+        stats[entry.first] = entry.second.getStats();
+    }
+    return stats;
+}
+
 void MidiManager::startDeviceMonitoring() {
-    deviceCheckTimer->start(1000); // Check for devices every second
+    bool announced = false;
+#ifdef MIDI_MONITOR_ALSA
+    // Port announcements wake us when a device comes or goes; poll only without them
+    if (!portWatcher) {
+        std::unique_ptr<AlsaPortWatcher> watcher(new AlsaPortWatcher());
+        std::string error;
+        if (watcher->start(error)) {
+            connect(watcher.get(), &AlsaPortWatcher::portsChanged, this, [this]() {
+                countWakeup();
+                checkForMidiDevices();
+            });
+            portWatcher = std::move(watcher);
+        } else {
+            std::cerr << "No port announcements, polling for devices: " << error << std::endl;
+        }
+    }
+    announced = portWatcher != nullptr;
+#endif
+    if (!announced) {
+        deviceCheckTimer->start(1000); // Check for devices every second
+    }
     checkForMidiDevices(); // Initial check
 }
 
 void MidiManager::stopDeviceMonitoring() {
     deviceCheckTimer->stop();
+#ifdef MIDI_MONITOR_ALSA
+    portWatcher.reset();
+#endif
+}
+
+bool MidiManager::enableNetworkMidi(const NetworkMidiOptions& options) {
+    if (!networkSession) {
+        networkSession = new RtpMidiSession(options.sessionName, this);
+        
+        connect(networkSession, &RtpMidiSession::midiReceived, this, &MidiManager::onNetworkMidiReceived);
+        connect(networkSession, &RtpMidiSession::peerConnected, this,
+                [this](int peerId, const QString& name) {
+                    selectTransform(peerId, name.toStdString());
+                    emit networkPeerConnected(name);
+                });
+        connect(networkSession, &RtpMidiSession::peerDisconnected, this,
+                [this](int peerId, const QString& name) {
+                    noteWatchdog.removeSource(peerId, releasedNotes);
+                    releaseStuckNotes();
+                    translators.erase(peerId);
+                    QMutexLocker locker(&producerMutex);
+                    clocks.erase(peerId);
+                    transforms.erase(peerId);
+                    transport.removeSource(peerId);
+                    sourceNames.erase(peerId);
+                    emit networkPeerDisconnected(name);
+                });
+        connect(networkSession, &RtpMidiSession::sessionError, this, &MidiManager::midiError);
+        networkConsumer = inputRing.addConsumer("network", MidiBroadcastRing::LagPolicy::Overwrite);
+        QMutexLocker locker(&producerMutex);
+        forwardClock = networkConsumer >= 0;
+    }
+    
+    networkSession->setJitterConfig(options.jitter);
+    
+    if (options.listenPort != 0 && !networkSession->listen(options.listenPort)) {
+        return false;
+    }
+    
+    if (!options.inviteTarget.isEmpty()) {
+        qsizetype separator = options.inviteTarget.lastIndexOf(':');
+        bool portOk = false;
+        quint16 port = separator > 0 ? static_cast<quint16>(options.inviteTarget.mid(separator + 1).toUInt(&portOk)) : 0;
+        if (!portOk || port == 0) {
+            emit midiError("Invalid RTP-MIDI invite target: " + options.inviteTarget);
+            return false;
+        }
+        
+        // Names as well as literals; the session sockets are IPv4 only
+        QString host = options.inviteTarget.left(separator);
+        QHostAddress address(host);
+        if (address.isNull()) {
+            QHostInfo info = QHostInfo::fromName(host);
+            for (const QHostAddress& candidate : info.addresses()) {
+                if (candidate.protocol() == QAbstractSocket::IPv4Protocol) {
+                    address = candidate;
+                    break;
+                }
+            }
+        }
+        if (address.isNull() || address.protocol() != QAbstractSocket::IPv4Protocol) {
+            emit midiError("Cannot resolve RTP-MIDI invite host: " + host);
+            return false;
+        }
+        networkSession->invite(address, port);
+    }
+    
+    if (options.testPatternIntervalMs > 0) {
+        networkSession->startTestPattern(options.testPatternIntervalMs);
+    }
+    
+    return true;
+}
+
+#ifdef MIDI_MONITOR_ALSA
+bool MidiManager::enableAlsaInput(const QString& source) {
+    if (alsaInput) {
+        alsaInput->stop();
+        alsaInput.reset();
+    }
+    
+    // Only one local input at a time
+    deviceCheckTimer->stop();
+    disconnectMidi();
+    
+    std::unique_ptr<AlsaMidiInput> input(new AlsaMidiInput());
+    std::string sourceName = source.toStdString();
+    std::string error;
+    bool opened = source.startsWith("hw:") ? input->openRawMidi(sourceName, error)
+                                           : input->openSequencer(sourceName, error);
+    
+    if (opened) selectTransform(MusicTypes::LocalMidiSource, input->getSourceName());
+    
+    // The ingest thread publishes straight into the ring; the delta from the
+    // previous message matches what RtMidi delivers as its time stamp
+    lastAlsaTimeNs = 0;
+    if (!opened || !input->start([this](int64_t timeNs, const unsigned char* data, size_t size) {
+            if (isDestroying.load()) return;
+            double deltaSeconds = lastAlsaTimeNs > 0 ? (timeNs - lastAlsaTimeNs) / 1e9 : 0.0;
+            lastAlsaTimeNs = timeNs;
+            QMutexLocker locker(&producerMutex);
+            ingest(MusicTypes::LocalMidiSource, deltaSeconds, data, size);
+            wakeForInput();
+        }, error)) {
+        std::cerr << "ALSA input failed: " << error << std::endl;
+        emit midiError(QString::fromStdString("ALSA input: " + error));
+        return false;
+    }
+    
+    alsaInput = std::move(input);
+    lastConnectedDevice = alsaInput->getSourceName();
+    midiConnected = true;
+    std::cout << "Reading ALSA input directly: " << lastConnectedDevice << std::endl;
+    emit deviceConnected(QString::fromStdString(lastConnectedDevice));
+    return true;
+}
+#endif
+
+void MidiManager::onNetworkMidiReceived(int peerId, double deltaSeconds, const std::vector<unsigned char>& data) {
+    // Network events join the same ring as the RtMidi callback
+    QMutexLocker locker(&producerMutex);
+    ingest(peerId, deltaSeconds, data.data(), data.size());
+    wakeForInput();
+}
+
+void MidiManager::ingest(int sourceId, double deltaSeconds, const unsigned char* data, size_t size) {
+    if (sysExAssembler.feed(sourceId, deltaSeconds, data, size)) {
+        // The dump's duration still counts towards the source clock
+        clocks[sourceId].advance(deltaSeconds);
+        return;
+    }
+    
+    // The delta comes from the driver's or the peer's clock (ALSA sequencer
+    // stamps may be queue time); the fit maps it onto ours
+    int64_t hostTimeNs = clocks[sourceId].update(deltaSeconds, monotonicNs());
+    
+    // 24 ppqn clock would be most of the traffic. The tracker takes it here;
+    // only peers synced to the local keyboard need the ticks themselves.
+    if (transport.onMessage(sourceId, hostTimeNs, data, size) &&
+        !(forwardClock && sourceId == MusicTypes::LocalMidiSource)) {
+        return;
+    }
+    
+    // Device transform before anything downstream sees the note
+    unsigned char transformed[3];
+    auto transform = transforms.find(sourceId);
+    if (transform != transforms.end() && size <= sizeof(transformed)) {
+        std::memcpy(transformed, data, size);
+        if (!transform->second.apply(transformed, size)) {
+            filteredMessages++;
+            return;
+        }
+        data = transformed;
+    }
+    inputRing.publish(deltaSeconds, hostTimeNs, transport.beatsAt(hostTimeNs), sourceId, data, size);
+}
+
+void MidiManager::addTransform(const std::string& devicePattern, const NoteTransform& transform) {
+    transformRules.push_back({devicePattern, transform});
+    
+    // Devices connected before the rule was added pick it up now
+    std::map<int, std::string> connected = sourceNames;
+    for (const auto& entry : connected) {
+        selectTransform(entry.first, entry.second);
+    }
+}
+
+void MidiManager::selectTransform(int sourceId, const std::string& deviceName) {
+    sourceNames[sourceId] = deviceName;
+    const NoteTransform* transform = NoteTransformRule::select(transformRules, deviceName);
+    bool identity = !transform || transform->isIdentity();
+    
+    // Notes held now went through the old table; their note-offs would go
+    // through the new one and miss them, so they are released first
+    bool replacing;
+    {
+        QMutexLocker locker(&producerMutex);
+        replacing = !identity || transforms.count(sourceId) > 0;
+    }
+    if (replacing) {
+        noteWatchdog.removeSource(sourceId, releasedNotes);
+        releaseStuckNotes();
+    }
+    
+    QMutexLocker locker(&producerMutex);
+    if (!identity) {
+        transforms[sourceId] = *transform;
+        std::cout << "Applying transform to " << deviceName << std::endl;
+    } else {
+        transforms.erase(sourceId);
+    }
+}
+
+MidiBroadcastRing& MidiManager::getInputRing() {
+    return inputRing;
+}
+
+bool MidiManager::isIdle() const {
+    return idle.load();
+}
+
+MidiManager::WakeupStats MidiManager::getWakeupStats() const {
+    WakeupStats stats = wakeupStats;
+    double current = (monotonicNs() - stateSinceNs) / 1e9;
+    if (idle.load()) {
+        stats.idleSeconds += current;
+    } else {
+        stats.activeSeconds += current;
+    }
+    return stats;
+}
+
+void MidiManager::countWakeup() {
+    if (idle.load()) {
+        wakeupStats.idleWakeups++;
+    } else {
+        wakeupStats.activeWakeups++;
+    }
+}
+
+void MidiManager::wakeForInput() {
+    // Producers only post while idle; otherwise the drain timer picks input
+    // up. The fence pairs with the one in enterIdle(), so either the drain
+    // sees this input or this sees the idle flag.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!idle.load() || wakePending.exchange(true)) return;
+    QMetaObject::invokeMethod(this, [this]() {
+        wakePending = false;
+        countWakeup();
+        processPendingMidiMessages();
+    }, Qt::QueuedConnection);
+}
+
+void MidiManager::enterIdle(int64_t nowNs) {
+    if (idle.load()) return;
+    midiProcessTimer->stop();
+    wakeupStats.activeSeconds += (nowNs - stateSinceNs) / 1e9;
+    stateSinceNs = nowNs;
+    idle.store(true);
+    
+    // Input that raced with going idle has not posted a wakeup
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (inputRing.getLag(analysisConsumer) > 0 || sysExAssembler.hasCompleted()) {
+        leaveIdle(nowNs);
+    }
+}
+
+void MidiManager::leaveIdle(int64_t nowNs) {
+    if (!idle.load()) return;
+    idle.store(false);
+    wakeupStats.idleSeconds += (nowNs - stateSinceNs) / 1e9;
+    stateSinceNs = nowNs;
+    midiProcessTimer->start(PROCESS_INTERVAL_MS);
+}
+
+TransportTracker::State MidiManager::getTransport() const {
+    return transport.getState();
+}
+
+bool MidiManager::isCatchingUp() const {
+    return catchingUp;
+}
+
+MidiManager::DrainStats MidiManager::getDrainStats() const {
+    return drainStats;
 }
 
 void MidiManager::checkForMidiDevices() {
-    if (!midiIn) return;
+    if (!midiIn || rtMidiDetached) return;
+#ifdef MIDI_MONITOR_ALSA
+    if (alsaInput) return;
+#endif
     
     try {
         unsigned int nPorts = midiIn->getPortCount();
@@ -120,57 +583,134 @@ void MidiManager::attemptMidiConnection() {
     if (!midiIn) return;
     
     try {
+        // Every port except Midi Through is a candidate; which one is the
+        // keyboard is settled by asking each for its identity
+        identityCandidates.clear();
         unsigned int nPorts = midiIn->getPortCount();
-        
-        if (nPorts == 0) {
-            midiConnected = false;
-            return;
-        }
-        
-        // Find the best MIDI device (prefer actual keyboards over Midi Through)
-        int targetPort = -1;
-        std::string bestDeviceName;
-        
         for (unsigned int i = 0; i < nPorts; i++) {
-            std::string portName = midiIn->getPortName(i);
-            
-            // Prefer specific devices we know about
-            if (portName.find("Recital Play") != std::string::npos ||
-                portName.find("Keyboard") != std::string::npos ||
-                portName.find("Piano") != std::string::npos) {
-                targetPort = i;
-                bestDeviceName = portName;
-                break;
-            }
-            
-            // Skip Midi Through ports
-            if (portName.find("Midi Through") == std::string::npos && targetPort == -1) {
-                targetPort = i;
-                bestDeviceName = portName;
+            if (midiIn->getPortName(i).find("Midi Through") == std::string::npos) {
+                identityCandidates.push_back(i);
             }
         }
         
-        if (targetPort == -1) {
+        if (identityCandidates.empty()) {
             midiConnected = false;
             return;
         }
-        
-        // Connect to the selected device
-        if (midiIn->isPortOpen()) {
-            midiIn->closePort();
+        // Known keyboard names are the only candidates when present: the
+        // first one is kept if none answers, and an answering interface or
+        // sound module never beats them
+        auto preferredEnd = std::stable_partition(
+            identityCandidates.begin(), identityCandidates.end(),
+            [this](unsigned int port) { return isPreferredPort(midiIn->getPortName(port)); });
+        if (preferredEnd != identityCandidates.begin()) {
+            identityCandidates.erase(preferredEnd, identityCandidates.end());
         }
         
-        midiIn->openPort(targetPort);
+        identityCandidate = 0;
+        deviceIdentified = false;
+        openCandidatePort();
+        
+    } catch (RtMidiError& error) {
+        std::cerr << "Error connecting to MIDI device: " << error.getMessage() << std::endl;
+        midiConnected = false;
+        emit midiError(QString::fromStdString(error.getMessage()));
+    }
+}
+
+void MidiManager::openCandidatePort() {
+    // Candidates without an output port cannot answer; skip straight past them
+    for (; identityCandidate < identityCandidates.size(); identityCandidate++) {
+        unsigned int port = identityCandidates[identityCandidate];
+        std::string portName = midiIn->getPortName(port);
+        
+        closeCandidatePort();
+        selectTransform(MusicTypes::LocalMidiSource, portName);
+        midiIn->openPort(port);
         midiIn->setCallback(&MidiManager::midiCallback, this);
         midiIn->ignoreTypes(false, false, false);
-        
         midiConnected = true;
-        lastConnectedDevice = bestDeviceName;
-        
-        emit deviceConnected(QString::fromStdString(bestDeviceName));
+        lastConnectedDevice = portName;
         
-        std::cout << "Successfully connected to: " << bestDeviceName << " (Port " << targetPort << ")" << std::endl;
+        if (sendIdentityRequest(portName)) {
+            std::cout << "Asking " << portName << " for its identity" << std::endl;
+            identityTimer->start(IDENTITY_TIMEOUT_MS);
+            return;
+        }
+    }
+    
+    // Nobody answers identity requests: keep the first candidate, which is
+    // the port the name preference has always chosen
+    unsigned int port = identityCandidates.front();
+    closeCandidatePort();
+    selectTransform(MusicTypes::LocalMidiSource, midiIn->getPortName(port));
+    midiIn->openPort(port);
+    midiIn->setCallback(&MidiManager::midiCallback, this);
+    midiIn->ignoreTypes(false, false, false);
+    midiConnected = true;
+    lastConnectedDevice = midiIn->getPortName(port);
+    
+    emit deviceConnected(QString::fromStdString(lastConnectedDevice));
+    std::cout << "Successfully connected to: " << lastConnectedDevice << " (Port " << port << ", not identified)"
+              << std::endl;
+}
+
+void MidiManager::closeCandidatePort() {
+    if (!midiIn->isPortOpen()) return;
+    midiIn->cancelCallback();
+    midiIn->closePort();
+    
+    // Everything the previous candidate sent is handled before the next one
+    // opens, with the identity timer stopped so a late reply is not credited
+    // to the next port; then its per-source state goes
+    identityTimer->stop();
+    processPendingMidiMessages();
+    resetLocalSource();
+    releaseStuckNotes();
+}
+
+// Every port opens as LocalMidiSource: clock fit, UMP bank/RPN state,
+// transport and held notes belong to one device
+void MidiManager::resetLocalSource() {
+    noteWatchdog.removeSource(MusicTypes::LocalMidiSource, releasedNotes);
+    translators.erase(MusicTypes::LocalMidiSource);
+    QMutexLocker locker(&producerMutex);
+    clocks.erase(MusicTypes::LocalMidiSource);
+    transforms.erase(MusicTypes::LocalMidiSource);
+    transport.removeSource(MusicTypes::LocalMidiSource);
+    sourceNames.erase(MusicTypes::LocalMidiSource);
+}
+
+bool MidiManager::sendIdentityRequest(const std::string& portName) {
+    try {
+        if (!midiOut) {
+            midiOut = std::make_unique<RtMidiOut>();
+        }
+        if (midiOut->isPortOpen()) {
+            midiOut->closePort();
+        }
         
+        // Input and output of one device share the port name
+        for (unsigned int i = 0; i < midiOut->getPortCount(); i++) {
+            if (midiOut->getPortName(i) == portName) {
+                midiOut->openPort(i);
+                std::vector<unsigned char> request = DeviceIdentity::request();
+                midiOut->sendMessage(&request);
+                return true;
+            }
+        }
+    } catch (RtMidiError& error) {
+        std::cerr << "Cannot send identity request to " << portName << ": " << error.getMessage() << std::endl;
+    }
+    return false;
+}
+
+void MidiManager::onIdentityTimeout() {
+    if (!midiIn || !midiConnected) return;
+    
+    try {
+        identityCandidate++;
+        openCandidatePort();
     } catch (RtMidiError& error) {
         std::cerr << "Error connecting to MIDI device: " << error.getMessage() << std::endl;
         midiConnected = false;
@@ -178,12 +718,33 @@ void MidiManager::attemptMidiConnection() {
     }
 }
 
+void MidiManager::handleSysEx(const SysExAssembler::Message& message) {
+    noteWatchdog.onMessage(message.sourceId(), monotonicNs(), message.data(), message.size(), releasedNotes);
+    
+    // Identity replies settle which local port is the keyboard
+    DeviceIdentity identity;
+    if (message.sourceId() == MusicTypes::LocalMidiSource && identityTimer->isActive() &&
+        DeviceIdentity::parseReply(message.data(), message.size(), identity)) {
+        identityTimer->stop();
+        deviceIdentity = identity;
+        deviceIdentified = true;
+        
+        std::string portName = lastConnectedDevice;
+        lastConnectedDevice = identity.describe();
+        emit deviceConnected(QString::fromStdString(lastConnectedDevice));
+        std::cout << "Successfully connected to: " << lastConnectedDevice << " on " << portName << std::endl;
+    }
+    
+    emit sysExReceived(message);
+}
+
+
 void MidiManager::disconnectMidi() {
     try {
         std::cout << "Disconnecting MIDI..." << std::endl;
         
-        // Set the destroying flag to prevent new callbacks
-        isDestroying = true;
+        // Stop RtMidi callbacks and reconnects; teardown is isDestroying's job
+        rtMidiDetached = true;
         
         if (midiIn && midiIn->isPortOpen()) {
             std::cout << "Closing MIDI port..." << std::endl;
@@ -194,8 +755,17 @@ void MidiManager::disconnectMidi() {
             std::cout << "MIDI port closed" << std::endl;
         }
         
+        identityTimer->stop();
+        if (midiOut && midiOut->isPortOpen()) {
+            midiOut->closePort();
+        }
+        deviceIdentified = false;
+        
         midiConnected = false;
         activeNotes.clear();
+        // The next device starts its own clock
+        resetLocalSource();
+        releasedNotes.clear();
         
         // Wait a brief moment to ensure no callbacks are still running
         std::this_thread::sleep_for(std::chrono::milliseconds(50));
@@ -223,39 +793,142 @@ void MidiManager::disconnectMidi() {
 }
 
 void MidiManager::processPendingMidiMessages() {
-    if (!midiConnected) return;
+    // Anything left over from a device that has gone is still drained, so
+    // with nothing connected the first drain finds nothing and goes idle
+    int64_t nowNs = monotonicNs();
+    leaveIdle(nowNs);
+    
+    // Forward the local keyboard to network participants
+    if (networkSession && networkConsumer >= 0) {
+        inputRing.consume(networkConsumer, [this](const MidiBroadcastRing::Entry& entry) {
+            if (entry.sourceId == MusicTypes::LocalMidiSource && entry.size > 0) {
+                networkSession->sendMidi(entry.data, entry.size);
+            }
+        });
+    }
     
-    std::vector<MusicTypes::MidiMessage> messages;
+    int64_t deadlineNs = nowNs + DRAIN_BUDGET_NS;
+    SysExAssembler::Message sysEx;
+    while (sysExAssembler.take(sysEx)) {
+        handleSysEx(sysEx);
+        lastInputNs = nowNs;
+    }
     
-    {
-        QMutexLocker locker(&midiQueueMutex);
-        messages = midiMessageQueue;
-        midiMessageQueue.clear();
+    uint64_t backlog = inputRing.getLag(analysisConsumer);
+    drainStats.drains++;
+    if (backlog > drainStats.peakBacklog) drainStats.peakBacklog = backlog;
+    if (!catchingUp && backlog > SHED_BACKLOG) {
+        catchingUp = true;
+        shedSinceCatchUp = 0;
+        drainStats.catchUps++;
     }
     
-    for (const auto& msg : messages) {
-        if (msg.data.empty()) continue;
+    auto visit = [this, nowNs](const MidiBroadcastRing::Entry& entry) {
+        // Clock ticks are in the ring for network peers; the tracker has already seen them
+        if (entry.size == 0 || entry.data[0] == 0xF8) return;
         
-        MusicTypes::MidiEvent event = parseMidiMessage(msg.data);
+        // Notes cut by all notes off or reset go out before anything after them
+        noteWatchdog.onMessage(entry.sourceId, nowNs, entry.data, entry.size, releasedNotes);
+        releaseStuckNotes();
         
-        if (event.type == MusicTypes::MidiEventType::NoteOn) {
-            activeNotes.insert(event.noteNumber);
-            emit noteEvent(event);
-        } else if (event.type == MusicTypes::MidiEventType::NoteOff) {
-            activeNotes.erase(event.noteNumber);
+        // Up-convert per source so bank and RPN/NRPN state never mix
+        UmpTranslator& translator = translators.try_emplace(entry.sourceId).first->second;
+        UmpPacket packets[UmpTranslator::MAX_PACKETS];
+        size_t count = translator.translate(entry.data, entry.size, packets);
+        
+        for (size_t i = 0; i < count; i++) {
+            UmpEvent ump = UmpParser::decode(packets[i]);
+            emit umpEvent(entry.sourceId, ump);
+            
+            MusicTypes::MidiEvent event = toMidiEvent(ump);
+            event.timeNs = entry.hostTimeNs;
+            event.beats = entry.beats;
+            if (event.type == MusicTypes::MidiEventType::NoteOn) {
+                activeNotes.insert(event.noteNumber);
+            } else if (event.type == MusicTypes::MidiEventType::NoteOff) {
+                activeNotes.erase(event.noteNumber);
+            } else {
+                continue;
+            }
+            // Still delivered while catching up (note state must stay exact);
+            // receivers check isCatchingUp() and skip the per-note display
+            if (catchingUp) shedSinceCatchUp++;
             emit noteEvent(event);
         }
+    };
+    
+    // Slices keep the clock checks cheap; the budget bounds how long the UI waits
+    size_t visited;
+    do {
+        visited = inputRing.consume(analysisConsumer, visit, DRAIN_SLICE);
+        if (visited > 0) lastInputNs = nowNs;
+    } while (visited == DRAIN_SLICE && monotonicNs() < deadlineNs);
+    
+    noteWatchdog.advance(nowNs, releasedNotes);
+    releaseStuckNotes();
+    
+    // Clock ticks bypass the note drain; a running clock still counts as input
+    TransportTracker::State transportState = transport.getState();
+    if (transportState.ticks != reportedTransport.ticks) lastInputNs = nowNs;
+    if (transportState.running != reportedTransport.running ||
+        std::fabs(transportState.bpm - reportedTransport.bpm) >= TEMPO_REPORT_BPM) {
+        emit transportChanged(transportState.running, transportState.bpm);
+        reportedTransport = transportState;
+    } else {
+        reportedTransport.ticks = transportState.ticks;
+    }
+    
+    if (visited == DRAIN_SLICE && inputRing.getLag(analysisConsumer) > 0) {
+        // Out of time: paint and handle input, then carry on without waiting a tick
+        drainStats.yields++;
+        if (!drainContinuationPending) {
+            drainContinuationPending = true;
+            QTimer::singleShot(0, this, [this]() {
+                drainContinuationPending = false;
+                countWakeup();
+                processPendingMidiMessages();
+            });
+        }
+        return;
+    }
+    
+    if (catchingUp) {
+        catchingUp = false;
+        drainStats.shedEvents += shedSinceCatchUp;
+        emit caughtUp(shedSinceCatchUp);
+    }
+    
+    // Quiet for a while and no watchdog timers due: stop ticking
+    if (nowNs - lastInputNs >= IDLE_AFTER_NS && noteWatchdog.isIdle()) {
+        enterIdle(nowNs);
+    }
+}
+
+void MidiManager::releaseStuckNotes() {
+    for (const NoteWatchdog::ReleasedNote& released : releasedNotes) {
+        MusicTypes::MidiEvent event;
+        event.type = MusicTypes::MidiEventType::NoteOff;
+        event.noteNumber = released.note;
+        event.velocity = 0;
+        event.channel = released.channel;
+        event.timeNs = monotonicNs();
+        event.beats = -1.0;
+        activeNotes.erase(released.note);
+        emit noteEvent(event);
     }
+    releasedNotes.clear();
 }
 
-MusicTypes::MidiEvent MidiManager::parseMidiMessage(const std::vector<unsigned char>& data) const {
+MusicTypes::MidiEvent MidiManager::parseMidiMessage(const unsigned char* data, size_t size) {
     MusicTypes::MidiEvent event;
     event.type = MusicTypes::MidiEventType::Unknown;
     event.noteNumber = 0;
     event.velocity = 0;
     event.channel = 0;
+    event.timeNs = 0;
+    event.beats = -1.0;
     
-    if (data.size() >= 3) {
+    if (size >= 3) {
         unsigned char status = data[0];
         unsigned char noteNumber = data[1];
         unsigned char velocity = data[2];
@@ -281,15 +954,16 @@ void MidiManager::midiCallback(double timeStamp, std::vector<unsigned char>* mes
     MidiManager* manager = static_cast<MidiManager*>(userData);
     
     // Safety check: don't process if manager is being destroyed
-    if (!manager || manager->isDestroying.load()) {
+    if (!manager || manager->isDestroying.load() || manager->rtMidiDetached.load()) {
         return;
     }
     
     try {
-        QMutexLocker locker(&manager->midiQueueMutex);
-        if (!manager->isDestroying.load()) {
-            manager->midiMessageQueue.push_back({timeStamp, *message});
+        QMutexLocker locker(&manager->producerMutex);
+        if (!manager->isDestroying.load() && !manager->rtMidiDetached.load()) {
+            manager->ingest(MusicTypes::LocalMidiSource, timeStamp, message->data(), message->size());
         }
+        manager->wakeForInput();
     } catch (...) {
         // Ignore any exceptions during destruction
     }
@@ -1,16 +1,40 @@
 #pragma once
 
+#include "ClockEstimator.h"
+#include "DeviceIdentity.h"
+#include "MidiBroadcastRing.h"
 #include "MusicTypes.h"
+#include "NoteTransform.h"
+#include "NoteWatchdog.h"
+#include "RtpMidiSession.h"
+#include "SysExAssembler.h"
+#include "TransportTracker.h"
+#include "UmpPacket.h"
 #include <QObject>
 #include <QTimer>
 #include <QMutex>
 #include <RtMidi.h>
 #include <memory>
+#include <map>
 #include <set>
 #include <vector>
 #include <string>
 #include <atomic>
 
+#ifdef MIDI_MONITOR_ALSA
+class AlsaMidiInput;
+class AlsaPortWatcher;
+#endif
+
+// Network (RTP-MIDI) input configuration
+struct NetworkMidiOptions {
+    QString sessionName;
+    quint16 listenPort;           // 0 = do not accept invitations
+    QString inviteTarget;         // "host:port", empty = do not invite
+    RtpMidiSession::JitterConfig jitter;
+    int testPatternIntervalMs;    // 0 = off
+};
+
 class MidiManager : public QObject {
     Q_OBJECT
 
@@ -21,38 +45,166 @@ public:
     // Connection management
     bool isConnected() const;
     const std::string& getConnectedDeviceName() const;
+    // False until the connected device answers an identity request
+    bool getDeviceIdentity(DeviceIdentity& identity) const;
     void startDeviceMonitoring();
     void stopDeviceMonitoring();
+    bool enableNetworkMidi(const NetworkMidiOptions& options);
+#ifdef MIDI_MONITOR_ALSA
+    // Reads a sequencer port ("24:0") or rawmidi device ("hw:1,0,0") directly
+    // instead of through RtMidi; device polling stops while it is open
+    bool enableAlsaInput(const QString& source);
+#endif
     
     // Note state
     const std::set<int>& getActiveNotes() const;
     void clearActiveNotes();
+    
+    // Stuck-note watchdog: held notes age out after this long without any
+    // message from their port (0 = never); sensing loss and all-notes-off
+    // always apply
+    void setStuckNoteTimeout(double seconds);
+    NoteWatchdog::Counters getWatchdogCounters() const;
+    // Drift and jitter of each source's clock against ours, by source id
+    std::map<int, ClockEstimator::Stats> getClockStats();
+    // Velocity curve, split, transposition etc. for devices whose port or
+    // peer name contains the pattern; the first matching rule applies. Add
+    // rules before playing: a connected device switches immediately.
+    void addTransform(const std::string& devicePattern, const NoteTransform& transform);
+
+    // Every ingested message, local and network; further consumers attach here
+    MidiBroadcastRing& getInputRing();
+
+    // Input is drained in time-boxed slices. While a backlog is being worked
+    // off, note state stays exact but per-note display and analysis should be
+    // skipped; caughtUp() says when to refresh once.
+    struct DrainStats {
+        uint64_t drains;
+        uint64_t yields;          // budget ran out with input left
+        uint64_t peakBacklog;
+        uint64_t catchUps;        // backlogs large enough to shed load
+        uint64_t shedEvents;      // note events delivered while catching up
+    };
+    bool isCatchingUp() const;
+    DrainStats getDrainStats() const;
+
+    // With no input for a while, no held notes and no port on sensing watch
+    // the drain timer stops and only incoming data (or, with ALSA, a port
+    // announcement) wakes the process
+    struct WakeupStats {
+        double idleSeconds;
+        double activeSeconds;
+        uint64_t idleWakeups;
+        uint64_t activeWakeups;
+    };
+    bool isIdle() const;
+    WakeupStats getWakeupStats() const;
+
+    // External MIDI clock and transport (Start/Stop/Continue, Song Position);
+    // note events carry the position in MidiEvent::beats
+    TransportTracker::State getTransport() const;
+
+    // Raw bytes to note event (shared with the headless analysis sessions)
+    static MusicTypes::MidiEvent parseMidiMessage(const unsigned char* data, size_t size);
 
 signals:
     void deviceConnected(const QString& deviceName);
     void deviceDisconnected();
     void noteEvent(const MusicTypes::MidiEvent& event);
+    // Every ingested message, up-converted to MIDI 2.0 at full resolution
+    void umpEvent(int sourceId, const UmpEvent& event);
+    // Complete SysEx from any source; keep a copy of the handle to hold on to the buffer
+    void sysExReceived(const SysExAssembler::Message& message);
     void midiError(const QString& error);
+    // A backlog has been drained; shedEvents note events went by without their own update
+    void caughtUp(int shedEvents);
+    // Transport started or stopped, or the external tempo moved noticeably
+    void transportChanged(bool running, double bpm);
+    void networkPeerConnected(const QString& peerName);
+    void networkPeerDisconnected(const QString& peerName);
 
 private slots:
     void checkForMidiDevices();
+    void onIdentityTimeout();
     void processPendingMidiMessages();
+    void onNetworkMidiReceived(int peerId, double deltaSeconds, const std::vector<unsigned char>& data);
 
 private:
     // MIDI components
     std::unique_ptr<RtMidiIn> midiIn;
+    std::unique_ptr<RtMidiOut> midiOut;   // identity requests
     bool midiConnected;
     std::string lastConnectedDevice;
     
+    // Device identification: candidate input ports are opened in turn and
+    // the first to answer an identity request is kept. When some port names
+    // match the name preference only those are candidates, so a silent
+    // keyboard is not passed over for a sound module that answers.
+    std::vector<unsigned int> identityCandidates;
+    size_t identityCandidate;
+    QTimer* identityTimer;
+    DeviceIdentity deviceIdentity;
+    bool deviceIdentified;
+    
+    // RTP-MIDI session (optional second input source)
+    RtpMidiSession* networkSession;
+    
+#ifdef MIDI_MONITOR_ALSA
+    // Direct ALSA input (optional replacement for midiIn)
+    std::unique_ptr<AlsaMidiInput> alsaInput;
+    int64_t lastAlsaTimeNs;
+    // Port announcements in place of polling for devices
+    std::unique_ptr<AlsaPortWatcher> portWatcher;
+#endif
+    
     // Safety flag for destruction
     std::atomic<bool> isDestroying;
+    // RtMidi input torn down by disconnectMidi(); no more callbacks or reconnects
+    std::atomic<bool> rtMidiDetached;
     
     // Active notes tracking
     std::set<int> activeNotes;
+    NoteWatchdog noteWatchdog;
+    std::vector<NoteWatchdog::ReleasedNote> releasedNotes;
+    
+    // Ingest ring: the RtMidi (or ALSA) callback and network input publish, and each
+    // consumer below reads at its own pace. The mutex only serialises the two
+    // producers; consumers never take it.
+    MidiBroadcastRing inputRing;
+    QMutex producerMutex;
+    int analysisConsumer;         // note state and signals; exact
+    int networkConsumer;          // local keyboard to RTP-MIDI peers; lossy, -1 = off
+    bool forwardClock;            // under producerMutex: local clock ticks go in the ring for peers
+    std::map<int, ClockEstimator> clocks;  // per source, under producerMutex
+    
+    // MIDI 1.0 to UMP conversion state (bank, RPN/NRPN) per source
+    std::map<int, UmpTranslator> translators;
+    
+    // SysEx bypasses the ring (its entries are too small) into pooled buffers
+    SysExAssembler sysExAssembler;
+    
+    // Budgeted draining of the analysis consumer
+    bool catchingUp;
+    bool drainContinuationPending;
+    int shedSinceCatchUp;
+    DrainStats drainStats;
+    
+    // Idle (tickless) mode; idle is also read by the producers
+    std::atomic<bool> idle;
+    std::atomic<bool> wakePending;
+    int64_t lastInputNs;
+    int64_t stateSinceNs;
+    WakeupStats wakeupStats;
+    
+    // Per-device transforms; the active ones are read by the producers under producerMutex
+    std::vector<NoteTransformRule> transformRules;
+    std::map<int, NoteTransform> transforms;
+    std::map<int, std::string> sourceNames;   // connected sources, for late rules
+    uint64_t filteredMessages;
     
-    // Thread-safe message queue
-    std::vector<MusicTypes::MidiMessage> midiMessageQueue;
-    QMutex midiQueueMutex;
+    // Clock ticks end here on the ingest thread; the drain only looks at the state
+    TransportTracker transport;
+    TransportTracker::State reportedTransport;
     
     // Timers
     QTimer* deviceCheckTimer;
@@ -62,7 +214,19 @@ private:
     void setupMidi();
     void attemptMidiConnection();
     void disconnectMidi();
-    MusicTypes::MidiEvent parseMidiMessage(const std::vector<unsigned char>& data) const;
+    void openCandidatePort();
+    void closeCandidatePort();
+    void resetLocalSource();
+    bool sendIdentityRequest(const std::string& portName);
+    void handleSysEx(const SysExAssembler::Message& message);
+    void releaseStuckNotes();
+    // Producers, under producerMutex: SysEx, clock fit, transform, ring
+    void ingest(int sourceId, double deltaSeconds, const unsigned char* data, size_t size);
+    void selectTransform(int sourceId, const std::string& deviceName);
+    void wakeForInput();
+    void countWakeup();
+    void enterIdle(int64_t nowNs);
+    void leaveIdle(int64_t nowNs);
     
     // Static callback for RtMidi
     static void midiCallback(double timeStamp, std::vector<unsigned char>* message, void* userData);
@@ -1,4 +1,5 @@
 #include "MusicTheoryEngine.h"
+#include <cmath>
 #include <set>
 
 MusicTheoryEngine& MusicTheoryEngine::instance() {
@@ -296,4 +297,51 @@ std::vector<int> MusicTheoryEngine::findAccidentalNotes(const std::vector<int>&
     }
     
     return accidentals;
+}
+
+int MusicTheoryEngine::estimateKey(const float* pitchClassProfile, float* outCorrelation) const {
+    // Krumhansl-Kessler key profiles, tonic first
+    static const float majorProfile[12] = {6.35f, 2.23f, 3.48f, 2.33f, 4.38f, 4.09f, 2.52f, 5.19f, 2.39f, 3.66f, 2.29f, 2.88f};
+    static const float minorProfile[12] = {6.33f, 2.68f, 3.52f, 5.38f, 2.60f, 3.53f, 2.54f, 4.75f, 3.98f, 2.69f, 3.34f, 3.17f};
+    
+    float profileMean = 0.0f;
+    for (int i = 0; i < 12; i++) {
+        profileMean += pitchClassProfile[i] / 12.0f;
+    }
+    
+    int bestIndex = 0;
+    float bestCorrelation = -2.0f;
+    
+    // Enharmonic duplicates score the same; the first (sharp-side) spelling wins
+    for (int index = 0; index < static_cast<int>(keySignatures.size()); index++) {
+        const MusicTypes::KeySignature& key = keySignatures[index];
+        const float* reference = key.isMajor ? majorProfile : minorProfile;
+        
+        float referenceMean = 0.0f;
+        for (int i = 0; i < 12; i++) {
+            referenceMean += reference[i] / 12.0f;
+        }
+        
+        float covariance = 0.0f;
+        float profileVariance = 0.0f;
+        float referenceVariance = 0.0f;
+        for (int pitchClass = 0; pitchClass < 12; pitchClass++) {
+            float x = pitchClassProfile[pitchClass] - profileMean;
+            float y = reference[(pitchClass - key.tonic + 12) % 12] - referenceMean;
+            covariance += x * y;
+            profileVariance += x * x;
+            referenceVariance += y * y;
+        }
+        
+        float correlation = profileVariance > 0.0f ? covariance / std::sqrt(profileVariance * referenceVariance) : 0.0f;
+        if (correlation > bestCorrelation) {
+            bestCorrelation = correlation;
+            bestIndex = index;
+        }
+    }
+    
+    if (outCorrelation) {
+        *outCorrelation = bestCorrelation;
+    }
+    return bestIndex;
 }
\ No newline at end of file
@@ -31,6 +31,9 @@ public:
     bool isChordDiatonic(int rootNoteClass, const std::string& chordQuality, const MusicTypes::KeySignature& key) const;
     std::vector<int> findAccidentalNotes(const std::vector<int>& notes, const MusicTypes::KeySignature& key) const;
 
+    // Key estimation from a 12-bin pitch-class profile (index = midiNote % 12, as everywhere else)
+    int estimateKey(const float* pitchClassProfile, float* outCorrelation = nullptr) const;
+
 private:
     MusicTheoryEngine();
     ~MusicTheoryEngine() = default;
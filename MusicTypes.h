@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QString>
+#include <cstdint>
 #include <vector>
 #include <string>
 
@@ -25,11 +26,16 @@ struct ChordAnalysis {
     std::vector<int> accidentalNotes; // MIDI note numbers of accidentals
     int bassNote;               // MIDI note number of bass (lowest note)
     int rootNote;               // MIDI note number of harmonic root
+    std::string chordQuality;   // chord pattern, e.g. "m7"; empty for clusters
 };
 
+// Source id 0 is the local RtMidi device; network participants count up from 1
+constexpr int LocalMidiSource = 0;
+
 struct MidiMessage {
     double timeStamp;
     std::vector<unsigned char> data;
+    int sourceId;
 };
 
 enum class MidiEventType {
@@ -43,6 +49,8 @@ struct MidiEvent {
     int noteNumber;
     int velocity;
     int channel;
+    int64_t timeNs;             // de-jittered steady clock time; 0 if unknown
+    double beats;               // external transport position in quarter notes; < 0 if none
 };
 
 } // namespace MusicTypes
\ No newline at end of file
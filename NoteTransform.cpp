@@ -0,0 +1,171 @@
+#include "NoteTransform.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+const uint16_t NoteTransform::DROPPED;
+
+namespace {
+
+bool parseInt(const std::string& text, int low, int high, int& value) {
+    if (text.empty()) return false;
+    char* end = nullptr;
+    long parsed = std::strtol(text.c_str(), &end, 10);
+    if (*end != '\0' || parsed < low || parsed > high) return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+// "a-b" with a <= b; a leading minus sign belongs to the first number
+bool parseRange(const std::string& text, int low, int high, int& first, int& second) {
+    size_t dash = text.find('-', 1);
+    return dash != std::string::npos &&
+           parseInt(text.substr(0, dash), low, high, first) &&
+           parseInt(text.substr(dash + 1), low, high, second) &&
+           first <= second;
+}
+
+std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator)) {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+std::string lower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+} // namespace
+
+NoteTransform::NoteTransform()
+    : identity(true)
+{
+    for (int channel = 0; channel < 16; channel++) {
+        channels[channel] = static_cast<unsigned char>(channel);
+        for (int note = 0; note < 128; note++) {
+            notes[channel][note] = static_cast<uint16_t>(channel << 8 | note);
+        }
+    }
+    for (int velocity = 0; velocity < 128; velocity++) {
+        velocities[velocity] = static_cast<unsigned char>(velocity);
+    }
+}
+
+bool NoteTransform::parse(const std::string& spec, NoteTransform& transform, std::string& error) {
+    int rangeLow = 0;
+    int rangeHigh = 127;
+    int channelMap[16];
+    for (int channel = 0; channel < 16; channel++) channelMap[channel] = channel;
+    int transpose = 0;
+    int splitNote = -1;
+    int splitChannel = 0;
+    int splitTranspose = 0;
+    double curve = 1.0;
+    int velocityLow = 1;
+    int velocityHigh = 127;
+
+    for (const std::string& item : split(spec, ',')) {
+        std::vector<std::string> fields = split(item, ':');
+        const std::string& key = fields.empty() ? item : fields[0];
+        bool valid = fields.size() >= 2;
+
+        if (valid && key == "range") {
+            valid = fields.size() == 2 && parseRange(fields[1], 0, 127, rangeLow, rangeHigh);
+        } else if (valid && key == "channel") {
+            size_t arrow = fields[1].find('>');
+            int from = 0;
+            int to = 0;
+            if (arrow == std::string::npos) {
+                valid = fields.size() == 2 && parseInt(fields[1], 1, 16, to);
+                for (int channel = 0; valid && channel < 16; channel++) channelMap[channel] = to - 1;
+            } else {
+                valid = fields.size() == 2 && parseInt(fields[1].substr(0, arrow), 1, 16, from) &&
+                        parseInt(fields[1].substr(arrow + 1), 1, 16, to);
+                if (valid) channelMap[from - 1] = to - 1;
+            }
+        } else if (valid && key == "transpose") {
+            valid = fields.size() == 2 && parseInt(fields[1], -127, 127, transpose);
+        } else if (valid && key == "split") {
+            valid = (fields.size() == 3 || fields.size() == 4) &&
+                    parseInt(fields[1], 0, 127, splitNote) &&
+                    parseInt(fields[2], 1, 16, splitChannel) &&
+                    (fields.size() == 3 || parseInt(fields[3], -127, 127, splitTranspose));
+            splitChannel--;
+        } else if (valid && key == "curve") {
+            char* end = nullptr;
+            curve = std::strtod(fields[1].c_str(), &end);
+            valid = fields.size() == 2 && !fields[1].empty() && *end == '\0' && curve > 0.0 && curve <= 10.0;
+        } else if (valid && key == "velocity") {
+            valid = fields.size() == 2 && parseRange(fields[1], 1, 127, velocityLow, velocityHigh);
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            error = "bad transform item '" + item + "'";
+            return false;
+        }
+    }
+
+    NoteTransform compiled;
+    for (int channel = 0; channel < 16; channel++) {
+        compiled.channels[channel] = static_cast<unsigned char>(channelMap[channel]);
+        for (int note = 0; note < 128; note++) {
+            bool lowerZone = note < splitNote;
+            int outChannel = lowerZone ? splitChannel : channelMap[channel];
+            int outNote = note + (lowerZone ? splitTranspose : transpose);
+            bool kept = note >= rangeLow && note <= rangeHigh && outNote >= 0 && outNote <= 127;
+            compiled.notes[channel][note] = kept ? static_cast<uint16_t>(outChannel << 8 | outNote) : DROPPED;
+        }
+    }
+    for (int velocity = 1; velocity < 128; velocity++) {
+        // 1 and 127 land on the ends of the range; exponent 1 over 1-127 changes nothing
+        double shaped = std::pow((velocity - 1) / 126.0, curve);
+        int scaled = static_cast<int>(std::lround(velocityLow + shaped * (velocityHigh - velocityLow)));
+        compiled.velocities[velocity] = static_cast<unsigned char>(std::max(1, std::min(127, scaled)));
+    }
+    compiled.identity = spec.empty();
+
+    transform = compiled;
+    return true;
+}
+
+bool NoteTransform::isIdentity() const {
+    return identity;
+}
+
+bool NoteTransform::apply(unsigned char* data, size_t size) const {
+    if (identity || size == 0 || data[0] < 0x80 || data[0] >= 0xF0) return true;
+
+    unsigned char type = data[0] & 0xF0;
+    int channel = data[0] & 0x0F;
+    if (type == 0x80 || type == 0x90 || type == 0xA0) {
+        if (size < 3) return true;
+        uint16_t mapped = notes[channel][data[1] & 0x7F];
+        if (mapped == DROPPED) return false;
+        data[0] = static_cast<unsigned char>(type | (mapped >> 8));
+        data[1] = static_cast<unsigned char>(mapped & 0x7F);
+        // Velocity 0 stays 0: it is a note off
+        if (type == 0x90) data[2] = velocities[data[2] & 0x7F];
+        return true;
+    }
+    data[0] = static_cast<unsigned char>(type | channels[channel]);
+    return true;
+}
+
+const NoteTransform* NoteTransformRule::select(const std::vector<NoteTransformRule>& rules,
+                                               const std::string& deviceName) {
+    std::string name = lower(deviceName);
+    for (const NoteTransformRule& rule : rules) {
+        if (name.find(lower(rule.devicePattern)) != std::string::npos) return &rule.transform;
+    }
+    return nullptr;
+}
\ No newline at end of file
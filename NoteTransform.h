@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-device rewrite of channel voice messages: velocity curve, transposition,
+// key split, channel remap and a playable key range. The spec is compiled
+// once into lookup tables (a 128-entry note table per input channel and one
+// velocity table), so applying it is a few array reads and no branching on
+// the configuration.
+//
+// Spec: comma-separated items, applied in this order
+//   range:<low>-<high>          drop keys outside (input note numbers)
+//   channel:<from>><to>         remap an input channel (1-16); "channel:<to>" remaps all
+//   transpose:<semitones>
+//   split:<note>:<channel>[:<semitones>]
+//                               keys below <note> go to <channel>, transposed
+//                               by their own amount instead
+//   curve:<exponent>            shape velocity by ((v - 1) / 126) ^ exponent;
+//                               below 1 plays louder, above 1 softer
+//   velocity:<min>-<max>        range the shaped velocity spans (default 1-127)
+// Notes transposed off the keyboard are dropped. Note on velocity never
+// becomes 0, so a note on stays a note on.
+class NoteTransform {
+public:
+    NoteTransform();   // leaves every message as it is
+
+    static bool parse(const std::string& spec, NoteTransform& transform, std::string& error);
+
+    // Rewrites the message in place; false when it is filtered out
+    bool apply(unsigned char* data, size_t size) const;
+    bool isIdentity() const;
+
+private:
+    static const uint16_t DROPPED = 0xFFFF;
+
+    uint16_t notes[16][128];    // output channel << 8 | output note, or DROPPED
+    unsigned char channels[16]; // for messages without a note number
+    unsigned char velocities[128];
+    bool identity;
+};
+
+struct NoteTransformRule {
+    std::string devicePattern;  // case-insensitive substring of the port or peer name
+    NoteTransform transform;
+
+    // First rule matching the device, or null
+    static const NoteTransform* select(const std::vector<NoteTransformRule>& rules, const std::string& deviceName);
+};
\ No newline at end of file
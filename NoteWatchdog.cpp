@@ -0,0 +1,242 @@
+#include "NoteWatchdog.h"
+#include <cstring>
+
+const int NoteWatchdog::WHEEL_SLOTS;
+const uint16_t NoteWatchdog::SENSING_TIMER;
+
+NoteWatchdog::Options NoteWatchdog::defaultOptions() {
+    Options options;
+    options.holdTimeoutNs = 60000000000LL;   // a minute with nothing else from the port
+    options.sensingTimeoutNs = 300000000LL;  // the MIDI 1.0 specification's 300 ms
+    options.tickNs = 50000000LL;
+    return options;
+}
+
+NoteWatchdog::NoteWatchdog(const Options& options)
+    : options(options)
+    , currentTick(-1)
+{
+    for (Timer& slot : wheel) {
+        slot.prev = &slot;
+        slot.next = &slot;
+    }
+    std::memset(&counters, 0, sizeof(counters));
+}
+
+NoteWatchdog::~NoteWatchdog() {
+}
+
+void NoteWatchdog::setHoldTimeout(int64_t holdTimeoutNs) {
+    options.holdTimeoutNs = holdTimeoutNs;
+}
+
+NoteWatchdog::Counters NoteWatchdog::getCounters() const {
+    return counters;
+}
+
+bool NoteWatchdog::isIdle() const {
+    if (counters.held > 0) return false;
+    for (const auto& entry : ports) {
+        if (entry.second->sensing) return false;
+    }
+    return true;
+}
+
+NoteWatchdog::Port& NoteWatchdog::portFor(int sourceId, int64_t nowNs) {
+    std::unique_ptr<Port>& entry = ports[sourceId];
+    if (!entry) {
+        entry.reset(new Port());
+        Port& port = *entry;
+        port.sourceId = sourceId;
+        port.lastActivityNs = nowNs;
+        port.sensing = false;
+        port.held = 0;
+        for (int i = 0; i < 16 * 128; i++) {
+            port.notes[i] = false;
+            port.noteTimers[i].prev = nullptr;
+            port.noteTimers[i].next = nullptr;
+            port.noteTimers[i].port = &port;
+            port.noteTimers[i].channelNote = static_cast<uint16_t>(i);
+            port.noteTimers[i].expired = false;
+        }
+        port.sensingTimer.prev = nullptr;
+        port.sensingTimer.next = nullptr;
+        port.sensingTimer.port = &port;
+        port.sensingTimer.channelNote = SENSING_TIMER;
+        port.sensingTimer.expired = false;
+    }
+    return *entry;
+}
+
+void NoteWatchdog::schedule(Timer& timer, int64_t deadlineNs) {
+    cancel(timer);
+    int64_t tick = deadlineNs / options.tickNs;
+    if (tick <= currentTick) tick = currentTick + 1;
+
+    Timer& slot = wheel[tick % WHEEL_SLOTS];
+    timer.deadlineNs = deadlineNs;
+    timer.prev = slot.prev;
+    timer.next = &slot;
+    slot.prev->next = &timer;
+    slot.prev = &timer;
+}
+
+void NoteWatchdog::cancel(Timer& timer) {
+    timer.expired = false;
+    if (!timer.next) return;
+    timer.prev->next = timer.next;
+    timer.next->prev = timer.prev;
+    timer.prev = nullptr;
+    timer.next = nullptr;
+}
+
+void NoteWatchdog::onMessage(int sourceId, int64_t nowNs, const unsigned char* data, size_t size,
+                             std::vector<ReleasedNote>& released) {
+    if (size == 0) return;
+    Port& port = portFor(sourceId, nowNs);
+    port.lastActivityNs = nowNs;
+
+    unsigned char status = data[0];
+    if (status == 0xFE) {
+        if (!port.sensing) {
+            port.sensing = true;
+            schedule(port.sensingTimer, nowNs + options.sensingTimeoutNs);
+        }
+        return;
+    }
+    if (status == 0xFF) {
+        counters.clearedByReset += releaseAll(port, released);
+        return;
+    }
+    if (status < 0x80 || status >= 0xF0 || size < 3) return;
+
+    int channel = status & 0x0F;
+    int channelNote = channel * 128 + (data[1] & 0x7F);
+    switch (status & 0xF0) {
+    case 0x90:
+        if (data[2] > 0) {
+            if (!port.notes[channelNote]) {
+                port.notes[channelNote] = true;
+                port.held++;
+                counters.held++;
+            }
+            if (options.holdTimeoutNs > 0) {
+                schedule(port.noteTimers[channelNote], nowNs + options.holdTimeoutNs);
+            }
+            break;
+        }
+        // Velocity 0 is a note off
+        // fall through
+    case 0x80:
+        if (port.notes[channelNote]) {
+            port.notes[channelNote] = false;
+            port.held--;
+            counters.held--;
+            cancel(port.noteTimers[channelNote]);
+        }
+        break;
+    case 0xB0:
+        // All Sound Off, All Notes Off, and the mode changes that imply it
+        if (data[1] == 120 || data[1] >= 123) {
+            counters.clearedByController += releaseChannel(port, channel, released);
+        }
+        break;
+    }
+}
+
+void NoteWatchdog::advance(int64_t nowNs, std::vector<ReleasedNote>& released) {
+    int64_t targetTick = nowNs / options.tickNs;
+    if (currentTick < 0) currentTick = targetTick - 1;
+    if (targetTick <= currentTick) return;
+
+    // After a long gap every slot is visited once, not once per missed tick
+    int64_t firstTick = targetTick - currentTick > WHEEL_SLOTS ? targetTick - WHEEL_SLOTS + 1 : currentTick + 1;
+    for (int64_t tick = firstTick; tick <= targetTick; tick++) {
+        Timer& slot = wheel[tick % WHEEL_SLOTS];
+        for (Timer* timer = slot.next; timer != &slot;) {
+            Timer* next = timer->next;
+            if (timer->deadlineNs <= nowNs) {
+                cancel(*timer);
+                timer->expired = true;
+                expiring.push_back(timer);
+            }
+            timer = next;
+        }
+    }
+    currentTick = targetTick;
+
+    // Firing can release other notes; one released that way is no longer expired
+    for (Timer* timer : expiring) {
+        if (timer->expired) {
+            timer->expired = false;
+            fire(*timer, nowNs, released);
+        }
+    }
+    expiring.clear();
+}
+
+void NoteWatchdog::fire(Timer& timer, int64_t nowNs, std::vector<ReleasedNote>& released) {
+    Port& port = *timer.port;
+
+    if (timer.channelNote == SENSING_TIMER) {
+        if (port.lastActivityNs + options.sensingTimeoutNs > nowNs) {
+            schedule(timer, port.lastActivityNs + options.sensingTimeoutNs);
+            return;
+        }
+        // Sensing resumes with the next FE, if the port ever sends one again
+        port.sensing = false;
+        counters.sensingTimeouts++;
+        counters.clearedBySensing += releaseAll(port, released);
+        return;
+    }
+
+    if (options.holdTimeoutNs <= 0) return;
+    if (port.lastActivityNs + options.holdTimeoutNs > nowNs) {
+        schedule(timer, port.lastActivityNs + options.holdTimeoutNs);
+        return;
+    }
+    release(port, timer.channelNote, released);
+    counters.agedOut++;
+}
+
+void NoteWatchdog::release(Port& port, int channelNote, std::vector<ReleasedNote>& released) {
+    port.notes[channelNote] = false;
+    port.held--;
+    counters.held--;
+    cancel(port.noteTimers[channelNote]);
+
+    ReleasedNote note;
+    note.sourceId = port.sourceId;
+    note.channel = channelNote / 128;
+    note.note = channelNote % 128;
+    released.push_back(note);
+}
+
+int NoteWatchdog::releaseChannel(Port& port, int channel, std::vector<ReleasedNote>& released) {
+    int count = 0;
+    for (int channelNote = channel * 128; channelNote < (channel + 1) * 128 && port.held > 0; channelNote++) {
+        if (port.notes[channelNote]) {
+            release(port, channelNote, released);
+            count++;
+        }
+    }
+    return count;
+}
+
+int NoteWatchdog::releaseAll(Port& port, std::vector<ReleasedNote>& released) {
+    int count = 0;
+    for (int channel = 0; channel < 16 && port.held > 0; channel++) {
+        count += releaseChannel(port, channel, released);
+    }
+    return count;
+}
+
+void NoteWatchdog::removeSource(int sourceId, std::vector<ReleasedNote>& released) {
+    auto it = ports.find(sourceId);
+    if (it == ports.end()) return;
+
+    Port& port = *it->second;
+    releaseAll(port, released);
+    cancel(port.sensingTimer);
+    ports.erase(it);
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Releases notes whose note off will never come. Three things clear notes:
+// a port that sent active sensing and then went quiet for longer than the
+// sensing timeout, All Sound Off / All Notes Off / Reset from the port, and
+// notes held past the hold timeout while their port showed no activity.
+//
+// Every held note and every sensing port owns a timer on a hashed timer
+// wheel, so note on/off and activity are O(1) and a tick only visits the
+// wheel slots that have come due. Timers are not moved on activity; an
+// expiring timer checks the port's last activity and re-arms itself.
+class NoteWatchdog {
+public:
+    struct Options {
+        int64_t holdTimeoutNs;      // 0 = never age out held notes
+        int64_t sensingTimeoutNs;   // silence after active sensing that counts as a lost port
+        int64_t tickNs;             // wheel resolution
+    };
+
+    struct Counters {
+        uint64_t sensingTimeouts;    // ports that stopped sensing
+        uint64_t clearedBySensing;   // notes released by those timeouts
+        uint64_t clearedByController;// CC 120/123-127
+        uint64_t clearedByReset;
+        uint64_t agedOut;
+        uint64_t held;               // currently held
+    };
+
+    struct ReleasedNote {
+        int sourceId;
+        int channel;
+        int note;
+    };
+
+    static Options defaultOptions();
+
+    explicit NoteWatchdog(const Options& options);
+    ~NoteWatchdog();
+
+    // Every message from a port; notes it releases implicitly are appended
+    void onMessage(int sourceId, int64_t nowNs, const unsigned char* data, size_t size,
+                   std::vector<ReleasedNote>& released);
+    // Fires due timers; call regularly with a monotonic clock
+    void advance(int64_t nowNs, std::vector<ReleasedNote>& released);
+    // The port is gone: its held notes are released without being counted
+    // as stuck, and its state is dropped
+    void removeSource(int sourceId, std::vector<ReleasedNote>& released);
+
+    void setHoldTimeout(int64_t holdTimeoutNs);
+    Counters getCounters() const;
+    // No held notes and no port on sensing watch: advance() has nothing to do
+    bool isIdle() const;
+
+private:
+    static const int WHEEL_SLOTS = 256;
+    static const uint16_t SENSING_TIMER = 0xFFFF;
+
+    struct Port;
+
+    struct Timer {
+        Timer* prev;
+        Timer* next;
+        Port* port;
+        int64_t deadlineNs;
+        uint16_t channelNote;   // channel * 128 + note, or SENSING_TIMER
+        bool expired;           // taken off the wheel, about to fire
+    };
+
+    struct Port {
+        int sourceId;
+        int64_t lastActivityNs;
+        bool sensing;           // has sent active sensing
+        int held;
+        bool notes[16 * 128];
+        Timer noteTimers[16 * 128];
+        Timer sensingTimer;
+    };
+
+    Options options;
+    std::map<int, std::unique_ptr<Port>> ports;
+    Timer wheel[WHEEL_SLOTS];   // sentinels of circular lists
+    int64_t currentTick;        // last tick processed, -1 before the first
+    std::vector<Timer*> expiring;
+    Counters counters;
+
+    Port& portFor(int sourceId, int64_t nowNs);
+    void schedule(Timer& timer, int64_t deadlineNs);
+    void cancel(Timer& timer);
+    void fire(Timer& timer, int64_t nowNs, std::vector<ReleasedNote>& released);
+    void release(Port& port, int channelNote, std::vector<ReleasedNote>& released);
+    int releaseChannel(Port& port, int channel, std::vector<ReleasedNote>& released);
+    int releaseAll(Port& port, std::vector<ReleasedNote>& released);
+};
\ No newline at end of file
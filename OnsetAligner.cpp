@@ -0,0 +1,176 @@
+#include "OnsetAligner.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+namespace {
+
+double median(std::vector<double> values) {
+    if (values.empty()) return 0.0;
+    size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    return values[middle];
+}
+
+} // namespace
+
+OnsetAligner::Config OnsetAligner::defaultConfig() {
+    Config config;
+    config.maxOffsetSeconds = 2.0;
+    config.windowSeconds = 0.15;
+    config.chordSeconds = 0.03;
+    config.skipSeconds = 0.1;
+    return config;
+}
+
+OnsetAligner::OnsetAligner(const Config& config)
+    : config(config)
+{
+}
+
+double OnsetAligner::estimateOffset(const std::vector<double>& midi, const std::vector<double>& audio) const {
+    // Most common difference, in 5 ms bins smoothed over their neighbours
+    const double binSeconds = 0.005;
+    std::map<long, int> histogram;
+    size_t first = 0;
+    for (double a : audio) {
+        while (first < midi.size() && midi[first] < a - config.maxOffsetSeconds) first++;
+        for (size_t j = first; j < midi.size() && midi[j] <= a + config.maxOffsetSeconds; j++) {
+            histogram[std::lround((a - midi[j]) / binSeconds)]++;
+        }
+    }
+    if (histogram.empty()) return 0.0;
+
+    long bestBin = 0;
+    int bestCount = -1;
+    for (const auto& entry : histogram) {
+        int count = entry.second;
+        auto previous = histogram.find(entry.first - 1);
+        auto next = histogram.find(entry.first + 1);
+        if (previous != histogram.end()) count += previous->second;
+        if (next != histogram.end()) count += next->second;
+        if (count > bestCount) {
+            bestCount = count;
+            bestBin = entry.first;
+        }
+    }
+    return bestBin * binSeconds;
+}
+
+OnsetAligner::Result OnsetAligner::align(const std::vector<double>& midiNoteOns,
+                                         const std::vector<double>& audioOnsets) const {
+    std::vector<double> midi;
+    for (double t : midiNoteOns) {
+        if (midi.empty() || t - midi.back() > config.chordSeconds) midi.push_back(t);
+    }
+    const std::vector<double>& audio = audioOnsets;
+
+    Result result;
+    result.offsetSeconds = estimateOffset(midi, audio);
+    result.midiOnsets = midi.size();
+    result.audioOnsets = audio.size();
+    result.latencyMedianMs = result.latencyJitterMs = 0.0;
+    result.latencyMinMs = result.latencyMaxMs = 0.0;
+
+    // D[i][j]: cost of aligning the first i audio onsets with the first j MIDI
+    // onsets. Row i only keeps the band of j whose MIDI onset lies within the
+    // window of audio onset i - 1; skips commute, so no optimum is lost.
+    size_t n = audio.size();
+    size_t m = midi.size();
+    double offset = result.offsetSeconds;
+    double window = config.windowSeconds;
+    double skip = config.skipSeconds;
+
+    std::vector<size_t> rowLow(n + 1), rowHigh(n + 1), rowStart(n + 2);
+    rowLow[0] = 0;
+    rowHigh[0] = 0;
+    size_t low = 0, high = 0;
+    for (size_t i = 1; i <= n; i++) {
+        while (low < m && midi[low] + offset < audio[i - 1] - window) low++;
+        while (high < m && midi[high] + offset <= audio[i - 1] + window) high++;
+        rowLow[i] = std::max(low, rowLow[i - 1]);
+        rowHigh[i] = std::max(high, rowLow[i]);
+    }
+    rowStart[0] = 0;
+    for (size_t i = 0; i <= n; i++) {
+        rowStart[i + 1] = rowStart[i] + (rowHigh[i] - rowLow[i] + 1);
+    }
+
+    enum Move : unsigned char { Diagonal, Up, Left };
+    std::vector<double> cost(rowStart[n + 1]);
+    std::vector<unsigned char> moves(rowStart[n + 1]);
+
+    // Cost of cell (i, j), extending past the stored band by skipping MIDI onsets
+    auto at = [&](size_t i, size_t j) {
+        if (j > rowHigh[i]) return cost[rowStart[i] + rowHigh[i] - rowLow[i]] + (j - rowHigh[i]) * skip;
+        return cost[rowStart[i] + j - rowLow[i]];
+    };
+
+    cost[0] = 0.0;
+    moves[0] = Left;
+    for (size_t i = 1; i <= n; i++) {
+        for (size_t j = rowLow[i]; j <= rowHigh[i]; j++) {
+            double best = at(i - 1, j) + skip;
+            unsigned char move = Up;
+
+            if (j > rowLow[i]) {
+                double left = cost[rowStart[i] + j - 1 - rowLow[i]] + skip;
+                if (left < best) {
+                    best = left;
+                    move = Left;
+                }
+            }
+            if (j > rowLow[i - 1] && j > 0) {
+                double distance = std::fabs(audio[i - 1] - (midi[j - 1] + offset));
+                if (distance <= window) {
+                    double diagonal = at(i - 1, j - 1) + distance;
+                    if (diagonal < best) {
+                        best = diagonal;
+                        move = Diagonal;
+                    }
+                }
+            }
+
+            cost[rowStart[i] + j - rowLow[i]] = best;
+            moves[rowStart[i] + j - rowLow[i]] = move;
+        }
+    }
+
+    // Backtrack from (n, m); columns beyond a row's band are MIDI skips
+    size_t i = n;
+    size_t j = m;
+    while (i > 0) {
+        if (j > rowHigh[i]) {
+            j = rowHigh[i];
+            continue;
+        }
+        unsigned char move = moves[rowStart[i] + j - rowLow[i]];
+        if (move == Diagonal) {
+            result.matches.push_back({midi[j - 1], audio[i - 1]});
+            i--;
+            j--;
+        } else if (move == Up) {
+            i--;
+        } else {
+            j--;
+        }
+    }
+    std::reverse(result.matches.begin(), result.matches.end());
+
+    if (!result.matches.empty()) {
+        std::vector<double> latencies;
+        for (const Match& match : result.matches) {
+            latencies.push_back((match.audioTime - match.midiTime) * 1000.0);
+        }
+        result.latencyMedianMs = median(latencies);
+        std::vector<double> deviations;
+        for (double latency : latencies) {
+            deviations.push_back(std::fabs(latency - result.latencyMedianMs));
+        }
+        result.latencyJitterMs = median(deviations);
+        result.latencyMinMs = *std::min_element(latencies.begin(), latencies.end());
+        result.latencyMaxMs = *std::max_element(latencies.begin(), latencies.end());
+    }
+
+    return result;
+}
\ No newline at end of file
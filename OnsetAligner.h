@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Aligns audio onsets with the MIDI note-ons of the same performance, e.g. a
+// lesson recorded with both a microphone and MIDI. A histogram of onset time
+// differences gives the coarse offset between the recordings; a banded DTW
+// with skip costs then pairs individual onsets, tolerating onsets the audio
+// detector missed or invented. Matched pairs measure the instrument's sound
+// latency and its spread.
+class OnsetAligner {
+public:
+    struct Config {
+        double maxOffsetSeconds;  // how far apart the recordings may have started
+        double windowSeconds;     // band half-width around the coarse offset
+        double chordSeconds;      // MIDI note-ons this close count as one onset
+        double skipSeconds;       // cost of leaving an onset unmatched
+    };
+
+    struct Match {
+        double midiTime;
+        double audioTime;
+    };
+
+    struct Result {
+        double offsetSeconds;     // coarse audio - MIDI offset
+        size_t midiOnsets;        // after chord merging
+        size_t audioOnsets;
+        std::vector<Match> matches;
+        double latencyMedianMs;   // audio - MIDI over matched pairs
+        double latencyJitterMs;   // median absolute deviation
+        double latencyMinMs;
+        double latencyMaxMs;
+    };
+
+    static Config defaultConfig();
+
+    explicit OnsetAligner(const Config& config);
+
+    // Both inputs sorted, in seconds on their own clocks
+    Result align(const std::vector<double>& midiNoteOns, const std::vector<double>& audioOnsets) const;
+
+private:
+    Config config;
+
+    double estimateOffset(const std::vector<double>& midi, const std::vector<double>& audio) const;
+};
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "OnsetDetector.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+OnsetDetector::Config OnsetDetector::defaultConfig() {
+    Config config;
+    config.frameSize = 1024;
+    config.hopSize = 128;      // ~2.9 ms at 44.1 kHz
+    config.thresholdFrames = 16;
+    config.thresholdScale = 1.5f;
+    config.thresholdOffset = 0.005f; // well above a -60 dB noise floor
+    config.minIntervalSeconds = 0.03f;
+    return config;
+}
+
+OnsetDetector::OnsetDetector(int sampleRate, const Config& config)
+    : sampleRate(sampleRate)
+    , config(config)
+    , fft(config.frameSize)
+    , frame(config.frameSize, 0.0f)
+    , filled(0)
+    , spectrum(fft.getBinCount())
+    , previousSpectrum(fft.getBinCount(), 0.0f)
+    , flux(static_cast<size_t>(2 * config.thresholdFrames + 1), 0.0f)
+    , fluxCount(0)
+    , lastOnset(-1e9)
+{
+}
+
+double OnsetDetector::frameTime(uint64_t frameIndex) const {
+    // Log-compressed flux peaks when an attack is about three quarters into
+    // the frame, so that is where the onset is placed
+    return static_cast<double>(frameIndex * config.hopSize + config.frameSize * 3 / 4) / sampleRate;
+}
+
+void OnsetDetector::process(const float* samples, size_t count, const OnsetCallback& onOnset) {
+    size_t frameSize = frame.size();
+    size_t hop = static_cast<size_t>(config.hopSize);
+
+    while (count > 0) {
+        size_t take = std::min(count, frameSize - filled);
+        std::memcpy(frame.data() + filled, samples, take * sizeof(float));
+        filled += take;
+        samples += take;
+        count -= take;
+        if (filled < frameSize) break;
+
+        fft.magnitudes(frame.data(), spectrum.data());
+
+        // Log compression makes quiet and loud attacks comparable
+        float value = 0.0f;
+        size_t bins = spectrum.size();
+        for (size_t bin = 0; bin < bins; bin++) {
+            float magnitude = std::log1p(100.0f * spectrum[bin]);
+            float rise = magnitude - previousSpectrum[bin];
+            value += rise > 0.0f ? rise : 0.0f;
+            previousSpectrum[bin] = magnitude;
+        }
+        pushFlux(value / bins, onOnset);
+
+        std::memmove(frame.data(), frame.data() + hop, (frameSize - hop) * sizeof(float));
+        filled = frameSize - hop;
+    }
+}
+
+void OnsetDetector::finish(const OnsetCallback& onOnset) {
+    // Flush the lookahead with silence
+    for (int i = 0; i < config.thresholdFrames; i++) {
+        pushFlux(0.0f, onOnset);
+    }
+}
+
+void OnsetDetector::pushFlux(float value, const OnsetCallback& onOnset) {
+    size_t window = flux.size();
+    flux[fluxCount % window] = value;
+    fluxCount++;
+    if (fluxCount < window) return;
+
+    // Decide the centre frame of the window
+    uint64_t centreIndex = fluxCount - 1 - static_cast<uint64_t>(config.thresholdFrames);
+    float centre = flux[centreIndex % window];
+
+    float sum = 0.0f;
+    bool isPeak = true;
+    for (size_t i = 0; i < window; i++) {
+        sum += flux[i];
+        if (flux[i] > centre) isPeak = false;
+    }
+    float threshold = sum / window * config.thresholdScale + config.thresholdOffset;
+
+    double time = frameTime(centreIndex);
+    if (isPeak && centre > threshold && time - lastOnset >= config.minIntervalSeconds) {
+        lastOnset = time;
+        onOnset(time, centre);
+    }
+}
\ No newline at end of file
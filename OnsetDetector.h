@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Fft.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Streaming note-onset detection for mono audio: log-compressed spectral flux
+// (positive magnitude changes only), peak-picked against an adaptive
+// threshold of the surrounding frames. Onsets are reported a few frames late,
+// once the threshold window has been seen; buffers are fixed-size.
+class OnsetDetector {
+public:
+    struct Config {
+        int frameSize;
+        int hopSize;           // time resolution
+        int thresholdFrames;   // frames on each side of the threshold window
+        float thresholdScale;  // onset if flux > mean * scale + offset
+        float thresholdOffset;
+        float minIntervalSeconds;
+    };
+
+    using OnsetCallback = std::function<void(double timeSeconds, float strength)>;
+
+    static Config defaultConfig();
+
+    OnsetDetector(int sampleRate, const Config& config);
+
+    void process(const float* samples, size_t count, const OnsetCallback& onOnset);
+    void finish(const OnsetCallback& onOnset);
+
+private:
+    int sampleRate;
+    Config config;
+    Fft fft;
+
+    std::vector<float> frame;
+    size_t filled;
+    std::vector<float> spectrum;
+    std::vector<float> previousSpectrum;
+
+    // Flux history, centred on the frame being decided
+    std::vector<float> flux;
+    uint64_t fluxCount;
+    double lastOnset;
+
+    void pushFlux(float value, const OnsetCallback& onOnset);
+    double frameTime(uint64_t frameIndex) const;
+};
\ No newline at end of file
@@ -0,0 +1,367 @@
+#include "OutputSink.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+
+const char OutputSink::FILE_MAGIC[8] = {'M', 'I', 'D', 'I', 'M', 'O', 'N', 1};
+const size_t OutputSink::MAX_TEXT_LENGTH;
+const size_t OutputSink::BUFFER_SIZE;
+
+namespace {
+
+// Fixed-size record under construction. Every field is length-clamped by the
+// callers, so a record always fits.
+class RecordBuffer {
+public:
+    RecordBuffer() : size(0) {}
+
+    const char* data() const { return bytes; }
+    size_t length() const { return size; }
+
+    void raw(const void* source, size_t count) {
+        std::memcpy(bytes + size, source, count);
+        size += count;
+    }
+
+    template <size_t N>
+    void literal(const char (&text)[N]) {
+        raw(text, N - 1);
+    }
+
+    void u8(uint8_t value) { bytes[size++] = static_cast<char>(value); }
+
+    void u16(uint16_t value) {
+        u8(static_cast<uint8_t>(value));
+        u8(static_cast<uint8_t>(value >> 8));
+    }
+
+    void u32(uint32_t value) {
+        u16(static_cast<uint16_t>(value));
+        u16(static_cast<uint16_t>(value >> 16));
+    }
+
+    void u64(uint64_t value) {
+        u32(static_cast<uint32_t>(value));
+        u32(static_cast<uint32_t>(value >> 32));
+    }
+
+    // Binary string: u16 length + bytes
+    void text(const char* source, size_t count) {
+        count = std::min(count, OutputSink::MAX_TEXT_LENGTH);
+        u16(static_cast<uint16_t>(count));
+        raw(source, count);
+    }
+
+    // Decimal integer for JSON
+    void integer(int64_t value) {
+        std::to_chars_result result = std::to_chars(bytes + size, bytes + sizeof(bytes), value);
+        size = static_cast<size_t>(result.ptr - bytes);
+    }
+
+    // Quoted, escaped JSON string
+    void jsonString(const char* source, size_t count) {
+        static const char hex[] = "0123456789abcdef";
+        count = std::min(count, OutputSink::MAX_TEXT_LENGTH);
+        u8('"');
+        for (size_t i = 0; i < count; i++) {
+            unsigned char c = static_cast<unsigned char>(source[i]);
+            if (c == '"' || c == '\\') {
+                u8('\\');
+                u8(c);
+            } else if (c < 0x20) {
+                literal("\\u00");
+                u8(static_cast<uint8_t>(hex[c >> 4]));
+                u8(static_cast<uint8_t>(hex[c & 0x0F]));
+            } else {
+                u8(c);
+            }
+        }
+        u8('"');
+    }
+
+    // Patches the u32 length prefix of a binary record started at offset 0;
+    // trailingBytes counts payload appended separately
+    void finishBinaryRecord(size_t trailingBytes = 0) {
+        uint32_t payload = static_cast<uint32_t>(size - 4 + trailingBytes);
+        for (int i = 0; i < 4; i++) {
+            bytes[i] = static_cast<char>(payload >> (8 * i));
+        }
+    }
+
+private:
+    char bytes[4096];
+    size_t size;
+};
+
+size_t boundedLength(const char* text, size_t capacity) {
+    const void* end = std::memchr(text, 0, capacity);
+    return end ? static_cast<size_t>(static_cast<const char*>(end) - text) : capacity;
+}
+
+class JsonLinesSink : public OutputSink {
+public:
+    JsonLinesSink(std::FILE* file, bool ownsFile) : OutputSink(file, ownsFile) {}
+
+    void writeSessionOpen(int32_t sessionId, int64_t timeNs, int64_t wallClockMs,
+                          const char* name, size_t nameLength) override {
+        RecordBuffer record;
+        begin(record, "session_open", sessionId, timeNs);
+        record.literal(",\"wall_ms\":");
+        record.integer(wallClockMs);
+        record.literal(",\"name\":");
+        record.jsonString(name, nameLength);
+        end(record);
+    }
+
+    void writeSessionClose(int32_t sessionId, int64_t timeNs) override {
+        RecordBuffer record;
+        begin(record, "session_close", sessionId, timeNs);
+        end(record);
+    }
+
+    void writeMidi(int32_t sessionId, int64_t timeNs, const unsigned char* data, size_t size) override {
+        RecordBuffer record;
+        begin(record, "midi", sessionId, timeNs);
+        record.literal(",\"bytes\":[");
+        size = std::min<size_t>(size, 3);
+        for (size_t i = 0; i < size; i++) {
+            if (i > 0) record.u8(',');
+            record.integer(data[i]);
+        }
+        record.u8(']');
+        end(record);
+    }
+
+    void writeChord(int32_t sessionId, int64_t timeNs, const char* chord, size_t chordLength,
+                    const char* roman, size_t romanLength) override {
+        RecordBuffer record;
+        begin(record, "chord", sessionId, timeNs);
+        record.literal(",\"chord\":");
+        record.jsonString(chord, chordLength);
+        record.literal(",\"roman\":");
+        record.jsonString(roman, romanLength);
+        end(record);
+    }
+
+    void writeAnnotation(int32_t sessionId, int64_t timeNs, const char* plugin, size_t pluginLength,
+                         const midimon_annotation& annotation) override {
+        RecordBuffer record;
+        begin(record, "annotation", sessionId, timeNs);
+        record.literal(",\"plugin\":");
+        record.jsonString(plugin, pluginLength);
+        record.literal(",\"kind\":");
+        record.integer(annotation.kind);
+        record.literal(",\"value\":");
+        record.integer(annotation.value);
+        record.literal(",\"text\":");
+        record.jsonString(annotation.text, boundedLength(annotation.text, sizeof(annotation.text)));
+        end(record);
+    }
+
+    // Checkpoints only exist to make binary journals seekable
+    void writeCheckpoint(int32_t, int64_t, const char*, size_t) override {}
+
+private:
+    template <size_t N>
+    void begin(RecordBuffer& record, const char (&type)[N], int32_t sessionId, int64_t timeNs) {
+        record.literal("{\"type\":\"");
+        record.literal(type);
+        record.literal("\",\"session\":");
+        record.integer(sessionId);
+        record.literal(",\"t_ns\":");
+        record.integer(timeNs);
+    }
+
+    void end(RecordBuffer& record) {
+        record.literal("}\n");
+        append(record.data(), record.length());
+    }
+};
+
+class BinarySink : public OutputSink {
+public:
+    BinarySink(std::FILE* file, bool ownsFile) : OutputSink(file, ownsFile) {
+        appendHeader(FILE_MAGIC, sizeof(FILE_MAGIC));
+    }
+
+    void writeSessionOpen(int32_t sessionId, int64_t timeNs, int64_t wallClockMs,
+                          const char* name, size_t nameLength) override {
+        RecordBuffer record;
+        begin(record, SessionOpenRecord, sessionId, timeNs);
+        record.u64(static_cast<uint64_t>(wallClockMs));
+        record.text(name, nameLength);
+        end(record);
+    }
+
+    void writeSessionClose(int32_t sessionId, int64_t timeNs) override {
+        RecordBuffer record;
+        begin(record, SessionCloseRecord, sessionId, timeNs);
+        end(record);
+    }
+
+    void writeMidi(int32_t sessionId, int64_t timeNs, const unsigned char* data, size_t size) override {
+        RecordBuffer record;
+        begin(record, MidiRecord, sessionId, timeNs);
+        size = std::min<size_t>(size, 3);
+        record.u8(static_cast<uint8_t>(size));
+        record.raw(data, size);
+        end(record);
+    }
+
+    void writeChord(int32_t sessionId, int64_t timeNs, const char* chord, size_t chordLength,
+                    const char* roman, size_t romanLength) override {
+        RecordBuffer record;
+        begin(record, ChordRecord, sessionId, timeNs);
+        record.text(chord, chordLength);
+        record.text(roman, romanLength);
+        end(record);
+    }
+
+    void writeAnnotation(int32_t sessionId, int64_t timeNs, const char* plugin, size_t pluginLength,
+                         const midimon_annotation& annotation) override {
+        RecordBuffer record;
+        begin(record, AnnotationRecord, sessionId, timeNs);
+        record.text(plugin, pluginLength);
+        record.u32(annotation.kind);
+        record.u32(static_cast<uint32_t>(annotation.value));
+        record.text(annotation.text, boundedLength(annotation.text, sizeof(annotation.text)));
+        end(record);
+    }
+
+    void writeCheckpoint(int32_t sessionId, int64_t timeNs, const char* snapshot, size_t size) override {
+        RecordBuffer record;
+        begin(record, CheckpointRecord, sessionId, timeNs);
+        record.finishBinaryRecord(size);
+        append(record.data(), record.length(), snapshot, size);
+    }
+
+private:
+    void begin(RecordBuffer& record, RecordType type, int32_t sessionId, int64_t timeNs) {
+        record.u32(0); // length, patched in end()
+        record.u8(type);
+        record.u32(static_cast<uint32_t>(sessionId));
+        record.u64(static_cast<uint64_t>(timeNs));
+    }
+
+    void end(RecordBuffer& record) {
+        record.finishBinaryRecord();
+        append(record.data(), record.length());
+    }
+};
+
+} // namespace
+
+std::unique_ptr<OutputSink> OutputSink::create(Format format, const std::string& path, std::string& error) {
+    std::FILE* file = stdout;
+    bool ownsFile = false;
+
+    if (path != "-") {
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            error = "cannot open " + path + ": " + std::strerror(errno);
+            return nullptr;
+        }
+        ownsFile = true;
+    }
+
+    // We do our own buffering; stdio's would only add a copy
+    std::setvbuf(file, nullptr, _IONBF, 0);
+
+    if (format == Format::Binary) {
+        return std::unique_ptr<OutputSink>(new BinarySink(file, ownsFile));
+    }
+    return std::unique_ptr<OutputSink>(new JsonLinesSink(file, ownsFile));
+}
+
+OutputSink::OutputSink(std::FILE* file, bool ownsFile)
+    : file(file)
+    , ownsFile(ownsFile)
+    , buffer(BUFFER_SIZE)
+    , used(0)
+    , bytesWritten(0)
+    , recordsWritten(0)
+    , writeFailed(false)
+    , bytesDropped(0)
+{
+}
+
+OutputSink::~OutputSink() {
+    flush();
+    if (ownsFile) {
+        std::fclose(file);
+    }
+}
+
+void OutputSink::append(const char* data, size_t size) {
+    append(data, size, nullptr, 0);
+}
+
+void OutputSink::append(const char* head, size_t headSize, const char* body, size_t bodySize) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (used + headSize + bodySize > buffer.size()) {
+        flushLocked();
+        if (headSize + bodySize > buffer.size()) {
+            buffer.resize(headSize + bodySize);
+        }
+    }
+    std::memcpy(buffer.data() + used, head, headSize);
+    used += headSize;
+    if (bodySize > 0) {
+        std::memcpy(buffer.data() + used, body, bodySize);
+        used += bodySize;
+    }
+    recordsWritten++;
+}
+
+void OutputSink::appendHeader(const char* data, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (used + size > buffer.size()) {
+        flushLocked();
+    }
+    std::memcpy(buffer.data() + used, data, size);
+    used += size;
+}
+
+void OutputSink::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    flushLocked();
+}
+
+void OutputSink::flushLocked() {
+    if (used == 0) return;
+    if (writeFailed) {
+        bytesDropped += used;
+        used = 0;
+        return;
+    }
+    size_t written = std::fwrite(buffer.data(), 1, used, file);
+    bytesWritten += written;
+    if (written < used) {
+        std::cerr << "Output write failed after " << bytesWritten << " bytes: " << std::strerror(errno) << std::endl;
+        writeFailed = true;
+        bytesDropped += used - written;
+    }
+    used = 0;
+}
+
+uint64_t OutputSink::getBytesWritten() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytesWritten + used;
+}
+
+uint64_t OutputSink::getRecordsWritten() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return recordsWritten;
+}
+
+bool OutputSink::hasWriteFailed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return writeFailed;
+}
+
+uint64_t OutputSink::getBytesDropped() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytesDropped;
+}
\ No newline at end of file
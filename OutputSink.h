@@ -0,0 +1,84 @@
+#pragma once
+
+#include "AnalyzerPlugin.h"
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Buffered record output for headless runs, as newline-delimited JSON or as
+// length-prefixed binary records. Records are formatted into a stack buffer
+// without allocation and appended to one large write buffer, so throughput
+// is limited by the disk rather than by formatting. Safe to call from any
+// worker thread.
+//
+// Binary layout (little-endian): an 8-byte file header "MIDIMON" + version,
+// then records of  u32 length | u8 type | payload  where length counts the
+// type byte and payload.
+class OutputSink {
+public:
+    enum class Format {
+        JsonLines,
+        Binary
+    };
+
+    enum RecordType : uint8_t {
+        SessionOpenRecord = 1,
+        SessionCloseRecord = 2,
+        MidiRecord = 3,
+        ChordRecord = 4,
+        AnnotationRecord = 5,
+        CheckpointRecord = 6     // payload is a serialized SessionSnapshot
+    };
+
+    static const char FILE_MAGIC[8];
+    static const size_t MAX_TEXT_LENGTH = 255;
+
+    // path "-" writes to stdout
+    static std::unique_ptr<OutputSink> create(Format format, const std::string& path, std::string& error);
+    virtual ~OutputSink();
+
+    virtual void writeSessionOpen(int32_t sessionId, int64_t timeNs, int64_t wallClockMs,
+                                  const char* name, size_t nameLength) = 0;
+    virtual void writeSessionClose(int32_t sessionId, int64_t timeNs) = 0;
+    virtual void writeMidi(int32_t sessionId, int64_t timeNs, const unsigned char* data, size_t size) = 0;
+    virtual void writeChord(int32_t sessionId, int64_t timeNs, const char* chord, size_t chordLength,
+                            const char* roman, size_t romanLength) = 0;
+    virtual void writeAnnotation(int32_t sessionId, int64_t timeNs, const char* plugin, size_t pluginLength,
+                                 const midimon_annotation& annotation) = 0;
+    virtual void writeCheckpoint(int32_t sessionId, int64_t timeNs, const char* snapshot, size_t size) = 0;
+
+    void flush();
+    uint64_t getBytesWritten() const;
+    uint64_t getRecordsWritten() const;
+    // After a failed or short write, nothing more reaches the file; buffered
+    // records are dropped and counted
+    bool hasWriteFailed() const;
+    uint64_t getBytesDropped() const;
+
+protected:
+    OutputSink(std::FILE* file, bool ownsFile);
+
+    // Appends one complete record; records are never split between threads
+    void append(const char* data, size_t size);
+    void append(const char* head, size_t headSize, const char* body, size_t bodySize);
+    // File header bytes, not counted as a record
+    void appendHeader(const char* data, size_t size);
+
+private:
+    static const size_t BUFFER_SIZE = 4 * 1024 * 1024;
+
+    std::FILE* file;
+    bool ownsFile;
+    mutable std::mutex mutex;
+    std::vector<char> buffer;
+    size_t used;
+    uint64_t bytesWritten;
+    uint64_t recordsWritten;
+    bool writeFailed;
+    uint64_t bytesDropped;
+
+    void flushLocked();
+};
\ No newline at end of file
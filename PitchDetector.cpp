@@ -0,0 +1,197 @@
+#include "PitchDetector.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+PitchDetector::Config PitchDetector::defaultConfig() {
+    Config config;
+    config.frameSize = 4096;   // ~93 ms at 44.1 kHz, enough to separate low partials
+    config.hopSize = 512;
+    config.lowestNote = 33;    // A1
+    config.highestNote = 96;   // C7
+    config.harmonics = 8;
+    config.maxPolyphony = 6;
+    config.relativeThreshold = 0.3f;
+    config.silenceDb = -50.0f;
+    config.onFrames = 3;
+    config.offFrames = 3;
+    return config;
+}
+
+PitchDetector::PitchDetector(int sampleRate, const Config& config)
+    : sampleRate(sampleRate)
+    , config(config)
+    , fft(config.frameSize)
+    , frame(config.frameSize, 0.0f)
+    , filled(0)
+    , framesAnalyzed(0)
+    , spectrum(fft.getBinCount())
+    , residual(fft.getBinCount())
+    , peakPosition(fft.getBinCount(), -1.0f)
+    , activeFrames(128, 0)
+    , missingFrames(128, 0)
+    , pendingVelocity(128, 0)
+{
+    // Quarter-tone search window around every partial of every candidate
+    double binHz = static_cast<double>(sampleRate) / config.frameSize;
+    double nyquist = sampleRate / 2.0;
+    double quarterTone = std::pow(2.0, 1.0 / 24.0);
+    int candidates = config.highestNote - config.lowestNote + 1;
+
+    partials.resize(static_cast<size_t>(candidates * config.harmonics));
+    partialCount.resize(candidates, 0);
+    detected.reserve(config.maxPolyphony);
+
+    for (int c = 0; c < candidates; c++) {
+        double f0 = 440.0 * std::pow(2.0, (config.lowestNote + c - 69) / 12.0);
+        for (int h = 1; h <= config.harmonics; h++) {
+            double f = f0 * h;
+            if (f * quarterTone >= nyquist) break;
+
+            Partial& partial = partials[static_cast<size_t>(c * config.harmonics + h - 1)];
+            partial.lowPosition = static_cast<float>(f / quarterTone / binHz);
+            partial.highPosition = static_cast<float>(f * quarterTone / binHz);
+            partial.lowBin = std::max(1, static_cast<int>(std::floor(partial.lowPosition)));
+            partial.highBin = std::min(fft.getBinCount() - 2, static_cast<int>(std::ceil(partial.highPosition)));
+            partial.weight = 1.0f / h;
+            partialCount[c]++;
+        }
+    }
+}
+
+uint64_t PitchDetector::getFramesAnalyzed() const {
+    return framesAnalyzed;
+}
+
+void PitchDetector::process(const float* samples, size_t count, const NoteCallback& onNote) {
+    size_t frameSize = frame.size();
+    size_t hop = static_cast<size_t>(config.hopSize);
+
+    while (count > 0) {
+        size_t take = std::min(count, frameSize - filled);
+        std::memcpy(frame.data() + filled, samples, take * sizeof(float));
+        filled += take;
+        samples += take;
+        count -= take;
+
+        if (filled == frameSize) {
+            analyzeFrame(onNote);
+            std::memmove(frame.data(), frame.data() + hop, (frameSize - hop) * sizeof(float));
+            filled = frameSize - hop;
+        }
+    }
+}
+
+void PitchDetector::finish(const NoteCallback& onNote) {
+    double timeSeconds = static_cast<double>(framesAnalyzed * config.hopSize + frame.size() / 2) / sampleRate;
+    for (int note = 0; note < 128; note++) {
+        if (!sounding[note]) continue;
+        unsigned char message[3] = {0x80, static_cast<unsigned char>(note), 0};
+        onNote(timeSeconds, message, sizeof(message));
+    }
+    sounding.reset();
+}
+
+float PitchDetector::candidateSalience(int candidate) const {
+    const Partial* partial = &partials[static_cast<size_t>(candidate * config.harmonics)];
+    float salience = 0.0f;
+    for (int h = 0; h < partialCount[candidate]; h++, partial++) {
+        float peak = 0.0f;
+        for (int bin = partial->lowBin; bin <= partial->highBin; bin++) {
+            float position = peakPosition[bin];
+            if (position >= partial->lowPosition && position <= partial->highPosition) {
+                peak = std::max(peak, residual[bin]);
+            }
+        }
+        salience += peak * partial->weight;
+    }
+    return salience;
+}
+
+void PitchDetector::analyzeFrame(const NoteCallback& onNote) {
+    // Frame time is its centre
+    double timeSeconds = static_cast<double>(framesAnalyzed * config.hopSize + frame.size() / 2) / sampleRate;
+    framesAnalyzed++;
+
+    float energy = 0.0f;
+    for (float sample : frame) {
+        energy += sample * sample;
+    }
+    float rmsDb = 10.0f * std::log10(energy / frame.size() + 1e-12f);
+
+    detected.clear();
+    if (rmsDb >= config.silenceDb) {
+        fft.magnitudes(frame.data(), spectrum.data());
+        residual = spectrum;
+
+        // Parabolic interpolation of every local maximum
+        int bins = static_cast<int>(spectrum.size());
+        for (int bin = 1; bin < bins - 1; bin++) {
+            float left = spectrum[bin - 1];
+            float centre = spectrum[bin];
+            float right = spectrum[bin + 1];
+            if (centre > left && centre >= right) {
+                float curvature = left - 2.0f * centre + right;
+                peakPosition[bin] = bin + (curvature < 0.0f ? 0.5f * (left - right) / curvature : 0.0f);
+            } else {
+                peakPosition[bin] = -1.0f;
+            }
+        }
+
+        int candidates = static_cast<int>(partialCount.size());
+        float strongest = 0.0f;
+        while (static_cast<int>(detected.size()) < config.maxPolyphony) {
+            int best = -1;
+            float bestSalience = 0.0f;
+            for (int c = 0; c < candidates; c++) {
+                float salience = candidateSalience(c);
+                if (salience > bestSalience) {
+                    bestSalience = salience;
+                    best = c;
+                }
+            }
+            if (best < 0 || bestSalience < strongest * config.relativeThreshold) break;
+            if (detected.empty()) strongest = bestSalience;
+
+            int note = config.lowestNote + best;
+            detected.push_back(note);
+            if (!sounding[note]) {
+                float db = 20.0f * std::log10(bestSalience + 1e-9f);
+                pendingVelocity[note] = static_cast<unsigned char>(std::clamp(127.0f + 1.5f * db, 1.0f, 127.0f));
+            }
+
+            // Take most of the fundamental and half of each overtone out, so
+            // shared partials can still support other notes
+            const Partial* partial = &partials[static_cast<size_t>(best * config.harmonics)];
+            for (int h = 0; h < partialCount[best]; h++, partial++) {
+                float keep = h == 0 ? 0.1f : 0.5f;
+                for (int bin = partial->lowBin; bin <= partial->highBin; bin++) {
+                    residual[bin] *= keep;
+                }
+            }
+        }
+    }
+
+    std::bitset<128> present;
+    for (int note : detected) {
+        present[note] = true;
+    }
+
+    for (int note = config.lowestNote; note <= config.highestNote; note++) {
+        if (present[note]) {
+            missingFrames[note] = 0;
+            if (!sounding[note] && ++activeFrames[note] >= config.onFrames) {
+                sounding[note] = true;
+                unsigned char message[3] = {0x90, static_cast<unsigned char>(note), pendingVelocity[note]};
+                onNote(timeSeconds, message, sizeof(message));
+            }
+        } else {
+            activeFrames[note] = 0;
+            if (sounding[note] && ++missingFrames[note] >= config.offFrames) {
+                sounding[note] = false;
+                unsigned char message[3] = {0x80, static_cast<unsigned char>(note), 0};
+                onNote(timeSeconds, message, sizeof(message));
+            }
+        }
+    }
+}
\ No newline at end of file
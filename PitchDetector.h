@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Fft.h"
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Streaming polyphonic pitch estimation for mono audio. Each hop computes a
+// magnitude spectrum, then repeatedly picks the note whose harmonic series
+// carries the most energy and attenuates that series before looking for the
+// next one. A partial only counts when a spectral peak lies within a quarter
+// tone of it, so leakage from a neighbouring note does not. Per-note
+// hysteresis turns the frame estimates into MIDI note-on and note-off
+// messages. All buffers are sized up front.
+class PitchDetector {
+public:
+    struct Config {
+        int frameSize;            // FFT size (power of two)
+        int hopSize;
+        int lowestNote;
+        int highestNote;
+        int harmonics;            // partials summed per candidate
+        int maxPolyphony;
+        float relativeThreshold;  // candidates weaker than this fraction of the strongest are ignored
+        float silenceDb;          // frames quieter than this (RMS, dBFS) hold no notes
+        int onFrames;             // consecutive frames before a note starts
+        int offFrames;            // missing frames before a note stops
+    };
+
+    // Receives complete MIDI messages; timeSeconds is the position in the audio
+    using NoteCallback = std::function<void(double timeSeconds, const unsigned char* data, size_t size)>;
+
+    static Config defaultConfig();
+
+    PitchDetector(int sampleRate, const Config& config);
+
+    void process(const float* samples, size_t count, const NoteCallback& onNote);
+    // Releases every sounding note at the end of the input
+    void finish(const NoteCallback& onNote);
+
+    uint64_t getFramesAnalyzed() const;
+
+private:
+    struct Partial {
+        int lowBin;
+        int highBin;
+        float lowPosition;   // exact quarter-tone bounds in fractional bins
+        float highPosition;
+        float weight;
+    };
+
+    int sampleRate;
+    Config config;
+    Fft fft;
+
+    std::vector<float> frame;
+    size_t filled;
+    uint64_t framesAnalyzed;
+
+    std::vector<float> spectrum;
+    std::vector<float> residual;
+    std::vector<float> peakPosition;     // interpolated bin of each local maximum, -1 elsewhere
+    std::vector<Partial> partials;       // config.harmonics per candidate note
+    std::vector<int> partialCount;       // usable partials per candidate (below Nyquist)
+    std::vector<int> detected;
+
+    std::bitset<128> sounding;
+    std::vector<int> activeFrames;       // per MIDI note
+    std::vector<int> missingFrames;
+    std::vector<unsigned char> pendingVelocity;
+
+    void analyzeFrame(const NoteCallback& onNote);
+    float candidateSalience(int candidate) const;
+};
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "PluginHost.h"
+#include <dlfcn.h>
+#include <chrono>
+#include <iostream>
+
+PluginHost::PluginHost(const Limits& limits)
+    : limits(limits)
+{
+}
+
+PluginHost::~PluginHost() {
+    // Chains must be gone by now; they hold instances created by these libraries
+    for (auto& library : libraries) {
+        if (library->handle) {
+            dlclose(library->handle);
+        }
+    }
+}
+
+PluginHost::Limits PluginHost::defaultLimits() {
+    Limits limits;
+    limits.budgetNs = 500 * 1000; // 0.5 ms per batch
+    limits.maxConsecutiveOverruns = 8;
+    limits.resultCapacity = 32;
+    return limits;
+}
+
+bool PluginHost::load(const std::string& path, std::string& error) {
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        error = dlerror();
+        return false;
+    }
+
+    auto entry = reinterpret_cast<midimon_analyzer_entry_fn>(dlsym(handle, MIDIMON_ANALYZER_ENTRY_SYMBOL));
+    const midimon_analyzer_plugin* table = entry ? entry() : nullptr;
+
+    if (!table) {
+        error = "missing " + std::string(MIDIMON_ANALYZER_ENTRY_SYMBOL);
+    } else if (table->abi_version != MIDIMON_ANALYZER_ABI_VERSION) {
+        error = "ABI version " + std::to_string(table->abi_version) + ", expected " +
+                std::to_string(MIDIMON_ANALYZER_ABI_VERSION);
+    } else if (table->struct_size < sizeof(midimon_analyzer_plugin) || !table->create ||
+               !table->destroy || !table->process_batch) {
+        error = "incomplete plugin table";
+    }
+
+    if (!error.empty()) {
+        dlclose(handle);
+        return false;
+    }
+
+    auto library = std::make_unique<Library>();
+    library->path = path;
+    library->name = table->name ? table->name : path;
+    library->handle = handle;
+    library->table = table;
+
+    std::cout << "Loaded analyzer plugin: " << library->name << std::endl;
+    libraries.push_back(std::move(library));
+    return true;
+}
+
+size_t PluginHost::getPluginCount() const {
+    return libraries.size();
+}
+
+std::unique_ptr<PluginHost::Chain> PluginHost::createChain(const std::string& config) const {
+    std::unique_ptr<Chain> chain(new Chain());
+    chain->host = this;
+
+    for (const auto& library : libraries) {
+        if (library->disabled.load()) continue;
+
+        void* state = library->table->create(config.c_str());
+        if (!state) {
+            library->disable("create() failed");
+            continue;
+        }
+
+        Chain::Instance instance;
+        instance.library = library.get();
+        instance.state = state;
+        instance.consecutiveOverruns = 0;
+        instance.resultSlots.resize(limits.resultCapacity);
+        chain->instances.push_back(std::move(instance));
+    }
+
+    chain->results.reserve(chain->instances.size());
+    return chain;
+}
+
+std::vector<PluginHost::PluginStats> PluginHost::getStats() const {
+    std::vector<PluginStats> stats;
+    for (const auto& library : libraries) {
+        PluginStats s;
+        s.name = library->name;
+        s.calls = library->calls.load();
+        s.overruns = library->overruns.load();
+        s.meanMicros = s.calls > 0 ? static_cast<double>(library->totalNs.load()) / s.calls / 1000.0 : 0.0;
+        s.worstMicros = static_cast<double>(library->worstNs.load()) / 1000.0;
+        s.disabled = library->disabled.load();
+        {
+            std::lock_guard<std::mutex> lock(library->reasonMutex);
+            s.disabledReason = library->disabledReason;
+        }
+        stats.push_back(s);
+    }
+    return stats;
+}
+
+void PluginHost::Library::disable(const std::string& reason) {
+    if (disabled.exchange(true)) return;
+    {
+        std::lock_guard<std::mutex> lock(reasonMutex);
+        disabledReason = reason;
+    }
+    std::cerr << "Analyzer plugin " << name << " disabled: " << reason << std::endl;
+}
+
+PluginHost::Chain::~Chain() {
+    for (Instance& instance : instances) {
+        instance.library->table->destroy(instance.state);
+    }
+}
+
+const std::vector<PluginHost::Result>& PluginHost::Chain::getResults() const {
+    return results;
+}
+
+size_t PluginHost::Chain::run(const midimon_event* events, uint32_t eventCount, const midimon_note_state& state) {
+    results.clear();
+    size_t produced = 0;
+
+    for (Instance& instance : instances) {
+        Library& library = *instance.library;
+        if (library.disabled.load(std::memory_order_relaxed)) continue;
+
+        midimon_result_slots slots;
+        slots.entries = instance.resultSlots.data();
+        slots.capacity = static_cast<uint32_t>(instance.resultSlots.size());
+        slots.count = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        int status = library.table->process_batch(instance.state, events, eventCount, &state, &slots);
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        library.calls++;
+        library.totalNs += elapsed;
+        int64_t worst = library.worstNs.load();
+        while (elapsed > worst && !library.worstNs.compare_exchange_weak(worst, elapsed)) {
+        }
+
+        if (status != 0) {
+            library.disable("process_batch returned " + std::to_string(status));
+            continue;
+        }
+        if (slots.count > slots.capacity) {
+            library.disable("wrote " + std::to_string(slots.count) + " results into " +
+                            std::to_string(slots.capacity) + " slots");
+            continue;
+        }
+
+        if (elapsed > host->limits.budgetNs) {
+            library.overruns++;
+            if (++instance.consecutiveOverruns >= host->limits.maxConsecutiveOverruns) {
+                library.disable(std::to_string(instance.consecutiveOverruns) + " consecutive budget overruns");
+                continue;
+            }
+        } else {
+            instance.consecutiveOverruns = 0;
+        }
+
+        if (slots.count > 0) {
+            results.push_back({library.name.c_str(), slots.entries, slots.count});
+            produced += slots.count;
+        }
+    }
+
+    return produced;
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "AnalyzerPlugin.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Loads analyzer plugins (see AnalyzerPlugin.h) and runs them under a time
+// budget on each session's analysis thread. A plugin that keeps overrunning,
+// reports an error or overfills its result slots is disabled for all sessions.
+class PluginHost {
+    struct Library;
+
+public:
+    struct Limits {
+        int64_t budgetNs;              // per process_batch call
+        int maxConsecutiveOverruns;    // disable after this many in a row
+        uint32_t resultCapacity;       // annotation slots per instance
+    };
+
+    struct PluginStats {
+        std::string name;
+        uint64_t calls;
+        uint64_t overruns;
+        double meanMicros;
+        double worstMicros;
+        bool disabled;
+        std::string disabledReason;
+    };
+
+    struct Result {
+        const char* pluginName;
+        const midimon_annotation* annotations;
+        uint32_t count;
+    };
+
+    // Per-session plugin instances
+    class Chain {
+    public:
+        ~Chain();
+
+        // Runs every enabled plugin on one batch; returns the number of annotations
+        size_t run(const midimon_event* events, uint32_t eventCount, const midimon_note_state& state);
+        const std::vector<Result>& getResults() const;
+
+    private:
+        friend class PluginHost;
+
+        struct Instance {
+            Library* library;
+            void* state;
+            int consecutiveOverruns;
+            std::vector<midimon_annotation> resultSlots;
+        };
+
+        const PluginHost* host;
+        std::vector<Instance> instances;
+        std::vector<Result> results;
+    };
+
+    explicit PluginHost(const Limits& limits);
+    ~PluginHost();
+
+    static Limits defaultLimits();
+
+    bool load(const std::string& path, std::string& error);
+    size_t getPluginCount() const;
+    std::unique_ptr<Chain> createChain(const std::string& config) const;
+    std::vector<PluginStats> getStats() const;
+
+private:
+    struct Library {
+        std::string path;
+        std::string name;
+        void* handle;
+        const midimon_analyzer_plugin* table;
+
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> overruns{0};
+        std::atomic<int64_t> totalNs{0};
+        std::atomic<int64_t> worstNs{0};
+        std::atomic<bool> disabled{false};
+
+        mutable std::mutex reasonMutex;
+        std::string disabledReason;
+
+        void disable(const std::string& reason);
+    };
+
+    Limits limits;
+    std::vector<std::unique_ptr<Library>> libraries;
+};
\ No newline at end of file
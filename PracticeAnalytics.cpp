@@ -0,0 +1,379 @@
+#include "PracticeAnalytics.h"
+#include "FieldCodec.h"
+#include "OutputSink.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <set>
+#include <thread>
+
+const int PracticeAnalytics::VELOCITY_BINS;
+const int PracticeAnalytics::WINDOW_NOTES;
+const int64_t PracticeAnalytics::ONSET_WINDOW_NS;
+const int64_t PracticeAnalytics::IDLE_GAP_NS;
+const int64_t PracticeAnalytics::MAX_INTERVAL_NS;
+
+namespace {
+
+const char SUMMARY_FILE_MAGIC[8] = {'M', 'I', 'D', 'I', 'S', 'U', 'M', '\x01'};
+
+// Journals only grow, so a hash of the bytes already read identifies the file
+const size_t PREFIX_HASH_BYTES = 4096;
+
+} // namespace
+
+PracticeAnalytics::Metrics::Metrics()
+    : sessions(0)
+    , notes(0)
+    , activeNs(0)
+    , intervalPairs(0)
+    , timingDeviationSum(0.0)
+    , timingDeviationSquares(0.0)
+    , chordPatterns(0)
+{
+    std::fill(std::begin(velocities), std::end(velocities), 0u);
+    std::fill(std::begin(keyWindows), std::end(keyWindows), 0u);
+}
+
+void PracticeAnalytics::Metrics::merge(const Metrics& other) {
+    sessions += other.sessions;
+    notes += other.notes;
+    activeNs += other.activeNs;
+    intervalPairs += other.intervalPairs;
+    timingDeviationSum += other.timingDeviationSum;
+    timingDeviationSquares += other.timingDeviationSquares;
+    for (int i = 0; i < VELOCITY_BINS; i++) velocities[i] += other.velocities[i];
+    chordPatterns |= other.chordPatterns;
+    for (int i = 0; i < SessionCatalog::KEY_COUNT; i++) keyWindows[i] += other.keyWindows[i];
+}
+
+double PracticeAnalytics::Metrics::notesPerMinute() const {
+    return activeNs > 0 ? notes * 60e9 / activeNs : 0.0;
+}
+
+double PracticeAnalytics::Metrics::timingSpreadPercent() const {
+    if (intervalPairs < 2) return 0.0;
+    double mean = timingDeviationSum / intervalPairs;
+    double variance = std::max(timingDeviationSquares / intervalPairs - mean * mean, 0.0);
+    return (std::exp2(std::sqrt(variance)) - 1.0) * 100.0;
+}
+
+int PracticeAnalytics::Metrics::velocityPercentile(double fraction) const {
+    uint64_t total = 0;
+    for (uint64_t count : velocities) total += count;
+    if (total == 0) return 0;
+
+    uint64_t seen = 0;
+    for (int bin = 0; bin < VELOCITY_BINS; bin++) {
+        seen += velocities[bin];
+        if (seen >= fraction * total) return bin * (128 / VELOCITY_BINS) + 128 / VELOCITY_BINS / 2;
+    }
+    return 127;
+}
+
+int PracticeAnalytics::Metrics::chordTypes() const {
+    int count = 0;
+    for (uint64_t bits = chordPatterns; bits; bits &= bits - 1) count++;
+    return count;
+}
+
+int PracticeAnalytics::Metrics::keysPlayed() const {
+    return static_cast<int>(std::count_if(std::begin(keyWindows), std::end(keyWindows),
+                                          [](uint32_t windows) { return windows > 0; }));
+}
+
+PracticeAnalytics::SessionState::SessionState()
+    : lastEventNs(std::numeric_limits<int64_t>::min())
+    , lastOnsetNs(std::numeric_limits<int64_t>::min())
+    , lastIntervalNs(0)
+    , onsetStartNs(0)
+    , onsetOpen(false)
+    , windowNotes(0)
+{
+    std::fill(std::begin(windowProfile), std::end(windowProfile), 0u);
+}
+
+PracticeAnalytics::PracticeAnalytics(MusicTheoryEngine* theoryEngine, int workerCount)
+    : theoryEngine(theoryEngine)
+    , workerCount(std::max(workerCount, 1))
+{
+    int bit = 0;
+    for (const auto& pattern : theoryEngine->getChordPatterns()) {
+        if (bit < 64) patternBits[pattern.first] = bit++;
+    }
+}
+
+void PracticeAnalytics::setStudents(const std::map<std::string, std::string>& students) {
+    this->students = students;
+}
+
+void PracticeAnalytics::closeOnset(SessionState& session, ChordAnalyzer& chordAnalyzer) const {
+    session.onsetOpen = false;
+
+    std::bitset<128> chordNotes = session.heldNotes | session.onsetNotes;
+    session.onsetNotes.reset();
+    if (chordNotes.count() < 3) return;
+
+    std::vector<int> notes;
+    for (int note = 0; note < 128; note++) {
+        if (chordNotes[note]) notes.push_back(note);
+    }
+    // Only the chord type is kept, so the key passed in does not matter
+    std::string quality = chordAnalyzer.analyzeChord(notes, theoryEngine->getKeySignature(0)).chordQuality;
+    auto bit = patternBits.find(quality);
+    if (bit != patternBits.end()) {
+        session.metrics.chordPatterns |= uint64_t(1) << bit->second;
+    }
+}
+
+void PracticeAnalytics::noteOn(SessionState& session, ChordAnalyzer& chordAnalyzer, int64_t timeNs, int note,
+                               int velocity) const {
+    Metrics& metrics = session.metrics;
+    metrics.notes++;
+    metrics.velocities[velocity * VELOCITY_BINS / 128]++;
+
+    session.windowProfile[note % 12]++;
+    if (++session.windowNotes == WINDOW_NOTES) {
+        float profile[12];
+        std::copy(std::begin(session.windowProfile), std::end(session.windowProfile), profile);
+        const MusicTypes::KeySignature& key = theoryEngine->getKeySignature(theoryEngine->estimateKey(profile));
+        metrics.keyWindows[key.tonic + (key.isMajor ? 0 : 12)]++;
+        std::fill(std::begin(session.windowProfile), std::end(session.windowProfile), 0u);
+        session.windowNotes = 0;
+    }
+
+    if (session.onsetOpen && timeNs - session.onsetStartNs <= ONSET_WINDOW_NS) {
+        session.onsetNotes[note] = true;
+        return;
+    }
+    if (session.onsetOpen) closeOnset(session, chordAnalyzer);
+
+    // Successive intervals compared on a log scale; a deviation of one octave
+    // is a change of note value (e.g. quarters to eighths), not unsteadiness
+    int64_t interval = session.lastOnsetNs != std::numeric_limits<int64_t>::min() ? timeNs - session.lastOnsetNs : 0;
+    if (interval > 0 && interval <= MAX_INTERVAL_NS) {
+        if (session.lastIntervalNs > 0) {
+            double ratio = std::log2(static_cast<double>(interval) / session.lastIntervalNs);
+            double deviation = ratio - std::round(ratio);
+            metrics.intervalPairs++;
+            metrics.timingDeviationSum += deviation;
+            metrics.timingDeviationSquares += deviation * deviation;
+        }
+        session.lastIntervalNs = interval;
+    } else {
+        session.lastIntervalNs = 0;
+    }
+
+    session.lastOnsetNs = timeNs;
+    session.onsetStartNs = timeNs;
+    session.onsetOpen = true;
+    session.onsetNotes[note] = true;
+}
+
+size_t PracticeAnalytics::mapSessions(const JournalReader& journal, size_t from, int worker, int workers,
+                                      SessionMap& sessions, std::set<int32_t>& touched) const {
+    ChordAnalyzer chordAnalyzer(theoryEngine);
+
+    return journal.forEachRecord(from, [&](uint8_t type, int32_t sessionId, int64_t timeNs,
+                                    const unsigned char* payload, size_t payloadSize) {
+        if (static_cast<uint32_t>(sessionId) % workers != static_cast<uint32_t>(worker)) return;
+        touched.insert(sessionId);
+
+        if (type == OutputSink::SessionOpenRecord && payloadSize >= 10) {
+            SessionState& session = sessions[sessionId];
+            size_t nameLength = std::min<size_t>(payload[8] | payload[9] << 8, payloadSize - 10);
+            session.name.assign(reinterpret_cast<const char*>(payload + 10), nameLength);
+            session.metrics.sessions = 1;
+            return;
+        }
+
+        auto it = sessions.find(sessionId);
+        if (it == sessions.end()) {
+            // Opened before the journal began (e.g. a rotated file)
+            it = sessions.emplace(sessionId, SessionState()).first;
+            it->second.name = "session " + std::to_string(sessionId);
+            it->second.metrics.sessions = 1;
+        }
+        SessionState& session = it->second;
+
+        if (type == OutputSink::SessionCloseRecord) {
+            if (session.onsetOpen) closeOnset(session, chordAnalyzer);
+            return;
+        }
+        if (type != OutputSink::MidiRecord || payloadSize < 4 || payload[0] < 3) return;
+
+        if (session.lastEventNs != std::numeric_limits<int64_t>::min() && timeNs - session.lastEventNs <= IDLE_GAP_NS) {
+            session.metrics.activeNs += timeNs - session.lastEventNs;
+        }
+        session.lastEventNs = timeNs;
+
+        int status = payload[1] & 0xF0;
+        int note = payload[2] & 0x7F;
+        int velocity = payload[3] & 0x7F;
+        if (status == 0x90 && velocity > 0) {
+            session.heldNotes[note] = true;
+            noteOn(session, chordAnalyzer, timeNs, note, velocity);
+        } else if (status == 0x80 || status == 0x90) {
+            session.heldNotes[note] = false;
+        }
+    });
+}
+
+bool PracticeAnalytics::update(const std::string& journalPath, UpdateStats& stats, std::string& error) {
+    JournalReader journal;
+    if (!journal.open(QString::fromStdString(journalPath), error)) return false;
+
+    std::string summaryPath = journalPath + ".summary";
+    uint64_t offset = 0, hash = 0;
+    SessionMap sessions;
+    if (!readSummary(summaryPath, offset, hash, sessions) || offset > journal.getSize() ||
+        hash != prefixHash(journal, static_cast<size_t>(offset))) {
+        // Missing, damaged, or from a different journal: start over
+        offset = 0;
+        sessions.clear();
+    }
+    stats.cachedBytes = offset;
+
+    // Map: sessions are spread over the workers by id, each worker owning its share
+    std::vector<SessionMap> shares(workerCount);
+    for (auto& entry : sessions) {
+        shares[static_cast<uint32_t>(entry.first) % workerCount].insert(std::move(entry));
+    }
+    std::vector<std::set<int32_t>> touched(workerCount);
+    std::vector<std::thread> threads;
+    for (int worker = 1; worker < workerCount; worker++) {
+        threads.emplace_back([&, worker]() {
+            mapSessions(journal, static_cast<size_t>(offset), worker, workerCount, shares[worker], touched[worker]);
+        });
+    }
+    uint64_t end = mapSessions(journal, static_cast<size_t>(offset), 0, workerCount, shares[0], touched[0]);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    sessions.clear();
+    stats.newBytes = end - offset;
+    stats.sessionsUpdated = 0;
+    for (int worker = 0; worker < workerCount; worker++) {
+        stats.sessionsUpdated += static_cast<uint32_t>(touched[worker].size());
+        for (auto& entry : shares[worker]) {
+            sessions.insert(std::move(entry));
+        }
+    }
+
+    if (end != offset &&
+        !writeSummary(summaryPath, end, prefixHash(journal, static_cast<size_t>(end)), sessions, error)) {
+        return false;
+    }
+    journals[journalPath] = std::move(sessions);
+    return true;
+}
+
+std::vector<PracticeAnalytics::StudentMetrics> PracticeAnalytics::report() const {
+    // Reduce: merge every session's partial metrics into its student's
+    std::map<std::string, Metrics> byStudent;
+    for (const auto& journal : journals) {
+        for (const auto& entry : journal.second) {
+            auto student = students.find(entry.second.name);
+            byStudent[student != students.end() ? student->second : entry.second.name].merge(entry.second.metrics);
+        }
+    }
+
+    std::vector<StudentMetrics> result;
+    for (const auto& entry : byStudent) {
+        result.push_back({entry.first, entry.second});
+    }
+    return result;
+}
+
+uint64_t PracticeAnalytics::prefixHash(const JournalReader& journal, size_t length) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char* data = journal.getData();
+    for (size_t i = 0; data && i < std::min(length, PREFIX_HASH_BYTES); i++) {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool PracticeAnalytics::writeSummary(const std::string& path, uint64_t offset, uint64_t hash,
+                                     const SessionMap& sessions, std::string& error) {
+    std::vector<char> contents(SUMMARY_FILE_MAGIC, SUMMARY_FILE_MAGIC + sizeof(SUMMARY_FILE_MAGIC));
+    FieldWriter writer(contents);
+    writer.u64(offset);
+    writer.u64(hash);
+    writer.u32(static_cast<uint32_t>(sessions.size()));
+
+    for (const auto& entry : sessions) {
+        const SessionState& session = entry.second;
+        const Metrics& metrics = session.metrics;
+        writer.u32(static_cast<uint32_t>(entry.first));
+        writer.text(session.name);
+        writer.u32(metrics.sessions);
+        writer.u64(metrics.notes);
+        writer.u64(static_cast<uint64_t>(metrics.activeNs));
+        writer.u64(metrics.intervalPairs);
+        writer.f64(metrics.timingDeviationSum);
+        writer.f64(metrics.timingDeviationSquares);
+        for (uint64_t count : metrics.velocities) writer.u64(count);
+        writer.u64(metrics.chordPatterns);
+        for (uint32_t windows : metrics.keyWindows) writer.u32(windows);
+
+        writer.u64(static_cast<uint64_t>(session.lastEventNs));
+        writer.u64(static_cast<uint64_t>(session.lastOnsetNs));
+        writer.u64(static_cast<uint64_t>(session.lastIntervalNs));
+        writer.bits(session.heldNotes);
+        writer.bits(session.onsetNotes);
+        writer.u64(static_cast<uint64_t>(session.onsetStartNs));
+        writer.u8(session.onsetOpen ? 1 : 0);
+        for (uint32_t count : session.windowProfile) writer.u32(count);
+        writer.u32(session.windowNotes);
+    }
+
+    return FieldCodec::writeFileAtomically(path, contents, error);
+}
+
+bool PracticeAnalytics::readSummary(const std::string& path, uint64_t& offset, uint64_t& hash,
+                                    SessionMap& sessions) {
+    // A missing or unreadable summary just means starting from the top
+    std::vector<char> contents;
+    std::string error;
+    if (!FieldCodec::readFile(path, contents, error)) return false;
+
+    if (contents.size() < sizeof(SUMMARY_FILE_MAGIC) ||
+        std::memcmp(contents.data(), SUMMARY_FILE_MAGIC, sizeof(SUMMARY_FILE_MAGIC)) != 0) {
+        return false;
+    }
+
+    FieldReader reader(contents.data() + sizeof(SUMMARY_FILE_MAGIC), contents.size() - sizeof(SUMMARY_FILE_MAGIC));
+    offset = reader.u64();
+    hash = reader.u64();
+    uint32_t sessionCount = reader.u32();
+    for (uint32_t i = 0; i < sessionCount && reader.ok(); i++) {
+        int32_t sessionId = static_cast<int32_t>(reader.u32());
+        SessionState& session = sessions[sessionId];
+        Metrics& metrics = session.metrics;
+        session.name = reader.text();
+        metrics.sessions = reader.u32();
+        metrics.notes = reader.u64();
+        metrics.activeNs = static_cast<int64_t>(reader.u64());
+        metrics.intervalPairs = reader.u64();
+        metrics.timingDeviationSum = reader.f64();
+        metrics.timingDeviationSquares = reader.f64();
+        for (uint64_t& count : metrics.velocities) count = reader.u64();
+        metrics.chordPatterns = reader.u64();
+        for (uint32_t& windows : metrics.keyWindows) windows = reader.u32();
+
+        session.lastEventNs = static_cast<int64_t>(reader.u64());
+        session.lastOnsetNs = static_cast<int64_t>(reader.u64());
+        session.lastIntervalNs = static_cast<int64_t>(reader.u64());
+        session.heldNotes = reader.bits();
+        session.onsetNotes = reader.bits();
+        session.onsetStartNs = static_cast<int64_t>(reader.u64());
+        session.onsetOpen = reader.u8() != 0;
+        for (uint32_t& windowCount : session.windowProfile) windowCount = reader.u32();
+        session.windowNotes = reader.u32();
+    }
+    return reader.ok();
+}
\ No newline at end of file
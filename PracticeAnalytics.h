@@ -0,0 +1,111 @@
+#pragma once
+
+#include "ChordAnalyzer.h"
+#include "JournalReader.h"
+#include "MusicTheoryEngine.h"
+#include "SessionCatalog.h"
+#include <bitset>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Per-student practice metrics over binary journals. Updating a journal is a
+// map-reduce: worker threads each take a share of its sessions and fold their
+// new records into per-session partial metrics (map), which report() merges
+// per student (reduce). The partials, together with the journal offset they
+// cover, are cached in <journal>.summary, so an update only reads records
+// appended since the last one and a dashboard over hundreds of students opens
+// from the summaries alone.
+class PracticeAnalytics {
+public:
+    static const int VELOCITY_BINS = 16;
+
+    // Counts and sums only, so partial metrics merge exactly
+    struct Metrics {
+        uint32_t sessions;
+        uint64_t notes;
+        int64_t activeNs;                               // excluding pauses over IDLE_GAP_NS
+        uint64_t intervalPairs;
+        double timingDeviationSum;                      // see timingSpreadPercent()
+        double timingDeviationSquares;
+        uint64_t velocities[VELOCITY_BINS];
+        uint64_t chordPatterns;                         // bit per MusicTheoryEngine chord pattern, in name order
+        uint32_t keyWindows[SessionCatalog::KEY_COUNT];
+
+        Metrics();
+        void merge(const Metrics& other);
+
+        double notesPerMinute() const;
+        // Spread of successive inter-onset intervals after allowing for
+        // doubled and halved note values; 0 = metronomic
+        double timingSpreadPercent() const;
+        int velocityPercentile(double fraction) const;
+        int chordTypes() const;
+        int keysPlayed() const;                         // keys estimated for at least one window
+    };
+
+    struct StudentMetrics {
+        std::string student;
+        Metrics metrics;
+    };
+
+    struct UpdateStats {
+        uint64_t cachedBytes;     // journal bytes covered by the summary file
+        uint64_t newBytes;        // read in this update
+        uint32_t sessionsUpdated;
+    };
+
+    PracticeAnalytics(MusicTheoryEngine* theoryEngine, int workerCount);
+
+    // Session name -> student; other sessions are reported under their own name
+    void setStudents(const std::map<std::string, std::string>& students);
+
+    // Brings <journalPath>.summary up to date and adds the journal's sessions to the report
+    bool update(const std::string& journalPath, UpdateStats& stats, std::string& error);
+
+    // Sorted by student
+    std::vector<StudentMetrics> report() const;
+
+private:
+    static const int WINDOW_NOTES = 32;
+    static const int64_t ONSET_WINDOW_NS = 30000000;
+    static const int64_t IDLE_GAP_NS = 10000000000LL;
+    static const int64_t MAX_INTERVAL_NS = 2000000000;
+
+    // A session's partial metrics plus what is needed to continue it in the next segment
+    struct SessionState {
+        std::string name;
+        Metrics metrics;
+        int64_t lastEventNs;        // INT64_MIN = none yet
+        int64_t lastOnsetNs;
+        int64_t lastIntervalNs;     // 0 = none yet
+        std::bitset<128> heldNotes;
+        std::bitset<128> onsetNotes;
+        int64_t onsetStartNs;
+        bool onsetOpen;
+        uint32_t windowProfile[12];
+        uint32_t windowNotes;
+
+        SessionState();
+    };
+    using SessionMap = std::map<int32_t, SessionState>;
+
+    MusicTheoryEngine* theoryEngine;
+    int workerCount;
+    std::map<std::string, std::string> students;
+    std::map<std::string, int> patternBits;
+    std::map<std::string, SessionMap> journals;
+
+    // Folds the records from `from` on of one worker's sessions into their states; returns the end offset
+    size_t mapSessions(const JournalReader& journal, size_t from, int worker, int workers, SessionMap& sessions,
+                       std::set<int32_t>& touched) const;
+    void noteOn(SessionState& session, ChordAnalyzer& chordAnalyzer, int64_t timeNs, int note, int velocity) const;
+    void closeOnset(SessionState& session, ChordAnalyzer& chordAnalyzer) const;
+
+    static uint64_t prefixHash(const JournalReader& journal, size_t length);
+    static bool readSummary(const std::string& path, uint64_t& offset, uint64_t& hash, SessionMap& sessions);
+    static bool writeSummary(const std::string& path, uint64_t offset, uint64_t hash, const SessionMap& sessions,
+                             std::string& error);
+};
\ No newline at end of file
@@ -0,0 +1,1038 @@
+#include "RtpMidiSession.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+namespace {
+
+const quint32 APPLEMIDI_PROTOCOL_VERSION = 2;
+const unsigned char RTP_MIDI_PAYLOAD_TYPE = 0x61;
+const size_t MAX_JITTER_BUFFER_EVENTS = 4096;
+const int MAX_INVITE_ATTEMPTS = 12;
+const int FAST_SYNC_COUNT = 6;           // sync every tick until this many exchanges
+const int SLOW_SYNC_INTERVAL_TICKS = 10; // then every 10 housekeeping ticks
+const qint64 TICKS_PER_MS = 10;          // session clock runs at 10 kHz
+
+quint16 readU16(const unsigned char* p) {
+    return static_cast<quint16>((p[0] << 8) | p[1]);
+}
+
+quint32 readU32(const unsigned char* p) {
+    return (static_cast<quint32>(p[0]) << 24) | (static_cast<quint32>(p[1]) << 16) |
+           (static_cast<quint32>(p[2]) << 8) | static_cast<quint32>(p[3]);
+}
+
+qint64 readU64(const unsigned char* p) {
+    return static_cast<qint64>((static_cast<quint64>(readU32(p)) << 32) | readU32(p + 4));
+}
+
+void writeU16(std::vector<unsigned char>& out, quint16 value) {
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+void writeU32(std::vector<unsigned char>& out, quint32 value) {
+    writeU16(out, static_cast<quint16>(value >> 16));
+    writeU16(out, static_cast<quint16>(value));
+}
+
+void writeU64(std::vector<unsigned char>& out, qint64 value) {
+    quint64 v = static_cast<quint64>(value);
+    writeU32(out, static_cast<quint32>(v >> 32));
+    writeU32(out, static_cast<quint32>(v));
+}
+
+quint32 randomWord() {
+    static std::mt19937 generator{std::random_device{}()};
+    return generator();
+}
+
+} // namespace
+
+RtpMidiSession::RtpMidiSession(const QString& sessionName, QObject* parent)
+    : QObject(parent)
+    , sessionName(sessionName)
+    , localSsrc(randomWord())
+    , controlSocket(new QUdpSocket(this))
+    , dataSocket(new QUdpSocket(this))
+    , playoutTimer(new QTimer(this))
+    , housekeepingTimer(new QTimer(this))
+    , testPatternTimer(new QTimer(this))
+    , jitterConfig(defaultJitterConfig())
+    , nextPeerId(1)
+    , testPatternStep(0)
+    , housekeepingTicks(0)
+    , socketsBound(false)
+    , sendSequence(static_cast<quint16>(randomWord()))
+    , checkpointSequence(0)
+{
+    checkpointSequence = sendSequence;
+    std::memset(sendNoteVelocity, 0, sizeof(sendNoteVelocity));
+    std::memset(sendNoteOffSequence, 0, sizeof(sendNoteOffSequence));
+    sessionClock.start();
+
+    playoutTimer->setSingleShot(true);
+    playoutTimer->setTimerType(Qt::PreciseTimer);
+
+    connect(controlSocket, &QUdpSocket::readyRead, this, &RtpMidiSession::readControlSocket);
+    connect(dataSocket, &QUdpSocket::readyRead, this, &RtpMidiSession::readDataSocket);
+    connect(playoutTimer, &QTimer::timeout, this, &RtpMidiSession::playoutDueEvents);
+    connect(housekeepingTimer, &QTimer::timeout, this, &RtpMidiSession::housekeeping);
+    connect(testPatternTimer, &QTimer::timeout, this, &RtpMidiSession::sendTestPatternStep);
+}
+
+RtpMidiSession::~RtpMidiSession() {
+    endSession();
+}
+
+RtpMidiSession::JitterConfig RtpMidiSession::defaultJitterConfig() {
+    JitterConfig config;
+    config.mode = JitterMode::Adaptive;
+    config.fixedDelayMs = 5.0;
+    config.minDelayMs = 1.0;
+    config.maxDelayMs = 40.0;
+    return config;
+}
+
+void RtpMidiSession::setJitterConfig(const JitterConfig& config) {
+    jitterConfig = config;
+}
+
+qint64 RtpMidiSession::now() const {
+    return sessionClock.nsecsElapsed() / 100000; // 100 us ticks
+}
+
+bool RtpMidiSession::bindSockets(quint16 controlPort) {
+    if (socketsBound) return true;
+
+    if (!controlSocket->bind(QHostAddress::AnyIPv4, controlPort)) {
+        emit sessionError("RTP-MIDI control port bind failed: " + controlSocket->errorString());
+        return false;
+    }
+
+    // The data port is always the control port + 1; ephemeral sessions take any free pair
+    quint16 dataPort = controlPort == 0 ? 0 : static_cast<quint16>(controlPort + 1);
+    if (!dataSocket->bind(QHostAddress::AnyIPv4, dataPort)) {
+        emit sessionError("RTP-MIDI data port bind failed: " + dataSocket->errorString());
+        controlSocket->close();
+        return false;
+    }
+
+    socketsBound = true;
+    housekeepingTimer->start(1000);
+    return true;
+}
+
+bool RtpMidiSession::listen(quint16 controlPort) {
+    if (!bindSockets(controlPort)) return false;
+    std::cout << "RTP-MIDI session \"" << sessionName.toStdString() << "\" listening on ports "
+              << controlSocket->localPort() << "/" << dataSocket->localPort() << std::endl;
+    return true;
+}
+
+void RtpMidiSession::invite(const QHostAddress& address, quint16 controlPort) {
+    if (!bindSockets(0)) return;
+
+    Peer pending{};
+    pending.token = randomWord();
+    pending.address = address;
+    pending.controlPort = controlPort;
+    pending.dataPort = static_cast<quint16>(controlPort + 1);
+    pending.initiatedByUs = true;
+
+    auto& stored = pendingInvites[pending.token];
+    stored = pending;
+    sendInvitation(stored, false);
+}
+
+void RtpMidiSession::endSession() {
+    for (auto& entry : peers) {
+        if (entry.second.established) {
+            sendBye(entry.second);
+        }
+    }
+    while (!peers.empty()) {
+        removePeer(peers.begin()->first);
+    }
+    pendingInvites.clear();
+    testPatternTimer->stop();
+}
+
+int RtpMidiSession::peerCount() const {
+    int count = 0;
+    for (const auto& entry : peers) {
+        if (entry.second.established) count++;
+    }
+    return count;
+}
+
+std::vector<RtpMidiSession::PeerStats> RtpMidiSession::getPeerStats() const {
+    std::vector<PeerStats> stats;
+    for (const auto& entry : peers) {
+        const Peer& peer = entry.second;
+        PeerStats s;
+        s.name = peer.name;
+        s.packetsReceived = peer.packetsReceived;
+        s.packetsLost = peer.packetsLost;
+        s.eventsRecovered = peer.eventsRecovered;
+        s.lateEvents = peer.lateEvents;
+        s.jitterMs = peer.jitterTicks / TICKS_PER_MS;
+        s.playoutDelayMs = playoutDelayTicks(peer) / TICKS_PER_MS;
+        s.roundTripMs = static_cast<double>(peer.roundTrip) / TICKS_PER_MS;
+        stats.push_back(s);
+    }
+    return stats;
+}
+
+RtpMidiSession::Peer* RtpMidiSession::findPeerById(int peerId) {
+    for (auto& entry : peers) {
+        if (entry.second.id == peerId) return &entry.second;
+    }
+    return nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// Socket input
+// ---------------------------------------------------------------------------
+
+void RtpMidiSession::readControlSocket() {
+    while (controlSocket->hasPendingDatagrams()) {
+        datagram.resize(static_cast<size_t>(std::max<qint64>(controlSocket->pendingDatagramSize(), 1)));
+        QHostAddress sender;
+        quint16 senderPort = 0;
+        qint64 size = controlSocket->readDatagram(datagram.data(), datagram.size(), &sender, &senderPort);
+        if (size < 4) continue;
+
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(datagram.data());
+        if (data[0] == 0xFF && data[1] == 0xFF) {
+            handleExchangePacket(controlSocket, data, static_cast<size_t>(size), sender, senderPort);
+        }
+    }
+}
+
+void RtpMidiSession::readDataSocket() {
+    while (dataSocket->hasPendingDatagrams()) {
+        datagram.resize(static_cast<size_t>(std::max<qint64>(dataSocket->pendingDatagramSize(), 1)));
+        QHostAddress sender;
+        quint16 senderPort = 0;
+        qint64 size = dataSocket->readDatagram(datagram.data(), datagram.size(), &sender, &senderPort);
+        if (size < 4) continue;
+
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(datagram.data());
+        if (data[0] == 0xFF && data[1] == 0xFF) {
+            handleExchangePacket(dataSocket, data, static_cast<size_t>(size), sender, senderPort);
+        } else if ((data[0] & 0xC0) == 0x80) {
+            handleRtpPacket(data, static_cast<size_t>(size));
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// AppleMIDI exchange packets (IN / OK / NO / BY / CK / RS)
+// ---------------------------------------------------------------------------
+
+void RtpMidiSession::handleExchangePacket(QUdpSocket* socket, const unsigned char* data, size_t size,
+                                          const QHostAddress& sender, quint16 senderPort) {
+    const char c0 = static_cast<char>(data[2]);
+    const char c1 = static_cast<char>(data[3]);
+
+    if (c0 == 'C' && c1 == 'K') {
+        handleClockSync(data, size, sender, senderPort);
+        return;
+    }
+
+    if (c0 == 'R' && c1 == 'S') {
+        if (size >= 10) {
+            handleReceiverFeedback(readU32(data + 4), readU16(data + 8));
+        }
+        return;
+    }
+
+    // Invitation family: version(4) token(4) ssrc(4) [name\0]
+    if (size < 16) return;
+    quint32 token = readU32(data + 8);
+    quint32 ssrc = readU32(data + 12);
+    QString name;
+    if (size > 16) {
+        size_t nameLength = strnlen(reinterpret_cast<const char*>(data + 16), size - 16);
+        name = QString::fromUtf8(reinterpret_cast<const char*>(data + 16), static_cast<qsizetype>(nameLength));
+    }
+
+    if (c0 == 'I' && c1 == 'N') {
+        handleInvitation(socket, token, ssrc, name, sender, senderPort);
+    } else if (c0 == 'O' && c1 == 'K') {
+        handleInvitationAccepted(socket, token, ssrc, name);
+    } else if (c0 == 'N' && c1 == 'O') {
+        if (pendingInvites.erase(token) > 0) {
+            emit sessionError("RTP-MIDI invitation rejected by " + sender.toString());
+        }
+    } else if (c0 == 'B' && c1 == 'Y') {
+        removePeer(ssrc);
+    }
+}
+
+void RtpMidiSession::handleInvitation(QUdpSocket* socket, quint32 token, quint32 ssrc, const QString& name,
+                                      const QHostAddress& sender, quint16 senderPort) {
+    auto it = peers.find(ssrc);
+    if (it == peers.end()) {
+        Peer peer{};
+        peer.id = nextPeerId++;
+        peer.ssrc = ssrc;
+        peer.token = token;
+        peer.name = name.isEmpty() ? sender.toString() : name;
+        peer.address = sender;
+        peer.controlPort = senderPort;
+        peer.dataPort = static_cast<quint16>(senderPort + 1);
+        it = peers.emplace(ssrc, peer).first;
+    }
+
+    Peer& peer = it->second;
+    sendExchange(socket, "OK", token, sender, senderPort, true);
+
+    if (socket == controlSocket) {
+        peer.controlPort = senderPort;
+        peer.controlAccepted = true;
+    } else {
+        peer.dataPort = senderPort;
+        if (!peer.established) {
+            peer.established = true;
+            std::cout << "RTP-MIDI participant joined: " << peer.name.toStdString() << std::endl;
+            emit peerConnected(peer.id, peer.name);
+        }
+    }
+}
+
+void RtpMidiSession::handleInvitationAccepted(QUdpSocket* socket, quint32 token, quint32 ssrc, const QString& name) {
+    auto it = pendingInvites.find(token);
+    if (it == pendingInvites.end()) return;
+
+    Peer& pending = it->second;
+    pending.ssrc = ssrc;
+    if (!name.isEmpty()) pending.name = name;
+
+    if (socket == controlSocket) {
+        // Control channel accepted - invite on the data port next
+        pending.controlAccepted = true;
+        pending.inviteAttempts = 0;
+        sendInvitation(pending, true);
+        return;
+    }
+
+    Peer peer = pending;
+    pendingInvites.erase(it);
+
+    peer.id = nextPeerId++;
+    peer.established = true;
+    if (peer.name.isEmpty()) peer.name = peer.address.toString();
+
+    Peer& stored = peers[ssrc];
+    stored = peer;
+    std::cout << "RTP-MIDI session established with " << stored.name.toStdString() << std::endl;
+    emit peerConnected(stored.id, stored.name);
+
+    // Start clock synchronisation right away
+    sendClockSync(stored, 0, now(), 0, 0);
+}
+
+void RtpMidiSession::handleClockSync(const unsigned char* data, size_t size,
+                                     const QHostAddress& sender, quint16 senderPort) {
+    if (size < 36) return;
+
+    quint32 ssrc = readU32(data + 4);
+    quint8 count = data[8];
+    qint64 ts1 = readU64(data + 12);
+    qint64 ts2 = readU64(data + 20);
+    qint64 ts3 = readU64(data + 28);
+
+    auto it = peers.find(ssrc);
+    if (it == peers.end()) return;
+    Peer& peer = it->second;
+    peer.address = sender;
+    peer.dataPort = senderPort;
+
+    qint64 offset = 0;
+    switch (count) {
+        case 0:
+            // Responder: answer with our receive time
+            sendClockSync(peer, 1, ts1, now(), 0);
+            return;
+        case 1: {
+            // Initiator: ts1/ts3 are ours, ts2 is the responder's clock
+            ts3 = now();
+            sendClockSync(peer, 2, ts1, ts2, ts3);
+            peer.roundTrip = ts3 - ts1;
+            offset = ts2 - (ts1 + ts3) / 2;
+            break;
+        }
+        case 2:
+            // Responder: ts1/ts3 are the initiator's clock, ts2 is ours
+            peer.roundTrip = ts3 - ts1;
+            offset = (ts1 + ts3) / 2 - ts2;
+            break;
+        default:
+            return;
+    }
+
+    if (!peer.clockSynced) {
+        peer.clockOffset = offset;
+        peer.clockSynced = true;
+        peer.offsetKnown = true;
+    } else {
+        // Smooth subsequent measurements so playout order never jumps
+        peer.clockOffset += (offset - peer.clockOffset) / 8;
+    }
+    peer.syncCount++;
+}
+
+void RtpMidiSession::handleReceiverFeedback(quint32 ssrc, quint16 sequence) {
+    auto it = peers.find(ssrc);
+    if (it == peers.end()) return;
+
+    it->second.haveRemoteAck = true;
+    it->second.remoteAckSequence = sequence;
+    advanceCheckpoint();
+}
+
+void RtpMidiSession::advanceCheckpoint() {
+    // The journal may only forget what every participant has acknowledged
+    bool haveAny = false;
+    quint16 oldest = 0;
+    for (const auto& entry : peers) {
+        const Peer& peer = entry.second;
+        if (!peer.established) continue;
+        if (!peer.haveRemoteAck) return;
+        if (!haveAny || static_cast<qint16>(peer.remoteAckSequence - oldest) < 0) {
+            oldest = peer.remoteAckSequence;
+            haveAny = true;
+        }
+    }
+    if (!haveAny || static_cast<qint16>(oldest - checkpointSequence) <= 0) return;
+
+    checkpointSequence = oldest;
+    for (int channel = 0; channel < 16; channel++) {
+        if (sendNoteOffs[channel].none()) continue;
+        for (int note = 0; note < 128; note++) {
+            if (sendNoteOffs[channel][note] &&
+                static_cast<qint16>(checkpointSequence - sendNoteOffSequence[channel][note]) >= 0) {
+                sendNoteOffs[channel][note] = false;
+            }
+        }
+    }
+}
+
+void RtpMidiSession::sendExchange(QUdpSocket* socket, const char command[2], quint32 token,
+                                  const QHostAddress& address, quint16 port, bool includeName) {
+    std::vector<unsigned char> packet;
+    packet.reserve(64);
+    packet.push_back(0xFF);
+    packet.push_back(0xFF);
+    packet.push_back(static_cast<unsigned char>(command[0]));
+    packet.push_back(static_cast<unsigned char>(command[1]));
+    writeU32(packet, APPLEMIDI_PROTOCOL_VERSION);
+    writeU32(packet, token);
+    writeU32(packet, localSsrc);
+    if (includeName) {
+        QByteArray name = sessionName.toUtf8();
+        packet.insert(packet.end(), name.constData(), name.constData() + name.size());
+        packet.push_back(0);
+    }
+    socket->writeDatagram(reinterpret_cast<const char*>(packet.data()), static_cast<qint64>(packet.size()), address, port);
+}
+
+void RtpMidiSession::sendInvitation(Peer& pending, bool dataPort) {
+    pending.inviteAttempts++;
+    if (dataPort) {
+        sendExchange(dataSocket, "IN", pending.token, pending.address, pending.dataPort, true);
+    } else {
+        sendExchange(controlSocket, "IN", pending.token, pending.address, pending.controlPort, true);
+    }
+}
+
+void RtpMidiSession::sendClockSync(Peer& peer, quint8 count, qint64 ts1, qint64 ts2, qint64 ts3) {
+    std::vector<unsigned char> packet;
+    packet.reserve(36);
+    packet.push_back(0xFF);
+    packet.push_back(0xFF);
+    packet.push_back('C');
+    packet.push_back('K');
+    writeU32(packet, localSsrc);
+    packet.push_back(count);
+    packet.push_back(0);
+    packet.push_back(0);
+    packet.push_back(0);
+    writeU64(packet, ts1);
+    writeU64(packet, ts2);
+    writeU64(packet, ts3);
+    dataSocket->writeDatagram(reinterpret_cast<const char*>(packet.data()), static_cast<qint64>(packet.size()),
+                              peer.address, peer.dataPort);
+}
+
+void RtpMidiSession::sendReceiverFeedback(Peer& peer) {
+    std::vector<unsigned char> packet;
+    packet.reserve(12);
+    packet.push_back(0xFF);
+    packet.push_back(0xFF);
+    packet.push_back('R');
+    packet.push_back('S');
+    writeU32(packet, localSsrc);
+    writeU16(packet, peer.lastReceivedSequence);
+    writeU16(packet, 0);
+    controlSocket->writeDatagram(reinterpret_cast<const char*>(packet.data()), static_cast<qint64>(packet.size()),
+                                 peer.address, peer.controlPort);
+    peer.feedbackPending = false;
+}
+
+void RtpMidiSession::sendBye(Peer& peer) {
+    sendExchange(controlSocket, "BY", peer.token, peer.address, peer.controlPort, false);
+}
+
+void RtpMidiSession::removePeer(quint32 ssrc) {
+    auto it = peers.find(ssrc);
+    if (it == peers.end()) return;
+
+    Peer& peer = it->second;
+    int peerId = peer.id;
+    QString name = peer.name;
+    bool wasEstablished = peer.established;
+
+    // Drop anything still waiting for playout, then release held notes
+    jitterBuffer.erase(std::remove_if(jitterBuffer.begin(), jitterBuffer.end(),
+                                      [peerId](const BufferedEvent& e) { return e.peerId == peerId; }),
+                       jitterBuffer.end());
+    releaseHeldNotes(peer);
+
+    peers.erase(it);
+    rescheduleTimer();
+
+    if (wasEstablished) {
+        std::cout << "RTP-MIDI participant left: " << name.toStdString() << std::endl;
+        emit peerDisconnected(peerId, name);
+    }
+    advanceCheckpoint();
+}
+
+void RtpMidiSession::releaseHeldNotes(Peer& peer) {
+    for (int channel = 0; channel < 16; channel++) {
+        if (peer.notesOn[channel].none()) continue;
+        for (int note = 0; note < 128; note++) {
+            if (peer.notesOn[channel][note]) {
+                std::vector<unsigned char> noteOff = {static_cast<unsigned char>(0x80 | channel),
+                                                      static_cast<unsigned char>(note), 0};
+                emit midiReceived(peer.id, 0.0, noteOff);
+            }
+        }
+        peer.notesOn[channel].reset();
+    }
+}
+
+void RtpMidiSession::housekeeping() {
+    housekeepingTicks++;
+
+    // Retry outstanding invitations
+    for (auto it = pendingInvites.begin(); it != pendingInvites.end();) {
+        Peer& pending = it->second;
+        if (pending.inviteAttempts >= MAX_INVITE_ATTEMPTS) {
+            emit sessionError("RTP-MIDI invitation to " + pending.address.toString() + " timed out");
+            it = pendingInvites.erase(it);
+            continue;
+        }
+        sendInvitation(pending, pending.controlAccepted);
+        ++it;
+    }
+
+    for (auto& entry : peers) {
+        Peer& peer = entry.second;
+        if (!peer.established) continue;
+
+        // The initiator drives clock sync: a quick burst, then every 10 seconds
+        if (peer.initiatedByUs &&
+            (peer.syncCount < FAST_SYNC_COUNT || housekeepingTicks % SLOW_SYNC_INTERVAL_TICKS == 0)) {
+            sendClockSync(peer, 0, now(), 0, 0);
+        }
+
+        if (peer.feedbackPending) {
+            sendReceiverFeedback(peer);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// RTP-MIDI payload
+// ---------------------------------------------------------------------------
+
+int RtpMidiSession::midiDataLength(unsigned char status) {
+    switch (status & 0xF0) {
+        case 0x80: case 0x90: case 0xA0: case 0xB0: case 0xE0:
+            return 2;
+        case 0xC0: case 0xD0:
+            return 1;
+        default:
+            break;
+    }
+    switch (status) {
+        case 0xF1: case 0xF3: return 1;
+        case 0xF2: return 2;
+        default: return 0;
+    }
+}
+
+void RtpMidiSession::handleRtpPacket(const unsigned char* data, size_t size) {
+    if (size < 13) return;
+    if ((data[1] & 0x7F) != RTP_MIDI_PAYLOAD_TYPE) return;
+
+    quint16 sequence = readU16(data + 2);
+    quint32 timestamp = readU32(data + 4);
+    quint32 ssrc = readU32(data + 8);
+
+    auto it = peers.find(ssrc);
+    if (it == peers.end() || !it->second.established) return;
+    Peer& peer = it->second;
+
+    qint64 arrival = now();
+
+    bool packetsMissing = false;
+    if (peer.haveSequence) {
+        qint16 gap = static_cast<qint16>(sequence - peer.expectedSequence);
+        if (gap < 0) return; // duplicate or too late to matter
+        if (gap > 0) {
+            peer.packetsLost += static_cast<quint64>(gap);
+            packetsMissing = true;
+        }
+    }
+    peer.haveSequence = true;
+    peer.expectedSequence = static_cast<quint16>(sequence + 1);
+    peer.lastReceivedSequence = sequence;
+    peer.feedbackPending = true;
+    peer.packetsReceived++;
+
+    // MIDI command section header: B J Z P LEN
+    size_t pos = 12;
+    unsigned char header = data[pos++];
+    bool longHeader = header & 0x80;
+    bool hasJournal = header & 0x40;
+    bool firstHasDelta = header & 0x20;
+    size_t length = header & 0x0F;
+    if (longHeader) {
+        if (pos >= size) return;
+        length = (length << 8) | data[pos++];
+    }
+    if (pos + length > size) return;
+
+    qint64 packetPlayout = playoutTimeFor(peer, timestamp, arrival);
+
+    // The journal describes the stream before this packet, so repair first
+    if (packetsMissing && hasJournal) {
+        parseRecoveryJournal(peer, data + pos + length, size - pos - length, packetPlayout);
+    }
+
+    parseCommandList(peer, data + pos, length, firstHasDelta, timestamp, arrival);
+    rescheduleTimer();
+}
+
+void RtpMidiSession::parseCommandList(Peer& peer, const unsigned char* data, size_t size, bool firstHasDelta,
+                                      quint32 timestamp, qint64 arrival) {
+    size_t pos = 0;
+    unsigned char runningStatus = 0;
+    quint32 eventTimestamp = timestamp;
+    bool first = true;
+    unsigned char message[3];
+
+    while (pos < size) {
+        if (!first || firstHasDelta) {
+            quint32 delta = 0;
+            for (int i = 0; i < 4 && pos < size; i++) {
+                unsigned char b = data[pos++];
+                delta = (delta << 7) | (b & 0x7F);
+                if (!(b & 0x80)) break;
+            }
+            eventTimestamp += delta;
+            if (pos >= size) break;
+        }
+        first = false;
+
+        unsigned char status;
+        if (data[pos] & 0x80) {
+            status = data[pos++];
+        } else if (runningStatus) {
+            status = runningStatus;
+        } else {
+            return; // data byte without status - malformed
+        }
+
+        qint64 playoutTime = playoutTimeFor(peer, eventTimestamp, arrival);
+
+        if (status == 0xF0) {
+            // SysEx runs to F7 (or a segment boundary); running status is cancelled
+            size_t end = pos;
+            while (end < size && data[end] != 0xF7 && data[end] != 0xF0 && data[end] != 0xF4) end++;
+            std::vector<unsigned char> sysex;
+            sysex.reserve(end - pos + 2);
+            sysex.push_back(0xF0);
+            sysex.insert(sysex.end(), data + pos, data + end);
+            if (end < size && data[end] == 0xF7) sysex.push_back(0xF7);
+            schedule(peer.id, playoutTime, sysex.data(), sysex.size());
+            pos = end < size ? end + 1 : end;
+            runningStatus = 0;
+            continue;
+        }
+
+        int dataBytes = midiDataLength(status);
+        if (pos + static_cast<size_t>(dataBytes) > size) return;
+
+        message[0] = status;
+        for (int i = 0; i < dataBytes; i++) {
+            message[i + 1] = data[pos + i];
+        }
+        pos += dataBytes;
+
+        if (status < 0xF0) {
+            runningStatus = status;
+        } else if (status < 0xF8) {
+            runningStatus = 0; // system common cancels running status, realtime does not
+        }
+
+        trackReceivedNote(peer, message, dataBytes + 1);
+        schedule(peer.id, playoutTime, message, dataBytes + 1);
+    }
+}
+
+void RtpMidiSession::parseRecoveryJournal(Peer& peer, const unsigned char* data, size_t size, qint64 playoutTime) {
+    if (size < 3) return;
+
+    // Journal header: S Y A H TOTCHAN | checkpoint sequence
+    bool hasSystemJournal = data[0] & 0x40;
+    bool hasChannelJournals = data[0] & 0x20;
+    int totalChannels = (data[0] & 0x0F) + 1;
+    size_t pos = 3;
+
+    if (hasSystemJournal) {
+        if (pos + 2 > size) return;
+        size_t systemLength = ((data[pos] & 0x03) << 8) | data[pos + 1];
+        pos += systemLength;
+    }
+    if (!hasChannelJournals) return;
+
+    for (int c = 0; c < totalChannels && pos + 3 <= size; c++) {
+        int channel = (data[pos] >> 3) & 0x0F;
+        size_t channelLength = ((data[pos] & 0x03) << 8) | data[pos + 1];
+        unsigned char toc = data[pos + 2];
+        if (channelLength < 3 || pos + channelLength > size) return;
+
+        const unsigned char* chapter = data + pos + 3;
+        const unsigned char* channelEnd = data + pos + channelLength;
+
+        // Skip chapters P, C, M and W to reach chapter N
+        if (toc & 0x80) chapter += 3;                                   // P: program change
+        if ((toc & 0x40) && chapter < channelEnd) {                     // C: controllers
+            chapter += 1 + 2 * ((chapter[0] & 0x7F) + 1);
+        }
+        if ((toc & 0x20) && chapter + 2 <= channelEnd) {                // M: parameter system
+            chapter += ((chapter[0] & 0x03) << 8) | chapter[1];
+        }
+        if (toc & 0x10) chapter += 2;                                   // W: pitch wheel
+
+        if ((toc & 0x08) && chapter < channelEnd) {
+            recoverChapterN(peer, channel, chapter, static_cast<size_t>(channelEnd - chapter), playoutTime);
+        }
+
+        pos += channelLength;
+    }
+}
+
+void RtpMidiSession::recoverChapterN(Peer& peer, int channel, const unsigned char* data, size_t size,
+                                     qint64 playoutTime) {
+    if (size < 2) return;
+
+    int logCount = data[0] & 0x7F;
+    int low = data[1] >> 4;
+    int high = data[1] & 0x0F;
+    if (logCount == 127 && low == 15 && high == 0) logCount = 128;
+
+    size_t pos = 2;
+    unsigned char message[3];
+
+    for (int i = 0; i < logCount && pos + 2 <= size; i++, pos += 2) {
+        int note = data[pos] & 0x7F;
+        int velocity = data[pos + 1] & 0x7F;
+        if (velocity == 0 || peer.notesOn[channel][note]) continue;
+
+        message[0] = static_cast<unsigned char>(0x90 | channel);
+        message[1] = static_cast<unsigned char>(note);
+        message[2] = static_cast<unsigned char>(velocity);
+        trackReceivedNote(peer, message, 3);
+        schedule(peer.id, playoutTime, message, 3);
+        peer.eventsRecovered++;
+    }
+
+    if (low > high) return; // no OFFBITS
+
+    for (int octet = low; octet <= high && pos < size; octet++, pos++) {
+        for (int bit = 0; bit < 8; bit++) {
+            int note = octet * 8 + bit;
+            if (!(data[pos] & (0x80 >> bit)) || !peer.notesOn[channel][note]) continue;
+
+            message[0] = static_cast<unsigned char>(0x80 | channel);
+            message[1] = static_cast<unsigned char>(note);
+            message[2] = 0;
+            trackReceivedNote(peer, message, 3);
+            schedule(peer.id, playoutTime, message, 3);
+            peer.eventsRecovered++;
+        }
+    }
+}
+
+void RtpMidiSession::trackReceivedNote(Peer& peer, const unsigned char* data, size_t size) {
+    if (size < 3) return;
+    int channel = data[0] & 0x0F;
+    int type = data[0] & 0xF0;
+
+    if (type == 0x90 && data[2] > 0) {
+        peer.notesOn[channel][data[1] & 0x7F] = true;
+    } else if (type == 0x80 || type == 0x90) {
+        peer.notesOn[channel][data[1] & 0x7F] = false;
+    } else if (type == 0xB0 && (data[1] == 120 || data[1] == 123)) {
+        peer.notesOn[channel].reset();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Jitter buffer
+// ---------------------------------------------------------------------------
+
+double RtpMidiSession::playoutDelayTicks(const Peer& peer) const {
+    if (jitterConfig.mode == JitterMode::Fixed) {
+        return jitterConfig.fixedDelayMs * TICKS_PER_MS;
+    }
+    double minTicks = jitterConfig.minDelayMs * TICKS_PER_MS;
+    double maxTicks = jitterConfig.maxDelayMs * TICKS_PER_MS;
+    return std::clamp(minTicks + 3.0 * peer.jitterTicks, minTicks, maxTicks);
+}
+
+qint64 RtpMidiSession::playoutTimeFor(Peer& peer, quint32 timestamp, qint64 arrival) {
+    if (!peer.offsetKnown) {
+        // No clock sync yet: anchor the sender clock to this arrival
+        peer.clockOffset = static_cast<qint64>(timestamp) - arrival;
+        peer.offsetKnown = true;
+    }
+
+    // Unwrap the 32-bit RTP timestamp around the sender's current time
+    qint64 remoteNow = arrival + peer.clockOffset;
+    qint32 diff = static_cast<qint32>(timestamp - static_cast<quint32>(remoteNow));
+    qint64 sentAt = arrival + diff;
+
+    // RFC 3550 interarrival jitter
+    qint64 transit = arrival - sentAt;
+    if (peer.haveTransit) {
+        double d = std::fabs(static_cast<double>(transit - peer.lastTransit));
+        peer.jitterTicks += (d - peer.jitterTicks) / 16.0;
+    }
+    peer.lastTransit = transit;
+    peer.haveTransit = true;
+
+    qint64 latency = peer.clockSynced ? peer.roundTrip / 2 : 0;
+    return sentAt + latency + static_cast<qint64>(playoutDelayTicks(peer));
+}
+
+void RtpMidiSession::schedule(int peerId, qint64 playoutTime, const unsigned char* data, size_t size) {
+    if (jitterBuffer.size() >= MAX_JITTER_BUFFER_EVENTS) {
+        // Overflow: release the oldest event now rather than dropping anything
+        playoutTimer->stop();
+        BufferedEvent overflow = std::move(jitterBuffer.front());
+        jitterBuffer.pop_front();
+        if (Peer* peer = findPeerById(overflow.peerId)) {
+            peer->lateEvents++;
+            peer->lastPlayoutTime = now();
+        }
+        emit midiReceived(overflow.peerId, 0.0, overflow.data);
+    }
+
+    qint64 current = now();
+    if (playoutTime < current) {
+        if (Peer* peer = findPeerById(peerId)) peer->lateEvents++;
+        playoutTime = current;
+    }
+
+    BufferedEvent event;
+    event.playoutTime = playoutTime;
+    event.peerId = peerId;
+    event.data.assign(data, data + size);
+
+    auto position = std::upper_bound(jitterBuffer.begin(), jitterBuffer.end(), playoutTime,
+                                     [](qint64 t, const BufferedEvent& e) { return t < e.playoutTime; });
+    jitterBuffer.insert(position, std::move(event));
+}
+
+void RtpMidiSession::rescheduleTimer() {
+    if (jitterBuffer.empty()) {
+        playoutTimer->stop();
+        return;
+    }
+    qint64 wait = (jitterBuffer.front().playoutTime - now()) / TICKS_PER_MS;
+    playoutTimer->start(static_cast<int>(std::max<qint64>(0, wait)));
+}
+
+void RtpMidiSession::playoutDueEvents() {
+    qint64 current = now();
+
+    while (!jitterBuffer.empty() && jitterBuffer.front().playoutTime <= current) {
+        BufferedEvent event = std::move(jitterBuffer.front());
+        jitterBuffer.pop_front();
+
+        double delta = 0.0;
+        if (Peer* peer = findPeerById(event.peerId)) {
+            if (peer->lastPlayoutTime > 0) {
+                delta = static_cast<double>(event.playoutTime - peer->lastPlayoutTime) / 10000.0;
+            }
+            peer->lastPlayoutTime = event.playoutTime;
+        }
+        emit midiReceived(event.peerId, delta, event.data);
+    }
+
+    rescheduleTimer();
+}
+
+// ---------------------------------------------------------------------------
+// Outgoing MIDI
+// ---------------------------------------------------------------------------
+
+void RtpMidiSession::sendMidi(const unsigned char* data, size_t size) {
+    if (size == 0 || size > 0x0FFF || peerCount() == 0) return;
+
+    std::vector<unsigned char> journal = buildSendJournal();
+
+    std::vector<unsigned char> packet;
+    packet.reserve(16 + size + journal.size());
+    packet.push_back(0x80);
+    packet.push_back(RTP_MIDI_PAYLOAD_TYPE);
+    writeU16(packet, sendSequence);
+    writeU32(packet, static_cast<quint32>(now()));
+    writeU32(packet, localSsrc);
+
+    // Single command, no leading delta time (Z = 0)
+    unsigned char journalFlag = journal.empty() ? 0x00 : 0x40;
+    if (size <= 0x0F) {
+        packet.push_back(static_cast<unsigned char>(journalFlag | size));
+    } else {
+        packet.push_back(static_cast<unsigned char>(0x80 | journalFlag | (size >> 8)));
+        packet.push_back(static_cast<unsigned char>(size & 0xFF));
+    }
+    packet.insert(packet.end(), data, data + size);
+    packet.insert(packet.end(), journal.begin(), journal.end());
+
+    for (auto& entry : peers) {
+        Peer& peer = entry.second;
+        if (!peer.established) continue;
+        dataSocket->writeDatagram(reinterpret_cast<const char*>(packet.data()), static_cast<qint64>(packet.size()),
+                                  peer.address, peer.dataPort);
+    }
+
+    trackSentNote(data, size);
+    sendSequence++;
+}
+
+void RtpMidiSession::trackSentNote(const unsigned char* data, size_t size) {
+    if (size < 3) return;
+    int channel = data[0] & 0x0F;
+    int type = data[0] & 0xF0;
+    int note = data[1] & 0x7F;
+
+    if (type == 0x90 && data[2] > 0) {
+        sendNoteVelocity[channel][note] = data[2] & 0x7F;
+        sendNoteOffs[channel][note] = false;
+    } else if (type == 0x80 || type == 0x90) {
+        sendNoteVelocity[channel][note] = 0;
+        sendNoteOffs[channel][note] = true;
+        sendNoteOffSequence[channel][note] = sendSequence;
+    }
+}
+
+std::vector<unsigned char> RtpMidiSession::buildSendJournal() const {
+    std::vector<unsigned char> channelJournals;
+    int channelCount = 0;
+
+    for (int channel = 0; channel < 16; channel++) {
+        std::vector<unsigned char> chapterN;
+        int logCount = 0;
+        int low = 16;
+        int high = -1;
+
+        for (int note = 0; note < 128; note++) {
+            if (sendNoteVelocity[channel][note] > 0 && logCount < 127) logCount++;
+            if (sendNoteOffs[channel][note]) {
+                low = std::min(low, note / 8);
+                high = std::max(high, note / 8);
+            }
+        }
+        if (logCount == 0 && high < 0) continue;
+
+        // LOW > HIGH codes "no OFFBITS"; LOW=15/HIGH=1 keeps LEN=127 unambiguous
+        if (high < 0) {
+            low = 15;
+            high = logCount == 127 ? 1 : 0;
+        }
+
+        chapterN.push_back(static_cast<unsigned char>(logCount));
+        chapterN.push_back(static_cast<unsigned char>((low << 4) | high));
+
+        int written = 0;
+        for (int note = 0; note < 128 && written < logCount; note++) {
+            if (sendNoteVelocity[channel][note] == 0) continue;
+            chapterN.push_back(static_cast<unsigned char>(note));
+            chapterN.push_back(sendNoteVelocity[channel][note]);
+            written++;
+        }
+
+        for (int octet = low; octet <= high; octet++) {
+            unsigned char bits = 0;
+            for (int bit = 0; bit < 8; bit++) {
+                if (sendNoteOffs[channel][octet * 8 + bit]) bits |= static_cast<unsigned char>(0x80 >> bit);
+            }
+            chapterN.push_back(bits);
+        }
+
+        size_t channelLength = 3 + chapterN.size();
+        channelJournals.push_back(static_cast<unsigned char>((channel << 3) | ((channelLength >> 8) & 0x03)));
+        channelJournals.push_back(static_cast<unsigned char>(channelLength & 0xFF));
+        channelJournals.push_back(0x08); // TOC: chapter N only
+        channelJournals.insert(channelJournals.end(), chapterN.begin(), chapterN.end());
+        channelCount++;
+    }
+
+    std::vector<unsigned char> journal;
+    if (channelCount == 0) return journal;
+
+    journal.reserve(3 + channelJournals.size());
+    journal.push_back(static_cast<unsigned char>(0x20 | (channelCount - 1))); // A flag + TOTCHAN
+    writeU16(journal, checkpointSequence);
+    journal.insert(journal.end(), channelJournals.begin(), channelJournals.end());
+    return journal;
+}
+
+void RtpMidiSession::startTestPattern(int intervalMs) {
+    testPatternStep = 0;
+    testPatternTimer->start(intervalMs);
+}
+
+void RtpMidiSession::sendTestPatternStep() {
+    // I - IV - V - I in C major, so a listening instance has something to analyse
+    static const unsigned char progression[4][3] = {
+        {60, 64, 67}, {65, 69, 72}, {67, 71, 74}, {60, 64, 67}
+    };
+
+    const unsigned char* previous = progression[(testPatternStep + 3) % 4];
+    const unsigned char* next = progression[testPatternStep % 4];
+
+    if (testPatternStep > 0) {
+        for (int i = 0; i < 3; i++) {
+            unsigned char noteOff[3] = {0x80, previous[i], 0};
+            sendMidi(noteOff, 3);
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        unsigned char noteOn[3] = {0x90, next[i], 90};
+        sendMidi(noteOn, 3);
+    }
+    testPatternStep++;
+}
\ No newline at end of file
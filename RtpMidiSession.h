@@ -0,0 +1,192 @@
+#pragma once
+
+#include <QObject>
+#include <QUdpSocket>
+#include <QHostAddress>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QString>
+#include <bitset>
+#include <deque>
+#include <map>
+#include <vector>
+#include <cstdint>
+
+// RTP-MIDI (AppleMIDI / RFC 6295) session endpoint.
+// Binds a control port and the data port directly above it, answers or sends
+// invitations, keeps a clock offset per participant and plays received MIDI
+// out of a jitter buffer. Lost packets are repaired from the recovery journal
+// (chapter N), so held notes never stay stuck after packet loss.
+class RtpMidiSession : public QObject {
+    Q_OBJECT
+
+public:
+    enum class JitterMode {
+        Fixed,      // constant playout delay
+        Adaptive    // delay follows the measured interarrival jitter
+    };
+
+    struct JitterConfig {
+        JitterMode mode;
+        double fixedDelayMs;
+        double minDelayMs;
+        double maxDelayMs;
+    };
+
+    struct PeerStats {
+        QString name;
+        quint64 packetsReceived;
+        quint64 packetsLost;
+        quint64 eventsRecovered;
+        quint64 lateEvents;
+        double jitterMs;
+        double playoutDelayMs;
+        double roundTripMs;
+    };
+
+    explicit RtpMidiSession(const QString& sessionName, QObject* parent = nullptr);
+    ~RtpMidiSession();
+
+    // Session control
+    bool listen(quint16 controlPort);
+    void invite(const QHostAddress& address, quint16 controlPort);
+    void endSession();
+    int peerCount() const;
+    std::vector<PeerStats> getPeerStats() const;
+
+    // Jitter buffer
+    void setJitterConfig(const JitterConfig& config);
+    static JitterConfig defaultJitterConfig();
+
+    // Outgoing MIDI (sent to every established peer)
+    void sendMidi(const unsigned char* data, size_t size);
+    void startTestPattern(int intervalMs);
+
+signals:
+    void peerConnected(int peerId, const QString& name);
+    void peerDisconnected(int peerId, const QString& name);
+    void midiReceived(int peerId, double deltaSeconds, const std::vector<unsigned char>& data);
+    void sessionError(const QString& error);
+
+private slots:
+    void readControlSocket();
+    void readDataSocket();
+    void playoutDueEvents();
+    void housekeeping();
+    void sendTestPatternStep();
+
+private:
+    struct Peer {
+        int id;
+        quint32 ssrc;
+        quint32 token;
+        QString name;
+        QHostAddress address;
+        quint16 controlPort;
+        quint16 dataPort;
+        bool initiatedByUs;
+        bool controlAccepted;
+        bool established;
+        int inviteAttempts;
+
+        // Clock sync (100 us units, remote minus local)
+        bool clockSynced;
+        qint64 clockOffset;
+        qint64 roundTrip;
+        int syncCount;
+
+        // Receive state
+        bool haveSequence;
+        quint16 expectedSequence;
+        quint16 lastReceivedSequence;
+        bool feedbackPending;
+        bool haveTransit;
+        qint64 lastTransit;
+        double jitterTicks;
+        bool offsetKnown;
+        qint64 lastPlayoutTime;
+        std::bitset<128> notesOn[16];
+
+        // Send-side acknowledgement from receiver feedback
+        bool haveRemoteAck;
+        quint16 remoteAckSequence;
+
+        quint64 packetsReceived;
+        quint64 packetsLost;
+        quint64 eventsRecovered;
+        quint64 lateEvents;
+    };
+
+    struct BufferedEvent {
+        qint64 playoutTime;   // local session clock, 100 us units
+        int peerId;
+        std::vector<unsigned char> data;
+    };
+
+    QString sessionName;
+    quint32 localSsrc;
+    QUdpSocket* controlSocket;
+    QUdpSocket* dataSocket;
+    QTimer* playoutTimer;
+    QTimer* housekeepingTimer;
+    QTimer* testPatternTimer;
+    QElapsedTimer sessionClock;
+    JitterConfig jitterConfig;
+    int nextPeerId;
+    int testPatternStep;
+    int housekeepingTicks;
+    bool socketsBound;
+
+    std::map<quint32, Peer> peers;          // established or accepting, keyed by SSRC
+    std::map<quint32, Peer> pendingInvites; // our invitations, keyed by token
+    std::deque<BufferedEvent> jitterBuffer; // sorted by playout time
+    std::vector<char> datagram;
+
+    // Send-side recovery journal (chapter N per channel)
+    quint16 sendSequence;
+    quint16 checkpointSequence;
+    unsigned char sendNoteVelocity[16][128];
+    std::bitset<128> sendNoteOffs[16];
+    quint16 sendNoteOffSequence[16][128];
+
+    // Clock
+    qint64 now() const;
+
+    // Exchange packets
+    void handleExchangePacket(QUdpSocket* socket, const unsigned char* data, size_t size,
+                              const QHostAddress& sender, quint16 senderPort);
+    void handleInvitation(QUdpSocket* socket, quint32 token, quint32 ssrc, const QString& name,
+                          const QHostAddress& sender, quint16 senderPort);
+    void handleInvitationAccepted(QUdpSocket* socket, quint32 token, quint32 ssrc, const QString& name);
+    void handleClockSync(const unsigned char* data, size_t size, const QHostAddress& sender, quint16 senderPort);
+    void handleReceiverFeedback(quint32 ssrc, quint16 sequence);
+    void sendExchange(QUdpSocket* socket, const char command[2], quint32 token,
+                      const QHostAddress& address, quint16 port, bool includeName);
+    void sendClockSync(Peer& peer, quint8 count, qint64 ts1, qint64 ts2, qint64 ts3);
+    void sendReceiverFeedback(Peer& peer);
+    void sendBye(Peer& peer);
+    void removePeer(quint32 ssrc);
+    void sendInvitation(Peer& pending, bool dataPort);
+    void releaseHeldNotes(Peer& peer);
+    void advanceCheckpoint();
+
+    // RTP-MIDI payload
+    void handleRtpPacket(const unsigned char* data, size_t size);
+    void parseCommandList(Peer& peer, const unsigned char* data, size_t size, bool firstHasDelta,
+                          quint32 timestamp, qint64 arrival);
+    void parseRecoveryJournal(Peer& peer, const unsigned char* data, size_t size, qint64 playoutTime);
+    void recoverChapterN(Peer& peer, int channel, const unsigned char* data, size_t size, qint64 playoutTime);
+    void trackReceivedNote(Peer& peer, const unsigned char* data, size_t size);
+    std::vector<unsigned char> buildSendJournal() const;
+    void trackSentNote(const unsigned char* data, size_t size);
+
+    // Jitter buffer
+    qint64 playoutTimeFor(Peer& peer, quint32 timestamp, qint64 arrival);
+    bool bindSockets(quint16 controlPort);
+    double playoutDelayTicks(const Peer& peer) const;
+    void schedule(int peerId, qint64 playoutTime, const unsigned char* data, size_t size);
+    void rescheduleTimer();
+
+    Peer* findPeerById(int peerId);
+    static int midiDataLength(unsigned char status);
+};
\ No newline at end of file
@@ -0,0 +1,454 @@
+#include "SessionCatalog.h"
+#include "FieldCodec.h"
+#include <QDir>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+const int SessionCatalog::KEY_COUNT;
+const int SessionCatalog::Builder::WINDOW_NOTES;
+const int SessionCatalog::Builder::IOI_BINS;
+
+namespace {
+
+const char* const QUALITY_NAMES[] = {"major", "minor", "dominant", "diminished", "augmented", "suspended", "other"};
+const char* const STRINGS_FILE = "strings.txt";
+
+uint32_t readU32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+uint16_t readU16(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+void putU16(unsigned char* p, uint16_t value) {
+    p[0] = static_cast<unsigned char>(value);
+    p[1] = static_cast<unsigned char>(value >> 8);
+}
+
+void putU32(unsigned char* p, uint32_t value) {
+    putU16(p, static_cast<uint16_t>(value));
+    putU16(p + 2, static_cast<uint16_t>(value >> 16));
+}
+
+uint16_t perMille(uint32_t count, uint32_t total) {
+    return total > 0 ? static_cast<uint16_t>((static_cast<uint64_t>(count) * 1000 + total / 2) / total) : 0;
+}
+
+} // namespace
+
+SessionCatalog::Builder::Builder(MusicTheoryEngine* theoryEngine)
+    : theoryEngine(theoryEngine)
+    , noteCount(0)
+    , windowNotes(0)
+    , lastOnsetNs(std::numeric_limits<int64_t>::min())
+{
+    std::fill(std::begin(windowProfile), std::end(windowProfile), 0.0f);
+    std::fill(std::begin(keyWindows), std::end(keyWindows), 0u);
+    std::fill(std::begin(qualityCounts), std::end(qualityCounts), 0u);
+    std::fill(std::begin(ioiHistogram), std::end(ioiHistogram), 0u);
+}
+
+void SessionCatalog::Builder::countKeyWindow(const float* profile, uint32_t* windows) const {
+    const MusicTypes::KeySignature& key = theoryEngine->getKeySignature(theoryEngine->estimateKey(profile));
+    windows[key.tonic + (key.isMajor ? 0 : 12)]++;
+}
+
+void SessionCatalog::Builder::noteOn(int64_t timeNs, int note) {
+    noteCount++;
+
+    windowProfile[note % 12] += 1.0f;
+    if (++windowNotes == WINDOW_NOTES) {
+        countKeyWindow(windowProfile, keyWindows);
+        std::fill(std::begin(windowProfile), std::end(windowProfile), 0.0f);
+        windowNotes = 0;
+    }
+
+    // Notes within 40 ms form one onset (a chord)
+    const int64_t chordNs = 40000000;
+    if (lastOnsetNs != std::numeric_limits<int64_t>::min() && timeNs - lastOnsetNs < chordNs) return;
+    if (lastOnsetNs != std::numeric_limits<int64_t>::min()) {
+        int64_t bin = (timeNs - lastOnsetNs) / 10000000;
+        if (bin < IOI_BINS) ioiHistogram[bin]++;
+    }
+    lastOnsetNs = timeNs;
+}
+
+void SessionCatalog::Builder::chord(const std::string& quality) {
+    qualityCounts[qualityOf(quality)]++;
+}
+
+void SessionCatalog::Builder::save(std::vector<char>& out) const {
+    FieldWriter writer(out);
+    writer.u32(noteCount);
+    for (float count : windowProfile) {
+        writer.u8(static_cast<uint8_t>(count));
+    }
+    writer.u8(static_cast<uint8_t>(windowNotes));
+    for (uint32_t count : keyWindows) {
+        writer.u32(count);
+    }
+    for (uint32_t count : qualityCounts) {
+        writer.u32(count);
+    }
+    writer.u64(static_cast<uint64_t>(lastOnsetNs));
+
+    // Mostly empty: only the used bins
+    writer.u8(static_cast<uint8_t>(std::count_if(std::begin(ioiHistogram), std::end(ioiHistogram),
+                                                 [](uint32_t count) { return count > 0; })));
+    for (int bin = 0; bin < IOI_BINS; bin++) {
+        if (ioiHistogram[bin] == 0) continue;
+        writer.u8(static_cast<uint8_t>(bin));
+        writer.u32(ioiHistogram[bin]);
+    }
+}
+
+bool SessionCatalog::Builder::restore(const std::vector<char>& state) {
+    Builder restored(theoryEngine);
+    FieldReader reader(state.data(), state.size());
+    restored.noteCount = reader.u32();
+    for (float& count : restored.windowProfile) {
+        count = reader.u8();
+    }
+    restored.windowNotes = reader.u8();
+    for (uint32_t& count : restored.keyWindows) {
+        count = reader.u32();
+    }
+    for (uint32_t& count : restored.qualityCounts) {
+        count = reader.u32();
+    }
+    restored.lastOnsetNs = static_cast<int64_t>(reader.u64());
+
+    int usedBins = reader.u8();
+    for (int i = 0; i < usedBins && reader.ok(); i++) {
+        int bin = reader.u8();
+        uint32_t count = reader.u32();
+        if (bin >= IOI_BINS) return false;
+        restored.ioiHistogram[bin] = count;
+    }
+
+    if (!reader.ok() || restored.windowNotes >= WINDOW_NOTES) return false;
+    *this = restored;
+    return true;
+}
+
+SessionCatalog::Summary SessionCatalog::Builder::finish(int64_t startWallClockMs, int64_t durationNs) const {
+    Summary summary;
+    summary.startWallClockMs = startWallClockMs;
+    summary.durationMs = static_cast<uint32_t>(std::max<int64_t>(durationNs, 0) / 1000000);
+    summary.noteCount = noteCount;
+
+    // A partly filled last window still counts if it has a reasonable sample
+    uint32_t windows[KEY_COUNT];
+    std::copy(std::begin(keyWindows), std::end(keyWindows), windows);
+    if (windowNotes >= WINDOW_NOTES / 4) {
+        countKeyWindow(windowProfile, windows);
+    }
+    uint32_t windowTotal = 0;
+    for (uint32_t count : windows) windowTotal += count;
+    for (int key = 0; key < KEY_COUNT; key++) {
+        summary.keyShares[key] = perMille(windows[key], windowTotal);
+    }
+
+    uint32_t chordTotal = 0;
+    for (uint32_t count : qualityCounts) chordTotal += count;
+    for (int quality = 0; quality < QUALITY_COUNT; quality++) {
+        summary.qualityShares[quality] = perMille(qualityCounts[quality], chordTotal);
+    }
+
+    // Median inter-onset interval as the beat, folded into 60-180 BPM
+    uint32_t onsetTotal = 0;
+    for (uint32_t count : ioiHistogram) onsetTotal += count;
+    summary.tempoBpm = 0.0f;
+    if (onsetTotal >= 8) {
+        uint32_t seen = 0;
+        int bin = 0;
+        for (; bin < IOI_BINS; bin++) {
+            seen += ioiHistogram[bin];
+            if (seen * 2 >= onsetTotal) break;
+        }
+        float bpm = 60000.0f / ((bin + 0.5f) * 10.0f);
+        while (bpm < 60.0f) bpm *= 2.0f;
+        while (bpm >= 180.0f) bpm /= 2.0f;
+        summary.tempoBpm = bpm;
+    }
+    return summary;
+}
+
+SessionCatalog::Query SessionCatalog::anyQuery() {
+    Query query;
+    query.fromWallClockMs = std::numeric_limits<int64_t>::min();
+    query.toWallClockMs = std::numeric_limits<int64_t>::max();
+    query.minNotes = 0;
+    query.minFlatKeyShare = 0.0f;
+    query.minSharpKeyShare = 0.0f;
+    query.quality = -1;
+    query.minQualityShare = 0.0f;
+    return query;
+}
+
+SessionCatalog::ChordQuality SessionCatalog::qualityOf(const std::string& pattern) {
+    // Pattern names as in MusicTheoryEngine's chord table
+    if (pattern.find("sus") != std::string::npos) return SuspendedQuality;
+    if (pattern.find("dim") != std::string::npos || pattern.find("ø") != std::string::npos) return DiminishedQuality;
+    if (pattern.compare(0, 3, "aug") == 0) return AugmentedQuality;
+    if (pattern.compare(0, 3, "maj") == 0 || pattern == "6" || pattern == "add9") return MajorQuality;
+    if (pattern.compare(0, 1, "m") == 0) return MinorQuality;
+    if (!pattern.empty() && pattern[0] >= '0' && pattern[0] <= '9') return DominantQuality;
+    return OtherQuality;
+}
+
+const char* SessionCatalog::qualityName(int quality) {
+    return quality >= 0 && quality < QUALITY_COUNT ? QUALITY_NAMES[quality] : "";
+}
+
+int SessionCatalog::keyAccidentals(int key) {
+    // Relative major's position on the circle of fifths
+    int majorTonic = key < 12 ? key : (key + 3) % 12;
+    int fifths = majorTonic * 7 % 12;
+    return fifths <= 6 ? fifths : fifths - 12;
+}
+
+std::string SessionCatalog::keyName(int key) {
+    static const char* const majorNames[] = {"C", "D♭", "D", "E♭", "E", "F", "F#", "G", "A♭", "A", "B♭", "B"};
+    static const char* const minorNames[] = {"C", "C#", "D", "E♭", "E", "F", "F#", "G", "G#", "A", "B♭", "B"};
+    return key < 12 ? std::string(majorNames[key]) + " Major" : std::string(minorNames[key - 12]) + " minor";
+}
+
+SessionCatalog::SessionCatalog()
+    : rowCount(0)
+    , stringAppender(nullptr)
+{
+    for (Column& column : columns) {
+        column.appender = nullptr;
+        column.data = nullptr;
+    }
+}
+
+SessionCatalog::~SessionCatalog() {
+    for (Column& column : columns) {
+        if (column.data) column.file.unmap(const_cast<uchar*>(column.data));
+        if (column.appender) std::fclose(column.appender);
+    }
+    if (stringAppender) std::fclose(stringAppender);
+}
+
+size_t SessionCatalog::columnWidth(int column) {
+    switch (column) {
+    case StartColumn: return 8;
+    case KeysColumn: return 2 * KEY_COUNT;
+    case QualitiesColumn: return 2 * QUALITY_COUNT;
+    default: return 4;
+    }
+}
+
+const char* SessionCatalog::columnFile(int column) {
+    static const char* const names[COLUMN_COUNT] = {
+        "start.i64", "duration.u32", "notes.u32", "tempo.f32",
+        "keys.u16x24", "qualities.u16x7", "device.u32", "student.u32"
+    };
+    return names[column];
+}
+
+bool SessionCatalog::open(const std::string& directory, std::string& error) {
+    this->directory = directory;
+    if (!QDir().mkpath(QString::fromStdString(directory))) {
+        error = "cannot create " + directory;
+        return false;
+    }
+
+    std::ifstream stringsIn(directory + "/" + STRINGS_FILE);
+    for (std::string line; std::getline(stringsIn, line);) {
+        stringIds.emplace(line, static_cast<uint32_t>(strings.size()));
+        strings.push_back(line);
+    }
+    stringAppender = std::fopen((directory + "/" + STRINGS_FILE).c_str(), "ab");
+    if (!stringAppender) {
+        error = "cannot open " + directory + "/" + STRINGS_FILE + ": " + std::strerror(errno);
+        return false;
+    }
+
+    rowCount = std::numeric_limits<uint32_t>::max();
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+        std::string path = directory + "/" + columnFile(c);
+        columns[c].appender = std::fopen(path.c_str(), "ab");
+        columns[c].file.setFileName(QString::fromStdString(path));
+        if (!columns[c].appender || !columns[c].file.open(QIODevice::ReadWrite)) {
+            error = "cannot open " + path;
+            return false;
+        }
+        rowCount = std::min<uint32_t>(rowCount, static_cast<uint32_t>(columns[c].file.size() / columnWidth(c)));
+    }
+
+    // An append interrupted by a crash leaves some columns a row ahead
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+        qint64 expected = static_cast<qint64>(rowCount) * columnWidth(c);
+        if (columns[c].file.size() != expected) columns[c].file.resize(expected);
+    }
+    mapColumns();
+    return true;
+}
+
+bool SessionCatalog::intern(const std::string& value, uint32_t& id, std::string& error) {
+    std::string line = value;
+    std::replace(line.begin(), line.end(), '\n', ' ');
+
+    auto it = stringIds.find(line);
+    if (it != stringIds.end()) {
+        id = it->second;
+        return true;
+    }
+
+    if (std::fprintf(stringAppender, "%s\n", line.c_str()) < 0 || std::fflush(stringAppender) != 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    id = static_cast<uint32_t>(strings.size());
+    stringIds.emplace(line, id);
+    strings.push_back(line);
+    return true;
+}
+
+bool SessionCatalog::append(const Summary& summary, std::string& error) {
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+        if (!columns[c].appender) {
+            error = std::string("cannot append to ") + columnFile(c);
+            return false;
+        }
+    }
+    uint32_t deviceId, studentId;
+    if (!intern(summary.device, deviceId, error) || !intern(summary.student, studentId, error)) {
+        return false;
+    }
+
+    unsigned char start[8];
+    putU32(start, static_cast<uint32_t>(summary.startWallClockMs));
+    putU32(start + 4, static_cast<uint32_t>(static_cast<uint64_t>(summary.startWallClockMs) >> 32));
+    unsigned char duration[4], notes[4], tempo[4], device[4], student[4];
+    putU32(duration, summary.durationMs);
+    putU32(notes, summary.noteCount);
+    uint32_t tempoBits;
+    std::memcpy(&tempoBits, &summary.tempoBpm, sizeof(tempoBits));
+    putU32(tempo, tempoBits);
+    putU32(device, deviceId);
+    putU32(student, studentId);
+    unsigned char keys[2 * KEY_COUNT], qualities[2 * QUALITY_COUNT];
+    for (int i = 0; i < KEY_COUNT; i++) putU16(keys + 2 * i, summary.keyShares[i]);
+    for (int i = 0; i < QUALITY_COUNT; i++) putU16(qualities + 2 * i, summary.qualityShares[i]);
+
+    const unsigned char* values[COLUMN_COUNT] = {start, duration, notes, tempo, keys, qualities, device, student};
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+        if (std::fwrite(values[c], 1, columnWidth(c), columns[c].appender) != columnWidth(c) ||
+            std::fflush(columns[c].appender) != 0) {
+            error = std::string("cannot append to ") + columnFile(c) + ": " + std::strerror(errno);
+            dropPartialRow();
+            return false;
+        }
+    }
+    rowCount++;
+    mapColumns();
+    return true;
+}
+
+void SessionCatalog::dropPartialRow() {
+    // Closing first keeps bytes still buffered in stdio from landing after
+    // the truncation; appenders reopen at the new end
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+        if (columns[c].appender) std::fclose(columns[c].appender);
+        columns[c].file.resize(static_cast<qint64>(rowCount) * columnWidth(c));
+        columns[c].appender = std::fopen((directory + "/" + columnFile(c)).c_str(), "ab");
+    }
+}
+
+void SessionCatalog::mapColumns() {
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+        if (columns[c].data) columns[c].file.unmap(const_cast<uchar*>(columns[c].data));
+        columns[c].data = rowCount > 0
+            ? columns[c].file.map(0, static_cast<qint64>(rowCount) * columnWidth(c)) : nullptr;
+    }
+}
+
+uint32_t SessionCatalog::getRowCount() const {
+    return rowCount;
+}
+
+const unsigned char* SessionCatalog::cell(int column, uint32_t row) const {
+    return columns[column].data + row * columnWidth(column);
+}
+
+std::vector<uint32_t> SessionCatalog::find(const Query& query) const {
+    std::vector<uint32_t> rows;
+    for (const Column& column : columns) {
+        if (!column.data) return rows;
+    }
+
+    uint32_t deviceId = 0, studentId = 0;
+    if (!query.device.empty()) {
+        auto it = stringIds.find(query.device);
+        if (it == stringIds.end()) return rows;
+        deviceId = it->second;
+    }
+    if (!query.student.empty()) {
+        auto it = stringIds.find(query.student);
+        if (it == stringIds.end()) return rows;
+        studentId = it->second;
+    }
+
+    // Per-mille thresholds, and which keys count as flat or sharp
+    uint32_t minFlat = static_cast<uint32_t>(query.minFlatKeyShare * 1000.0f + 0.5f);
+    uint32_t minSharp = static_cast<uint32_t>(query.minSharpKeyShare * 1000.0f + 0.5f);
+    uint32_t minQuality = static_cast<uint32_t>(query.minQualityShare * 1000.0f + 0.5f);
+    bool flatKey[KEY_COUNT], sharpKey[KEY_COUNT];
+    for (int key = 0; key < KEY_COUNT; key++) {
+        flatKey[key] = keyAccidentals(key) < 0;
+        sharpKey[key] = keyAccidentals(key) > 0;
+    }
+
+    // Cheapest filters first; key and chord columns are only read for survivors
+    for (uint32_t row = 0; row < rowCount; row++) {
+        const unsigned char* start = cell(StartColumn, row);
+        int64_t startMs = static_cast<int64_t>(readU32(start) | static_cast<uint64_t>(readU32(start + 4)) << 32);
+        if (startMs < query.fromWallClockMs || startMs > query.toWallClockMs) continue;
+        if (readU32(cell(NotesColumn, row)) < query.minNotes) continue;
+        if (!query.device.empty() && readU32(cell(DeviceColumn, row)) != deviceId) continue;
+        if (!query.student.empty() && readU32(cell(StudentColumn, row)) != studentId) continue;
+
+        if (minFlat > 0 || minSharp > 0) {
+            const unsigned char* keys = cell(KeysColumn, row);
+            uint32_t flat = 0, sharp = 0;
+            for (int key = 0; key < KEY_COUNT; key++) {
+                uint32_t share = readU16(keys + 2 * key);
+                if (flatKey[key]) flat += share;
+                if (sharpKey[key]) sharp += share;
+            }
+            if (flat < minFlat || sharp < minSharp) continue;
+        }
+        if (query.quality >= 0 && query.quality < QUALITY_COUNT &&
+            readU16(cell(QualitiesColumn, row) + 2 * query.quality) < minQuality) {
+            continue;
+        }
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+SessionCatalog::Summary SessionCatalog::getSummary(uint32_t row) const {
+    Summary summary;
+    const unsigned char* start = cell(StartColumn, row);
+    summary.startWallClockMs = static_cast<int64_t>(readU32(start) | static_cast<uint64_t>(readU32(start + 4)) << 32);
+    summary.durationMs = readU32(cell(DurationColumn, row));
+    summary.noteCount = readU32(cell(NotesColumn, row));
+    uint32_t tempoBits = readU32(cell(TempoColumn, row));
+    std::memcpy(&summary.tempoBpm, &tempoBits, sizeof(tempoBits));
+    for (int i = 0; i < KEY_COUNT; i++) summary.keyShares[i] = readU16(cell(KeysColumn, row) + 2 * i);
+    for (int i = 0; i < QUALITY_COUNT; i++) summary.qualityShares[i] = readU16(cell(QualitiesColumn, row) + 2 * i);
+    uint32_t deviceId = readU32(cell(DeviceColumn, row));
+    uint32_t studentId = readU32(cell(StudentColumn, row));
+    summary.device = deviceId < strings.size() ? strings[deviceId] : std::string();
+    summary.student = studentId < strings.size() ? strings[studentId] : std::string();
+    return summary;
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "MusicTheoryEngine.h"
+#include <QFile>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+// Per-session summary statistics for searching years of archived practice
+// without opening a journal. The catalog is a directory with one file per
+// column, each a packed array of fixed-width values; closing a session
+// appends one row to every column. Queries map the columns and scan only the
+// ones their filters touch. Device and student names are interned in a
+// string table, so rows stay fixed-width.
+class SessionCatalog {
+public:
+    // Keys by tonic pitch class; minor keys follow the majors
+    static const int KEY_COUNT = 24;
+
+    enum ChordQuality {
+        MajorQuality,
+        MinorQuality,
+        DominantQuality,
+        DiminishedQuality,
+        AugmentedQuality,
+        SuspendedQuality,
+        OtherQuality,
+        QUALITY_COUNT
+    };
+
+    struct Summary {
+        int64_t startWallClockMs;
+        uint32_t durationMs;
+        uint32_t noteCount;
+        float tempoBpm;                         // 0 when too few onsets
+        uint16_t keyShares[KEY_COUNT];          // per mille of key-estimate windows
+        uint16_t qualityShares[QUALITY_COUNT];  // per mille of chord changes
+        std::string device;
+        std::string student;
+    };
+
+    // Collects a Summary while a session runs
+    class Builder {
+    public:
+        explicit Builder(MusicTheoryEngine* theoryEngine);
+
+        void noteOn(int64_t timeNs, int note);
+        void chord(const std::string& quality);   // chord pattern name, e.g. "m7"
+        Summary finish(int64_t startWallClockMs, int64_t durationNs) const;
+
+        // Accumulators so far, for session snapshots; restore leaves the
+        // builder unchanged when the state does not parse
+        void save(std::vector<char>& out) const;
+        bool restore(const std::vector<char>& state);
+
+    private:
+        static const int WINDOW_NOTES = 32;       // notes per key estimate
+        static const int IOI_BINS = 200;          // 10 ms bins up to 2 s
+
+        MusicTheoryEngine* theoryEngine;
+        uint32_t noteCount;
+        float windowProfile[12];
+        int windowNotes;
+        uint32_t keyWindows[KEY_COUNT];
+        uint32_t qualityCounts[QUALITY_COUNT];
+        int64_t lastOnsetNs;
+        uint32_t ioiHistogram[IOI_BINS];
+
+        void countKeyWindow(const float* profile, uint32_t* windows) const;
+    };
+
+    struct Query {
+        int64_t fromWallClockMs;
+        int64_t toWallClockMs;
+        std::string device;                       // empty = any
+        std::string student;
+        uint32_t minNotes;
+        float minFlatKeyShare;                    // 0..1, 0 = no constraint
+        float minSharpKeyShare;
+        int quality;                              // ChordQuality, -1 = no constraint
+        float minQualityShare;
+    };
+
+    static Query anyQuery();
+    static ChordQuality qualityOf(const std::string& pattern);
+    static const char* qualityName(int quality);
+    // Signature of a catalog key: negative = flats, positive = sharps (six counts as sharps)
+    static int keyAccidentals(int key);
+    static std::string keyName(int key);
+
+    SessionCatalog();
+    ~SessionCatalog();
+
+    // Creates the directory and columns on first use
+    bool open(const std::string& directory, std::string& error);
+
+    bool append(const Summary& summary, std::string& error);
+
+    uint32_t getRowCount() const;
+    std::vector<uint32_t> find(const Query& query) const;
+    Summary getSummary(uint32_t row) const;
+
+private:
+    enum ColumnId {
+        StartColumn,
+        DurationColumn,
+        NotesColumn,
+        TempoColumn,
+        KeysColumn,
+        QualitiesColumn,
+        DeviceColumn,
+        StudentColumn,
+        COLUMN_COUNT
+    };
+
+    struct Column {
+        QFile file;
+        std::FILE* appender;
+        const unsigned char* data;   // mapped, covers rowCount rows
+    };
+
+    std::string directory;
+    Column columns[COLUMN_COUNT];
+    uint32_t rowCount;
+
+    std::vector<std::string> strings;
+    std::map<std::string, uint32_t> stringIds;
+    std::FILE* stringAppender;
+
+    static size_t columnWidth(int column);
+    static const char* columnFile(int column);
+
+    bool intern(const std::string& value, uint32_t& id, std::string& error);
+    void dropPartialRow();
+    void mapColumns();
+    const unsigned char* cell(int column, uint32_t row) const;
+};
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "SessionScheduler.h"
+#include <algorithm>
+
+SessionScheduler::SessionScheduler(int workerCount)
+    : pendingDrains(0)
+    , running(false)
+{
+    int count = std::max(1, workerCount);
+    for (int i = 0; i < count; i++) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+}
+
+SessionScheduler::~SessionScheduler() {
+    stop();
+}
+
+void SessionScheduler::start(UpdateCallback onUpdate, CloseCallback onClose) {
+    if (running.exchange(true)) return;
+
+    updateCallback = std::move(onUpdate);
+    closeCallback = std::move(onClose);
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->thread = std::thread(&SessionScheduler::workerLoop, this, static_cast<int>(i));
+    }
+}
+
+void SessionScheduler::stop() {
+    if (!running.exchange(false)) return;
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wakeup.notify_all();
+
+    for (auto& worker : workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->queue.clear();
+    }
+    pendingDrains = 0;
+}
+
+int SessionScheduler::getWorkerCount() const {
+    return static_cast<int>(workers.size());
+}
+
+std::vector<SessionScheduler::WorkerStats> SessionScheduler::getWorkerStats() const {
+    std::vector<WorkerStats> stats;
+    for (const auto& worker : workers) {
+        stats.push_back({worker->drainsRun.load(), worker->drainsStolen.load()});
+    }
+    return stats;
+}
+
+void SessionScheduler::schedule(const std::shared_ptr<AnalysisSession>& session) {
+    Worker& home = *workers[static_cast<size_t>(session->getId()) % workers.size()];
+    {
+        std::lock_guard<std::mutex> lock(home.mutex);
+        home.queue.push_back(session);
+    }
+
+    pendingDrains++;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wakeup.notify_one();
+}
+
+std::shared_ptr<AnalysisSession> SessionScheduler::takeWork(int index) {
+    Worker& own = *workers[index];
+    {
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.queue.empty()) {
+            std::shared_ptr<AnalysisSession> session = std::move(own.queue.front());
+            own.queue.pop_front();
+            return session;
+        }
+    }
+
+    // Steal the most recently queued session from another shard
+    int count = static_cast<int>(workers.size());
+    for (int offset = 1; offset < count; offset++) {
+        Worker& victim = *workers[(index + offset) % count];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || victim.queue.empty()) continue;
+
+        std::shared_ptr<AnalysisSession> session = std::move(victim.queue.back());
+        victim.queue.pop_back();
+        own.drainsStolen++;
+        return session;
+    }
+
+    return nullptr;
+}
+
+void SessionScheduler::workerLoop(int index) {
+    Worker& self = *workers[index];
+
+    while (running.load()) {
+        std::shared_ptr<AnalysisSession> session = takeWork(index);
+
+        if (!session) {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeup.wait(lock, [this] { return pendingDrains.load() > 0 || !running.load(); });
+            continue;
+        }
+        pendingDrains--;
+
+        if (session->drain() && updateCallback) {
+            updateCallback(*session);
+        }
+        if (session->closedInLastDrain() && closeCallback) {
+            closeCallback(*session);
+        }
+        self.drainsRun++;
+
+        // Events that arrived during the drain go back through the home shard
+        if (session->releaseAfterDrain()) {
+            schedule(session);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "AnalysisSession.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads that drain analysis sessions. Each session is
+// sharded to a home worker; idle workers steal from the back of other queues
+// so a burst on one shard never leaves cores idle.
+class SessionScheduler {
+public:
+    using UpdateCallback = std::function<void(AnalysisSession& session)>;
+    // After the drain that wrote a session's close record, on that worker
+    using CloseCallback = std::function<void(AnalysisSession& session)>;
+
+    struct WorkerStats {
+        uint64_t drainsRun;
+        uint64_t drainsStolen;
+    };
+
+    explicit SessionScheduler(int workerCount);
+    ~SessionScheduler();
+
+    void start(UpdateCallback onUpdate, CloseCallback onClose = nullptr);
+    void stop();
+
+    // Hand a session that reported "needs scheduling" to its home worker
+    void schedule(const std::shared_ptr<AnalysisSession>& session);
+
+    int getWorkerCount() const;
+    std::vector<WorkerStats> getWorkerStats() const;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::shared_ptr<AnalysisSession>> queue;
+        std::thread thread;
+        std::atomic<uint64_t> drainsRun{0};
+        std::atomic<uint64_t> drainsStolen{0};
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    UpdateCallback updateCallback;
+    CloseCallback closeCallback;
+
+    std::mutex sleepMutex;
+    std::condition_variable wakeup;
+    std::atomic<int> pendingDrains;
+    std::atomic<bool> running;
+
+    void workerLoop(int index);
+    std::shared_ptr<AnalysisSession> takeWork(int index);
+};
\ No newline at end of file
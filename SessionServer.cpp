@@ -0,0 +1,312 @@
+#include "SessionServer.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+SessionServer::SessionServer(const Options& options, QObject* parent)
+    : QObject(parent)
+    , options(options)
+    , theoryEngine(&MusicTheoryEngine::instance())
+    , networkSession(new RtpMidiSession(options.sessionName, this))
+    , statsTimer(new QTimer(this))
+    , flushTimer(new QTimer(this))
+    , snapshotTimer(new QTimer(this))
+    , pluginHost(options.pluginLimits)
+    , scheduler(options.workerCount)
+    , nextSessionId(1)
+{
+    networkSession->setJitterConfig(options.jitter);
+
+    connect(networkSession, &RtpMidiSession::peerConnected, this, &SessionServer::onPeerConnected);
+    connect(networkSession, &RtpMidiSession::peerDisconnected, this, &SessionServer::onPeerDisconnected);
+    connect(networkSession, &RtpMidiSession::midiReceived, this, &SessionServer::onMidiReceived);
+    connect(networkSession, &RtpMidiSession::sessionError, this,
+            [](const QString& error) { std::cerr << "Server error: " << error.toStdString() << std::endl; });
+    connect(statsTimer, &QTimer::timeout, this, &SessionServer::reportStats);
+    connect(flushTimer, &QTimer::timeout, this, [this]() { outputSink->flush(); });
+    connect(snapshotTimer, &QTimer::timeout, this, &SessionServer::writeSnapshots);
+}
+
+SessionServer::~SessionServer() {
+    stop();
+}
+
+bool SessionServer::start() {
+    for (const std::string& path : options.pluginPaths) {
+        std::string error;
+        if (!pluginHost.load(path, error)) {
+            std::cerr << "Failed to load plugin " << path << ": " << error << std::endl;
+        }
+    }
+
+    if (!options.restorePath.empty()) {
+        std::vector<SessionSnapshot> snapshots;
+        std::string error;
+        if (!SessionSnapshot::readFile(options.restorePath, snapshots, error)) {
+            std::cerr << "Failed to restore snapshots: " << error << std::endl;
+            return false;
+        }
+        for (SessionSnapshot& snapshot : snapshots) {
+            restoredSnapshots[snapshot.name] = std::move(snapshot);
+        }
+        std::cout << "Restored " << restoredSnapshots.size() << " session snapshots" << std::endl;
+    }
+
+    if (!options.outputPath.empty()) {
+        std::string error;
+        outputSink = OutputSink::create(options.outputFormat, options.outputPath, error);
+        if (!outputSink) {
+            std::cerr << "Failed to open output: " << error << std::endl;
+            return false;
+        }
+        // Keeps live consumers (e.g. jq) current without flushing per record
+        flushTimer->start(250);
+    }
+
+    if (!options.catalogPath.empty()) {
+        std::string error;
+        catalog.reset(new SessionCatalog());
+        if (!catalog->open(options.catalogPath, error)) {
+            std::cerr << "Failed to open catalog: " << error << std::endl;
+            catalog.reset();
+            return false;
+        }
+    }
+
+    scheduler.start([this](AnalysisSession& session) { printUpdate(session); },
+                    [this](AnalysisSession& session) { finishSession(session); });
+
+    if (!networkSession->listen(options.listenPort)) {
+        scheduler.stop();
+        return false;
+    }
+
+    if (options.statsIntervalMs > 0) {
+        statsTimer->start(options.statsIntervalMs);
+    }
+    if (!options.snapshotPath.empty() && options.snapshotIntervalMs > 0) {
+        snapshotTimer->start(options.snapshotIntervalMs);
+    }
+
+    std::cout << "Session server running with " << scheduler.getWorkerCount() << " workers" << std::endl;
+    return true;
+}
+
+void SessionServer::stop() {
+    statsTimer->stop();
+    flushTimer->stop();
+    snapshotTimer->stop();
+    networkSession->endSession();
+    scheduler.stop();
+
+    // No workers left: queued events are drained here, then every session closes
+    for (const auto& entry : sessions) {
+        entry.second->requestClose();
+        closingSessions.push_back(entry.second);
+    }
+    for (const auto& session : closingSessions) {
+        session->drain();
+        if (session->closedInLastDrain()) {
+            finishSession(*session);
+        }
+    }
+    closingSessions.clear();
+
+    if (!options.snapshotPath.empty() && !sessions.empty()) {
+        writeSnapshots();
+    }
+    if (outputSink) {
+        outputSink->flush();
+    }
+    sessions.clear();
+    peerSessions.clear();
+}
+
+int SessionServer::openSession(const std::string& name) {
+    int sessionId = nextSessionId++;
+    auto session = std::make_shared<AnalysisSession>(sessionId, name, options.keySignatureIndex, theoryEngine);
+    if (pluginHost.getPluginCount() > 0) {
+        session->attachPlugins(pluginHost.createChain(options.pluginConfig));
+    }
+
+    auto restored = restoredSnapshots.find(name);
+    if (restored != restoredSnapshots.end()) {
+        session->restoreSnapshot(restored->second);
+        restoredSnapshots.erase(restored);
+        std::cout << "Session " << sessionId << " resumed from snapshot" << std::endl;
+    }
+
+    session->attachOutput(outputSink.get(), static_cast<int64_t>(options.checkpointIntervalMs) * 1000000);
+    sessions[sessionId] = session;
+    std::cout << "Session " << sessionId << " opened: " << name << std::endl;
+    return sessionId;
+}
+
+void SessionServer::closeSession(int sessionId) {
+    auto it = sessions.find(sessionId);
+    if (it == sessions.end()) return;
+
+    // The close record and catalog row come from the last drain, after
+    // everything already submitted
+    closingSessions.erase(std::remove_if(closingSessions.begin(), closingSessions.end(),
+                                         [](const std::shared_ptr<AnalysisSession>& session) {
+                                             return session->isClosed();
+                                         }),
+                          closingSessions.end());
+    if (it->second->requestClose()) {
+        scheduler.schedule(it->second);
+    }
+    closingSessions.push_back(it->second);
+    sessions.erase(it);
+}
+
+void SessionServer::finishSession(const AnalysisSession& session) {
+    AnalysisSession::Stats stats = session.getStats();
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::cout << "Session " << session.getId() << " closed: " << stats.eventsProcessed << " events, "
+                  << stats.analysesRun << " analyses, mean latency " << stats.meanLatencyMs << "ms" << std::endl;
+    }
+    catalogSession(session);
+}
+
+void SessionServer::submit(int sessionId, const unsigned char* data, size_t size, int64_t eventNs) {
+    auto it = sessions.find(sessionId);
+    if (it == sessions.end()) return;
+
+    if (it->second->submitAt(data, size, eventNs)) {
+        scheduler.schedule(it->second);
+    }
+}
+
+void SessionServer::onPeerConnected(int peerId, const QString& name) {
+    peerSessions[peerId] = openSession(name.toStdString());
+
+    const NoteTransform* transform = NoteTransformRule::select(options.transforms, name.toStdString());
+    if (transform && !transform->isIdentity()) {
+        peerTransforms[peerId] = *transform;
+    }
+}
+
+void SessionServer::onPeerDisconnected(int peerId, const QString&) {
+    auto it = peerSessions.find(peerId);
+    if (it == peerSessions.end()) return;
+
+    closeSession(it->second);
+    peerSessions.erase(it);
+    peerClocks.erase(peerId);
+    peerTransforms.erase(peerId);
+}
+
+void SessionServer::onMidiReceived(int peerId, double deltaSeconds, const std::vector<unsigned char>& data) {
+    auto it = peerSessions.find(peerId);
+    if (it == peerSessions.end()) return;
+
+    // Journal, catalog tempo and plugins see when the peer played the event,
+    // not when the network got it here
+    int64_t eventNs = peerClocks[peerId].update(deltaSeconds, AnalysisSession::monotonicNs());
+
+    // The keyboard's transform comes before the session's note state
+    unsigned char transformed[3];
+    const unsigned char* bytes = data.data();
+    auto transform = peerTransforms.find(peerId);
+    if (transform != peerTransforms.end() && data.size() <= sizeof(transformed)) {
+        std::memcpy(transformed, bytes, data.size());
+        if (!transform->second.apply(transformed, data.size())) return;
+        bytes = transformed;
+    }
+    submit(it->second, bytes, data.size(), eventNs);
+}
+
+void SessionServer::writeSnapshots() {
+    std::vector<SessionSnapshot> snapshots;
+    snapshots.reserve(sessions.size());
+    for (const auto& entry : sessions) {
+        snapshots.push_back(entry.second->takeSnapshot());
+    }
+
+    std::string error;
+    if (!SessionSnapshot::writeFile(options.snapshotPath, snapshots, error)) {
+        std::cerr << "Failed to write snapshots: " << error << std::endl;
+    }
+}
+
+void SessionServer::printUpdate(AnalysisSession& session) {
+    // Called on worker threads. With a record sink the session has already
+    // written the same results as records.
+    if (outputSink) return;
+
+    std::lock_guard<std::mutex> lock(outputMutex);
+    if (session.chordChangedInLastDrain()) {
+        std::cout << "[" << session.getName() << "] " << session.getChordName().toStdString();
+        if (!session.getRomanNumeral().isEmpty()) {
+            std::cout << " (" << session.getRomanNumeral().toStdString() << ")";
+        }
+        std::cout << '\n';
+    }
+
+    for (const PluginHost::Result& result : session.getPluginResults()) {
+        for (uint32_t i = 0; i < result.count; i++) {
+            const midimon_annotation& annotation = result.annotations[i];
+            std::cout << "[" << session.getName() << "] " << result.pluginName << ": "
+                      << std::string(annotation.text, strnlen(annotation.text, sizeof(annotation.text)))
+                      << " (" << annotation.value << ")\n";
+        }
+    }
+}
+
+void SessionServer::reportStats() {
+    std::lock_guard<std::mutex> lock(outputMutex);
+
+    std::cout << "--- " << sessions.size() << " sessions ---" << std::endl;
+    for (const auto& entry : sessions) {
+        AnalysisSession::Stats stats = entry.second->getStats();
+        std::cout << "  " << entry.second->getName() << ": " << stats.eventsProcessed << " events, latency mean "
+                  << stats.meanLatencyMs << "ms max " << stats.maxLatencyMs << "ms" << std::endl;
+    }
+
+    for (const auto& entry : peerClocks) {
+        ClockEstimator::Stats clock = entry.second.getStats();
+        std::cout << "  peer " << entry.first << " clock: drift " << clock.driftPpm << "ppm, jitter rms "
+                  << clock.jitterRmsUs << "us max " << clock.jitterMaxUs << "us, " << clock.outliers
+                  << " outliers" << std::endl;
+    }
+
+    std::vector<SessionScheduler::WorkerStats> workers = scheduler.getWorkerStats();
+    for (size_t i = 0; i < workers.size(); i++) {
+        std::cout << "  worker " << i << ": " << workers[i].drainsRun << " drains, "
+                  << workers[i].drainsStolen << " stolen" << std::endl;
+    }
+
+    for (const PluginHost::PluginStats& plugin : pluginHost.getStats()) {
+        std::cout << "  plugin " << plugin.name << ": " << plugin.calls << " calls, " << plugin.overruns
+                  << " overruns, mean " << plugin.meanMicros << "us worst " << plugin.worstMicros << "us";
+        if (plugin.disabled) {
+            std::cout << " [disabled: " << plugin.disabledReason << "]";
+        }
+        std::cout << std::endl;
+    }
+
+    if (outputSink) {
+        std::cout << "  output: " << outputSink->getRecordsWritten() << " records, "
+                  << outputSink->getBytesWritten() << " bytes";
+        if (outputSink->hasWriteFailed()) {
+            std::cout << " [write failed, " << outputSink->getBytesDropped() << " bytes dropped]";
+        }
+        std::cout << std::endl;
+    }
+}
+
+void SessionServer::catalogSession(const AnalysisSession& session) {
+    if (!catalog) return;
+
+    SessionCatalog::Summary summary = session.summarize();
+    auto student = options.students.find(session.getName());
+    if (student != options.students.end()) summary.student = student->second;
+
+    std::string error;
+    std::lock_guard<std::mutex> lock(catalogMutex);
+    if (!catalog->append(summary, error)) {
+        std::cerr << "Failed to catalog session " << session.getId() << ": " << error << std::endl;
+    }
+}
\ No newline at end of file
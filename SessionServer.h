@@ -0,0 +1,97 @@
+#pragma once
+
+#include "AnalysisSession.h"
+#include "SessionScheduler.h"
+#include "RtpMidiSession.h"
+#include "PluginHost.h"
+#include "OutputSink.h"
+#include "SessionCatalog.h"
+#include "MusicTheoryEngine.h"
+#include "ClockEstimator.h"
+#include "NoteTransform.h"
+#include <QObject>
+#include <QTimer>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Headless server mode: one process hosts many independent analysis sessions,
+// one per RTP-MIDI participant (e.g. 30 classroom keyboards), drained by a
+// fixed worker pool.
+class SessionServer : public QObject {
+    Q_OBJECT
+
+public:
+    struct Options {
+        QString sessionName;
+        quint16 listenPort;
+        int workerCount;
+        int keySignatureIndex;
+        int statsIntervalMs;     // 0 = no periodic report
+        RtpMidiSession::JitterConfig jitter;
+        std::vector<std::string> pluginPaths;
+        std::string pluginConfig;
+        PluginHost::Limits pluginLimits;
+        std::string outputPath;  // empty = no record output, "-" = stdout
+        OutputSink::Format outputFormat;
+        int checkpointIntervalMs; // journal checkpoints, 0 = only at session open
+        std::string snapshotPath; // empty = no crash-recovery snapshots
+        int snapshotIntervalMs;
+        std::string restorePath;  // snapshots to resume sessions from, matched by name
+        std::string catalogPath;  // empty = closed sessions are not catalogued
+        std::map<std::string, std::string> students; // session name -> student tag
+        std::vector<NoteTransformRule> transforms;   // matched against peer names
+    };
+
+    explicit SessionServer(const Options& options, QObject* parent = nullptr);
+    ~SessionServer();
+
+    bool start();
+    void stop();
+
+    // Sessions can also be fed directly (replays, other inputs)
+    int openSession(const std::string& name);
+    void closeSession(int sessionId);
+    // eventNs: when the event was played, on AnalysisSession::monotonicNs()
+    void submit(int sessionId, const unsigned char* data, size_t size, int64_t eventNs);
+
+private slots:
+    void onPeerConnected(int peerId, const QString& name);
+    void onPeerDisconnected(int peerId, const QString& name);
+    void onMidiReceived(int peerId, double deltaSeconds, const std::vector<unsigned char>& data);
+    void reportStats();
+    void writeSnapshots();
+
+private:
+    Options options;
+    MusicTheoryEngine* theoryEngine;
+    RtpMidiSession* networkSession;
+    QTimer* statsTimer;
+    QTimer* flushTimer;
+    QTimer* snapshotTimer;
+    PluginHost pluginHost;     // outlives every session's plugin chain
+    std::unique_ptr<OutputSink> outputSink;
+    std::unique_ptr<SessionCatalog> catalog;
+    SessionScheduler scheduler;
+
+    // Owned by the Qt thread; workers hold their own references while draining
+    std::map<int, std::shared_ptr<AnalysisSession>> sessions;
+    // Closed but possibly still queued; a worker finishes them
+    std::vector<std::shared_ptr<AnalysisSession>> closingSessions;
+    std::map<int, int> peerSessions; // RTP-MIDI peer id -> session id
+    std::map<int, ClockEstimator> peerClocks; // de-jitters each peer's playout times
+    std::map<int, NoteTransform> peerTransforms;
+    int nextSessionId;
+
+    // Restored on the first open with the same name (e.g. a keyboard reconnecting)
+    std::map<std::string, SessionSnapshot> restoredSnapshots;
+
+    std::mutex outputMutex;
+    std::mutex catalogMutex;
+
+    void printUpdate(AnalysisSession& session);
+    void finishSession(const AnalysisSession& session);
+    void catalogSession(const AnalysisSession& session);
+};
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "SessionSnapshot.h"
+#include "FieldCodec.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char SNAPSHOT_FILE_MAGIC[8] = {'M', 'I', 'D', 'I', 'S', 'N', 'A', 'P'};
+
+} // namespace
+
+const uint32_t SessionSnapshot::FORMAT_VERSION;
+
+SessionSnapshot::SessionSnapshot()
+    : sessionId(0)
+    , timeNs(0)
+    , keySignatureIndex(0)
+    , eventsProcessed(0)
+    , sustainDown(false)
+{
+    std::memset(velocities, 0, sizeof(velocities));
+    std::memset(pitchClassCounts, 0, sizeof(pitchClassCounts));
+}
+
+void SessionSnapshot::serialize(std::vector<char>& out) const {
+    FieldWriter writer(out);
+    writer.u32(FORMAT_VERSION);
+    writer.u32(static_cast<uint32_t>(sessionId));
+    writer.text(name);
+    writer.u64(static_cast<uint64_t>(timeNs));
+    writer.u32(static_cast<uint32_t>(keySignatureIndex));
+    writer.u64(eventsProcessed);
+
+    writer.bits(heldNotes);
+    writer.bits(sustainedNotes);
+    writer.u8(sustainDown ? 1 : 0);
+
+    // Velocities only matter for held notes
+    writer.u8(static_cast<uint8_t>(heldNotes.count()));
+    for (int note = 0; note < 128; note++) {
+        if (!heldNotes[note]) continue;
+        writer.u8(static_cast<uint8_t>(note));
+        writer.u8(velocities[note]);
+    }
+
+    for (uint32_t count : pitchClassCounts) {
+        writer.u32(count);
+    }
+
+    writer.text(chord);
+    writer.text(roman);
+    writer.u8(static_cast<uint8_t>(std::min<size_t>(chordHistory.size(), 255)));
+    size_t first = chordHistory.size() > 255 ? chordHistory.size() - 255 : 0;
+    for (size_t i = first; i < chordHistory.size(); i++) {
+        writer.u64(static_cast<uint64_t>(chordHistory[i].startNs));
+        writer.text(chordHistory[i].chord);
+        writer.text(chordHistory[i].roman);
+    }
+    writer.blob(catalogState);
+}
+
+bool SessionSnapshot::deserialize(const char* data, size_t size) {
+    FieldReader reader(data, size);
+    // Version 1 (older journals) lacks only the catalog state
+    uint32_t version = reader.u32();
+    if (version != 1 && version != FORMAT_VERSION) return false;
+
+    sessionId = static_cast<int32_t>(reader.u32());
+    name = reader.text();
+    timeNs = static_cast<int64_t>(reader.u64());
+    keySignatureIndex = static_cast<int32_t>(reader.u32());
+    eventsProcessed = reader.u64();
+
+    heldNotes = reader.bits();
+    sustainedNotes = reader.bits();
+    sustainDown = reader.u8() != 0;
+
+    std::memset(velocities, 0, sizeof(velocities));
+    int heldCount = reader.u8();
+    for (int i = 0; i < heldCount; i++) {
+        uint8_t note = reader.u8();
+        velocities[note & 0x7F] = reader.u8();
+    }
+
+    for (uint32_t& count : pitchClassCounts) {
+        count = reader.u32();
+    }
+
+    chord = reader.text();
+    roman = reader.text();
+    chordHistory.clear();
+    int historyCount = reader.u8();
+    for (int i = 0; i < historyCount && reader.ok(); i++) {
+        ChordSpan span;
+        span.startNs = static_cast<int64_t>(reader.u64());
+        span.chord = reader.text();
+        span.roman = reader.text();
+        chordHistory.push_back(span);
+    }
+    catalogState.clear();
+    if (version >= 2) {
+        catalogState = reader.blob();
+    }
+
+    return reader.ok();
+}
+
+bool SessionSnapshot::writeFile(const std::string& path, const std::vector<SessionSnapshot>& snapshots,
+                                std::string& error) {
+    std::vector<char> contents(SNAPSHOT_FILE_MAGIC, SNAPSHOT_FILE_MAGIC + sizeof(SNAPSHOT_FILE_MAGIC));
+    FieldWriter writer(contents);
+    writer.u32(static_cast<uint32_t>(snapshots.size()));
+
+    std::vector<char> blob;
+    for (const SessionSnapshot& snapshot : snapshots) {
+        blob.clear();
+        snapshot.serialize(blob);
+        writer.u32(static_cast<uint32_t>(blob.size()));
+        contents.insert(contents.end(), blob.begin(), blob.end());
+    }
+
+    return FieldCodec::writeFileAtomically(path, contents, error);
+}
+
+bool SessionSnapshot::readFile(const std::string& path, std::vector<SessionSnapshot>& snapshots,
+                               std::string& error) {
+    std::vector<char> contents;
+    if (!FieldCodec::readFile(path, contents, error)) return false;
+
+    if (contents.size() < sizeof(SNAPSHOT_FILE_MAGIC) + 4 ||
+        std::memcmp(contents.data(), SNAPSHOT_FILE_MAGIC, sizeof(SNAPSHOT_FILE_MAGIC)) != 0) {
+        error = path + " is not a snapshot file";
+        return false;
+    }
+
+    FieldReader reader(contents.data() + sizeof(SNAPSHOT_FILE_MAGIC), contents.size() - sizeof(SNAPSHOT_FILE_MAGIC));
+    uint32_t snapshotCount = reader.u32();
+    size_t offset = sizeof(SNAPSHOT_FILE_MAGIC) + 4;
+
+    snapshots.clear();
+    for (uint32_t i = 0; i < snapshotCount; i++) {
+        FieldReader sizeReader(contents.data() + offset, contents.size() - offset);
+        uint32_t blobSize = sizeReader.u32();
+        offset += 4;
+        SessionSnapshot snapshot;
+        if (!sizeReader.ok() || contents.size() - offset < blobSize ||
+            !snapshot.deserialize(contents.data() + offset, blobSize)) {
+            error = path + " is truncated or corrupt";
+            return false;
+        }
+        offset += blobSize;
+        snapshots.push_back(std::move(snapshot));
+    }
+    return true;
+}
\ No newline at end of file
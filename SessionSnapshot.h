@@ -0,0 +1,46 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Complete analysis state of one session at one instant. Serialized compactly
+// (a few hundred bytes for a typical session) into journal checkpoints and
+// snapshot files; restoring is a plain copy, no replay needed.
+struct SessionSnapshot {
+    struct ChordSpan {
+        int64_t startNs;     // session time the chord started sounding
+        std::string chord;
+        std::string roman;
+    };
+
+    static const uint32_t FORMAT_VERSION = 2;
+
+    int32_t sessionId;
+    std::string name;
+    int64_t timeNs;          // session time the snapshot was taken
+    int32_t keySignatureIndex;
+    uint64_t eventsProcessed;
+
+    std::bitset<128> heldNotes;
+    std::bitset<128> sustainedNotes; // released while the sustain pedal was down
+    bool sustainDown;
+    unsigned char velocities[128];
+    uint32_t pitchClassCounts[12];   // note-ons per pitch class
+
+    std::string chord;
+    std::string roman;
+    std::vector<ChordSpan> chordHistory; // oldest first
+    std::vector<char> catalogState;      // SessionCatalog::Builder::save, empty before version 2
+
+    SessionSnapshot();
+
+    void serialize(std::vector<char>& out) const;
+    bool deserialize(const char* data, size_t size);
+
+    // Snapshot files hold every session; writes go through a temporary file and
+    // a rename, so a crash mid-write leaves the previous snapshot intact
+    static bool writeFile(const std::string& path, const std::vector<SessionSnapshot>& snapshots, std::string& error);
+    static bool readFile(const std::string& path, std::vector<SessionSnapshot>& snapshots, std::string& error);
+};
\ No newline at end of file
@@ -0,0 +1,501 @@
+#include "SmfExporter.h"
+#include "OutputSink.h"
+#include "SessionCatalog.h"
+#include "SessionSnapshot.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+
+namespace {
+
+const size_t OUTPUT_BUFFER_SIZE = 256 * 1024;
+const size_t TRACK_LENGTH_OFFSET = 14 + 4;   // after MThd and "MTrk"
+const int KEY_WINDOW_NOTES = 32;
+const int KEY_CONFIRM_WINDOWS = 3;
+const int64_t CHORD_ONSET_NS = 40000000;
+const int64_t MAX_INTERVAL_NS = 2000000000;
+
+// Meta event types
+const uint8_t META_TEXT = 0x01;
+const uint8_t META_TRACK_NAME = 0x03;
+const uint8_t META_MARKER = 0x06;
+const uint8_t META_END_OF_TRACK = 0x2F;
+const uint8_t META_TEMPO = 0x51;
+const uint8_t META_KEY_SIGNATURE = 0x59;
+
+// Data bytes that follow a channel status
+int channelDataBytes(uint8_t status) {
+    uint8_t high = status & 0xF0;
+    return high == 0xC0 || high == 0xD0 ? 1 : 2;
+}
+
+uint16_t readU16(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+// u16 length + bytes, as OutputSink writes text fields
+bool readText(const unsigned char*& p, const unsigned char* end, std::string& text) {
+    if (end - p < 2) return false;
+    size_t length = readU16(p);
+    p += 2;
+    if (static_cast<size_t>(end - p) < length) return false;
+    text.assign(reinterpret_cast<const char*>(p), length);
+    p += length;
+    return true;
+}
+
+} // namespace
+
+class SmfExporter::Track {
+public:
+    Track(MusicTheoryEngine* theoryEngine, const Options& options, int32_t sessionId, const std::string& name);
+    ~Track();
+
+    bool open(const std::string& path, std::string& error);
+    void midi(int64_t timeNs, const unsigned char* data, size_t size);
+    void chord(int64_t timeNs, const std::string& chordName, const std::string& roman);
+    void text(int64_t timeNs, const std::string& value);
+    void setKey(int64_t timeNs, int key);   // SessionCatalog key index
+    bool hasKey() const;
+    bool close(std::string& error);
+
+    const Result& getResult() const;
+
+private:
+    // One event of the pending tempo window; text lives in windowText
+    struct Item {
+        int64_t timeNs;
+        uint8_t type;        // 0 = MIDI, 0xF0 = SysEx, otherwise a meta event type
+        uint8_t size;
+        uint8_t bytes[3];
+        uint32_t textOffset;
+        uint32_t textLength;
+    };
+
+    MusicTheoryEngine* theoryEngine;
+    Options options;
+    Result result;
+
+    std::vector<Item> window;
+    std::string windowText;
+    int64_t windowStartNs;
+
+    // Tempo map: ticks advance at the current tempo from the last change
+    uint32_t usPerQuarter;
+    int64_t tempoBaseNs;
+    double tempoBaseTicks;
+    int64_t lastTick;
+    uint8_t runningStatus;
+
+    float keyProfile[12];
+    int keyNotes;
+    int currentKey;
+    int candidateKey;
+    int candidateWindows;
+
+    std::FILE* file;
+    std::vector<unsigned char> out;
+    uint64_t trackBytes;
+    bool failed;
+
+    void add(int64_t timeNs, uint8_t type, const unsigned char* bytes, size_t size, const std::string& textValue);
+    void flushWindow();
+    uint32_t estimateTempo() const;
+    void writeEvent(int64_t timeNs, const Item& item);
+    void writeMeta(uint8_t type, const void* data, size_t size);
+    void writeVarLen(uint32_t value);
+    void put(uint8_t byte);
+    void flushOutput();
+};
+
+SmfExporter::Track::Track(MusicTheoryEngine* theoryEngine, const Options& options, int32_t sessionId,
+                          const std::string& name)
+    : theoryEngine(theoryEngine)
+    , options(options)
+    , windowStartNs(0)
+    , usPerQuarter(0)
+    , tempoBaseNs(0)
+    , tempoBaseTicks(0.0)
+    , lastTick(0)
+    , runningStatus(0)
+    , keyNotes(0)
+    , currentKey(-1)
+    , candidateKey(-1)
+    , candidateWindows(0)
+    , file(nullptr)
+    , trackBytes(0)
+    , failed(false)
+{
+    result.sessionId = sessionId;
+    result.name = name;
+    result.events = 0;
+    result.markers = 0;
+    result.tempoChanges = 0;
+    result.bytes = 0;
+    std::fill(std::begin(keyProfile), std::end(keyProfile), 0.0f);
+    out.reserve(OUTPUT_BUFFER_SIZE + 1024);
+}
+
+SmfExporter::Track::~Track() {
+    if (file) {
+        std::fclose(file);
+    }
+}
+
+bool SmfExporter::Track::open(const std::string& path, std::string& error) {
+    result.path = path;
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    // MThd: format 0, one track; the MTrk length is patched in close()
+    const unsigned char header[] = {
+        'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1,
+        static_cast<unsigned char>(options.ticksPerQuarter >> 8), static_cast<unsigned char>(options.ticksPerQuarter),
+        'M', 'T', 'r', 'k', 0, 0, 0, 0
+    };
+    out.insert(out.end(), header, header + sizeof(header));
+    trackBytes = 0;
+
+    put(0);
+    writeMeta(META_TRACK_NAME, result.name.data(), std::min<size_t>(result.name.size(), 255));
+    return true;
+}
+
+bool SmfExporter::Track::hasKey() const {
+    return currentKey >= 0;
+}
+
+const SmfExporter::Result& SmfExporter::Track::getResult() const {
+    return result;
+}
+
+void SmfExporter::Track::add(int64_t timeNs, uint8_t type, const unsigned char* bytes, size_t size,
+                             const std::string& textValue) {
+    if (window.empty()) {
+        windowStartNs = timeNs;
+    } else if (timeNs - windowStartNs >= options.tempoWindowNs) {
+        flushWindow();
+        windowStartNs = timeNs;
+    }
+
+    Item item;
+    item.timeNs = timeNs;
+    item.type = type;
+    item.size = static_cast<uint8_t>(std::min<size_t>(size, sizeof(item.bytes)));
+    if (item.size > 0) std::memcpy(item.bytes, bytes, item.size);
+    item.textOffset = static_cast<uint32_t>(windowText.size());
+    item.textLength = static_cast<uint32_t>(textValue.size());
+    windowText += textValue;
+    window.push_back(item);
+}
+
+void SmfExporter::Track::midi(int64_t timeNs, const unsigned char* data, size_t size) {
+    if (size == 0) return;
+    uint8_t status = data[0];
+
+    if (status == 0xF0) {
+        // SysEx keeps its body (after F0) as text
+        add(timeNs, 0xF0, nullptr, 0, std::string(reinterpret_cast<const char*>(data + 1), size - 1));
+        result.events++;
+        return;
+    }
+    // Real-time and system common messages have no place in a file
+    if (status < 0x80 || status >= 0xF0 || size != static_cast<size_t>(1 + channelDataBytes(status))) return;
+
+    add(timeNs, 0, data, size, std::string());
+    result.events++;
+
+    if ((status & 0xF0) != 0x90 || data[2] == 0) return;
+    keyProfile[data[1] % 12] += 1.0f;
+    if (++keyNotes < KEY_WINDOW_NOTES) return;
+
+    // The profile decays by a quarter each window, so the estimate follows
+    // the last few windows rather than single phrases
+    const MusicTypes::KeySignature& estimate = theoryEngine->getKeySignature(theoryEngine->estimateKey(keyProfile));
+    int key = estimate.tonic + (estimate.isMajor ? 0 : 12);
+    for (float& weight : keyProfile) weight *= 0.75f;
+    keyNotes = 0;
+
+    // A new key must win KEY_CONFIRM_WINDOWS estimates in a row, so a passing modulation is not a key change
+    if (key == currentKey || key != candidateKey) {
+        candidateKey = key == currentKey ? -1 : key;
+        candidateWindows = 1;
+    } else {
+        candidateWindows++;
+    }
+    if (currentKey < 0 || (candidateKey >= 0 && candidateWindows >= KEY_CONFIRM_WINDOWS)) {
+        setKey(timeNs, key);
+        candidateKey = -1;
+    }
+}
+
+void SmfExporter::Track::chord(int64_t timeNs, const std::string& chordName, const std::string& roman) {
+    if (!chordName.empty()) {
+        add(timeNs, META_MARKER, nullptr, 0, chordName);
+        result.markers++;
+    }
+    if (!roman.empty()) {
+        add(timeNs, META_TEXT, nullptr, 0, roman);
+    }
+}
+
+void SmfExporter::Track::text(int64_t timeNs, const std::string& value) {
+    add(timeNs, META_TEXT, nullptr, 0, value);
+}
+
+void SmfExporter::Track::setKey(int64_t timeNs, int key) {
+    currentKey = key;
+    int accidentals = SessionCatalog::keyAccidentals(key);
+    const unsigned char signature[2] = {static_cast<unsigned char>(static_cast<int8_t>(accidentals)),
+                                        static_cast<unsigned char>(key >= 12 ? 1 : 0)};
+    add(timeNs, META_KEY_SIGNATURE, signature, sizeof(signature), std::string());
+    add(timeNs, META_MARKER, nullptr, 0, "Key: " + SessionCatalog::keyName(key));
+    result.markers++;
+}
+
+uint32_t SmfExporter::Track::estimateTempo() const {
+    // Median interval between onsets (notes within CHORD_ONSET_NS are one onset)
+    std::vector<int64_t> intervals;
+    int64_t lastOnsetNs = -1;
+    for (const Item& item : window) {
+        if (item.type != 0 || (item.bytes[0] & 0xF0) != 0x90 || item.bytes[2] == 0) continue;
+        if (lastOnsetNs >= 0) {
+            int64_t interval = item.timeNs - lastOnsetNs;
+            if (interval < CHORD_ONSET_NS) continue;
+            if (interval <= MAX_INTERVAL_NS) intervals.push_back(interval);
+        }
+        lastOnsetNs = item.timeNs;
+    }
+    if (intervals.size() < 8) return 0;
+
+    std::nth_element(intervals.begin(), intervals.begin() + intervals.size() / 2, intervals.end());
+    double bpm = 60e9 / intervals[intervals.size() / 2];
+    while (bpm < 60.0) bpm *= 2.0;
+    while (bpm >= 180.0) bpm /= 2.0;
+    return static_cast<uint32_t>(std::lround(60e6 / bpm));
+}
+
+void SmfExporter::Track::flushWindow() {
+    if (window.empty()) return;
+    std::stable_sort(window.begin(), window.end(),
+                     [](const Item& a, const Item& b) { return a.timeNs < b.timeNs; });
+
+    // Small drifts keep the current tempo so the map stays readable
+    uint32_t tempo = estimateTempo();
+    if (usPerQuarter == 0) {
+        tempo = tempo ? tempo : 500000;
+    } else if (tempo == 0 || std::abs(static_cast<double>(tempo) - usPerQuarter) < 0.05 * usPerQuarter) {
+        tempo = usPerQuarter;
+    }
+    if (tempo != usPerQuarter) {
+        int64_t changeNs = usPerQuarter == 0 ? 0 : std::max(windowStartNs, tempoBaseNs);
+        Item item = Item();
+        item.type = META_TEMPO;
+        if (usPerQuarter != 0) {
+            tempoBaseTicks += (changeNs - tempoBaseNs) * options.ticksPerQuarter / (usPerQuarter * 1000.0);
+            tempoBaseNs = changeNs;
+        }
+        usPerQuarter = tempo;
+        writeEvent(changeNs, item);
+        result.tempoChanges++;
+    }
+
+    for (const Item& item : window) {
+        writeEvent(item.timeNs, item);
+    }
+    window.clear();
+    windowText.clear();
+}
+
+void SmfExporter::Track::writeEvent(int64_t timeNs, const Item& item) {
+    int64_t tick = std::llround(tempoBaseTicks + (timeNs - tempoBaseNs) * options.ticksPerQuarter /
+                                                 (usPerQuarter * 1000.0));
+    tick = std::max(tick, lastTick);
+    writeVarLen(static_cast<uint32_t>(std::min<int64_t>(tick - lastTick, 0x0FFFFFFF)));
+    lastTick = tick;
+
+    const char* textValue = windowText.data() + item.textOffset;
+    if (item.type == 0) {
+        if (item.bytes[0] != runningStatus) put(item.bytes[0]);
+        runningStatus = item.bytes[0];
+        for (uint8_t i = 1; i < item.size; i++) put(item.bytes[i]);
+    } else if (item.type == 0xF0) {
+        put(0xF0);
+        writeVarLen(item.textLength);
+        out.insert(out.end(), textValue, textValue + item.textLength);
+        trackBytes += item.textLength;
+        runningStatus = 0;
+    } else if (item.type == META_TEMPO) {
+        const unsigned char tempo[3] = {static_cast<unsigned char>(usPerQuarter >> 16),
+                                        static_cast<unsigned char>(usPerQuarter >> 8),
+                                        static_cast<unsigned char>(usPerQuarter)};
+        writeMeta(META_TEMPO, tempo, sizeof(tempo));
+    } else if (item.type == META_KEY_SIGNATURE) {
+        writeMeta(META_KEY_SIGNATURE, item.bytes, item.size);
+    } else {
+        writeMeta(item.type, textValue, item.textLength);
+    }
+
+    if (out.size() >= OUTPUT_BUFFER_SIZE) flushOutput();
+}
+
+void SmfExporter::Track::writeMeta(uint8_t type, const void* data, size_t size) {
+    put(0xFF);
+    put(type);
+    writeVarLen(static_cast<uint32_t>(size));
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+    trackBytes += size;
+    runningStatus = 0;
+}
+
+void SmfExporter::Track::writeVarLen(uint32_t value) {
+    unsigned char bytes[4];
+    int count = 0;
+    do {
+        bytes[count++] = static_cast<unsigned char>(value & 0x7F);
+        value >>= 7;
+    } while (value > 0);
+    while (count > 1) put(bytes[--count] | 0x80);
+    put(bytes[0]);
+}
+
+void SmfExporter::Track::put(uint8_t byte) {
+    out.push_back(byte);
+    trackBytes++;
+}
+
+void SmfExporter::Track::flushOutput() {
+    if (!out.empty() && std::fwrite(out.data(), 1, out.size(), file) != out.size()) {
+        failed = true;
+    }
+    result.bytes += out.size();
+    out.clear();
+}
+
+bool SmfExporter::Track::close(std::string& error) {
+    flushWindow();
+    put(0);
+    writeMeta(META_END_OF_TRACK, nullptr, 0);
+    flushOutput();
+
+    const unsigned char length[4] = {static_cast<unsigned char>(trackBytes >> 24),
+                                     static_cast<unsigned char>(trackBytes >> 16),
+                                     static_cast<unsigned char>(trackBytes >> 8),
+                                     static_cast<unsigned char>(trackBytes)};
+    bool ok = !failed && std::fseek(file, TRACK_LENGTH_OFFSET, SEEK_SET) == 0 &&
+              std::fwrite(length, 1, sizeof(length), file) == sizeof(length);
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    if (!ok) {
+        error = result.path + ": " + std::strerror(errno);
+    }
+    return ok;
+}
+
+SmfExporter::Options SmfExporter::defaultOptions() {
+    Options options;
+    options.ticksPerQuarter = 960;
+    options.tempoWindowNs = 8000000000LL;
+    return options;
+}
+
+SmfExporter::SmfExporter(MusicTheoryEngine* theoryEngine, const Options& options)
+    : theoryEngine(theoryEngine)
+    , options(options)
+{
+}
+
+bool SmfExporter::exportJournal(const JournalReader& journal, const std::string& prefix,
+                                std::vector<Result>& results, std::string& error) {
+    std::map<int32_t, std::unique_ptr<Track>> tracks;
+    bool ok = true;
+
+    auto close = [&](std::map<int32_t, std::unique_ptr<Track>>::iterator it) {
+        std::string closeError;
+        if (it->second->close(closeError)) {
+            results.push_back(it->second->getResult());
+        } else if (ok) {
+            error = closeError;
+            ok = false;
+        }
+        return tracks.erase(it);
+    };
+
+    auto track = [&](int32_t sessionId, const std::string& name) -> Track* {
+        auto it = tracks.find(sessionId);
+        if (it != tracks.end()) return it->second.get();
+
+        std::unique_ptr<Track> created(new Track(theoryEngine, options, sessionId, name));
+        std::string openError;
+        if (!created->open(prefix + std::to_string(sessionId) + ".mid", openError)) {
+            if (ok) error = openError;
+            ok = false;
+            return nullptr;
+        }
+        return tracks.emplace(sessionId, std::move(created)).first->second.get();
+    };
+
+    // Single pass: records are routed to their session's track as they come
+    journal.forEachRecord(0, [&](uint8_t type, int32_t sessionId, int64_t timeNs,
+                                 const unsigned char* payload, size_t payloadSize) {
+        if (!ok) return;
+        const unsigned char* end = payload + payloadSize;
+
+        if (type == OutputSink::SessionOpenRecord) {
+            auto existing = tracks.find(sessionId);
+            if (existing != tracks.end()) close(existing);
+            if (payloadSize < 10) return;
+            size_t nameLength = std::min<size_t>(readU16(payload + 8), payloadSize - 10);
+            track(sessionId, std::string(reinterpret_cast<const char*>(payload + 10), nameLength));
+            return;
+        }
+        if (type == OutputSink::SessionCloseRecord) {
+            auto it = tracks.find(sessionId);
+            if (it != tracks.end()) close(it);
+            return;
+        }
+
+        // Sessions opened before the journal began still get a file
+        Track* target = track(sessionId, "session " + std::to_string(sessionId));
+        if (!target) return;
+
+        if (type == OutputSink::MidiRecord && payloadSize >= 1) {
+            target->midi(timeNs, payload + 1, std::min<size_t>(payload[0], payloadSize - 1));
+        } else if (type == OutputSink::ChordRecord) {
+            std::string chordName, roman;
+            const unsigned char* p = payload;
+            if (readText(p, end, chordName) && readText(p, end, roman)) {
+                target->chord(timeNs, chordName, roman);
+            }
+        } else if (type == OutputSink::AnnotationRecord) {
+            std::string plugin, text;
+            const unsigned char* p = payload;
+            if (readText(p, end, plugin) && end - p >= 8) {
+                p += 8;   // kind, value
+                if (readText(p, end, text) && !text.empty()) {
+                    target->text(timeNs, plugin + ": " + text);
+                }
+            }
+        } else if (type == OutputSink::CheckpointRecord && !target->hasKey()) {
+            // The session's configured key until an estimate replaces it
+            SessionSnapshot snapshot;
+            if (snapshot.deserialize(reinterpret_cast<const char*>(payload), payloadSize)) {
+                const MusicTypes::KeySignature& key = theoryEngine->getKeySignature(snapshot.keySignatureIndex);
+                target->setKey(timeNs, key.tonic + (key.isMajor ? 0 : 12));
+            }
+        }
+    });
+
+    while (!tracks.empty()) {
+        close(tracks.begin());
+    }
+    return ok;
+}
\ No newline at end of file
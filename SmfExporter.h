@@ -0,0 +1,49 @@
+#pragma once
+
+#include "JournalReader.h"
+#include "MusicTheoryEngine.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Converts journal sessions into Standard MIDI Files (format 0) that a DAW
+// can open alongside the analysis: chord names become marker events, Roman
+// numerals and plugin annotations text events, and estimated key changes key
+// signature events with a marker. The tempo map is estimated per window of
+// tempoWindowNs from the inter-onset intervals, and ticks are derived from
+// it piecewise, so every event keeps its recorded time exactly.
+//
+// The journal is read once for all sessions. Each session holds at most one
+// tempo window of events and writes through its own large buffer; the track
+// length is patched into the chunk header when the session ends.
+class SmfExporter {
+public:
+    struct Options {
+        uint16_t ticksPerQuarter;
+        int64_t tempoWindowNs;
+    };
+
+    struct Result {
+        int32_t sessionId;
+        std::string name;
+        std::string path;
+        uint64_t events;
+        uint64_t markers;      // chord and key markers
+        uint32_t tempoChanges;
+        uint64_t bytes;
+    };
+
+    static Options defaultOptions();
+
+    SmfExporter(MusicTheoryEngine* theoryEngine, const Options& options);
+
+    // Writes <prefix><session id>.mid for every session in the journal
+    bool exportJournal(const JournalReader& journal, const std::string& prefix, std::vector<Result>& results,
+                       std::string& error);
+
+private:
+    class Track;
+
+    MusicTheoryEngine* theoryEngine;
+    Options options;
+};
\ No newline at end of file
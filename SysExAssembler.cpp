@@ -0,0 +1,288 @@
+#include "SysExAssembler.h"
+
+const size_t SysExAssembler::DEFAULT_BUFFER_COUNT;
+const size_t SysExAssembler::DEFAULT_MAX_BYTES;
+const int SysExAssembler::MAX_STREAMS;
+const int SysExAssembler::MAX_SKIPPING;
+const uint32_t SysExAssembler::NO_BUFFER;
+
+SysExAssembler::Message::Message()
+    : owner(nullptr)
+    , buffer(NO_BUFFER)
+{
+}
+
+SysExAssembler::Message::Message(const Message& other)
+    : owner(other.owner)
+    , buffer(other.buffer)
+{
+    if (buffer != NO_BUFFER) {
+        owner->buffers[buffer].references.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+SysExAssembler::Message& SysExAssembler::Message::operator=(const Message& other) {
+    if (this != &other) {
+        if (other.buffer != NO_BUFFER) {
+            other.owner->buffers[other.buffer].references.fetch_add(1, std::memory_order_relaxed);
+        }
+        release();
+        owner = other.owner;
+        buffer = other.buffer;
+    }
+    return *this;
+}
+
+SysExAssembler::Message::~Message() {
+    release();
+}
+
+void SysExAssembler::Message::release() {
+    if (buffer != NO_BUFFER &&
+        owner->buffers[buffer].references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        owner->recycle(buffer);
+    }
+    owner = nullptr;
+    buffer = NO_BUFFER;
+}
+
+bool SysExAssembler::Message::isValid() const {
+    return buffer != NO_BUFFER;
+}
+
+const unsigned char* SysExAssembler::Message::data() const {
+    return owner->buffers[buffer].bytes.get();
+}
+
+size_t SysExAssembler::Message::size() const {
+    return owner->buffers[buffer].size;
+}
+
+int SysExAssembler::Message::sourceId() const {
+    return owner->buffers[buffer].sourceId;
+}
+
+double SysExAssembler::Message::timeStamp() const {
+    return owner->buffers[buffer].timeStamp;
+}
+
+SysExAssembler::SysExAssembler(size_t bufferCount, size_t maxBytes)
+    : bufferCount(bufferCount)
+    , maxBytes(maxBytes)
+    , buffers(new Buffer[bufferCount])
+    , freeHead(0)
+    , completedMask(0)
+    , completedHead(0)
+    , completedTail(0)
+    , completed(0)
+    , completedBytes(0)
+    , oversized(0)
+    , poolExhausted(0)
+    , unterminated(0)
+    , inUse(0)
+{
+    // All memory the producer will ever touch is allocated here
+    for (size_t i = 0; i < bufferCount; i++) {
+        buffers[i].bytes.reset(new unsigned char[maxBytes]);
+        buffers[i].size = 0;
+        buffers[i].references.store(0, std::memory_order_relaxed);
+        buffers[i].nextFree.store(i + 1 < bufferCount ? static_cast<uint32_t>(i + 1) : NO_BUFFER,
+                                  std::memory_order_relaxed);
+    }
+    if (bufferCount == 0) freeHead.store(NO_BUFFER, std::memory_order_relaxed);
+
+    size_t queueSize = 1;
+    while (queueSize < bufferCount) queueSize <<= 1;
+    completedQueue.reset(new std::atomic<uint32_t>[queueSize]);
+    completedMask = queueSize - 1;
+
+    for (Stream& stream : streams) {
+        stream.active = false;
+        stream.sourceId = 0;
+        stream.buffer = NO_BUFFER;
+    }
+    for (Stream& stream : skipping) {
+        stream.active = false;
+        stream.sourceId = 0;
+        stream.buffer = NO_BUFFER;
+    }
+}
+
+SysExAssembler::~SysExAssembler() {
+}
+
+uint32_t SysExAssembler::allocate() {
+    uint64_t head = freeHead.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t index = static_cast<uint32_t>(head);
+        if (index == NO_BUFFER) return NO_BUFFER;
+        uint64_t next = buffers[index].nextFree.load(std::memory_order_relaxed);
+        uint64_t replacement = (((head >> 32) + 1) << 32) | next;
+        if (freeHead.compare_exchange_weak(head, replacement, std::memory_order_acquire,
+                                           std::memory_order_acquire)) {
+            inUse.fetch_add(1, std::memory_order_relaxed);
+            return index;
+        }
+    }
+}
+
+void SysExAssembler::recycle(uint32_t index) {
+    uint64_t head = freeHead.load(std::memory_order_relaxed);
+    for (;;) {
+        buffers[index].nextFree.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        uint64_t replacement = (((head >> 32) + 1) << 32) | index;
+        if (freeHead.compare_exchange_weak(head, replacement, std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+            break;
+        }
+    }
+    inUse.fetch_sub(1, std::memory_order_relaxed);
+}
+
+SysExAssembler::Stream* SysExAssembler::findStream(int sourceId) {
+    for (Stream& stream : streams) {
+        if (stream.active && stream.sourceId == sourceId) return &stream;
+    }
+    for (Stream& stream : skipping) {
+        if (stream.active && stream.sourceId == sourceId) return &stream;
+    }
+    return nullptr;
+}
+
+void SysExAssembler::abandon(Stream& stream) {
+    if (stream.buffer != NO_BUFFER) recycle(stream.buffer);
+    stream.buffer = NO_BUFFER;
+    stream.active = false;
+}
+
+void SysExAssembler::complete(Stream& stream) {
+    if (stream.buffer != NO_BUFFER) {
+        Buffer& buffer = buffers[stream.buffer];
+        buffer.references.store(1, std::memory_order_relaxed);
+        completedBytes.fetch_add(buffer.size, std::memory_order_relaxed);
+        completed.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t position = completedHead.load(std::memory_order_relaxed);
+        completedQueue[position & completedMask].store(stream.buffer, std::memory_order_relaxed);
+        completedHead.store(position + 1, std::memory_order_release);
+    }
+    stream.buffer = NO_BUFFER;
+    stream.active = false;
+}
+
+bool SysExAssembler::feed(int sourceId, double timeStamp, const unsigned char* data, size_t size) {
+    if (size == 0) return false;
+    Stream* stream = findStream(sourceId);
+
+    if (data[0] != 0xF0) {
+        // Real-time messages may fall between chunks without ending the message
+        if (!stream || data[0] >= 0xF8) return false;
+        if ((data[0] & 0x80) && data[0] != 0xF7) {
+            abandon(*stream);
+            unterminated.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        unsigned char byte = data[i];
+        if (byte >= 0xF8) continue;
+
+        if (byte == 0xF0) {
+            if (stream) {
+                abandon(*stream);
+                unterminated.fetch_add(1, std::memory_order_relaxed);
+            }
+            stream = nullptr;
+            for (Stream& candidate : streams) {
+                if (!candidate.active) {
+                    stream = &candidate;
+                    break;
+                }
+            }
+            if (!stream) {
+                // Every stream is busy: the source still needs one to skip to
+                // F7, or the rest of its message would reach the note path
+                poolExhausted.fetch_add(1, std::memory_order_relaxed);
+                for (Stream& candidate : skipping) {
+                    if (!candidate.active) {
+                        stream = &candidate;
+                        break;
+                    }
+                }
+                if (!stream) continue;
+                stream->active = true;
+                stream->sourceId = sourceId;
+                stream->buffer = NO_BUFFER;
+                continue;
+            }
+            stream->active = true;
+            stream->sourceId = sourceId;
+            stream->buffer = allocate();
+            if (stream->buffer == NO_BUFFER) {
+                // Skip to F7 so the rest does not look like stray data
+                poolExhausted.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            Buffer& buffer = buffers[stream->buffer];
+            buffer.bytes[0] = 0xF0;
+            buffer.size = 1;
+            buffer.sourceId = sourceId;
+            buffer.timeStamp = timeStamp;
+            continue;
+        }
+
+        if (!stream) continue;   // bytes after F7 within the same chunk
+        if ((byte & 0x80) && byte != 0xF7) {
+            abandon(*stream);
+            unterminated.fetch_add(1, std::memory_order_relaxed);
+            stream = nullptr;
+            continue;
+        }
+
+        if (stream->buffer != NO_BUFFER) {
+            Buffer& buffer = buffers[stream->buffer];
+            if (buffer.size < maxBytes) {
+                buffer.bytes[buffer.size++] = byte;
+            } else {
+                recycle(stream->buffer);
+                stream->buffer = NO_BUFFER;
+                oversized.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (byte == 0xF7) {
+            complete(*stream);
+            stream = nullptr;
+        }
+    }
+    return true;
+}
+
+bool SysExAssembler::take(Message& message) {
+    uint64_t tail = completedTail.load(std::memory_order_relaxed);
+    if (tail == completedHead.load(std::memory_order_acquire)) return false;
+
+    uint32_t index = completedQueue[tail & completedMask].load(std::memory_order_relaxed);
+    completedTail.store(tail + 1, std::memory_order_release);
+
+    // The queue's reference moves into the handle
+    message.release();
+    message.owner = this;
+    message.buffer = index;
+    return true;
+}
+
+bool SysExAssembler::hasCompleted() const {
+    return completedTail.load(std::memory_order_relaxed) != completedHead.load(std::memory_order_acquire);
+}
+
+SysExAssembler::Stats SysExAssembler::getStats() const {
+    Stats stats;
+    stats.completed = completed.load(std::memory_order_relaxed);
+    stats.bytes = completedBytes.load(std::memory_order_relaxed);
+    stats.oversized = oversized.load(std::memory_order_relaxed);
+    stats.poolExhausted = poolExhausted.load(std::memory_order_relaxed);
+    stats.unterminated = unterminated.load(std::memory_order_relaxed);
+    stats.buffersInUse = inUse.load(std::memory_order_relaxed);
+    return stats;
+}
\ No newline at end of file
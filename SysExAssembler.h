@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Reassembles SysEx from input chunks into buffers taken from a pool that is
+// allocated once, up front. The producer side never allocates and never
+// waits: a message that does not fit, or that finds the pool empty, is
+// dropped and counted while note traffic carries on through the input ring.
+//
+// Completed messages are handed out as Message handles that point into the
+// pool buffer. Copies share it, and the last handle to go returns the buffer
+// to the pool from whichever thread it is on.
+class SysExAssembler {
+public:
+    static const size_t DEFAULT_BUFFER_COUNT = 16;
+    static const size_t DEFAULT_MAX_BYTES = 65536;
+    static const int MAX_STREAMS = 8;          // sources assembling at the same time
+    static const int MAX_SKIPPING = 64;        // sources skipping a message that found no stream
+
+    class Message {
+    public:
+        Message();
+        Message(const Message& other);
+        Message& operator=(const Message& other);
+        ~Message();
+
+        bool isValid() const;
+        const unsigned char* data() const;     // F0 ... F7
+        size_t size() const;
+        int sourceId() const;
+        double timeStamp() const;              // of the first chunk
+
+    private:
+        friend class SysExAssembler;
+        SysExAssembler* owner;
+        uint32_t buffer;
+
+        void release();
+    };
+
+    struct Stats {
+        uint64_t completed;
+        uint64_t bytes;
+        uint64_t oversized;        // longer than the buffer size
+        uint64_t poolExhausted;    // no free buffer or stream when a message started
+        uint64_t unterminated;     // cut short by another status byte or a new F0
+        size_t buffersInUse;
+    };
+
+    SysExAssembler(size_t bufferCount = DEFAULT_BUFFER_COUNT, size_t maxBytes = DEFAULT_MAX_BYTES);
+    ~SysExAssembler();
+
+    // Producer (one thread at a time). Takes the chunk if it starts a SysEx
+    // or continues one from the same source; false means it is not SysEx
+    // and belongs on the ordinary input path.
+    bool feed(int sourceId, double timeStamp, const unsigned char* data, size_t size);
+
+    // Consumer thread: the next completed message, oldest first
+    bool take(Message& message);
+    // Consumer thread: whether take() would return a message
+    bool hasCompleted() const;
+
+    Stats getStats() const;
+
+private:
+    static const uint32_t NO_BUFFER = 0xFFFFFFFF;
+
+    struct Buffer {
+        std::unique_ptr<unsigned char[]> bytes;
+        size_t size;
+        int sourceId;
+        double timeStamp;
+        std::atomic<uint32_t> references;
+        std::atomic<uint32_t> nextFree;
+    };
+
+    // A source in the middle of a message; buffer is NO_BUFFER while the
+    // rest of a dropped message is skipped
+    struct Stream {
+        bool active;
+        int sourceId;
+        uint32_t buffer;
+    };
+
+    size_t bufferCount;
+    size_t maxBytes;
+    std::unique_ptr<Buffer[]> buffers;
+    Stream streams[MAX_STREAMS];
+    Stream skipping[MAX_SKIPPING];   // never hold a buffer
+
+    // Free list: a stack of buffer indices, tagged against ABA
+    std::atomic<uint64_t> freeHead;
+
+    // Completed buffers, producer to consumer; never fuller than the pool
+    std::unique_ptr<std::atomic<uint32_t>[]> completedQueue;
+    size_t completedMask;
+    std::atomic<uint64_t> completedHead;
+    std::atomic<uint64_t> completedTail;
+
+    std::atomic<uint64_t> completed;
+    std::atomic<uint64_t> completedBytes;
+    std::atomic<uint64_t> oversized;
+    std::atomic<uint64_t> poolExhausted;
+    std::atomic<uint64_t> unterminated;
+    std::atomic<size_t> inUse;
+
+    uint32_t allocate();
+    void recycle(uint32_t buffer);
+    Stream* findStream(int sourceId);
+    void abandon(Stream& stream);
+    void complete(Stream& stream);
+};
\ No newline at end of file
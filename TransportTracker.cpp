@@ -0,0 +1,123 @@
+#include "TransportTracker.h"
+#include <cmath>
+
+const int TransportTracker::TICKS_PER_BEAT;
+constexpr double TransportTracker::MAX_TICK_RATIO;
+constexpr double TransportTracker::SMOOTHING;
+
+TransportTracker::TransportTracker()
+    : clockSource(-1)
+    , running(false)
+    , awaitingFirstTick(false)
+    , positionTicks(0)
+    , lastTickNs(0)
+    , periodNs(0.0)
+    , rejectedTicks(0)
+    , publishedRunning(false)
+    , publishedBpm(0.0)
+    , publishedPositionTicks(0)
+    , publishedTicks(0)
+{
+}
+
+bool TransportTracker::onMessage(int sourceId, int64_t timeNs, const unsigned char* data, size_t size) {
+    if (size == 0) return false;
+    unsigned char status = data[0];
+    bool clock = status == 0xF8;
+    if (!clock && status != 0xFA && status != 0xFB && status != 0xFC && status != 0xF2) return false;
+
+    if (clockSource < 0) clockSource = sourceId;
+    if (sourceId != clockSource) return clock;
+
+    switch (status) {
+    case 0xF8:
+        if (lastTickNs > 0) {
+            double interval = static_cast<double>(timeNs - lastTickNs);
+            if (interval < periodNs * MAX_TICK_RATIO && interval > periodNs / MAX_TICK_RATIO) {
+                periodNs += SMOOTHING * (interval - periodNs);
+                rejectedTicks = 0;
+            } else if (periodNs <= 0.0 || ++rejectedTicks >= TICKS_PER_BEAT) {
+                // First interval, or a whole beat at a tempo far from the old one
+                periodNs = interval;
+                rejectedTicks = 0;
+            }
+        }
+        lastTickNs = timeNs;
+        if (running) {
+            if (awaitingFirstTick) {
+                awaitingFirstTick = false;
+            } else {
+                positionTicks++;
+            }
+        }
+        publishedTicks.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case 0xFA:   // Start: from the top on the next tick
+        positionTicks = 0;
+        running = true;
+        awaitingFirstTick = true;
+        break;
+    case 0xFB:   // Continue: from the current song position on the next tick
+        running = true;
+        awaitingFirstTick = true;
+        break;
+    case 0xFC:
+        running = false;
+        break;
+    case 0xF2:   // Song Position Pointer, in sixteenth notes (6 ticks)
+        if (size >= 3) {
+            positionTicks = static_cast<int64_t>((data[1] & 0x7F) | (data[2] & 0x7F) << 7) * 6;
+            awaitingFirstTick = true;
+        }
+        break;
+    }
+    publish();
+    return clock;
+}
+
+double TransportTracker::beatsAt(int64_t timeNs) const {
+    if (clockSource < 0) return -1.0;
+
+    double ticks = static_cast<double>(positionTicks);
+    // Between ticks the position moves on at the measured tempo
+    if (running && !awaitingFirstTick && periodNs > 0.0 && lastTickNs > 0) {
+        double fraction = (timeNs - lastTickNs) / periodNs;
+        ticks += fraction < 0.0 ? 0.0 : (fraction > 1.0 ? 1.0 : fraction);
+    }
+    return ticks / TICKS_PER_BEAT;
+}
+
+void TransportTracker::removeSource(int sourceId) {
+    if (sourceId != clockSource) return;
+    clockSource = -1;
+    running = false;
+    awaitingFirstTick = false;
+    positionTicks = 0;
+    lastTickNs = 0;
+    periodNs = 0.0;
+    rejectedTicks = 0;
+    publish();
+}
+
+void TransportTracker::publish() {
+    publishedRunning.store(running, std::memory_order_relaxed);
+    publishedBpm.store(periodNs > 0.0 ? 60e9 / (periodNs * TICKS_PER_BEAT) : 0.0, std::memory_order_relaxed);
+    publishedPositionTicks.store(positionTicks, std::memory_order_relaxed);
+}
+
+TransportTracker::State TransportTracker::getState() const {
+    State state;
+    state.running = publishedRunning.load(std::memory_order_relaxed);
+    state.bpm = publishedBpm.load(std::memory_order_relaxed);
+    state.locked = state.bpm > 0.0;
+    state.beats = static_cast<double>(publishedPositionTicks.load(std::memory_order_relaxed)) / TICKS_PER_BEAT;
+    state.ticks = publishedTicks.load(std::memory_order_relaxed);
+    return state;
+}
+
+void TransportTracker::toBarBeat(double beats, int beatsPerBar, int& bar, int& beat) {
+    if (beatsPerBar <= 0) beatsPerBar = 4;
+    int64_t whole = static_cast<int64_t>(std::floor(beats < 0.0 ? 0.0 : beats));
+    bar = static_cast<int>(whole / beatsPerBar) + 1;
+    beat = static_cast<int>(whole % beatsPerBar) + 1;
+}
\ No newline at end of file
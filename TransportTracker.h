@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Follows an external MIDI clock: Start / Stop / Continue, Song Position
+// Pointer and 24 ppqn timing clock. Tempo is the tick period smoothed over
+// about a beat; the position is counted in ticks and interpolated between
+// them, so any event can be placed in musical time.
+//
+// onMessage() and beatsAt() run on the ingest thread, one caller at a time,
+// and cost O(1). Only the first source to send transport messages is
+// followed until it goes away. getState() may be called from any thread.
+class TransportTracker {
+public:
+    static const int TICKS_PER_BEAT = 24;
+
+    struct State {
+        bool running;
+        bool locked;          // tempo measured from at least two ticks
+        double bpm;
+        double beats;         // quarter notes since song start, at the last tick
+        uint64_t ticks;       // clock ticks received in total
+    };
+
+    TransportTracker();
+
+    // True for messages that only drive the transport (clock ticks), which
+    // need not be passed on
+    bool onMessage(int sourceId, int64_t timeNs, const unsigned char* data, size_t size);
+    // Song position of an event at timeNs in quarter notes; negative while no
+    // source has sent clock or transport messages
+    double beatsAt(int64_t timeNs) const;
+    // The clock source is gone; the next one to send clock is followed
+    void removeSource(int sourceId);
+
+    State getState() const;
+
+    // "bar:beat" as 1-based numbers for a position from beatsAt()
+    static void toBarBeat(double beats, int beatsPerBar, int& bar, int& beat);
+
+private:
+    // Ticks further off the smoothed period than this are gaps, not tempo
+    static constexpr double MAX_TICK_RATIO = 2.5;
+    static constexpr double SMOOTHING = 1.0 / TICKS_PER_BEAT;
+
+    int clockSource;          // -1 = none yet
+    bool running;
+    bool awaitingFirstTick;   // after Start/Continue the next tick is the position itself
+    int64_t positionTicks;
+    int64_t lastTickNs;
+    double periodNs;          // smoothed tick period, 0 until measured
+    int rejectedTicks;        // consecutive intervals taken as gaps
+
+    // Lock-free copy for other threads
+    std::atomic<bool> publishedRunning;
+    std::atomic<double> publishedBpm;
+    std::atomic<int64_t> publishedPositionTicks;
+    std::atomic<uint64_t> publishedTicks;
+
+    void publish();
+};
\ No newline at end of file
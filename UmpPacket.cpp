@@ -0,0 +1,353 @@
+#include "UmpPacket.h"
+#include <cstring>
+
+const size_t UmpTranslator::MAX_PACKETS;
+
+namespace {
+
+// Words per packet by message type
+const int WORD_COUNTS[16] = {1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4};
+
+const uint8_t NO_PARAMETER = 0x7F;
+const size_t SYSEX_BYTES_PER_PACKET = 6;
+
+} // namespace
+
+int UmpPacket::wordCount(uint8_t messageType) {
+    return WORD_COUNTS[messageType & 0x0F];
+}
+
+size_t UmpParser::split(const uint32_t* words, size_t count, UmpPacket* packets, size_t maxPackets,
+                        size_t& packetCount) {
+    size_t used = 0;
+    packetCount = 0;
+    while (used < count && packetCount < maxPackets) {
+        size_t size = static_cast<size_t>(UmpPacket::wordCount(words[used] >> 28));
+        if (used + size > count) break;
+
+        UmpPacket& packet = packets[packetCount++];
+        std::memset(packet.words, 0, sizeof(packet.words));
+        std::memcpy(packet.words, words + used, size * sizeof(uint32_t));
+        used += size;
+    }
+    return used;
+}
+
+UmpEvent UmpParser::decode(const UmpPacket& packet) {
+    UmpEvent event;
+    std::memset(&event, 0, sizeof(event));
+    event.type = UmpEvent::Type::Unknown;
+    event.group = packet.group();
+
+    uint32_t header = packet.words[0];
+    uint8_t status = (header >> 16) & 0xFF;
+    uint8_t byte2 = (header >> 8) & 0xFF;
+    uint8_t byte3 = header & 0xFF;
+    uint32_t data = packet.words[1];
+    event.channel = status & 0x0F;
+
+    switch (packet.messageType()) {
+    case UmpPacket::System:
+        event.type = UmpEvent::Type::System;
+        event.channel = 0;
+        event.index = status;
+        event.value = (byte2 & 0x7F) | ((byte3 & 0x7F) << 7);   // song position is LSB first
+        break;
+
+    case UmpPacket::Data64:
+        // index: 0 complete, 1 start, 2 continue, 3 end; value: bytes in this packet
+        event.type = UmpEvent::Type::SysEx7;
+        event.channel = 0;
+        event.index = status >> 4;
+        event.value = status & 0x0F;
+        break;
+
+    case UmpPacket::Midi1ChannelVoice:
+        // MIDI 1.0 values in a packet: scaled, but no RPN or bank assembly
+        event.note = byte2 & 0x7F;
+        switch (status & 0xF0) {
+        case 0x80:
+        case 0x90:
+            event.type = (status & 0xF0) == 0x90 && byte3 > 0 ? UmpEvent::Type::NoteOn : UmpEvent::Type::NoteOff;
+            event.velocity = static_cast<uint16_t>(scaleUp(byte3 & 0x7F, 7, 16));
+            break;
+        case 0xA0:
+            event.type = UmpEvent::Type::PolyPressure;
+            event.value = scaleUp(byte3 & 0x7F, 7, 32);
+            break;
+        case 0xB0:
+            event.type = UmpEvent::Type::ControlChange;
+            event.note = 0;
+            event.index = byte2 & 0x7F;
+            event.value = scaleUp(byte3 & 0x7F, 7, 32);
+            break;
+        case 0xC0:
+            event.type = UmpEvent::Type::ProgramChange;
+            event.note = 0;
+            event.index = byte2 & 0x7F;
+            break;
+        case 0xD0:
+            event.type = UmpEvent::Type::ChannelPressure;
+            event.note = 0;
+            event.value = scaleUp(byte2 & 0x7F, 7, 32);
+            break;
+        case 0xE0:
+            event.type = UmpEvent::Type::PitchBend;
+            event.note = 0;
+            event.value = scaleUp((byte2 & 0x7F) | ((byte3 & 0x7F) << 7), 14, 32);
+            break;
+        }
+        break;
+
+    case UmpPacket::Midi2ChannelVoice:
+        switch (status >> 4) {
+        case 0x0:
+        case 0x1:
+            event.type = (status >> 4) == 0x0 ? UmpEvent::Type::RegisteredPerNoteController
+                                              : UmpEvent::Type::AssignablePerNoteController;
+            event.note = byte2 & 0x7F;
+            event.index = byte3;
+            event.value = data;
+            break;
+        case 0x2:
+        case 0x3:
+        case 0x4:
+        case 0x5: {
+            static const UmpEvent::Type controllers[4] = {
+                UmpEvent::Type::RegisteredController, UmpEvent::Type::AssignableController,
+                UmpEvent::Type::RelativeRegisteredController, UmpEvent::Type::RelativeAssignableController};
+            event.type = controllers[(status >> 4) - 0x2];
+            event.bank = byte2 & 0x7F;
+            event.index = byte3 & 0x7F;
+            event.value = data;
+            break;
+        }
+        case 0x6:
+            event.type = UmpEvent::Type::PerNotePitchBend;
+            event.note = byte2 & 0x7F;
+            event.value = data;
+            break;
+        case 0x8:
+        case 0x9:
+            event.type = (status >> 4) == 0x9 ? UmpEvent::Type::NoteOn : UmpEvent::Type::NoteOff;
+            event.note = byte2 & 0x7F;
+            event.attributeType = byte3;
+            event.velocity = static_cast<uint16_t>(data >> 16);
+            event.attribute = static_cast<uint16_t>(data & 0xFFFF);
+            break;
+        case 0xA:
+            event.type = UmpEvent::Type::PolyPressure;
+            event.note = byte2 & 0x7F;
+            event.value = data;
+            break;
+        case 0xB:
+            event.type = UmpEvent::Type::ControlChange;
+            event.index = byte2 & 0x7F;
+            event.value = data;
+            break;
+        case 0xC:
+            event.type = UmpEvent::Type::ProgramChange;
+            event.bankValid = (byte3 & 0x01) != 0;
+            event.index = (data >> 24) & 0x7F;
+            event.programBank = static_cast<uint16_t>((((data >> 8) & 0x7F) << 7) | (data & 0x7F));
+            break;
+        case 0xD:
+            event.type = UmpEvent::Type::ChannelPressure;
+            event.value = data;
+            break;
+        case 0xE:
+            event.type = UmpEvent::Type::PitchBend;
+            event.value = data;
+            break;
+        case 0xF:
+            event.type = UmpEvent::Type::PerNoteManagement;
+            event.note = byte2 & 0x7F;
+            event.attributeType = byte3;
+            break;
+        }
+        break;
+
+    default:
+        // Utility, 8-bit SysEx, flex data and stream messages are not interpreted
+        event.channel = 0;
+        break;
+    }
+
+    return event;
+}
+
+uint32_t UmpParser::scaleUp(uint32_t value, int sourceBits, int destinationBits) {
+    int scaleBits = destinationBits - sourceBits;
+    uint64_t shifted = static_cast<uint64_t>(value) << scaleBits;
+    uint32_t centre = 1u << (sourceBits - 1);
+    if (value <= centre) return static_cast<uint32_t>(shifted);
+
+    // Above the centre, fill the new low bits by repeating the value's
+    // bits below its MSB, so the maximum lands on all ones
+    int repeatBits = sourceBits - 1;
+    uint64_t repeat = value & ((1u << repeatBits) - 1);
+    repeat = scaleBits > repeatBits ? repeat << (scaleBits - repeatBits) : repeat >> (repeatBits - scaleBits);
+    while (repeat != 0) {
+        shifted |= repeat;
+        repeat >>= repeatBits;
+    }
+    return static_cast<uint32_t>(shifted);
+}
+
+uint32_t UmpParser::scaleDown(uint32_t value, int sourceBits, int destinationBits) {
+    return value >> (sourceBits - destinationBits);
+}
+
+UmpTranslator::UmpTranslator(uint8_t group)
+    : group(group & 0x0F)
+{
+    reset();
+}
+
+void UmpTranslator::reset() {
+    for (ChannelState& channel : channels) {
+        channel.bankMsb = 0;
+        channel.bankLsb = 0;
+        channel.bankValid = false;
+        channel.parameterMsb = NO_PARAMETER;
+        channel.parameterLsb = NO_PARAMETER;
+        channel.registered = true;
+        channel.dataMsb = 0;
+    }
+}
+
+uint32_t UmpTranslator::header(uint8_t messageType, uint8_t status, uint8_t byte2, uint8_t byte3) const {
+    return (static_cast<uint32_t>(messageType) << 28) | (static_cast<uint32_t>(group) << 24) |
+           (static_cast<uint32_t>(status) << 16) | (static_cast<uint32_t>(byte2) << 8) | byte3;
+}
+
+size_t UmpTranslator::translate(const unsigned char* data, size_t size, UmpPacket* packets) {
+    if (size == 0 || data[0] < 0x80) return 0;   // complete messages only
+    uint8_t status = data[0];
+
+    if (status == 0xF0) return sysEx(data, size, packets);
+
+    UmpPacket& packet = packets[0];
+    std::memset(packet.words, 0, sizeof(packet.words));
+
+    if (status > 0xF0) {
+        if (status == 0xF4 || status == 0xF5 || status == 0xF7) return 0;   // undefined or stray EOX
+        uint8_t data1 = size > 1 ? data[1] & 0x7F : 0;
+        uint8_t data2 = size > 2 && status == 0xF2 ? data[2] & 0x7F : 0;
+        packet.words[0] = header(UmpPacket::System, status, data1, data2);
+        return 1;
+    }
+
+    uint8_t channel = status & 0x0F;
+    uint8_t kind = status & 0xF0;
+    size_t needed = kind == 0xC0 || kind == 0xD0 ? 2 : 3;
+    if (size < needed) return 0;
+    uint8_t data1 = data[1] & 0x7F;
+    uint8_t data2 = needed > 2 ? data[2] & 0x7F : 0;
+
+    switch (kind) {
+    case 0x80:
+        packet.words[0] = header(UmpPacket::Midi2ChannelVoice, status, data1, 0);
+        packet.words[1] = UmpParser::scaleUp(data2, 7, 16) << 16;
+        return 1;
+    case 0x90:
+        // Velocity 0 is a note off in MIDI 1.0 but a valid note on in MIDI 2.0
+        packet.words[0] = header(UmpPacket::Midi2ChannelVoice, data2 > 0 ? status : (0x80 | channel), data1, 0);
+        packet.words[1] = UmpParser::scaleUp(data2, 7, 16) << 16;
+        return 1;
+    case 0xA0:
+        packet.words[0] = header(UmpPacket::Midi2ChannelVoice, status, data1, 0);
+        packet.words[1] = UmpParser::scaleUp(data2, 7, 32);
+        return 1;
+    case 0xB0:
+        return controlChange(channel, data1, data2, packets);
+    case 0xC0: {
+        ChannelState& state = channels[channel];
+        packet.words[0] = header(UmpPacket::Midi2ChannelVoice, status, 0, state.bankValid ? 0x01 : 0x00);
+        packet.words[1] = (static_cast<uint32_t>(data1) << 24) |
+                          (state.bankValid ? (static_cast<uint32_t>(state.bankMsb) << 8) | state.bankLsb : 0);
+        return 1;
+    }
+    case 0xD0:
+        packet.words[0] = header(UmpPacket::Midi2ChannelVoice, status, 0, 0);
+        packet.words[1] = UmpParser::scaleUp(data1, 7, 32);
+        return 1;
+    case 0xE0:
+        packet.words[0] = header(UmpPacket::Midi2ChannelVoice, status, 0, 0);
+        packet.words[1] = UmpParser::scaleUp(data1 | (data2 << 7), 14, 32);
+        return 1;
+    }
+    return 0;
+}
+
+size_t UmpTranslator::controlChange(uint8_t channel, uint8_t index, uint8_t value, UmpPacket* packets) {
+    ChannelState& state = channels[channel];
+    bool parameterSelected = state.parameterMsb != NO_PARAMETER || state.parameterLsb != NO_PARAMETER;
+    UmpPacket& packet = packets[0];
+
+    switch (index) {
+    case 0:
+        state.bankMsb = value;
+        state.bankValid = true;
+        return 0;
+    case 32:
+        state.bankLsb = value;
+        state.bankValid = true;
+        return 0;
+    case 99:
+    case 101:
+        state.parameterMsb = value;
+        state.registered = index == 101;
+        state.dataMsb = 0;
+        return 0;
+    case 98:
+    case 100:
+        state.parameterLsb = value;
+        state.registered = index == 100;
+        state.dataMsb = 0;
+        return 0;
+    case 6:
+    case 38:
+        if (!parameterSelected) break;
+        // Data entry MSB sends the coarse value at once; a following LSB refines it
+        if (index == 6) state.dataMsb = value;
+        packet.words[0] = header(UmpPacket::Midi2ChannelVoice, (state.registered ? 0x20 : 0x30) | channel,
+                                 state.parameterMsb, state.parameterLsb);
+        packet.words[1] = UmpParser::scaleUp((state.dataMsb << 7) | (index == 38 ? value : 0), 14, 32);
+        return 1;
+    }
+
+    packet.words[0] = header(UmpPacket::Midi2ChannelVoice, 0xB0 | channel, index, 0);
+    packet.words[1] = UmpParser::scaleUp(value, 7, 32);
+    return 1;
+}
+
+size_t UmpTranslator::sysEx(const unsigned char* data, size_t size, UmpPacket* packets) {
+    // Payload without F0 and the closing F7
+    const unsigned char* payload = data + 1;
+    size_t length = size - 1;
+    if (length > 0 && payload[length - 1] == 0xF7) length--;
+
+    size_t packetCount = (length + SYSEX_BYTES_PER_PACKET - 1) / SYSEX_BYTES_PER_PACKET;
+    if (packetCount == 0) packetCount = 1;
+    if (packetCount > MAX_PACKETS) {
+        packetCount = MAX_PACKETS;
+        length = MAX_PACKETS * SYSEX_BYTES_PER_PACKET;
+    }
+
+    for (size_t i = 0; i < packetCount; i++) {
+        size_t offset = i * SYSEX_BYTES_PER_PACKET;
+        size_t bytes = length - offset < SYSEX_BYTES_PER_PACKET ? length - offset : SYSEX_BYTES_PER_PACKET;
+        uint8_t status = packetCount == 1 ? 0x0 : i == 0 ? 0x1 : i + 1 == packetCount ? 0x3 : 0x2;
+
+        unsigned char chunk[SYSEX_BYTES_PER_PACKET] = {0, 0, 0, 0, 0, 0};
+        for (size_t j = 0; j < bytes; j++) chunk[j] = payload[offset + j] & 0x7F;
+
+        UmpPacket& packet = packets[i];
+        std::memset(packet.words, 0, sizeof(packet.words));
+        packet.words[0] = header(UmpPacket::Data64, static_cast<uint8_t>((status << 4) | bytes), chunk[0], chunk[1]);
+        packet.words[1] = (static_cast<uint32_t>(chunk[2]) << 24) | (static_cast<uint32_t>(chunk[3]) << 16) |
+                          (static_cast<uint32_t>(chunk[4]) << 8) | chunk[5];
+    }
+    return packetCount;
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// MIDI 2.0 Universal MIDI Packet: one to four 32-bit words, the first of
+// which names the message type and with it the packet length. Packets are
+// fixed-size and word-aligned, so they can be copied around the ingest path
+// like any other plain value.
+struct alignas(16) UmpPacket {
+    enum MessageType : uint8_t {
+        Utility = 0x0,
+        System = 0x1,
+        Midi1ChannelVoice = 0x2,
+        Data64 = 0x3,              // 7-bit SysEx
+        Midi2ChannelVoice = 0x4,
+        Data128 = 0x5,             // 8-bit SysEx, mixed data sets
+        FlexData = 0xD,
+        Stream = 0xF
+    };
+
+    uint32_t words[4];
+
+    uint8_t messageType() const { return words[0] >> 28; }
+    uint8_t group() const { return (words[0] >> 24) & 0x0F; }
+    int wordCount() const { return wordCount(messageType()); }
+
+    static int wordCount(uint8_t messageType);
+};
+
+// A decoded packet. Values keep the resolution the packet carried: 16-bit
+// velocity and attribute, 32-bit controllers, pressure and pitch bend.
+struct UmpEvent {
+    enum class Type : uint8_t {
+        NoteOff,
+        NoteOn,
+        PolyPressure,
+        ControlChange,
+        ProgramChange,
+        ChannelPressure,
+        PitchBend,
+        RegisteredPerNoteController,
+        AssignablePerNoteController,
+        PerNotePitchBend,
+        PerNoteManagement,
+        RegisteredController,        // RPN
+        AssignableController,        // NRPN
+        RelativeRegisteredController,
+        RelativeAssignableController,
+        System,                      // status in index
+        SysEx7,                      // bytes stay in the packet
+        Unknown
+    };
+
+    Type type;
+    uint8_t group;
+    uint8_t channel;
+    uint8_t note;           // notes, pressure and per-note messages
+    uint8_t index;          // controller index, program number or system status
+    uint8_t bank;           // RPN/NRPN bank (MSB)
+    uint8_t attributeType;  // note attribute type, or per-note management flags
+    bool bankValid;         // program change carries a bank
+    uint16_t velocity;
+    uint16_t attribute;
+    uint16_t programBank;   // 14-bit bank of a program change
+    uint32_t value;         // controller, pressure, bend (0x80000000 = centre), system data
+};
+
+// Packet splitting, decoding and value scaling.
+class UmpParser {
+public:
+    // Splits a stream of words into packets; a truncated trailing packet is
+    // left unconsumed. Returns the words used.
+    static size_t split(const uint32_t* words, size_t count, UmpPacket* packets, size_t maxPackets,
+                        size_t& packetCount);
+
+    static UmpEvent decode(const UmpPacket& packet);
+
+    // Min-centre-max scaling from the MIDI 2.0 specification: the midpoint of
+    // the source range maps to the midpoint of the destination and the
+    // maximum to the maximum. scaleDown(scaleUp(v)) == v for every v.
+    static uint32_t scaleUp(uint32_t value, int sourceBits, int destinationBits);
+    static uint32_t scaleDown(uint32_t value, int sourceBits, int destinationBits);
+};
+
+// Converts complete MIDI 1.0 messages from one source into MIDI 2.0 channel
+// voice packets. Bank select is folded into the next program change, and
+// RPN/NRPN parameter selection with its data entry becomes one registered or
+// assignable controller message, so every value survives at full resolution
+// and no MIDI 1.0 state is needed downstream. One instance per source.
+class UmpTranslator {
+public:
+    static const size_t MAX_PACKETS = 8;   // per message: 48 bytes of SysEx
+
+    explicit UmpTranslator(uint8_t group = 0);
+
+    // Returns the packets written; SysEx longer than MAX_PACKETS * 6 bytes is
+    // truncated, ending with an end packet
+    size_t translate(const unsigned char* data, size_t size, UmpPacket* packets);
+
+    void reset();
+
+private:
+    struct ChannelState {
+        uint8_t bankMsb;
+        uint8_t bankLsb;
+        bool bankValid;
+        uint8_t parameterMsb;   // selected RPN/NRPN, 0x7F 0x7F = none
+        uint8_t parameterLsb;
+        bool registered;        // RPN rather than NRPN
+        uint8_t dataMsb;
+    };
+
+    uint8_t group;
+    ChannelState channels[16];
+
+    uint32_t header(uint8_t messageType, uint8_t status, uint8_t byte2, uint8_t byte3) const;
+    size_t controlChange(uint8_t channel, uint8_t index, uint8_t value, UmpPacket* packets);
+    size_t sysEx(const unsigned char* data, size_t size, UmpPacket* packets);
+};
\ No newline at end of file
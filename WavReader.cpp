@@ -0,0 +1,154 @@
+#include "WavReader.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+uint16_t readU16(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+uint32_t readU32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+const uint16_t WAVE_FORMAT_PCM = 1;
+const uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+} // namespace
+
+WavReader::WavReader()
+    : file(nullptr)
+    , sampleRate(0)
+    , channels(0)
+    , bitsPerSample(0)
+    , isFloat(false)
+    , blockAlign(0)
+    , frameCount(0)
+    , bytesRemaining(0)
+{
+}
+
+WavReader::~WavReader() {
+    if (file) {
+        std::fclose(file);
+    }
+}
+
+bool WavReader::open(const std::string& path, std::string& error) {
+    file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+    unsigned char header[12];
+    if (std::fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        std::memcmp(header, "RIFF", 4) != 0 || std::memcmp(header + 8, "WAVE", 4) != 0) {
+        error = path + " is not a WAV file";
+        return false;
+    }
+
+    // Walk the chunks until "data"; "fmt " must come first
+    bool haveFormat = false;
+    unsigned char chunk[8];
+    while (std::fread(chunk, 1, sizeof(chunk), file) == sizeof(chunk)) {
+        uint32_t chunkSize = readU32(chunk + 4);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0) {
+            unsigned char format[40] = {};
+            size_t toRead = std::min<size_t>(chunkSize, sizeof(format));
+            if (chunkSize < 16 || std::fread(format, 1, toRead, file) != toRead) break;
+            std::fseek(file, static_cast<long>(chunkSize - toRead + (chunkSize & 1)), SEEK_CUR);
+
+            uint16_t tag = readU16(format);
+            if (tag == WAVE_FORMAT_EXTENSIBLE && chunkSize >= 26) {
+                tag = readU16(format + 24); // first two bytes of the subformat GUID
+            }
+            channels = readU16(format + 2);
+            sampleRate = static_cast<int>(readU32(format + 4));
+            blockAlign = readU16(format + 12);
+            bitsPerSample = readU16(format + 14);
+            isFloat = tag == WAVE_FORMAT_IEEE_FLOAT;
+
+            bool supported = (tag == WAVE_FORMAT_PCM && bitsPerSample >= 8 && bitsPerSample <= 32 &&
+                              bitsPerSample % 8 == 0) ||
+                             (isFloat && bitsPerSample == 32);
+            if (!supported || channels == 0 || sampleRate == 0 ||
+                blockAlign != static_cast<size_t>(channels * bitsPerSample / 8)) {
+                error = path + ": unsupported sample format";
+                return false;
+            }
+            haveFormat = true;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!haveFormat) break;
+            bytesRemaining = chunkSize - chunkSize % blockAlign;
+            frameCount = bytesRemaining / blockAlign;
+            return true;
+        } else {
+            std::fseek(file, static_cast<long>(chunkSize + (chunkSize & 1)), SEEK_CUR);
+        }
+    }
+
+    error = path + ": no audio data";
+    return false;
+}
+
+int WavReader::getSampleRate() const {
+    return sampleRate;
+}
+
+int WavReader::getChannels() const {
+    return channels;
+}
+
+uint64_t WavReader::getFrameCount() const {
+    return frameCount;
+}
+
+float WavReader::decodeSample(const unsigned char* p) const {
+    switch (bitsPerSample) {
+    case 8:
+        return (static_cast<int>(p[0]) - 128) / 128.0f;
+    case 16:
+        return static_cast<int16_t>(readU16(p)) / 32768.0f;
+    case 24: {
+        int32_t value = static_cast<int32_t>(static_cast<uint32_t>(p[0]) << 8 | static_cast<uint32_t>(p[1]) << 16 |
+                                             static_cast<uint32_t>(p[2]) << 24);
+        return (value >> 8) / 8388608.0f;
+    }
+    default:
+        if (isFloat) {
+            float value;
+            uint32_t bits = readU32(p);
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        return static_cast<int32_t>(readU32(p)) / 2147483648.0f;
+    }
+}
+
+size_t WavReader::readMono(float* output, size_t maxFrames) {
+    if (!file || bytesRemaining == 0) return 0;
+
+    size_t wanted = static_cast<size_t>(std::min<uint64_t>(maxFrames, bytesRemaining / blockAlign));
+    raw.resize(wanted * blockAlign);
+    size_t frames = std::fread(raw.data(), 1, raw.size(), file) / blockAlign;
+    bytesRemaining = frames < wanted ? 0 : bytesRemaining - frames * blockAlign;
+
+    size_t sampleBytes = static_cast<size_t>(bitsPerSample / 8);
+    float gain = 1.0f / channels;
+    for (size_t frame = 0; frame < frames; frame++) {
+        const unsigned char* p = raw.data() + frame * blockAlign;
+        float sum = 0.0f;
+        for (int channel = 0; channel < channels; channel++) {
+            sum += decodeSample(p + channel * sampleBytes);
+        }
+        output[frame] = sum * gain;
+    }
+    return frames;
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Streaming reader for RIFF/WAVE files: 8/16/24/32-bit integer PCM and
+// 32-bit float, any channel count, including WAVE_FORMAT_EXTENSIBLE. Audio
+// is read block by block and downmixed to mono, so memory use does not grow
+// with the length of the recording.
+class WavReader {
+public:
+    WavReader();
+    ~WavReader();
+
+    bool open(const std::string& path, std::string& error);
+
+    int getSampleRate() const;
+    int getChannels() const;
+    uint64_t getFrameCount() const;
+
+    // Reads up to maxFrames frames as mono samples in [-1, 1]; 0 at the end
+    size_t readMono(float* output, size_t maxFrames);
+
+private:
+    std::FILE* file;
+    int sampleRate;
+    int channels;
+    int bitsPerSample;
+    bool isFloat;
+    size_t blockAlign;
+    uint64_t frameCount;
+    uint64_t bytesRemaining;
+    std::vector<unsigned char> raw;
+
+    float decodeSample(const unsigned char* p) const;
+};
\ No newline at end of file
@@ -1,15 +1,832 @@
 #include <QApplication>
+#include <QCommandLineParser>
 #include "MidiKeyboardMonitor.h"
+#include "SessionServer.h"
+#include "JournalReader.h"
+#include "AudioTranscriber.h"
+#include "ChromaEngine.h"
+#include "EventArchive.h"
+#include "FingerprintIndex.h"
+#include "LeadSheetExporter.h"
+#include "OnsetAligner.h"
+#include "OnsetDetector.h"
+#include "PracticeAnalytics.h"
+#include "SessionCatalog.h"
+#include "SmfExporter.h"
+#include "WavReader.h"
+#ifdef MIDI_MONITOR_ALSA
+#include "MidiInputBench.h"
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+static RtpMidiSession::JitterConfig parseJitterConfig(const QString& value) {
+    RtpMidiSession::JitterConfig jitter = RtpMidiSession::defaultJitterConfig();
+    if (value.startsWith("fixed")) {
+        jitter.mode = RtpMidiSession::JitterMode::Fixed;
+        if (value.startsWith("fixed:")) {
+            jitter.fixedDelayMs = value.mid(6).toDouble();
+        }
+    }
+    return jitter;
+}
+
+// Prints every session's state at <seconds> after the journal's first session opened
+static int inspectJournal(const QString& path, double seconds) {
+    JournalReader journal;
+    std::string error;
+    if (!journal.open(path, error)) {
+        std::cerr << "Failed to open journal: " << error << std::endl;
+        return 1;
+    }
+    if (journal.getSessions().empty()) return 0;
+
+    int64_t firstWallClockMs = journal.getSessions().front().wallClockMs;
+    for (const JournalReader::SessionInfo& info : journal.getSessions()) {
+        firstWallClockMs = std::min(firstWallClockMs, info.wallClockMs);
+    }
+
+    MusicTheoryEngine* theoryEngine = &MusicTheoryEngine::instance();
+    for (const JournalReader::SessionInfo& info : journal.getSessions()) {
+        int64_t timeNs = info.openTimeNs + static_cast<int64_t>(seconds * 1e9) -
+                         (info.wallClockMs - firstWallClockMs) * 1000000;
+        size_t replayed = 0;
+        std::unique_ptr<AnalysisSession> session = journal.restoreSession(info.sessionId, timeNs, theoryEngine, &replayed);
+        if (!session) continue;
+
+        SessionSnapshot state = session->takeSnapshot();
+        std::cout << "[" << info.name << "] " << state.chord;
+        if (!state.roman.empty()) std::cout << " (" << state.roman << ")";
+        std::cout << ", " << state.heldNotes.count() << " held" << (state.sustainDown ? ", pedal down" : "")
+                  << ", " << replayed << " events replayed" << std::endl;
+    }
+    return 0;
+}
+
+// Transcribes WAV recordings and prints their chord changes
+static int analyzeAudio(const QStringList& files, int keySignatureIndex, int workerCount, OutputSink* output) {
+    std::vector<std::string> paths;
+    for (const QString& file : files) {
+        paths.push_back(file.toStdString());
+    }
+
+    std::mutex printMutex;
+    AudioTranscriber transcriber(keySignatureIndex, workerCount, output);
+    std::vector<AudioTranscriber::Result> results = transcriber.run(
+        paths, [&](const std::string& path, double timeSeconds, const AnalysisSession& session) {
+            if (output) return;
+            std::lock_guard<std::mutex> lock(printMutex);
+            std::cout << "[" << path << " " << timeSeconds << "s] " << session.getChordName().toStdString();
+            if (!session.getRomanNumeral().isEmpty()) {
+                std::cout << " (" << session.getRomanNumeral().toStdString() << ")";
+            }
+            std::cout << '\n';
+        });
+
+    int failures = 0;
+    for (const AudioTranscriber::Result& result : results) {
+        if (!result.ok) {
+            std::cerr << "Failed to analyze " << result.path << ": " << result.error << std::endl;
+            failures++;
+            continue;
+        }
+        std::cout << result.path << ": " << result.audioSeconds << "s of audio in " << result.elapsedSeconds
+                  << "s (" << result.audioSeconds / std::max(result.elapsedSeconds, 1e-9) << "x real time), "
+                  << result.noteEvents << " note events, key estimate "
+                  << MusicTheoryEngine::instance().getKeySignature(result.estimatedKeyIndex).name
+                  << " (r=" << result.keyCorrelation << ")" << std::endl;
+    }
+    return failures > 0 ? 1 : 0;
+}
+
+// Matches the onsets of a WAV recording against a journal session's note-ons
+static int alignAudio(const QString& wavPath, const QString& journalPath, int sessionId) {
+    JournalReader journal;
+    std::string error;
+    if (!journal.open(journalPath, error)) {
+        std::cerr << "Failed to open journal: " << error << std::endl;
+        return 1;
+    }
+    if (sessionId < 0) {
+        if (journal.getSessions().empty()) {
+            std::cerr << "Journal has no sessions" << std::endl;
+            return 1;
+        }
+        sessionId = journal.getSessions().front().sessionId;
+    }
+
+    WavReader wav;
+    if (!wav.open(wavPath.toStdString(), error)) {
+        std::cerr << "Failed to open " << wavPath.toStdString() << ": " << error << std::endl;
+        return 1;
+    }
+
+    // Chroma of both sides on one frame grid, summed: the key each implies
+    // and how closely their pitch content agrees
+    float midiProfile[ChromaEngine::BINS] = {};
+    float audioProfile[ChromaEngine::BINS] = {};
+    auto sumInto = [](float* profile) {
+        return [profile](const float* frames, size_t frameCount) {
+            for (size_t i = 0; i < frameCount * ChromaEngine::BINS; i++) {
+                profile[i % ChromaEngine::BINS] += frames[i];
+            }
+        };
+    };
+    ChromaEngine midiChroma(wav.getSampleRate(), ChromaEngine::defaultConfig(), sumInto(midiProfile));
+    ChromaEngine audioChroma(wav.getSampleRate(), ChromaEngine::defaultConfig(), sumInto(audioProfile));
+
+    std::vector<double> noteOns;
+    double lastMidiTime = 0.0;
+    journal.forEachMidi(sessionId, [&](int64_t timeNs, const unsigned char* data, size_t size) {
+        if (size >= 3 && (data[0] & 0xF0) == 0x90 && data[2] > 0) {
+            noteOns.push_back(timeNs / 1e9);
+        }
+        lastMidiTime = std::max(lastMidiTime, timeNs / 1e9);
+        midiChroma.processMidi(lastMidiTime, data, size);
+    });
+    midiChroma.flush(lastMidiTime);
+
+    std::vector<double> onsets;
+    OnsetDetector detector(wav.getSampleRate(), OnsetDetector::defaultConfig());
+    auto onOnset = [&](double timeSeconds, float) { onsets.push_back(timeSeconds); };
+    std::vector<float> block(65536);
+    while (size_t frames = wav.readMono(block.data(), block.size())) {
+        detector.process(block.data(), frames, onOnset);
+        audioChroma.processAudio(block.data(), frames);
+    }
+    detector.finish(onOnset);
+    audioChroma.flush();
+
+    std::sort(noteOns.begin(), noteOns.end());
+    OnsetAligner aligner(OnsetAligner::defaultConfig());
+    OnsetAligner::Result result = aligner.align(noteOns, onsets);
+
+    for (const OnsetAligner::Match& match : result.matches) {
+        std::cout << "MIDI " << match.midiTime << "s -> audio " << match.audioTime << "s ("
+                  << (match.audioTime - match.midiTime) * 1000.0 << " ms)" << '\n';
+    }
+    std::cout << result.matches.size() << " of " << result.midiOnsets << " MIDI onsets matched ("
+              << result.audioOnsets << " audio onsets), offset " << result.offsetSeconds * 1000.0
+              << " ms, latency median " << result.latencyMedianMs << " ms, jitter " << result.latencyJitterMs
+              << " ms, range " << result.latencyMinMs << ".." << result.latencyMaxMs << " ms" << std::endl;
+
+    MusicTheoryEngine* theoryEngine = &MusicTheoryEngine::instance();
+    float midiCorrelation = 0.0f;
+    float audioCorrelation = 0.0f;
+    int midiKey = theoryEngine->estimateKey(midiProfile, &midiCorrelation);
+    int audioKey = theoryEngine->estimateKey(audioProfile, &audioCorrelation);
+    double dot = 0.0, midiNorm = 0.0, audioNorm = 0.0;
+    for (int bin = 0; bin < ChromaEngine::BINS; bin++) {
+        dot += midiProfile[bin] * audioProfile[bin];
+        midiNorm += midiProfile[bin] * midiProfile[bin];
+        audioNorm += audioProfile[bin] * audioProfile[bin];
+    }
+    double similarity = midiNorm > 0.0 && audioNorm > 0.0 ? dot / std::sqrt(midiNorm * audioNorm) : 0.0;
+    std::cout << "Key from MIDI: " << theoryEngine->getKeySignature(midiKey).name << " (r = " << midiCorrelation
+              << "), from audio: " << theoryEngine->getKeySignature(audioKey).name << " (r = " << audioCorrelation
+              << "), chroma similarity " << similarity << std::endl;
+    return 0;
+}
+
+// Writes every journal session to <prefix><session id>.marc
+static int archiveJournal(const QString& journalPath, const QString& prefix) {
+    JournalReader journal;
+    std::string error;
+    if (!journal.open(journalPath, error)) {
+        std::cerr << "Failed to open journal: " << error << std::endl;
+        return 1;
+    }
+
+    for (const JournalReader::SessionInfo& info : journal.getSessions()) {
+        std::string path = prefix.toStdString() + std::to_string(info.sessionId) + ".marc";
+        EventArchiveWriter archive;
+        if (!archive.open(path, error)) {
+            std::cerr << "Failed to create archive: " << error << std::endl;
+            return 1;
+        }
+        journal.forEachMidi(info.sessionId, [&](int64_t timeNs, const unsigned char* data, size_t size) {
+            archive.append(timeNs, data, size);
+        });
+        if (!archive.close(error)) {
+            std::cerr << "Failed to write " << path << ": " << error << std::endl;
+            return 1;
+        }
+        std::cout << "[" << info.name << "] " << archive.getEventCount() << " events -> " << path << " ("
+                  << archive.getBytesWritten() << " bytes)" << std::endl;
+    }
+    return 0;
+}
+
+// Writes every journal session to <prefix><session id>.mid with its analysis as meta events
+static int exportSmf(const QString& journalPath, const QString& prefix) {
+    JournalReader journal;
+    std::string error;
+    if (!journal.open(journalPath, error)) {
+        std::cerr << "Failed to open journal: " << error << std::endl;
+        return 1;
+    }
+
+    SmfExporter exporter(&MusicTheoryEngine::instance(), SmfExporter::defaultOptions());
+    std::vector<SmfExporter::Result> results;
+    auto start = std::chrono::steady_clock::now();
+    if (!exporter.exportJournal(journal, prefix.toStdString(), results, error)) {
+        std::cerr << "Failed to export: " << error << std::endl;
+        return 1;
+    }
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (const SmfExporter::Result& result : results) {
+        std::cout << "[" << result.name << "] " << result.events << " events, " << result.markers << " markers, "
+                  << result.tempoChanges << " tempo changes -> " << result.path << " (" << result.bytes << " bytes)"
+                  << std::endl;
+    }
+    std::cout << "Exported " << results.size() << " sessions in " << elapsedMs << " ms" << std::endl;
+    return 0;
+}
+
+// Writes every journal session to <prefix><session id>.musicxml as a lead sheet
+static int exportLeadSheets(const QString& journalPath, const QString& prefix, float tempoBpm) {
+    JournalReader journal;
+    std::string error;
+    if (!journal.open(journalPath, error)) {
+        std::cerr << "Failed to open journal: " << error << std::endl;
+        return 1;
+    }
+
+    LeadSheetExporter::Options options = LeadSheetExporter::defaultOptions();
+    options.tempoBpm = tempoBpm;
+    LeadSheetExporter exporter(&MusicTheoryEngine::instance(), options);
+    for (const JournalReader::SessionInfo& info : journal.getSessions()) {
+        QString path = prefix + QString::number(info.sessionId) + ".musicxml";
+        LeadSheetExporter::Result result;
+        if (!exporter.exportSession(journal, info, path, result, error)) {
+            std::cerr << "Failed to export " << path.toStdString() << ": " << error << std::endl;
+            return 1;
+        }
+        std::cout << "[" << info.name << "] " << result.keyName << ", " << result.tempoBpm << " BPM, "
+                  << result.measures << " measures, " << result.notes << " notes, " << result.chords
+                  << " chord symbols -> " << path.toStdString() << std::endl;
+    }
+    return 0;
+}
+
+#ifdef MIDI_MONITOR_ALSA
+// Drives one input backend with the virtual-port load generator and reports
+// delivery latency and CPU cost
+static int benchMidiInput(const QString& backend, int rate, int seconds) {
+    MidiInputBench::Result result;
+    std::string error;
+    std::cout << "Sending " << rate << " notes/s for " << seconds << " s through " << backend.toStdString()
+              << "..." << std::endl;
+    if (!MidiInputBench::run(backend.toStdString(), rate, seconds, result, error)) {
+        std::cerr << "Benchmark failed: " << error << std::endl;
+        return 1;
+    }
+    std::cout << backend.toStdString() << ": " << result.received << "/" << result.sent << " received, latency p50 "
+              << result.latencyMedianUs << " us, p99 " << result.latencyP99Us << " us, max " << result.latencyMaxUs
+              << " us, CPU " << result.cpuMs << " ms (" << result.cpuUsPerEvent << " us/event)";
+    if (result.wakeups > 0) {
+        std::cout << ", " << result.wakeups << " wakeups";
+    }
+    std::cout << std::endl;
+    return 0;
+}
+#endif
+
+// Decodes a whole archive and reports its span and decode speed
+static int inspectArchive(const QString& path) {
+    EventArchiveReader archive;
+    std::string error;
+    if (!archive.open(path, error)) {
+        std::cerr << "Failed to open archive: " << error << std::endl;
+        return 1;
+    }
+
+    std::vector<EventArchiveReader::Event> events;
+    std::vector<unsigned char> longMessages;
+    uint64_t decoded = 0;
+    int64_t lastTimeNs = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t block = 0; block < archive.getBlockCount(); block++) {
+        if (!archive.decodeBlock(block, events, longMessages)) {
+            std::cerr << "Block " << block << " is damaged" << std::endl;
+            return 1;
+        }
+        decoded += events.size();
+        if (!events.empty()) lastTimeNs = events.back().timeNs;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double firstSeconds = archive.getBlockCount() > 0 ? archive.getBlockStartNs(0) / 1e9 : 0.0;
+    std::cout << decoded << " events in " << archive.getBlockCount() << " blocks, " << firstSeconds << "s to "
+              << lastTimeNs / 1e9 << "s, decoded at " << decoded / std::max(elapsed, 1e-9) / 1e6
+              << "M events/s" << std::endl;
+    return 0;
+}
+
+// --student device=name tags
+static bool parseStudents(const QStringList& tags, std::map<std::string, std::string>& students) {
+    for (const QString& tag : tags) {
+        int separator = tag.indexOf('=');
+        if (separator <= 0) {
+            std::cerr << "Expected --student device=name, got " << tag.toStdString() << std::endl;
+            return false;
+        }
+        students[tag.left(separator).toStdString()] = tag.mid(separator + 1).toStdString();
+    }
+    return true;
+}
+
+// --transform device=spec rules, first match wins
+static bool parseTransforms(const QStringList& rules, std::vector<NoteTransformRule>& transforms) {
+    for (const QString& rule : rules) {
+        int separator = rule.indexOf('=');
+        NoteTransformRule parsed;
+        std::string error;
+        if (separator <= 0) {
+            std::cerr << "Expected --transform device=spec, got " << rule.toStdString() << std::endl;
+            return false;
+        }
+        parsed.devicePattern = rule.left(separator).toStdString();
+        if (!NoteTransform::parse(rule.mid(separator + 1).toStdString(), parsed.transform, error)) {
+            std::cerr << "Invalid --transform " << rule.toStdString() << ": " << error << std::endl;
+            return false;
+        }
+        transforms.push_back(parsed);
+    }
+    return true;
+}
+
+// Updates the journals' summary files and prints one line of metrics per student
+static int practiceReport(const QStringList& journals, const std::map<std::string, std::string>& students,
+                          int workerCount) {
+    PracticeAnalytics analytics(&MusicTheoryEngine::instance(), workerCount);
+    analytics.setStudents(students);
+
+    auto start = std::chrono::steady_clock::now();
+    for (const QString& path : journals) {
+        PracticeAnalytics::UpdateStats stats;
+        std::string error;
+        if (!analytics.update(path.toStdString(), stats, error)) {
+            std::cerr << "Failed to update " << path.toStdString() << ": " << error << std::endl;
+            return 1;
+        }
+        std::cout << path.toStdString() << ": " << stats.cachedBytes << " bytes cached, " << stats.newBytes
+                  << " new, " << stats.sessionsUpdated << " sessions updated" << std::endl;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (const PracticeAnalytics::StudentMetrics& entry : analytics.report()) {
+        const PracticeAnalytics::Metrics& metrics = entry.metrics;
+        std::cout << entry.student << ": " << metrics.sessions << " sessions, " << metrics.activeNs / 60000000000LL
+                  << " min, " << static_cast<int>(metrics.notesPerMinute()) << " notes/min, timing spread "
+                  << metrics.timingSpreadPercent() << "%, velocity " << metrics.velocityPercentile(0.1) << "-"
+                  << metrics.velocityPercentile(0.9) << ", " << metrics.chordTypes() << " chord types, "
+                  << metrics.keysPlayed() << "/" << SessionCatalog::KEY_COUNT << " keys" << std::endl;
+    }
+    std::cout << "Updated in " << elapsed << "s" << std::endl;
+    return 0;
+}
+
+// Prints the catalogued sessions matching a query and how long the scan took
+static int queryCatalog(const QString& directory, const SessionCatalog::Query& query) {
+    SessionCatalog catalog;
+    std::string error;
+    if (!catalog.open(directory.toStdString(), error)) {
+        std::cerr << "Failed to open catalog: " << error << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint32_t> rows = catalog.find(query);
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (uint32_t row : rows) {
+        SessionCatalog::Summary summary = catalog.getSummary(row);
+        std::time_t startTime = static_cast<std::time_t>(summary.startWallClockMs / 1000);
+        char date[32];
+        std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M", std::localtime(&startTime));
+
+        int topKey = static_cast<int>(std::max_element(summary.keyShares, summary.keyShares + SessionCatalog::KEY_COUNT)
+                                      - summary.keyShares);
+        std::cout << date << "  " << (summary.student.empty() ? "-" : summary.student) << "  " << summary.device
+                  << "  " << summary.durationMs / 60000 << "min, " << summary.noteCount << " notes, "
+                  << static_cast<int>(summary.tempoBpm + 0.5f) << " bpm, mostly "
+                  << SessionCatalog::keyName(topKey) << " (" << summary.keyShares[topKey] / 10 << "%)" << std::endl;
+    }
+    std::cout << rows.size() << " of " << catalog.getRowCount() << " sessions match (" << elapsedMs << " ms)"
+              << std::endl;
+    return 0;
+}
+
+// Fingerprints every session of the given journals, named <journal>:<session>
+static bool fingerprintJournals(const QStringList& journals,
+                                const std::function<void(const std::string&, const std::vector<uint32_t>&)>& visit) {
+    MusicTheoryEngine* theoryEngine = &MusicTheoryEngine::instance();
+    for (const QString& path : journals) {
+        JournalReader journal;
+        std::string error;
+        if (!journal.open(path, error)) {
+            std::cerr << "Failed to open journal: " << error << std::endl;
+            return false;
+        }
+        for (const JournalReader::SessionInfo& info : journal.getSessions()) {
+            Fingerprinter fingerprinter(theoryEngine);
+            journal.forEachMidi(info.sessionId, [&](int64_t timeNs, const unsigned char* data, size_t size) {
+                fingerprinter.process(timeNs, data, size);
+            });
+            visit(path.toStdString() + ":" + info.name, fingerprinter.finish());
+        }
+    }
+    return true;
+}
+
+static int buildFingerprintIndex(const QString& indexPath, const QStringList& journals) {
+    FingerprintIndexWriter index;
+    size_t hashes = 0;
+    bool ok = fingerprintJournals(journals, [&](const std::string& name, const std::vector<uint32_t>& fingerprint) {
+        index.addPiece(name, fingerprint);
+        hashes += fingerprint.size();
+    });
+    if (!ok) return 1;
+
+    std::string error;
+    if (!index.write(indexPath.toStdString(), error)) {
+        std::cerr << "Failed to write fingerprint index: " << error << std::endl;
+        return 1;
+    }
+    std::cout << index.getPieceCount() << " pieces, " << hashes << " hashes -> " << indexPath.toStdString() << std::endl;
+    return 0;
+}
+
+// Reports the closest indexed pieces for every journal session
+static int queryFingerprintIndex(const QString& indexPath, const QStringList& journals) {
+    FingerprintIndex index;
+    std::string error;
+    if (!index.open(indexPath, error)) {
+        std::cerr << "Failed to open fingerprint index: " << error << std::endl;
+        return 1;
+    }
+
+    bool ok = fingerprintJournals(journals, [&](const std::string& name, const std::vector<uint32_t>& fingerprint) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<FingerprintIndex::Match> matches = index.search(fingerprint, 3);
+        double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "[" << name << "] " << fingerprint.size() << " hashes, " << elapsedMs << " ms" << std::endl;
+        for (const FingerprintIndex::Match& match : matches) {
+            std::cout << "  " << index.getPieceName(match.piece) << ": " << static_cast<int>(match.containment * 100)
+                      << "% of the performance, similarity " << match.similarity << std::endl;
+        }
+    });
+    return ok ? 0 : 1;
+}
+
+// True for "--name" and "--name=value"
+static bool isOption(const char* arg, const char* option) {
+    size_t length = std::strlen(option);
+    return std::strncmp(arg, option, length) == 0 && (arg[length] == '\0' || arg[length] == '=');
+}
 
 int main(int argc, char *argv[])
 {
-    QApplication app(argc, argv);
+    // Server mode and offline analysis run headless, so pick the application type before parsing
+    static const char* const headlessOptions[] = {
+        "--server", "--inspect-journal", "--analyze-audio", "--align-audio", "--archive-journal",
+        "--inspect-archive", "--query-catalog", "--fingerprint-build", "--fingerprint-query",
+        "--practice-journal", "--export-smf", "--export-leadsheet",
+#ifdef MIDI_MONITOR_ALSA
+        "--midi-bench",
+#endif
+    };
+    bool headless = false;
+    for (int i = 1; i < argc && std::strcmp(argv[i], "--") != 0; i++) {
+        for (const char* option : headlessOptions) {
+            if (isOption(argv[i], option)) {
+                headless = true;
+            }
+        }
+    }
+    std::unique_ptr<QCoreApplication> app(headless ? new QCoreApplication(argc, argv)
+                                                     : new QApplication(argc, argv));
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Real-time MIDI keyboard analysis");
+    parser.addHelpOption();
+    
+    QCommandLineOption listenOption("rtpmidi-listen", "Accept RTP-MIDI sessions on <port> (data on port + 1).", "port");
+    QCommandLineOption inviteOption("rtpmidi-invite", "Invite the RTP-MIDI session at <host:port>.", "host:port");
+    QCommandLineOption nameOption("rtpmidi-name", "RTP-MIDI session name.", "name", "MIDI Keyboard Monitor");
+    QCommandLineOption jitterOption("rtpmidi-jitter", "Jitter buffer: 'adaptive' or 'fixed:<ms>'.", "mode", "adaptive");
+    QCommandLineOption patternOption("rtpmidi-test-pattern", "Send a test chord progression every <ms> to peers.", "ms");
+    QCommandLineOption serverOption("server", "Run headless, one analysis session per RTP-MIDI participant.");
+    QCommandLineOption workersOption("server-workers", "Worker threads for server mode (default: all cores).", "count");
+    QCommandLineOption keyOption("server-key", "Key signature index used by server sessions.", "index", "0");
+    QCommandLineOption statsOption("server-stats", "Print session statistics every <ms> (0 = off).", "ms", "10000");
+    QCommandLineOption pluginOption("plugin", "Load an analyzer plugin (repeatable, server mode).", "path");
+    QCommandLineOption pluginConfigOption("plugin-config", "Configuration string passed to every plugin.", "config");
+    QCommandLineOption pluginBudgetOption("plugin-budget-us", "Time budget per plugin call in microseconds.", "us", "500");
+    QCommandLineOption outputOption("output", "Stream server records as 'jsonl' or 'binary'.", "format");
+    QCommandLineOption outputFileOption("output-file", "Record destination ('-' = stdout).", "path", "-");
+    QCommandLineOption checkpointOption("checkpoint-interval", "Binary journal checkpoint every <ms> (0 = off).", "ms", "10000");
+    QCommandLineOption snapshotFileOption("snapshot-file", "Keep crash-recovery snapshots of all sessions in <path>.", "path");
+    QCommandLineOption snapshotIntervalOption("snapshot-interval", "Rewrite the snapshot file every <ms>.", "ms", "5000");
+    QCommandLineOption restoreOption("restore", "Resume sessions from a snapshot file, matched by name.", "path");
+    QCommandLineOption inspectOption("inspect-journal", "Print the session states recorded in a binary journal.", "path");
+    QCommandLineOption inspectAtOption("inspect-at", "Seconds into the journal to inspect.", "seconds", "0");
+    QCommandLineOption audioOption("analyze-audio", "Transcribe a WAV recording and analyze its chords (repeatable).", "path");
+    QCommandLineOption alignAudioOption("align-audio", "Align the onsets of a WAV recording with --align-journal.", "path");
+    QCommandLineOption alignJournalOption("align-journal", "Binary journal holding the MIDI of the same performance.", "path");
+    QCommandLineOption alignSessionOption("align-session", "Journal session id to align (default: the first).", "id", "-1");
+    QCommandLineOption auditionOption("audition-wav", "Play notes and chords through the built-in synth into a WAV file.", "path");
+    QCommandLineOption auditionRateOption("audition-rate", "Audition sample rate.", "hz", "48000");
+    QCommandLineOption archiveOption("archive-journal", "Convert every session of a binary journal to a compact archive.", "path");
+    QCommandLineOption archivePrefixOption("archive-prefix", "Archive file prefix; the session id and .marc are appended.", "prefix", "session-");
+    QCommandLineOption smfOption("export-smf", "Export every session of a binary journal as a Standard MIDI File.", "path");
+    QCommandLineOption smfPrefixOption("smf-prefix", "MIDI file prefix; the session id and .mid are appended.", "prefix", "session-");
+    QCommandLineOption leadSheetOption("export-leadsheet", "Export every session of a binary journal as a MusicXML lead sheet.", "path");
+    QCommandLineOption leadSheetPrefixOption("leadsheet-prefix", "Lead sheet file prefix; the session id and .musicxml are appended.", "prefix", "session-");
+    QCommandLineOption leadSheetTempoOption("leadsheet-tempo", "Lead sheet tempo (default: estimated per session).", "bpm", "0");
+    QCommandLineOption stuckNoteOption("stuck-note-timeout", "Release notes held this long with no activity from their port (0 = never).", "seconds", "60");
+    QCommandLineOption transformOption("transform",
+        "Velocity curve, split, transposition, channel map or key range for devices whose name contains <device> "
+        "(repeatable), e.g. Keystation=curve:0.7,transpose:-12,split:48:2,range:21-108.", "device=spec");
+    QCommandLineOption inspectArchiveOption("inspect-archive", "Decode an event archive and report its contents.", "path");
+    QCommandLineOption catalogOption("catalog", "Add a summary of every closed session to the catalog in <dir>.", "dir");
+    QCommandLineOption studentOption("student", "Tag a session's catalog entry with a student (repeatable).", "device=name");
+    QCommandLineOption queryCatalogOption("query-catalog", "Search the session catalog in <dir>.", "dir");
+    QCommandLineOption queryDaysOption("query-days", "Only sessions started in the last <days>.", "days");
+    QCommandLineOption queryStudentOption("query-student", "Only sessions of this student.", "name");
+    QCommandLineOption queryDeviceOption("query-device", "Only sessions from this device.", "name");
+    QCommandLineOption queryNotesOption("query-min-notes", "Only sessions with at least <count> notes.", "count", "0");
+    QCommandLineOption queryFlatOption("query-min-flat", "Minimum share of time in flat keys (0-1).", "share", "0");
+    QCommandLineOption querySharpOption("query-min-sharp", "Minimum share of time in sharp keys (0-1).", "share", "0");
+    QCommandLineOption queryQualityOption("query-quality", "Minimum share of chords of a quality, e.g. 'diminished:0.1'.",
+                                          "quality[:share]");
+    QCommandLineOption fingerprintBuildOption("fingerprint-build", "Write a fingerprint index of --fingerprint-journal sessions.", "path");
+    QCommandLineOption fingerprintQueryOption("fingerprint-query", "Identify --fingerprint-journal sessions against an index.", "path");
+    QCommandLineOption fingerprintJournalOption("fingerprint-journal", "Binary journal to fingerprint (repeatable).", "path");
+    QCommandLineOption practiceOption("practice-journal", "Report per-student practice metrics from a journal (repeatable).", "path");
+    parser.addOption(listenOption);
+    parser.addOption(inviteOption);
+    parser.addOption(nameOption);
+    parser.addOption(jitterOption);
+    parser.addOption(patternOption);
+    parser.addOption(serverOption);
+    parser.addOption(workersOption);
+    parser.addOption(keyOption);
+    parser.addOption(statsOption);
+    parser.addOption(pluginOption);
+    parser.addOption(pluginConfigOption);
+    parser.addOption(pluginBudgetOption);
+    parser.addOption(outputOption);
+    parser.addOption(outputFileOption);
+    parser.addOption(checkpointOption);
+    parser.addOption(snapshotFileOption);
+    parser.addOption(snapshotIntervalOption);
+    parser.addOption(restoreOption);
+    parser.addOption(inspectOption);
+    parser.addOption(inspectAtOption);
+    parser.addOption(audioOption);
+    parser.addOption(alignAudioOption);
+    parser.addOption(alignJournalOption);
+    parser.addOption(alignSessionOption);
+    parser.addOption(auditionOption);
+    parser.addOption(auditionRateOption);
+    parser.addOption(archiveOption);
+    parser.addOption(archivePrefixOption);
+    parser.addOption(smfOption);
+    parser.addOption(smfPrefixOption);
+    parser.addOption(leadSheetOption);
+    parser.addOption(leadSheetPrefixOption);
+    parser.addOption(leadSheetTempoOption);
+    parser.addOption(stuckNoteOption);
+    parser.addOption(transformOption);
+    parser.addOption(inspectArchiveOption);
+    parser.addOption(catalogOption);
+    parser.addOption(studentOption);
+    parser.addOption(queryCatalogOption);
+    parser.addOption(queryDaysOption);
+    parser.addOption(queryStudentOption);
+    parser.addOption(queryDeviceOption);
+    parser.addOption(queryNotesOption);
+    parser.addOption(queryFlatOption);
+    parser.addOption(querySharpOption);
+    parser.addOption(queryQualityOption);
+    parser.addOption(fingerprintBuildOption);
+    parser.addOption(fingerprintQueryOption);
+    parser.addOption(fingerprintJournalOption);
+    parser.addOption(practiceOption);
+#ifdef MIDI_MONITOR_ALSA
+    QCommandLineOption alsaInputOption("alsa-input", "Read a sequencer port ('24:0') or rawmidi device ('hw:1,0,0') directly.", "source");
+    QCommandLineOption benchOption("midi-bench", "Measure input latency and CPU of 'rtmidi' or 'alsa' under generated load.", "backend");
+    QCommandLineOption benchRateOption("midi-bench-rate", "Generated notes per second.", "rate", "1000");
+    QCommandLineOption benchSecondsOption("midi-bench-seconds", "Benchmark duration.", "seconds", "10");
+    parser.addOption(alsaInputOption);
+    parser.addOption(benchOption);
+    parser.addOption(benchRateOption);
+    parser.addOption(benchSecondsOption);
+#endif
+    parser.process(*app);
     
+    if (parser.isSet(inspectOption)) {
+        return inspectJournal(parser.value(inspectOption), parser.value(inspectAtOption).toDouble());
+    }
+
+    if (parser.isSet(archiveOption)) {
+        return archiveJournal(parser.value(archiveOption), parser.value(archivePrefixOption));
+    }
+    if (parser.isSet(smfOption)) {
+        return exportSmf(parser.value(smfOption), parser.value(smfPrefixOption));
+    }
+    if (parser.isSet(leadSheetOption)) {
+        return exportLeadSheets(parser.value(leadSheetOption), parser.value(leadSheetPrefixOption),
+                                parser.value(leadSheetTempoOption).toFloat());
+    }
+    if (parser.isSet(inspectArchiveOption)) {
+        return inspectArchive(parser.value(inspectArchiveOption));
+    }
+#ifdef MIDI_MONITOR_ALSA
+    if (parser.isSet(benchOption)) {
+        return benchMidiInput(parser.value(benchOption), parser.value(benchRateOption).toInt(),
+                              parser.value(benchSecondsOption).toInt());
+    }
+#endif
+
+    if (parser.isSet(fingerprintBuildOption)) {
+        return buildFingerprintIndex(parser.value(fingerprintBuildOption), parser.values(fingerprintJournalOption));
+    }
+    if (parser.isSet(fingerprintQueryOption)) {
+        return queryFingerprintIndex(parser.value(fingerprintQueryOption), parser.values(fingerprintJournalOption));
+    }
+
+    if (parser.isSet(queryCatalogOption)) {
+        SessionCatalog::Query query = SessionCatalog::anyQuery();
+        if (parser.isSet(queryDaysOption)) {
+            int64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            query.fromWallClockMs = nowMs - static_cast<int64_t>(parser.value(queryDaysOption).toDouble() * 86400000.0);
+        }
+        query.student = parser.value(queryStudentOption).toStdString();
+        query.device = parser.value(queryDeviceOption).toStdString();
+        query.minNotes = parser.value(queryNotesOption).toUInt();
+        query.minFlatKeyShare = parser.value(queryFlatOption).toFloat();
+        query.minSharpKeyShare = parser.value(querySharpOption).toFloat();
+        if (parser.isSet(queryQualityOption)) {
+            QStringList parts = parser.value(queryQualityOption).split(':');
+            for (int quality = 0; quality < SessionCatalog::QUALITY_COUNT; quality++) {
+                if (parts[0] == SessionCatalog::qualityName(quality)) query.quality = quality;
+            }
+            if (query.quality < 0) {
+                std::cerr << "Unknown chord quality: " << parts[0].toStdString() << std::endl;
+                return 1;
+            }
+            query.minQualityShare = parts.size() > 1 ? parts[1].toFloat() : 0.1f;
+        }
+        return queryCatalog(parser.value(queryCatalogOption), query);
+    }
+
+    if (parser.isSet(alignAudioOption)) {
+        if (!parser.isSet(alignJournalOption)) {
+            std::cerr << "--align-audio needs --align-journal" << std::endl;
+            return 1;
+        }
+        return alignAudio(parser.value(alignAudioOption), parser.value(alignJournalOption),
+                          parser.value(alignSessionOption).toInt());
+    }
+
+    // Record output is shared by the headless modes
+    OutputSink::Format outputFormat = OutputSink::Format::JsonLines;
+    std::string outputPath;
+    if (parser.isSet(outputOption)) {
+        QString format = parser.value(outputOption);
+        if (format == "binary") {
+            outputFormat = OutputSink::Format::Binary;
+        } else if (format != "jsonl") {
+            std::cerr << "Unknown output format: " << format.toStdString() << std::endl;
+            return 1;
+        }
+        outputPath = parser.value(outputFileOption).toStdString();
+
+        // Records own stdout; status messages move to stderr
+        if (outputPath == "-") {
+            std::cout.rdbuf(std::cerr.rdbuf());
+        }
+    }
+    int workerCount = parser.isSet(workersOption)
+        ? parser.value(workersOption).toInt() : static_cast<int>(std::thread::hardware_concurrency());
+
+    if (parser.isSet(practiceOption)) {
+        std::map<std::string, std::string> students;
+        if (!parseStudents(parser.values(studentOption), students)) return 1;
+        return practiceReport(parser.values(practiceOption), students, workerCount);
+    }
+
+    if (parser.isSet(audioOption)) {
+        std::unique_ptr<OutputSink> output;
+        if (!outputPath.empty()) {
+            std::string error;
+            output = OutputSink::create(outputFormat, outputPath, error);
+            if (!output) {
+                std::cerr << "Failed to open output: " << error << std::endl;
+                return 1;
+            }
+        }
+        int status = analyzeAudio(parser.values(audioOption), parser.value(keyOption).toInt(), workerCount, output.get());
+        if (output) {
+            output->flush();
+            if (output->hasWriteFailed()) {
+                std::cerr << "Output incomplete: " << output->getBytesDropped() << " bytes dropped" << std::endl;
+                status = 1;
+            }
+        }
+        return status;
+    }
+
+    if (parser.isSet(serverOption)) {
+        SessionServer::Options options;
+        options.sessionName = parser.value(nameOption);
+        options.listenPort = parser.isSet(listenOption)
+            ? static_cast<quint16>(parser.value(listenOption).toUInt()) : 5004;
+        options.workerCount = workerCount;
+        options.keySignatureIndex = parser.value(keyOption).toInt();
+        options.statsIntervalMs = parser.value(statsOption).toInt();
+        options.jitter = parseJitterConfig(parser.value(jitterOption));
+        for (const QString& path : parser.values(pluginOption)) {
+            options.pluginPaths.push_back(path.toStdString());
+        }
+        options.pluginConfig = parser.value(pluginConfigOption).toStdString();
+        options.pluginLimits = PluginHost::defaultLimits();
+        options.pluginLimits.budgetNs = parser.value(pluginBudgetOption).toLongLong() * 1000;
+        options.outputFormat = outputFormat;
+        options.outputPath = outputPath;
+        options.checkpointIntervalMs = parser.value(checkpointOption).toInt();
+        options.snapshotPath = parser.value(snapshotFileOption).toStdString();
+        options.snapshotIntervalMs = parser.value(snapshotIntervalOption).toInt();
+        options.restorePath = parser.value(restoreOption).toStdString();
+        options.catalogPath = parser.value(catalogOption).toStdString();
+        if (!parseStudents(parser.values(studentOption), options.students)) return 1;
+        if (!parseTransforms(parser.values(transformOption), options.transforms)) return 1;
+        
+        SessionServer server(options);
+        if (!server.start()) {
+            std::cerr << "Failed to start session server" << std::endl;
+            return 1;
+        }
+        return app->exec();
+    }
+    
+    std::vector<NoteTransformRule> transforms;
+    if (!parseTransforms(parser.values(transformOption), transforms)) return 1;
+
+    bool rateValid = false;
+    int auditionRate = parser.value(auditionRateOption).toInt(&rateValid);
+    if (!rateValid || auditionRate < AuditionSynth::MIN_SAMPLE_RATE || auditionRate > AuditionSynth::MAX_SAMPLE_RATE) {
+        std::cerr << "--audition-rate must be between " << AuditionSynth::MIN_SAMPLE_RATE << " and "
+                  << AuditionSynth::MAX_SAMPLE_RATE << " Hz" << std::endl;
+        return 1;
+    }
+
     std::cout << "Starting Keyboard Monitor..." << std::endl;
     
     MidiKeyboardMonitor window;
     window.show();
+    window.setStuckNoteTimeout(parser.value(stuckNoteOption).toDouble());
+    for (const NoteTransformRule& rule : transforms) {
+        window.addTransform(rule.devicePattern, rule.transform);
+    }
     
-    return app.exec();
+#ifdef MIDI_MONITOR_ALSA
+    if (parser.isSet(alsaInputOption) && !window.enableAlsaInput(parser.value(alsaInputOption))) {
+        std::cerr << "Failed to open ALSA input, staying on RtMidi" << std::endl;
+    }
+#endif
+
+    if (parser.isSet(listenOption) || parser.isSet(inviteOption)) {
+        NetworkMidiOptions network;
+        network.sessionName = parser.value(nameOption);
+        network.listenPort = static_cast<quint16>(parser.value(listenOption).toUInt());
+        network.inviteTarget = parser.value(inviteOption);
+        network.testPatternIntervalMs = parser.value(patternOption).toInt();
+        network.jitter = parseJitterConfig(parser.value(jitterOption));
+        
+        if (!window.enableNetworkMidi(network)) {
+            std::cerr << "Failed to start RTP-MIDI session" << std::endl;
+        }
+    }
+    
+    if (parser.isSet(auditionOption)) {
+        window.enableAudition(parser.value(auditionOption), auditionRate);
+    }
+
+    return app->exec();
 }
\ No newline at end of file